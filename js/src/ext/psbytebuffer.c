@@ -0,0 +1,802 @@
+/*
+ * ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is the ProntoScript re-implementation October 4, 2025.
+ *
+ * The Initial Developer of the Original Code is Stefan Sinnige.
+ * Portions created by the Initial Developer are Copyright (C) 2025
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either of the GNU General Public License Version 2 or later (the "GPL"),
+ * or the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK *****
+ */
+
+#include "jsapi.h"
+#include "jscntxt.h"
+#include "jslock.h"
+#include "jsobj.h"
+#include "jsstr.h"
+#include "jstypes.h"
+#include "psbytebuffer.h"
+#include <stddef.h>
+#include <string.h>
+
+/*
+ *Forward declarations
+ */
+static JSBool ByteBuffer_GetProperty(JSContext*, JSObject*, jsval, jsval*);
+static JSBool ByteBuffer_Slice(JSContext*, JSObject*, uintN, jsval*, jsval*);
+static JSBool ByteBuffer_Set(JSContext*, JSObject*, uintN, jsval*, jsval*);
+static JSBool ByteBuffer_ToString(JSContext*, JSObject*, uintN, jsval*, jsval*);
+static JSBool ByteBuffer_GetInt8(JSContext*, JSObject*, uintN, jsval*, jsval*);
+static JSBool ByteBuffer_GetUint8(JSContext*, JSObject*, uintN, jsval*, jsval*);
+static JSBool ByteBuffer_GetInt16(JSContext*, JSObject*, uintN, jsval*, jsval*);
+static JSBool ByteBuffer_GetUint16(JSContext*, JSObject*, uintN, jsval*, jsval*);
+static JSBool ByteBuffer_GetInt32(JSContext*, JSObject*, uintN, jsval*, jsval*);
+static JSBool ByteBuffer_GetUint32(JSContext*, JSObject*, uintN, jsval*, jsval*);
+static JSBool ByteBuffer_SetInt8(JSContext*, JSObject*, uintN, jsval*, jsval*);
+static JSBool ByteBuffer_SetUint8(JSContext*, JSObject*, uintN, jsval*, jsval*);
+static JSBool ByteBuffer_SetInt16(JSContext*, JSObject*, uintN, jsval*, jsval*);
+static JSBool ByteBuffer_SetUint16(JSContext*, JSObject*, uintN, jsval*, jsval*);
+static JSBool ByteBuffer_SetInt32(JSContext*, JSObject*, uintN, jsval*, jsval*);
+static JSBool ByteBuffer_SetUint32(JSContext*, JSObject*, uintN, jsval*, jsval*);
+static JSBool ByteBuffer_CT(JSContext*, JSObject*, uintN, jsval*, jsval*);
+static void   ByteBuffer_DT(JSContext*, JSObject*);
+
+/*
+ * The data of a buffer is kept in a store, which is shared with the slices
+ * of the buffer. The store is released once no buffer refers to it.
+ */
+typedef struct {
+    size_t refs;            /* The number of buffers sharing the store. */
+    char data[1];
+} ByteBufferStore;
+
+/*
+ * The ByteBuffer class private instance data.
+ */
+typedef struct {
+    ByteBufferStore* store; /* The store holding the data. */
+    char* data;             /* The first byte of the buffer in the store. */
+    size_t length;          /* The number of bytes in the buffer. */
+} ByteBuffer;
+
+/**
+ * Definition of the class properties
+ */
+enum bytebuffer_tinyid {
+    BYTEBUFFER_LENGTH = -1
+};
+
+#define BYTEBUFFER_PROP_ATTRS (JSPROP_PERMANENT)
+
+static JSPropertySpec bytebuffer_props[] = {
+    /* { name, tinyid, flags, getter, setter } */
+    {"length", BYTEBUFFER_LENGTH, BYTEBUFFER_PROP_ATTRS | JSPROP_READONLY, 0, 0},
+    {0, 0, 0, 0, 0}
+};
+
+/**
+ * Definition of the class methods
+ */
+static JSFunctionSpec bytebuffer_methods[] = {
+    /* { name, call, nargs, flags, extra } */
+    {"getInt8", ByteBuffer_GetInt8, 1, 0, 0},
+    {"getUint8", ByteBuffer_GetUint8, 1, 0, 0},
+    {"getInt16", ByteBuffer_GetInt16, 2, 0, 0},
+    {"getUint16", ByteBuffer_GetUint16, 2, 0, 0},
+    {"getInt32", ByteBuffer_GetInt32, 2, 0, 0},
+    {"getUint32", ByteBuffer_GetUint32, 2, 0, 0},
+    {"setInt8", ByteBuffer_SetInt8, 2, 0, 0},
+    {"setUint8", ByteBuffer_SetUint8, 2, 0, 0},
+    {"setInt16", ByteBuffer_SetInt16, 3, 0, 0},
+    {"setUint16", ByteBuffer_SetUint16, 3, 0, 0},
+    {"setInt32", ByteBuffer_SetInt32, 3, 0, 0},
+    {"setUint32", ByteBuffer_SetUint32, 3, 0, 0},
+    {"set", ByteBuffer_Set, 2, 0, 0},
+    {"slice", ByteBuffer_Slice, 2, 0, 0},
+    {"toString", ByteBuffer_ToString, 0, 0, 0},
+    {0, 0, 0, 0, 0}
+};
+
+/**
+ * Definition of the class
+ */
+static JSClass bytebuffer_class = {
+    ps_ByteBuffer_str,              /* name */
+    JSCLASS_HAS_PRIVATE,            /* flags */
+    JS_PropertyStub,                /* add property */
+    JS_PropertyStub,                /* del property */
+    ByteBuffer_GetProperty,         /* get property */
+    JS_PropertyStub,                /* set property */
+    JS_EnumerateStub,               /* enumerate */
+    JS_ResolveStub,                 /* resolve */
+    JS_ConvertStub,                 /* convert */
+    ByteBuffer_DT,                  /* finalize */
+    JSCLASS_NO_OPTIONAL_MEMBERS
+};
+
+/*
+ * Attach (part of) a store to an instance, which then shares the store.
+ */
+static JSBool
+ByteBuffer_Attach(JSContext *cx, JSObject *obj, ByteBufferStore* store,
+                  char* data, size_t length)
+{
+    ByteBuffer* buf = NULL;
+    JSBool ok;
+
+    buf = (ByteBuffer*) JS_malloc(cx, sizeof(ByteBuffer));
+    if (!buf) {
+        return JS_FALSE;
+    }
+    buf->store = store;
+    buf->data = data;
+    buf->length = length;
+    JS_LOCK_OBJ(cx, obj);
+    ok = JS_SetPrivate(cx, obj, buf);
+    JS_UNLOCK_OBJ(cx, obj);
+    if (!ok) {
+        JS_free(cx, buf);
+        return JS_FALSE;
+    }
+    ++store->refs;
+    return JS_TRUE;
+}
+
+/*
+ * Create a new store and attach it to an instance.
+ */
+static char*
+ByteBuffer_Alloc(JSContext *cx, JSObject *obj, size_t length)
+{
+    ByteBufferStore* store;
+
+    store = (ByteBufferStore*) JS_malloc(cx,
+            offsetof(ByteBufferStore, data) + length);
+    if (!store) {
+        return NULL;
+    }
+    store->refs = 0;
+    if (!ByteBuffer_Attach(cx, obj, store, store->data, length)) {
+        JS_free(cx, store);
+        return NULL;
+    }
+    return store->data;
+}
+
+static JSBool
+ByteBuffer_GetProperty(JSContext *cx, JSObject *obj, jsval id, jsval *vp)
+{
+    ByteBuffer* buf = NULL;
+    jsint slot;
+
+    /* Get the property's slot */
+    if (!JSVAL_IS_INT(id)) {
+        return JS_TRUE;
+    }
+    slot = JSVAL_TO_INT(id);
+
+    /* Get the value */
+    JS_LOCK_OBJ(cx, obj);
+    buf = (ByteBuffer*)JS_GetInstancePrivate(cx, obj, &bytebuffer_class, NULL);
+    if (buf) {
+        switch (slot) {
+            case BYTEBUFFER_LENGTH:
+                *vp = INT_TO_JSVAL(buf->length);
+                break;
+            default:
+                break;
+        }
+    }
+    JS_UNLOCK_OBJ(cx, obj);
+    return JS_TRUE;
+}
+
+/**
+ * Synopsis:
+ *      ByteBuffer(size)
+ *      ByteBuffer(data)
+ * Purpose:
+ *      Create a new ByteBuffer instance.
+ * Parameters:
+ *      size    Integer
+ *              The number of bytes in the buffer, which are all zero.
+ *      data    String
+ *              The bytes of the buffer, each character of the string is a
+ *              byte.
+ * Returns:
+ *      A new ByteBuffer instance.
+ * Exceptions:
+ *      Not enough arguments specified
+ *      Argument is not an integer
+ *      Argument is not a positive integer number
+ */
+static JSBool
+ByteBuffer_CT(JSContext* cx, JSObject *obj, uintN argc, jsval *argv,
+              jsval *rval)
+{
+    JSString* str = NULL;
+    const jschar* chars;
+    size_t length;
+    char* data;
+
+    /* Create the object */
+    if (!obj) {
+        obj = js_NewObject(cx, &bytebuffer_class, NULL, NULL);
+        if (!obj) {
+            return JS_FALSE;
+        }
+    }
+
+    /* Get the 'size' or 'data' argument */
+    if (argc < 1) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_NOT_ENOUGH_ARGUMENTS);
+        return JS_FALSE;
+    }
+    if (JS_TypeOfValue(cx, argv[0]) == JSTYPE_STRING) {
+        str = JSVAL_TO_STRING(argv[0]);
+        length = JSSTRING_LENGTH(str);
+    }
+    else if (!JSVAL_IS_INT(argv[0])) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_ARGUMENT_NOT_INT);
+        return JS_FALSE;
+    }
+    else if (JSVAL_TO_INT(argv[0]) < 0) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_ARGUMENT_NOT_POSITIVE_INT);
+        return JS_FALSE;
+    }
+    else {
+        length = JSVAL_TO_INT(argv[0]);
+    }
+
+    /* Set the private instance data */
+    data = ByteBuffer_Alloc(cx, obj, length);
+    if (!data) {
+        return JS_FALSE;
+    }
+    if (str) {
+        chars = JSSTRING_CHARS(str);
+        for (size_t i = 0; i < length; ++i) {
+            data[i] = (char) chars[i];
+        }
+    }
+    else {
+        memset(data, 0, length);
+    }
+    return JS_TRUE;
+}
+
+/**
+ * Destructor.
+ */
+static void
+ByteBuffer_DT(JSContext* cx, JSObject *obj)
+{
+    ByteBuffer* buf = NULL;
+
+    buf = (ByteBuffer*)JS_GetInstancePrivate(cx, obj, &bytebuffer_class, NULL);
+    if (buf) {
+        if (--buf->store->refs == 0) {
+            JS_free(cx, buf->store);
+        }
+        JS_free(cx, buf);
+    }
+}
+
+/*
+ * Get the index of a value of the given size in the buffer.
+ */
+static JSBool
+ByteBuffer_Index(JSContext *cx, ByteBuffer* buf, jsval v, size_t size,
+                 size_t* index)
+{
+    if (!JSVAL_IS_INT(v)) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_ARGUMENT_NOT_INT);
+        return JS_FALSE;
+    }
+    if (JSVAL_TO_INT(v) < 0 || JSVAL_TO_INT(v) + size > buf->length) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_ARGUMENT_OUT_OF_RANGE);
+        return JS_FALSE;
+    }
+    *index = JSVAL_TO_INT(v);
+    return JS_TRUE;
+}
+
+/*
+ * Get an integer of 1, 2 or 4 bytes, in big-endian byte order unless the
+ * optional second argument is true.
+ */
+static JSBool
+ByteBuffer_Get(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
+               jsval *rval, size_t size, JSBool sign)
+{
+    ByteBuffer* buf = NULL;
+    const unsigned char* bytes;
+    JSBool little = JS_FALSE;
+    JSUint32 value = 0;
+    size_t index;
+
+    buf = (ByteBuffer*) JS_GetPrivate(cx, obj);
+    if (!buf) {
+        return JS_FALSE;
+    }
+
+    /*
+     * Extract the parameters
+     */
+    if (argc < 1) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_NOT_ENOUGH_ARGUMENTS);
+        return JS_FALSE;
+    }
+    if (!ByteBuffer_Index(cx, buf, argv[0], size, &index)) {
+        return JS_FALSE;
+    }
+    if (argc > 1 && !JS_ValueToBoolean(cx, argv[1], &little)) {
+        return JS_FALSE;
+    }
+
+    /*
+     * Get the value
+     */
+    bytes = (const unsigned char*) buf->data + index;
+    for (size_t i = 0; i < size; ++i) {
+        value = (value << 8) | bytes[little ? size - 1 - i : i];
+    }
+    if (!sign) {
+        return JS_NewNumberValue(cx, (jsdouble) value, rval);
+    }
+    switch (size) {
+        case 1:
+            *rval = INT_TO_JSVAL((JSInt8) value);
+            return JS_TRUE;
+        case 2:
+            *rval = INT_TO_JSVAL((JSInt16) value);
+            return JS_TRUE;
+        default:
+            return JS_NewNumberValue(cx, (jsdouble) (JSInt32) value, rval);
+    }
+}
+
+/*
+ * Set an integer of 1, 2 or 4 bytes, in big-endian byte order unless the
+ * optional third argument is true. The value is truncated to its size, so
+ * the signed and unsigned forms store the same bytes.
+ */
+static JSBool
+ByteBuffer_Put(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
+               size_t size)
+{
+    ByteBuffer* buf = NULL;
+    unsigned char* bytes;
+    JSBool little = JS_FALSE;
+    uint32 value;
+    size_t index;
+
+    buf = (ByteBuffer*) JS_GetPrivate(cx, obj);
+    if (!buf) {
+        return JS_FALSE;
+    }
+
+    /*
+     * Extract the parameters
+     */
+    if (argc < 2) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_NOT_ENOUGH_ARGUMENTS);
+        return JS_FALSE;
+    }
+    if (!ByteBuffer_Index(cx, buf, argv[0], size, &index)) {
+        return JS_FALSE;
+    }
+    if (!JS_ValueToECMAUint32(cx, argv[1], &value)) {
+        return JS_FALSE;
+    }
+    if (argc > 2 && !JS_ValueToBoolean(cx, argv[2], &little)) {
+        return JS_FALSE;
+    }
+
+    /*
+     * Set the value
+     */
+    bytes = (unsigned char*) buf->data + index;
+    for (size_t i = 0; i < size; ++i) {
+        bytes[little ? i : size - 1 - i] = (unsigned char) value;
+        value >>= 8;
+    }
+    return JS_TRUE;
+}
+
+/**
+ * Synopsis:
+ *      getInt8(index)
+ *      getUint8(index)
+ *      getInt16(index[, littleEndian])
+ *      getUint16(index[, littleEndian])
+ *      getInt32(index[, littleEndian])
+ *      getUint32(index[, littleEndian])
+ * Purpose:
+ *      Get a signed or unsigned integer of 8, 16 or 32 bits.
+ * Parameters:
+ *      index           Integer
+ *              The index of the first byte of the integer.
+ *      littleEndian    Boolean (opt)
+ *              True if the integer is stored in little-endian byte order,
+ *              otherwise it is in big-endian (network) byte order.
+ * Returns:
+ *      Integer The value of the integer.
+ * Exceptions:
+ *      Not enough arguments specified
+ *      Argument is not an integer
+ *      Argument out of range
+ */
+static JSBool
+ByteBuffer_GetInt8(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
+                   jsval *rval)
+{
+    return ByteBuffer_Get(cx, obj, argc, argv, rval, 1, JS_TRUE);
+}
+
+static JSBool
+ByteBuffer_GetUint8(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
+                    jsval *rval)
+{
+    return ByteBuffer_Get(cx, obj, argc, argv, rval, 1, JS_FALSE);
+}
+
+static JSBool
+ByteBuffer_GetInt16(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
+                    jsval *rval)
+{
+    return ByteBuffer_Get(cx, obj, argc, argv, rval, 2, JS_TRUE);
+}
+
+static JSBool
+ByteBuffer_GetUint16(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
+                     jsval *rval)
+{
+    return ByteBuffer_Get(cx, obj, argc, argv, rval, 2, JS_FALSE);
+}
+
+static JSBool
+ByteBuffer_GetInt32(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
+                    jsval *rval)
+{
+    return ByteBuffer_Get(cx, obj, argc, argv, rval, 4, JS_TRUE);
+}
+
+static JSBool
+ByteBuffer_GetUint32(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
+                     jsval *rval)
+{
+    return ByteBuffer_Get(cx, obj, argc, argv, rval, 4, JS_FALSE);
+}
+
+/**
+ * Synopsis:
+ *      setInt8(index, value)
+ *      setUint8(index, value)
+ *      setInt16(index, value[, littleEndian])
+ *      setUint16(index, value[, littleEndian])
+ *      setInt32(index, value[, littleEndian])
+ *      setUint32(index, value[, littleEndian])
+ * Purpose:
+ *      Set a signed or unsigned integer of 8, 16 or 32 bits.
+ * Parameters:
+ *      index           Integer
+ *              The index of the first byte of the integer.
+ *      value           Integer
+ *              The value of the integer, which is truncated to its size.
+ *      littleEndian    Boolean (opt)
+ *              True if the integer is to be stored in little-endian byte
+ *              order, otherwise it is in big-endian (network) byte order.
+ * Exceptions:
+ *      Not enough arguments specified
+ *      Argument is not an integer
+ *      Argument out of range
+ */
+static JSBool
+ByteBuffer_SetInt8(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
+                   jsval *rval)
+{
+    return ByteBuffer_Put(cx, obj, argc, argv, 1);
+}
+
+static JSBool
+ByteBuffer_SetUint8(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
+                    jsval *rval)
+{
+    return ByteBuffer_Put(cx, obj, argc, argv, 1);
+}
+
+static JSBool
+ByteBuffer_SetInt16(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
+                    jsval *rval)
+{
+    return ByteBuffer_Put(cx, obj, argc, argv, 2);
+}
+
+static JSBool
+ByteBuffer_SetUint16(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
+                     jsval *rval)
+{
+    return ByteBuffer_Put(cx, obj, argc, argv, 2);
+}
+
+static JSBool
+ByteBuffer_SetInt32(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
+                    jsval *rval)
+{
+    return ByteBuffer_Put(cx, obj, argc, argv, 4);
+}
+
+static JSBool
+ByteBuffer_SetUint32(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
+                     jsval *rval)
+{
+    return ByteBuffer_Put(cx, obj, argc, argv, 4);
+}
+
+/**
+ * Synopsis:
+ *      slice(begin[, end])
+ * Purpose:
+ *      Get a part of the buffer, which shares its bytes with the buffer.
+ * Parameters:
+ *      begin   Integer
+ *              The index of the first byte of the part. A negative index
+ *              counts from the end of the buffer.
+ *      end     Integer (opt)
+ *              The index following the last byte of the part. A negative
+ *              index counts from the end of the buffer. If omitted, the part
+ *              extends to the end of the buffer.
+ * Returns:
+ *      ByteBuffer  The part of the buffer. Changing its bytes changes those
+ *              of the buffer, and vice versa.
+ * Exceptions:
+ *      Not enough arguments specified
+ *      Argument is not an integer
+ */
+static JSBool
+ByteBuffer_Slice(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
+                 jsval *rval)
+{
+    ByteBuffer* buf = NULL;
+    JSObject* slice;
+    jsint length, begin, end;
+
+    buf = (ByteBuffer*) JS_GetPrivate(cx, obj);
+    if (!buf) {
+        return JS_FALSE;
+    }
+
+    /*
+     * Extract the parameters, clamped to the buffer.
+     */
+    if (argc < 1) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_NOT_ENOUGH_ARGUMENTS);
+        return JS_FALSE;
+    }
+    if (!JSVAL_IS_INT(argv[0]) ||
+        (argc > 1 && !JSVAL_IS_VOID(argv[1]) && !JSVAL_IS_INT(argv[1])))
+    {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_ARGUMENT_NOT_INT);
+        return JS_FALSE;
+    }
+    length = (jsint) buf->length;
+    begin = JSVAL_TO_INT(argv[0]);
+    end = (argc > 1 && !JSVAL_IS_VOID(argv[1])) ? JSVAL_TO_INT(argv[1])
+                                                 : length;
+    if (begin < 0) {
+        begin = JS_MAX(0, length + begin);
+    }
+    if (end < 0) {
+        end = JS_MAX(0, length + end);
+    }
+    begin = JS_MIN(begin, length);
+    end = JS_MIN(JS_MAX(begin, end), length);
+
+    /*
+     * Create the slice, sharing the store.
+     */
+    slice = js_NewObject(cx, &bytebuffer_class, NULL, NULL);
+    if (!slice) {
+        return JS_FALSE;
+    }
+    *rval = OBJECT_TO_JSVAL(slice);
+    return ByteBuffer_Attach(cx, slice, buf->store, buf->data + begin,
+                             end - begin);
+}
+
+/**
+ * Synopsis:
+ *      set(data[, index])
+ * Purpose:
+ *      Copy bytes into the buffer.
+ * Parameters:
+ *      data    ByteBuffer or String
+ *              The bytes to copy. Each character of a string is a byte.
+ *      index   Integer (opt)
+ *              The index in the buffer to copy the bytes to. If omitted, the
+ *              bytes are copied to the start of the buffer.
+ * Exceptions:
+ *      Not enough arguments specified
+ *      Argument is not a string
+ *      Argument is not an integer
+ *      Argument out of range
+ */
+static JSBool
+ByteBuffer_Set(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
+               jsval *rval)
+{
+    ByteBuffer* buf = NULL;
+    JSString* str = NULL;
+    const char* bytes = NULL;
+    size_t length;
+    size_t index = 0;
+
+    buf = (ByteBuffer*) JS_GetPrivate(cx, obj);
+    if (!buf) {
+        return JS_FALSE;
+    }
+
+    /*
+     * Extract the parameters
+     */
+    if (argc < 1) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_NOT_ENOUGH_ARGUMENTS);
+        return JS_FALSE;
+    }
+    if (JS_TypeOfValue(cx, argv[0]) == JSTYPE_STRING) {
+        str = JSVAL_TO_STRING(argv[0]);
+        length = JSSTRING_LENGTH(str);
+    }
+    else {
+        bytes = ps_GetByteBufferData(cx, argv[0], &length);
+        if (!bytes) {
+            JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                                 PSMSG_ARGUMENT_NOT_STRING);
+            return JS_FALSE;
+        }
+    }
+    if (argc > 1 && !ByteBuffer_Index(cx, buf, argv[1], 0, &index)) {
+        return JS_FALSE;
+    }
+    if (index + length > buf->length) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_ARGUMENT_OUT_OF_RANGE);
+        return JS_FALSE;
+    }
+
+    /*
+     * Copy the bytes, which may overlap when they share the store.
+     */
+    if (str) {
+        const jschar* chars = JSSTRING_CHARS(str);
+        for (size_t i = 0; i < length; ++i) {
+            buf->data[index + i] = (char) chars[i];
+        }
+    }
+    else {
+        memmove(buf->data + index, bytes, length);
+    }
+    return JS_TRUE;
+}
+
+/**
+ * Synopsis:
+ *      toString()
+ * Purpose:
+ *      Get the bytes of the buffer as a string.
+ * Parameters:
+ *      None
+ * Returns:
+ *      String  The bytes of the buffer, each byte is a character.
+ */
+static JSBool
+ByteBuffer_ToString(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
+                    jsval *rval)
+{
+    ByteBuffer* buf = NULL;
+    jschar* chars;
+    JSString* str;
+
+    buf = (ByteBuffer*) JS_GetPrivate(cx, obj);
+    if (!buf) {
+        return JS_FALSE;
+    }
+    chars = (jschar*) JS_malloc(cx, (buf->length + 1) * sizeof(jschar));
+    if (!chars) {
+        return JS_FALSE;
+    }
+    for (size_t i = 0; i < buf->length; ++i) {
+        chars[i] = (unsigned char) buf->data[i];
+    }
+    chars[buf->length] = 0;
+    str = JS_NewUCString(cx, chars, buf->length);
+    if (!str) {
+        JS_free(cx, chars);
+        return JS_FALSE;
+    }
+    *rval = STRING_TO_JSVAL(str);
+    return JS_TRUE;
+}
+
+JSObject*
+ps_NewByteBuffer(JSContext *cx, size_t length, char **data)
+{
+    JSObject* obj;
+
+    obj = js_NewObject(cx, &bytebuffer_class, NULL, NULL);
+    if (!obj) {
+        return NULL;
+    }
+    *data = ByteBuffer_Alloc(cx, obj, length);
+    return *data ? obj : NULL;
+}
+
+char*
+ps_GetByteBufferData(JSContext *cx, jsval v, size_t *length)
+{
+    ByteBuffer* buf = NULL;
+
+    if (JSVAL_IS_PRIMITIVE(v)) {
+        return NULL;
+    }
+    buf = (ByteBuffer*)JS_GetInstancePrivate(cx, JSVAL_TO_OBJECT(v),
+                                              &bytebuffer_class, NULL);
+    if (!buf) {
+        return NULL;
+    }
+    *length = buf->length;
+    return buf->data;
+}
+
+/**
+ * ByteBuffer class initialiser.
+ */
+JSObject*
+ps_InitByteBufferClass(JSContext *cx, JSObject *obj)
+{
+    JSObject *proto;
+
+    proto = JS_InitClass(cx, obj, NULL, &bytebuffer_class, ByteBuffer_CT, 1,
+                         bytebuffer_props, bytebuffer_methods, NULL, NULL);
+    if (!proto) {
+        return NULL;
+    }
+    return proto;
+}
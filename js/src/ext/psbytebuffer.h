@@ -0,0 +1,71 @@
+/*
+ * ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is the ProntoScript re-implementation October 4, 2025.
+ *
+ * The Initial Developer of the Original Code is Stefan Sinnige.
+ * Portions created by the Initial Developer are Copyright (C) 2025
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either of the GNU General Public License Version 2 or later (the "GPL"),
+ * or the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK *****
+ */
+
+#ifndef psbytebuffer_h___
+#define psbytebuffer_h___
+
+#include "jsprvtd.h"
+#include "jspubtd.h"
+#include <stddef.h>
+
+/*
+ * ProntoScipt ByteBuffer class.
+ *
+ * A ByteBuffer holds a fixed number of bytes, which the sockets receive into
+ * and send from directly. Unlike a string, each byte takes a single byte of
+ * memory and is never converted. Slices of a ByteBuffer share its data.
+ */
+
+JS_BEGIN_EXTERN_C
+
+/* Initialise the JavaScript 'ByteBuffer' class.  */
+extern JSObject *
+ps_InitByteBufferClass(JSContext *cx, JSObject *obj);
+
+/* Create a ByteBuffer of the given length. Its data, which is not
+ * initialised, is returned to be filled in. Returns NULL on failure. */
+extern JSObject *
+ps_NewByteBuffer(JSContext *cx, size_t length, char **data);
+
+/* Get the data and length of a ByteBuffer. Returns NULL if the value is not
+ * a ByteBuffer. */
+extern char *
+ps_GetByteBufferData(JSContext *cx, jsval v, size_t *length);
+
+JS_END_EXTERN_C
+
+#endif /* psbytebuffer_h___ */
@@ -0,0 +1,1183 @@
+/*
+ * ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is the ProntoScript re-implementation October 4, 2025.
+ *
+ * The Initial Developer of the Original Code is Stefan Sinnige.
+ * Portions created by the Initial Developer are Copyright (C) 2025
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either of the GNU General Public License Version 2 or later (the "GPL"),
+ * or the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK *****
+ */
+
+#include "jsapi.h"
+#include "jscntxt.h"
+#include "jsfun.h"
+#include "jshash.h"
+#include "jslock.h"
+#include "jstypes.h"
+#include "psdnsresolver.h"
+#include "psselect.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ *Forward declarations
+ */
+static JSBool DNSResolver_GetProperty(JSContext*, JSObject*, jsval, jsval*);
+static JSBool DNSResolver_SetProperty(JSContext*, JSObject*, jsval, jsval*);
+static JSBool DNSResolver_Resolve(JSContext*, JSObject*, uintN, jsval*, jsval*);
+static JSBool DNSResolver_CT(JSContext*, JSObject*, uintN, jsval*, jsval*);
+static void   DNSResolver_DT(JSContext*, JSObject*);
+static uint32 DNSResolver_Mark(JSContext*, JSObject*, void*);
+static JSBool DNSResolver_Invoke(JSContext*, JSObject*, jsval, uintN, jsval*);
+
+/*
+ * Host names are resolved by a small pool of worker threads. The resolver
+ * does not report the time-to-live of the records, so the results are cached
+ * for a fixed duration (in seconds). Only the host names that do not exist
+ * are cached as failures, other failures may be temporary.
+ */
+#define PS_DNS_THREADS 4
+#define PS_DNS_TTL 60
+#define PS_DNS_NEGATIVE_TTL 5
+#define PS_DNS_CACHE_SIZE 256
+
+/*
+ * A cached resolution.
+ */
+typedef struct _PSHostEntry {
+    PSAddressList addrs;    /* The addresses. */
+    int error;              /* The resolver error, or 0 on success. */
+    time_t expires;         /* The time the entry expires. */
+    char name[1];           /* The host name. */
+} PSHostEntry;
+
+/*
+ * The resolution of a host name, shared by all the requests for the same
+ * host name. A lookup is queued for the worker threads and moved to the done
+ * list once it has been resolved, unless its outcome is known already.
+ */
+typedef struct _PSLookup {
+    struct _PSLookup* next;         /* The next queued or done lookup. */
+    struct _PSLookup* pending;      /* The next lookup being resolved. */
+    PSResolveRequest* requests;     /* The requests waiting for it. */
+    JSBool known;                   /* True if it has not been resolved. */
+    PSAddressList addrs;            /* The addresses. */
+    int error;                      /* The resolver error, or 0. */
+    int syserror;                   /* The system error for EAI_SYSTEM. */
+    char name[1];                   /* The host name. */
+} PSLookup;
+
+struct _PSResolveRequest {
+    struct _PSResolveRequest* next; /* The next request of the lookup. */
+    PSLookup* lookup;               /* The lookup the request waits for, or
+                                       NULL if it is never answered. */
+    JSObject* obj;                  /* The object passed to the callback. */
+    PSResolveCallback func;         /* The IPv4 callback function, or */
+    PSResolveAddressesCallback funcs; /* the callback for all addresses. */
+};
+
+/* Shared with the worker threads. */
+static pthread_mutex_t ps_DnsLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ps_DnsCond = PTHREAD_COND_INITIALIZER;
+static PSLookup* ps_DnsQueue = NULL;
+static PSLookup* ps_DnsQueueTail = NULL;
+static PSLookup* ps_DnsDone = NULL;
+static int ps_DnsThreads = 0;
+static int ps_DnsIdle = 0;
+static int ps_DnsPipe[2] = {-1, -1};
+
+/* Only used by the interpreter thread. */
+static PSLookup* ps_DnsPending = NULL;
+static int ps_DnsRequests = 0;
+static JSHashTable* ps_DnsCache = NULL;
+
+/*
+ * The DNSResolver class private instance data.
+ */
+
+typedef struct {
+    JSObject* self;         /* The instance, rooted while resolving. */
+    JSBool blocking;        /* True if blocking resolution is to be used. */
+    jsval onResolve;        /* The on-resolve callback function. */
+    jsval onIOError;        /* The on-error callback function. */
+    int pending;            /* The number of pending resolutions. */
+} DNSResolver;
+
+/**
+ * Definition of the class properties
+ */
+enum dnsresolver_tinyid {
+    DNSRESOLVER_ONRESOLVE = -1,
+    DNSRESOLVER_ONIOERROR = -2
+};
+
+#define DNSRESOLVER_PROP_ATTRS (JSPROP_PERMANENT)
+
+static JSPropertySpec dnsresolver_props[] = {
+    /* { name, tinyid, flags, getter, setter } */
+    {"onResolve", DNSRESOLVER_ONRESOLVE, DNSRESOLVER_PROP_ATTRS , 0, 0},
+    {"onIOError", DNSRESOLVER_ONIOERROR, DNSRESOLVER_PROP_ATTRS , 0, 0},
+    {0, 0, 0, 0, 0}
+};
+
+/**
+ * Definition of the class methods
+ */
+static JSFunctionSpec dnsresolver_methods[] = {
+    /* { name, call, nargs, flags, extra } */
+    {"resolve", DNSResolver_Resolve, 1, 0, 0},
+    {0, 0, 0, 0, 0}
+};
+
+/**
+ * Definition of the class
+ */
+static JSClass dnsresolver_class = {
+    ps_DNSResolver_str,             /* name */
+    JSCLASS_HAS_PRIVATE,            /* flags */
+    JS_PropertyStub,                /* add property */
+    JS_PropertyStub,                /* del property */
+    DNSResolver_GetProperty,        /* get property */
+    DNSResolver_SetProperty,        /* set property */
+    JS_EnumerateStub,               /* enumerate */
+    JS_ResolveStub,                 /* resolve */
+    JS_ConvertStub,                 /* convert */
+    DNSResolver_DT,                 /* finalize */
+    NULL,                           /* get object ops */
+    NULL,                           /* check access */
+    NULL,                           /* call */
+    NULL,                           /* construct */
+    NULL,                           /* xdr object */
+    NULL,                           /* has instance */
+    DNSResolver_Mark,               /* mark */
+    0                               /* reserve slots */
+};
+
+/*
+ * Host name cache
+ */
+
+static time_t
+dns_now()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec;
+}
+
+static intN
+dns_compare_names(const void *v1, const void *v2)
+{
+    return strcmp((const char*) v1, (const char*) v2) == 0;
+}
+
+static intN
+dns_remove_expired(JSHashEntry *he, intN i, void *arg)
+{
+    PSHostEntry* entry = (PSHostEntry*) he->value;
+    if (arg != NULL && entry->expires > *(time_t*) arg) {
+        return HT_ENUMERATE_NEXT;
+    }
+    free(entry);
+    return HT_ENUMERATE_REMOVE;
+}
+
+static PSHostEntry*
+dns_cache_lookup(const char* name)
+{
+    PSHostEntry* entry;
+    if (!ps_DnsCache) {
+        return NULL;
+    }
+    entry = (PSHostEntry*) JS_HashTableLookup(ps_DnsCache, name);
+    if (entry && entry->expires <= dns_now()) {
+        return NULL;
+    }
+    return entry;
+}
+
+static void
+dns_cache_store(const char* name, const PSAddressList* addrs, int error)
+{
+    JSHashNumber hash;
+    JSHashEntry **hep, *he;
+    PSHostEntry* entry;
+    time_t now = dns_now();
+
+    if (error != 0 && error != EAI_NONAME) {
+        return;
+    }
+    if (!ps_DnsCache) {
+        ps_DnsCache = JS_NewHashTable(PS_DNS_CACHE_SIZE, JS_HashString,
+                                      dns_compare_names, JS_CompareValues,
+                                      NULL, NULL);
+        if (!ps_DnsCache) {
+            return;
+        }
+    }
+
+    /* Update the entry in place if the host name is cached already. */
+    hash = JS_HashString(name);
+    hep = JS_HashTableRawLookup(ps_DnsCache, hash, name);
+    if (*hep) {
+        entry = (PSHostEntry*) (*hep)->value;
+    }
+    else {
+        /* Drop the expired entries when the cache is full, or all of them
+         * if none have expired. */
+        if (ps_DnsCache->nentries >= PS_DNS_CACHE_SIZE) {
+            JS_HashTableEnumerateEntries(ps_DnsCache, dns_remove_expired, &now);
+            if (ps_DnsCache->nentries >= PS_DNS_CACHE_SIZE) {
+                JS_HashTableEnumerateEntries(ps_DnsCache, dns_remove_expired,
+                                             NULL);
+            }
+            hep = JS_HashTableRawLookup(ps_DnsCache, hash, name);
+        }
+        entry = (PSHostEntry*) malloc(offsetof(PSHostEntry, name) +
+                                      strlen(name) + 1);
+        if (!entry) {
+            return;
+        }
+        strcpy(entry->name, name);
+        he = JS_HashTableRawAdd(ps_DnsCache, hep, hash, entry->name, entry);
+        if (!he) {
+            free(entry);
+            return;
+        }
+    }
+    entry->addrs = *addrs;
+    entry->error = error;
+    entry->expires = now + (error == 0 ? PS_DNS_TTL : PS_DNS_NEGATIVE_TTL);
+}
+
+static const char*
+dns_strerror(int error, int syserror)
+{
+    return error == EAI_SYSTEM ? strerror(syserror) : gai_strerror(error);
+}
+
+/*
+ * The error of a host name that has no IPv4 address, when only an IPv4
+ * address can be used.
+ */
+static const char dns_no_ipv4[] = "no IPv4 address";
+
+/*
+ * Get the first IPv4 address, returns JS_FALSE if there is none.
+ */
+static JSBool
+dns_first_ipv4(const PSAddressList* addrs, JSUint32* address)
+{
+    for (int i = 0; i < addrs->count; ++i) {
+        if (addrs->addrs[i].sa.sa_family == AF_INET) {
+            *address = addrs->addrs[i].sin.sin_addr.s_addr;
+            return JS_TRUE;
+        }
+    }
+    return JS_FALSE;
+}
+
+/*
+ * Resolve the addresses of a host name. The addresses are ordered as RFC 8305
+ * section 4 describes: starting with the first address in the order of
+ * preference of the resolver, alternating between the address families.
+ */
+static int
+dns_getaddrinfo(const char* name, PSAddressList* addrs, int* syserror)
+{
+    PSSockAddr preferred[PS_DNS_ADDRESSES], other[PS_DNS_ADDRESSES];
+    struct addrinfo* infos;
+    struct addrinfo* info;
+    struct addrinfo hint;
+    int npreferred = 0, nother = 0;
+    int family, error;
+
+    memset(&hint, 0, sizeof(struct addrinfo));
+    hint.ai_family = AF_UNSPEC;
+    hint.ai_socktype = SOCK_STREAM;
+    hint.ai_protocol = IPPROTO_TCP;
+    hint.ai_flags = AI_ADDRCONFIG;
+    error = getaddrinfo(name, NULL, &hint, &infos);
+    if (error != 0) {
+        *syserror = errno;
+        return error;
+    }
+    family = infos->ai_family;
+    for (info = infos; info != NULL; info = info->ai_next) {
+        PSSockAddr* addr;
+        if ((info->ai_family != AF_INET && info->ai_family != AF_INET6) ||
+            info->ai_addrlen > sizeof(PSSockAddr))
+        {
+            continue;
+        }
+        if (info->ai_family == family && npreferred < PS_DNS_ADDRESSES) {
+            addr = &preferred[npreferred++];
+        }
+        else if (info->ai_family != family && nother < PS_DNS_ADDRESSES) {
+            addr = &other[nother++];
+        }
+        else {
+            continue;
+        }
+        memset(addr, 0, sizeof(PSSockAddr));
+        memcpy(addr, info->ai_addr, info->ai_addrlen);
+    }
+    freeaddrinfo(infos);
+
+    addrs->count = 0;
+    for (int i = 0; i < npreferred || i < nother; ++i) {
+        if (i < npreferred && addrs->count < PS_DNS_ADDRESSES) {
+            addrs->addrs[addrs->count++] = preferred[i];
+        }
+        if (i < nother && addrs->count < PS_DNS_ADDRESSES) {
+            addrs->addrs[addrs->count++] = other[i];
+        }
+    }
+    return addrs->count > 0 ? 0 : EAI_NONAME;
+}
+
+/*
+ * Worker thread
+ */
+
+static void*
+dns_worker(void* arg)
+{
+    PSLookup* lookup;
+
+    pthread_mutex_lock(&ps_DnsLock);
+    for (;;) {
+        while (ps_DnsQueue == NULL) {
+            ++ps_DnsIdle;
+            pthread_cond_wait(&ps_DnsCond, &ps_DnsLock);
+            --ps_DnsIdle;
+        }
+        lookup = ps_DnsQueue;
+        ps_DnsQueue = lookup->next;
+        if (ps_DnsQueue == NULL) {
+            ps_DnsQueueTail = NULL;
+        }
+        pthread_mutex_unlock(&ps_DnsLock);
+
+        lookup->error = dns_getaddrinfo(lookup->name, &lookup->addrs,
+                                        &lookup->syserror);
+
+        /* Hand the lookup back, waking up the interpreter thread if it is
+         * the first one. */
+        pthread_mutex_lock(&ps_DnsLock);
+        lookup->next = ps_DnsDone;
+        ps_DnsDone = lookup;
+        if (lookup->next == NULL) {
+            (void) write(ps_DnsPipe[1], "", 1);
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Asynchronous handling of the completed lookups.
+ */
+
+static void
+dns_select_callback(JSContext *cx, JSObject *obj)
+{
+    PSLookup *done, *lookup, **lpp;
+    PSResolveRequest* request;
+    char buf[64];
+
+    /* Take the completed lookups, in the order they have completed. */
+    while (read(ps_DnsPipe[0], buf, sizeof(buf)) > 0);
+    pthread_mutex_lock(&ps_DnsLock);
+    lookup = ps_DnsDone;
+    ps_DnsDone = NULL;
+    pthread_mutex_unlock(&ps_DnsLock);
+    done = NULL;
+    while (lookup != NULL) {
+        PSLookup* next = lookup->next;
+        lookup->next = done;
+        done = lookup;
+        lookup = next;
+    }
+
+    while (done != NULL) {
+        lookup = done;
+        done = lookup->next;
+
+        /* Cache the resolved outcome, so that any new request for the host
+         * name is answered from the cache. */
+        if (!lookup->known) {
+            for (lpp = &ps_DnsPending; *lpp != NULL; lpp = &(*lpp)->pending) {
+                if (*lpp == lookup) {
+                    *lpp = lookup->pending;
+                    break;
+                }
+            }
+            dns_cache_store(lookup->name, &lookup->addrs, lookup->error);
+        }
+
+        /* Call back the requests, which may cancel other requests for the
+         * same lookup. */
+        while ((request = lookup->requests) != NULL) {
+            const char* errmsg = lookup->error == 0
+                               ? NULL
+                               : dns_strerror(lookup->error, lookup->syserror);
+            JSUint32 address = 0;
+            lookup->requests = request->next;
+            --ps_DnsRequests;
+            if (request->funcs) {
+                request->funcs(cx, request->obj, lookup->name, &lookup->addrs,
+                               errmsg);
+            }
+            else {
+                if (!errmsg && !dns_first_ipv4(&lookup->addrs, &address)) {
+                    errmsg = dns_no_ipv4;
+                }
+                request->func(cx, request->obj, lookup->name, address,
+                              errmsg);
+            }
+            free(request);
+        }
+        free(lookup);
+    }
+
+    if (ps_DnsRequests == 0) {
+        (void) ps_RemoveSelect(cx, ps_DnsPipe[0]);
+    }
+}
+
+/*
+ * Drop a lookup in a forked child, leaving its requests unanswered.
+ */
+static void
+dns_orphan_lookup(PSLookup* lookup)
+{
+    for (PSResolveRequest* request = lookup->requests; request != NULL;
+         request = request->next)
+    {
+        request->lookup = NULL;
+    }
+    free(lookup);
+}
+
+/*
+ * A forked child has none of the worker threads, and is not to share the
+ * pipe with its parent. The lock and the condition are initialised again, as
+ * they may have been in use by a worker. The lookups of the parent are
+ * dropped, as no worker is going to complete them, so that a new request for
+ * the same host name is resolved again.
+ */
+static void
+dns_atfork_child()
+{
+    PSLookup* lookup;
+
+    pthread_mutex_init(&ps_DnsLock, NULL);
+    pthread_cond_init(&ps_DnsCond, NULL);
+    ps_DnsThreads = 0;
+    ps_DnsIdle = 0;
+
+    /* A lookup being resolved is on the pending list, and also on the queue
+     * or the done list. A lookup with a known outcome is only on the done
+     * list. */
+    while ((lookup = ps_DnsDone) != NULL) {
+        ps_DnsDone = lookup->next;
+        if (lookup->known) {
+            dns_orphan_lookup(lookup);
+        }
+    }
+    while ((lookup = ps_DnsPending) != NULL) {
+        ps_DnsPending = lookup->pending;
+        dns_orphan_lookup(lookup);
+    }
+    ps_DnsQueue = NULL;
+    ps_DnsQueueTail = NULL;
+    ps_DnsRequests = 0;
+    for (int i = 0; i < 2; ++i) {
+        if (ps_DnsPipe[i] != -1) {
+            (void) close(ps_DnsPipe[i]);
+            ps_DnsPipe[i] = -1;
+        }
+    }
+}
+
+static void
+dns_register_atfork()
+{
+    (void) pthread_atfork(NULL, NULL, dns_atfork_child);
+}
+
+static JSBool
+dns_init()
+{
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+    if (ps_DnsPipe[0] != -1) {
+        return JS_TRUE;
+    }
+    (void) pthread_once(&once, dns_register_atfork);
+    if (pipe(ps_DnsPipe) < 0) {
+        return JS_FALSE;
+    }
+    for (int i = 0; i < 2; ++i) {
+        (void) fcntl(ps_DnsPipe[i], F_SETFL,
+                     fcntl(ps_DnsPipe[i], F_GETFL, 0) | O_NONBLOCK);
+        (void) fcntl(ps_DnsPipe[i], F_SETFD, FD_CLOEXEC);
+    }
+    return JS_TRUE;
+}
+
+/*
+ * Host name resolution
+ */
+
+/*
+ * Get the addresses of a host name without resolving it, when it is an
+ * address or its outcome is cached. Returns JS_FALSE if the host name is to be
+ * resolved, otherwise JS_TRUE with the resolver error, or 0.
+ */
+static JSBool
+dns_lookup_known(const char *name, PSAddressList *addrs, int *error)
+{
+    PSHostEntry* entry;
+
+    memset(&addrs->addrs[0], 0, sizeof(PSSockAddr));
+    *error = 0;
+    if (inet_pton(AF_INET, name, &addrs->addrs[0].sin.sin_addr) == 1) {
+        addrs->addrs[0].sin.sin_family = AF_INET;
+        addrs->count = 1;
+        return JS_TRUE;
+    }
+    if (inet_pton(AF_INET6, name, &addrs->addrs[0].sin6.sin6_addr) == 1) {
+        addrs->addrs[0].sin6.sin6_family = AF_INET6;
+        addrs->count = 1;
+        return JS_TRUE;
+    }
+    entry = dns_cache_lookup(name);
+    if (entry) {
+        *addrs = entry->addrs;
+        *error = entry->error;
+        return JS_TRUE;
+    }
+    return JS_FALSE;
+}
+
+JSBool
+ps_LookupHostAddresses(const char *name, PSAddressList *addrs,
+        const char **error)
+{
+    int code;
+
+    if (!dns_lookup_known(name, addrs, &code)) {
+        return JS_FALSE;
+    }
+    *error = code == 0 ? NULL : gai_strerror(code);
+    return JS_TRUE;
+}
+
+JSBool
+ps_LookupHost(const char *name, JSUint32 *address, const char **error)
+{
+    PSAddressList addrs;
+
+    if (!ps_LookupHostAddresses(name, &addrs, error)) {
+        return JS_FALSE;
+    }
+    if (!*error && !dns_first_ipv4(&addrs, address)) {
+        *error = dns_no_ipv4;
+    }
+    return JS_TRUE;
+}
+
+const char *
+ps_ResolveHostAddresses(JSContext *cx, const char *name, PSAddressList *addrs)
+{
+    const char* errmsg;
+    int error, syserror;
+
+    if (ps_LookupHostAddresses(name, addrs, &errmsg)) {
+        return errmsg;
+    }
+    error = dns_getaddrinfo(name, addrs, &syserror);
+    if (error != 0) {
+        addrs->count = 0;
+    }
+    dns_cache_store(name, addrs, error);
+    return error == 0 ? NULL : dns_strerror(error, syserror);
+}
+
+const char *
+ps_ResolveHost(JSContext *cx, const char *name, JSUint32 *address)
+{
+    PSAddressList addrs;
+    const char* error;
+
+    error = ps_ResolveHostAddresses(cx, name, &addrs);
+    if (!error && !dns_first_ipv4(&addrs, address)) {
+        error = dns_no_ipv4;
+    }
+    return error;
+}
+
+const char *
+ps_FormatAddress(const PSSockAddr *addr, char *buffer)
+{
+    struct in_addr mapped;
+
+    if (addr->sa.sa_family == AF_INET6) {
+        if (!IN6_IS_ADDR_V4MAPPED(&addr->sin6.sin6_addr)) {
+            return inet_ntop(AF_INET6, &addr->sin6.sin6_addr, buffer,
+                             INET6_ADDRSTRLEN);
+        }
+        memcpy(&mapped, &addr->sin6.sin6_addr.s6_addr[12], sizeof(mapped));
+        return inet_ntop(AF_INET, &mapped, buffer, INET6_ADDRSTRLEN);
+    }
+    return inet_ntop(AF_INET, &addr->sin.sin_addr, buffer, INET6_ADDRSTRLEN);
+}
+
+/*
+ * Resolve a host name asynchronously, calling back either with the first IPv4
+ * address or with all the addresses.
+ */
+static PSResolveRequest *
+dns_resolve_async(JSContext *cx, const char *name, JSObject *obj,
+        PSResolveCallback func, PSResolveAddressesCallback funcs)
+{
+    PSResolveRequest *request, **rpp;
+    PSLookup* lookup;
+
+    if (!dns_init()) {
+        return NULL;
+    }
+    request = (PSResolveRequest*) malloc(sizeof(PSResolveRequest));
+    if (!request) {
+        return NULL;
+    }
+    request->obj = obj;
+    request->func = func;
+    request->funcs = funcs;
+
+    /* Join the lookup of the same host name, if it is being resolved. */
+    for (lookup = ps_DnsPending; lookup != NULL; lookup = lookup->pending) {
+        if (strcmp(lookup->name, name) == 0) {
+            break;
+        }
+    }
+    if (!lookup) {
+        lookup = (PSLookup*) malloc(offsetof(PSLookup, name) +
+                                    strlen(name) + 1);
+        if (!lookup) {
+            free(request);
+            return NULL;
+        }
+        strcpy(lookup->name, name);
+        lookup->next = NULL;
+        lookup->pending = NULL;
+        lookup->requests = NULL;
+        lookup->addrs.count = 0;
+        lookup->error = 0;
+        lookup->syserror = 0;
+        lookup->known = dns_lookup_known(name, &lookup->addrs,
+                                         &lookup->error);
+
+        pthread_mutex_lock(&ps_DnsLock);
+        if (lookup->known) {
+            /* The outcome is known, hand it back right away. */
+            lookup->next = ps_DnsDone;
+            ps_DnsDone = lookup;
+            if (lookup->next == NULL) {
+                (void) write(ps_DnsPipe[1], "", 1);
+            }
+        }
+        else {
+            /* Queue the lookup, starting a worker thread if none is idle. */
+            if (ps_DnsIdle == 0 && ps_DnsThreads < PS_DNS_THREADS) {
+                pthread_t thread;
+                pthread_attr_t attr;
+                pthread_attr_init(&attr);
+                pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+                if (pthread_create(&thread, &attr, dns_worker, NULL) == 0) {
+                    ++ps_DnsThreads;
+                }
+                pthread_attr_destroy(&attr);
+                if (ps_DnsThreads == 0) {
+                    pthread_mutex_unlock(&ps_DnsLock);
+                    free(lookup);
+                    free(request);
+                    return NULL;
+                }
+            }
+            if (ps_DnsQueueTail) {
+                ps_DnsQueueTail->next = lookup;
+            }
+            else {
+                ps_DnsQueue = lookup;
+            }
+            ps_DnsQueueTail = lookup;
+            pthread_cond_signal(&ps_DnsCond);
+            lookup->pending = ps_DnsPending;
+            ps_DnsPending = lookup;
+        }
+        pthread_mutex_unlock(&ps_DnsLock);
+    }
+    request->lookup = lookup;
+    request->next = NULL;
+    for (rpp = &lookup->requests; *rpp != NULL; rpp = &(*rpp)->next);
+    *rpp = request;
+
+    /* Wait for the completed lookups while there are requests. */
+    if (++ps_DnsRequests == 1 &&
+        !ps_AddSelect(cx, ps_DnsPipe[0], PSFDSET_READ, NULL,
+                      &dns_select_callback, &dns_select_callback, -1))
+    {
+        ps_CancelResolve(cx, request);
+        return NULL;
+    }
+    return request;
+}
+
+PSResolveRequest *
+ps_ResolveHostAsync(JSContext *cx, const char *name, JSObject *obj,
+        PSResolveCallback func)
+{
+    return dns_resolve_async(cx, name, obj, func, NULL);
+}
+
+PSResolveRequest *
+ps_ResolveHostAddressesAsync(JSContext *cx, const char *name, JSObject *obj,
+        PSResolveAddressesCallback func)
+{
+    return dns_resolve_async(cx, name, obj, NULL, func);
+}
+
+void
+ps_CancelResolve(JSContext *cx, PSResolveRequest *request)
+{
+    PSResolveRequest** rpp;
+
+    /* A request inherited from the parent process is not counted. */
+    if (!request->lookup) {
+        free(request);
+        return;
+    }
+    for (rpp = &request->lookup->requests; *rpp != NULL; rpp = &(*rpp)->next) {
+        if (*rpp == request) {
+            *rpp = request->next;
+            break;
+        }
+    }
+    free(request);
+    if (--ps_DnsRequests == 0) {
+        (void) ps_RemoveSelect(cx, ps_DnsPipe[0]);
+    }
+}
+
+/*
+ * Create and destroy the resolver instance.
+ */
+
+static DNSResolver*
+DNSResolver_New(JSContext *cx, JSBool blocking)
+{
+    DNSResolver *dns = NULL;
+    dns = (DNSResolver*) JS_malloc(cx, sizeof(DNSResolver));
+    if (!dns) {
+        return NULL;
+    }
+    dns->self = NULL;
+    dns->blocking = blocking;
+    dns->onResolve = JSVAL_VOID;
+    dns->onIOError = JSVAL_VOID;
+    dns->pending = 0;
+    return dns;
+}
+
+static void
+DNSResolver_Delete(JSContext* cx, DNSResolver* dns)
+{
+    if (dns->self) {
+        JS_RemoveRoot(cx, &dns->self);
+    }
+    JS_free(cx, dns);
+}
+
+static JSBool
+DNSResolver_GetProperty(JSContext *cx, JSObject *obj, jsval id, jsval *vp)
+{
+    DNSResolver* dns = NULL;
+    jsint slot;
+
+    /* Get the property's slot */
+    if (!JSVAL_IS_INT(id)) {
+        return JS_TRUE;
+    }
+    slot = JSVAL_TO_INT(id);
+
+    /* Get the value */
+    JS_LOCK_OBJ(cx, obj);
+    dns = (DNSResolver*)JS_GetInstancePrivate(cx, obj, &dnsresolver_class,
+                                              NULL);
+    if (dns) {
+        switch (slot) {
+            case DNSRESOLVER_ONRESOLVE:
+                *vp = dns->onResolve;
+                break;
+            case DNSRESOLVER_ONIOERROR:
+                *vp = dns->onIOError;
+                break;
+            default:
+                break;
+        }
+    }
+    JS_UNLOCK_OBJ(cx, obj);
+    return JS_TRUE;
+}
+
+static JSBool
+DNSResolver_SetProperty(JSContext *cx, JSObject *obj, jsval id, jsval *vp)
+{
+    DNSResolver* dns = NULL;
+    jsint slot;
+
+    /* Get the property's slot */
+    if (!JSVAL_IS_INT(id)) {
+        return JS_TRUE;
+    }
+    slot = JSVAL_TO_INT(id);
+
+    /* Set the value */
+    JS_LOCK_OBJ(cx, obj);
+    dns = (DNSResolver*)JS_GetInstancePrivate(cx, obj, &dnsresolver_class,
+                                              NULL);
+    switch (slot) {
+        case DNSRESOLVER_ONRESOLVE:
+            if (JSVAL_IS_FUNCTION(cx, *vp)) {
+                dns->onResolve = *vp;
+            }
+            break;
+        case DNSRESOLVER_ONIOERROR:
+            if (JSVAL_IS_FUNCTION(cx, *vp)) {
+                dns->onIOError = *vp;
+            }
+            break;
+    }
+    JS_UNLOCK_OBJ(cx, obj);
+    return JS_TRUE;
+}
+
+/*
+ * Callback when an asynchronous resolution has completed.
+ */
+static void
+DNSResolver_ResolveCallback(JSContext *cx, JSObject *obj, const char *name,
+                            JSUint32 address, const char *error)
+{
+    DNSResolver* dns = NULL;
+    JSString* host;
+    struct in_addr addr;
+    jsval result = JSVAL_NULL;
+    jsval argv[2];
+
+    dns = (DNSResolver*) JS_GetPrivate(cx, obj);
+    if (!dns) {
+        return;
+    }
+
+    /*
+     * Invoke the callback with the host name and its address, or with the
+     * error and the host name. The first string is rooted while the second
+     * one is created.
+     */
+    if (error == NULL) {
+        addr.s_addr = address;
+        result = STRING_TO_JSVAL(JS_NewStringCopyZ(cx, inet_ntoa(addr)));
+    }
+    else {
+        result = STRING_TO_JSVAL(JS_NewStringCopyZ(cx, error));
+    }
+    if (JSVAL_TO_STRING(result) &&
+        JS_AddNamedRoot(cx, &result, "DNSResolver.result"))
+    {
+        host = JS_NewStringCopyZ(cx, name);
+        if (host && error == NULL && !JSVAL_IS_VOID(dns->onResolve)) {
+            argv[0] = STRING_TO_JSVAL(host);
+            argv[1] = result;
+            DNSResolver_Invoke(cx, obj, dns->onResolve, 2, argv);
+        }
+        else if (host && error != NULL && !JSVAL_IS_VOID(dns->onIOError)) {
+            argv[0] = result;
+            argv[1] = STRING_TO_JSVAL(host);
+            DNSResolver_Invoke(cx, obj, dns->onIOError, 2, argv);
+        }
+        JS_RemoveRoot(cx, &result);
+    }
+
+    /* The instance is no longer needed once all resolutions completed. */
+    if (--dns->pending == 0 && dns->self) {
+        JS_RemoveRoot(cx, &dns->self);
+        dns->self = NULL;
+    }
+}
+
+/*
+ * Invoke a callback function.
+ */
+static JSBool
+DNSResolver_Invoke(JSContext *cx, JSObject *obj, jsval fun, uintN argc,
+                   jsval *argv)
+{
+    JSStackFrame* fp;
+    jsval *sp, *oldsp;
+    void *mark;
+    JSBool result;
+
+    /* Allocate call stack frame and push the function, object and argument */
+    sp = js_AllocStack(cx, 2 + argc, &mark);
+    if (!sp) {
+        return JS_FALSE;
+    }
+    *sp++ = fun;
+    *sp++ = OBJECT_TO_JSVAL(obj);
+    for (int i = 0; i < argc; ++i) {
+        *sp++ = argv[i];
+    }
+
+    /* Lift current frame and call */
+    fp = cx->fp;
+    oldsp = fp->sp;
+    fp->sp = sp;
+    result = js_Invoke(cx, argc, JSINVOKE_INTERNAL | JSINVOKE_SKIP_CALLER);
+
+    /* Pop the call stack frame */
+    fp->sp = oldsp;
+    js_FreeStack(cx, mark);
+    return result;
+}
+
+/**
+ * Synopsis:
+ *      DNSResolver(blocking)
+ * Purpose:
+ *      Create a new DNSResolver instance.
+ * Parameters:
+ *      blocking    Boolean (opt)
+ *          When true, resolving blocks until the host name has been resolved.
+ *          If false or omitted, the resolver operates asynchronously using
+ *          the callback functions.
+ * Returns:
+ *      A new DNSResolver instance.
+ */
+static JSBool
+DNSResolver_CT(JSContext* cx, JSObject *obj, uintN argc, jsval *argv,
+               jsval *rval)
+{
+    JSBool ok = JS_TRUE;
+    DNSResolver* dns = NULL;
+    JSBool blocking = JS_FALSE;
+
+    /* Create the object */
+    if (!obj) {
+        obj = js_NewObject(cx, &dnsresolver_class, NULL, NULL);
+        if (!obj) {
+            return JS_FALSE;
+        }
+    }
+
+    /* Get the optional 'blocking' argument */
+    if (argc > 0 && !JS_ValueToBoolean(cx, argv[0], &blocking)) {
+        return JS_FALSE;
+    }
+
+    /* Set the private instance state object */
+    dns = DNSResolver_New(cx, blocking);
+    if (!dns) {
+        return JS_FALSE;
+    }
+    JS_LOCK_OBJ(cx, obj);
+    ok = JS_SetPrivate(cx, obj, dns);
+    JS_UNLOCK_OBJ(cx, obj);
+    if (!ok) {
+        JS_free(cx, dns);
+        return JS_FALSE;
+    }
+    return JS_TRUE;
+}
+
+/**
+ * Destructor.
+ */
+static void
+DNSResolver_DT(JSContext* cx, JSObject *obj)
+{
+    DNSResolver* dns = NULL;
+    dns = (DNSResolver*)JS_GetInstancePrivate(cx, obj, &dnsresolver_class,
+                                              NULL);
+    if (dns) {
+        DNSResolver_Delete(cx, dns);
+    }
+}
+
+/**
+ * Mark the callback functions, which are only referenced from the private
+ * instance data.
+ */
+static uint32
+DNSResolver_Mark(JSContext* cx, JSObject *obj, void *arg)
+{
+    DNSResolver* dns = NULL;
+
+    dns = (DNSResolver*)JS_GetInstancePrivate(cx, obj, &dnsresolver_class,
+                                              NULL);
+    if (dns) {
+        if (JSVAL_IS_GCTHING(dns->onResolve)) {
+            JS_MarkGCThing(cx, JSVAL_TO_GCTHING(dns->onResolve),
+                           "DNSResolver callback", arg);
+        }
+        if (JSVAL_IS_GCTHING(dns->onIOError)) {
+            JS_MarkGCThing(cx, JSVAL_TO_GCTHING(dns->onIOError),
+                           "DNSResolver callback", arg);
+        }
+    }
+    return 0;
+}
+
+/**
+ * Synopsis:
+ *      resolve(name)
+ * Purpose:
+ *      Resolve the IP address of a host name.
+ * Parameters:
+ *      name    String
+ *          The host name to resolve.
+ * Returns:
+ *      String  The IP address in dotted notation for a synchronous resolver.
+ *              For an asynchronous resolver, returns immediately and the
+ *              onResolve callback is called with the host name and its IP
+ *              address once it has been resolved, or the onIOError callback
+ *              with the error and the host name.
+ * Exceptions:
+ *      Not enough arguments specified
+ *      Argument is not a string
+ *      Failed
+ * Additional Information:
+ *      The resolved IP addresses are cached for a minute.
+ */
+static JSBool
+DNSResolver_Resolve(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
+                    jsval *rval)
+{
+    DNSResolver* dns = NULL;
+    const char* name;
+    const char* error;
+    JSUint32 address;
+    struct in_addr addr;
+    JSString* str;
+
+    dns = (DNSResolver*) JS_GetPrivate(cx, obj);
+    if (!dns) {
+        return JS_FALSE;
+    }
+
+    /*
+     * Extract the host name.
+     */
+    if (argc < 1) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_NOT_ENOUGH_ARGUMENTS);
+        return JS_FALSE;
+    }
+    if (JS_TypeOfValue(cx, argv[0]) != JSTYPE_STRING) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_ARGUMENT_NOT_STRING);
+        return JS_FALSE;
+    }
+    name = JS_GetStringBytes(JSVAL_TO_STRING(argv[0]));
+
+    /*
+     * Resolve synchronously, blocking until resolved.
+     */
+    if (dns->blocking) {
+        error = ps_ResolveHost(cx, name, &address);
+        if (error) {
+            JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                                 PSMSG_FAILED, error);
+            return JS_FALSE;
+        }
+        addr.s_addr = address;
+        str = JS_NewStringCopyZ(cx, inet_ntoa(addr));
+        if (!str) {
+            return JS_FALSE;
+        }
+        *rval = STRING_TO_JSVAL(str);
+        return JS_TRUE;
+    }
+
+    /*
+     * Resolve asynchronously, keeping the instance alive until resolved.
+     */
+    if (!ps_ResolveHostAsync(cx, name, obj, &DNSResolver_ResolveCallback)) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_FAILED, "asynchronous resolver setup");
+        return JS_FALSE;
+    }
+    if (dns->pending++ == 0 && !dns->self) {
+        dns->self = obj;
+        if (!JS_AddNamedRoot(cx, &dns->self, "DNSResolver.self")) {
+            dns->self = NULL;
+        }
+    }
+    return JS_TRUE;
+}
+
+/**
+ * DNSResolver class initialiser.
+ */
+JSObject*
+ps_InitDNSResolverClass(JSContext *cx, JSObject *obj)
+{
+    JSObject *proto;
+
+    proto = JS_InitClass(cx, obj, NULL, &dnsresolver_class, DNSResolver_CT, 1,
+                         dnsresolver_props, dnsresolver_methods, NULL, NULL);
+    if (!proto) {
+        return NULL;
+    }
+    return proto;
+}
@@ -0,0 +1,141 @@
+/*
+ * ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is the ProntoScript re-implementation October 4, 2025.
+ *
+ * The Initial Developer of the Original Code is Stefan Sinnige.
+ * Portions created by the Initial Developer are Copyright (C) 2025
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either of the GNU General Public License Version 2 or later (the "GPL"),
+ * or the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK *****
+ */
+
+#ifndef psdnsresolver_h___
+#define psdnsresolver_h___
+
+#include "jsprvtd.h"
+#include "jspubtd.h"
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+/*
+ * ProntoScipt DNSResolver class and host name resolution.
+ *
+ * Host names are resolved on worker threads, so that the resolution does not
+ * hold up the asynchronous handling of other events. The results, including
+ * failures, are cached for a limited time.
+ *
+ * A host name resolves to both IPv4 and IPv6 addresses. The functions that
+ * return a single address in network byte order only use its IPv4 addresses.
+ */
+
+/* The maximum number of addresses kept of a host name. */
+#define PS_DNS_ADDRESSES 8
+
+JS_BEGIN_EXTERN_C
+
+/* The handle of a pending asynchronous resolution. */
+typedef struct _PSResolveRequest PSResolveRequest;
+
+/* An IPv4 or IPv6 socket address. */
+typedef union {
+    struct sockaddr sa;
+    struct sockaddr_in sin;
+    struct sockaddr_in6 sin6;
+} PSSockAddr;
+
+/* The addresses of a host name, in the order they are to be tried. The
+ * address families alternate, starting with the preferred family. The ports
+ * of the addresses are 0. */
+typedef struct {
+    int count;
+    PSSockAddr addrs[PS_DNS_ADDRESSES];
+} PSAddressList;
+
+/* The callback function type when an asynchronous resolution has completed.
+ * The address is in network byte order, the error is NULL on success. */
+typedef void (*PSResolveCallback)(JSContext *cx, JSObject *obj,
+        const char *name, JSUint32 address, const char *error);
+
+/* The callback function type when an asynchronous resolution of all the
+ * addresses has completed. The error is NULL on success. */
+typedef void (*PSResolveAddressesCallback)(JSContext *cx, JSObject *obj,
+        const char *name, const PSAddressList *addrs, const char *error);
+
+/* Initialise the JavaScript 'DNSResolver' class.  */
+extern JSObject *
+ps_InitDNSResolverClass(JSContext *cx, JSObject *obj);
+
+/* Look up the address of a host name without blocking, from its numeric form
+ * or from the cache. Returns JS_TRUE if the outcome is known, with the error
+ * set to NULL on success. */
+extern JSBool
+ps_LookupHost(const char *name, JSUint32 *address, const char **error);
+
+/* Resolve the address of a host name, blocking until it is resolved. Returns
+ * NULL on success, otherwise the error. */
+extern const char *
+ps_ResolveHost(JSContext *cx, const char *name, JSUint32 *address);
+
+/* Resolve the address of a host name asynchronously. The callback is called
+ * from the asynchronous event handling once it has been resolved, even if it
+ * is known already. Returns NULL if the resolution could not be started. */
+extern PSResolveRequest *
+ps_ResolveHostAsync(JSContext *cx, const char *name, JSObject *obj,
+        PSResolveCallback func);
+
+/* Look up all the addresses of a host name without blocking, like
+ * ps_LookupHost(). */
+extern JSBool
+ps_LookupHostAddresses(const char *name, PSAddressList *addrs,
+        const char **error);
+
+/* Resolve all the addresses of a host name, blocking until it is resolved.
+ * Returns NULL on success, otherwise the error. */
+extern const char *
+ps_ResolveHostAddresses(JSContext *cx, const char *name, PSAddressList *addrs);
+
+/* Resolve all the addresses of a host name asynchronously, like
+ * ps_ResolveHostAsync(). */
+extern PSResolveRequest *
+ps_ResolveHostAddressesAsync(JSContext *cx, const char *name, JSObject *obj,
+        PSResolveAddressesCallback func);
+
+/* Format the IP address of a socket address into the buffer, which holds at
+ * least INET6_ADDRSTRLEN characters. An IPv4-mapped IPv6 address is formatted
+ * as an IPv4 address. */
+extern const char *
+ps_FormatAddress(const PSSockAddr *addr, char *buffer);
+
+/* Cancel an asynchronous resolution before its callback is called. */
+extern void
+ps_CancelResolve(JSContext *cx, PSResolveRequest *request);
+
+JS_END_EXTERN_C
+
+#endif /* psdnsresolver_h___ */
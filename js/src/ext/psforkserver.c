@@ -0,0 +1,496 @@
+/*
+ * ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is the ProntoScript re-implementation October 4, 2025.
+ *
+ * The Initial Developer of the Original Code is Stefan Sinnige.
+ * Portions created by the Initial Developer are Copyright (C) 2025
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either of the GNU General Public License Version 2 or later (the "GPL"),
+ * or the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK *****
+ */
+
+/* Required for pipe2. */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "jsapi.h"
+#include "jscntxt.h"
+#include "psforkserver.h"
+#include "psscriptcache.h"
+#include "pssystem.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+ * The maximum size of a job request, which holds the working directory and
+ * the arguments of the job, each terminated by a NUL character.
+ */
+#define FORKSERVER_REQUEST_MAX (256 * 1024)
+
+/* The number of descriptors passed with a job, being its standard I/O. */
+#define FORKSERVER_FDS 3
+
+/*
+ * A job that is running, and the connection to send its exit code to.
+ */
+typedef struct {
+    pid_t pid;              /* The child running the job. */
+    int fd;                 /* The connection of the job. */
+} PSForkJob;
+
+/*
+ * The pipe that the server is woken up through when a child has exited. It is
+ * non-blocking, so that the signal handler never waits for the server to read
+ * it.
+ */
+static int ps_ForkPipe[2] = {-1, -1};
+
+static void
+ForkServer_OnChild(int sig)
+{
+    int saved = errno;
+
+    (void) write(ps_ForkPipe[1], "", 1);
+    errno = saved;
+}
+
+/*
+ * Get the address of the Unix socket at a path. Returns JS_FALSE if the path
+ * is too long.
+ */
+static JSBool
+ForkServer_Address(const char* path, struct sockaddr_un* addr)
+{
+    size_t length = strlen(path);
+
+    if (length >= sizeof(addr->sun_path)) {
+        errno = ENAMETOOLONG;
+        return JS_FALSE;
+    }
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    memcpy(addr->sun_path, path, length + 1);
+    return JS_TRUE;
+}
+
+/*
+ * Remove the socket of an earlier server at an address, which is only done
+ * when that server no longer accepts connections. Returns JS_FALSE, with errno
+ * set, if the path is in use or is not a socket.
+ */
+static JSBool
+ForkServer_RemoveStale(const struct sockaddr_un* addr)
+{
+    struct stat st;
+    int fd;
+    JSBool live;
+
+    if (lstat(addr->sun_path, &st) < 0) {
+        return errno == ENOENT;
+    }
+    if (!S_ISSOCK(st.st_mode)) {
+        errno = EEXIST;
+        return JS_FALSE;
+    }
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return JS_FALSE;
+    }
+    live = connect(fd, (const struct sockaddr*) addr, sizeof(*addr)) == 0;
+    (void) close(fd);
+    if (live) {
+        errno = EADDRINUSE;
+        return JS_FALSE;
+    }
+    return unlink(addr->sun_path) == 0 || errno == ENOENT;
+}
+
+/*
+ * Read or write all of a buffer. Returns JS_FALSE on failure, or if the
+ * connection has been closed.
+ */
+static JSBool
+ForkServer_Transfer(int fd, char* data, size_t length, JSBool writing)
+{
+    ssize_t n;
+
+    while (length > 0) {
+        n = writing ? write(fd, data, length) : read(fd, data, length);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n == 0) {
+                errno = EPIPE;
+            }
+            return JS_FALSE;
+        }
+        data += n;
+        length -= n;
+    }
+    return JS_TRUE;
+}
+
+/*
+ * Receive a job request in the child, and take over its working directory
+ * and standard I/O. Returns JS_FALSE on failure.
+ */
+static JSBool
+ForkServer_Receive(int fd, char*** argvp, int* argcp)
+{
+    union {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(FORKSERVER_FDS * sizeof(int))];
+    } control;
+    struct msghdr msg;
+    struct cmsghdr* cmsg;
+    struct iovec iov;
+    int fds[FORKSERVER_FDS];
+    uint32 length;
+    ssize_t n;
+    char* request;
+    char* p;
+    char** argv;
+    int argc;
+
+    /* The descriptors are passed along with the first byte of the length of
+     * the request. */
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = &length;
+    iov.iov_len = sizeof(length);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+    do {
+        n = recvmsg(fd, &msg, 0);
+    } while (n < 0 && errno == EINTR);
+    cmsg = n > 0 ? CMSG_FIRSTHDR(&msg) : NULL;
+    if (!cmsg || cmsg->cmsg_level != SOL_SOCKET ||
+        cmsg->cmsg_type != SCM_RIGHTS ||
+        cmsg->cmsg_len != CMSG_LEN(FORKSERVER_FDS * sizeof(int)))
+    {
+        return JS_FALSE;
+    }
+    memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+    for (int i = 0; i < FORKSERVER_FDS; ++i) {
+        if (dup2(fds[i], i) < 0) {
+            return JS_FALSE;
+        }
+        if (fds[i] >= FORKSERVER_FDS) {
+            (void) close(fds[i]);
+        }
+    }
+    if (!ForkServer_Transfer(fd, (char*) &length + n, sizeof(length) - n,
+                             JS_FALSE) ||
+        length == 0 || length > FORKSERVER_REQUEST_MAX)
+    {
+        return JS_FALSE;
+    }
+
+    /* The request is the working directory followed by the arguments. */
+    request = (char*) malloc(length);
+    if (!request ||
+        !ForkServer_Transfer(fd, request, length, JS_FALSE) ||
+        request[length - 1] != '\0')
+    {
+        return JS_FALSE;
+    }
+    argc = 0;
+    for (p = request; p < request + length; p += strlen(p) + 1) {
+        ++argc;
+    }
+    argv = (char**) malloc(argc * sizeof(char*));
+    if (!argv) {
+        return JS_FALSE;
+    }
+    argc = 0;
+    for (p = request; p < request + length; p += strlen(p) + 1) {
+        argv[argc++] = p;
+    }
+    if (chdir(argv[0]) < 0) {
+        return JS_FALSE;
+    }
+    *argvp = argv + 1;
+    *argcp = argc - 1;
+    return JS_TRUE;
+}
+
+/*
+ * Send the exit code of a job that has finished, once its child has exited.
+ */
+static void
+ForkServer_Reap(PSForkJob* jobs, int* njobs)
+{
+    unsigned char code;
+    pid_t pid;
+    int status;
+
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        for (int i = 0; i < *njobs; ++i) {
+            if (jobs[i].pid != pid) {
+                continue;
+            }
+            code = WIFEXITED(status) ? WEXITSTATUS(status)
+                                     : 128 + WTERMSIG(status);
+            (void) ForkServer_Transfer(jobs[i].fd, (char*) &code, 1, JS_TRUE);
+            (void) close(jobs[i].fd);
+            jobs[i] = jobs[--*njobs];
+            break;
+        }
+    }
+}
+
+JSBool
+ps_ForkServer(JSContext *cx, const char *path, char ***argvp, int *argcp)
+{
+    struct sockaddr_un addr;
+    struct pollfd pfds[2];
+    PSForkJob* jobs = NULL;
+    PSForkJob* more;
+    int njobs = 0;
+    int maxjobs = 0;
+    char drain[64];
+    struct sigaction pipeAction, childAction;
+    pid_t pid;
+    mode_t mask;
+    int fd, conn, bound;
+
+    /* Listen on the socket, replacing the socket of an earlier server that
+     * has gone. Only the user is allowed to run jobs, so the socket is
+     * created without access for anyone else. */
+    if (!ForkServer_Address(path, &addr) || !ForkServer_RemoveStale(&addr) ||
+        (fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+    {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_FAILED, strerror(errno));
+        return JS_FALSE;
+    }
+    mask = umask(S_IRWXG | S_IRWXO);
+    bound = bind(fd, (struct sockaddr*) &addr, sizeof(addr));
+    (void) umask(mask);
+    if (bound < 0 || listen(fd, SOMAXCONN) < 0 ||
+        pipe2(ps_ForkPipe, O_NONBLOCK | O_CLOEXEC) < 0)
+    {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_FAILED, strerror(errno));
+        (void) close(fd);
+        return JS_FALSE;
+    }
+
+    /* The dispositions in place are restored in the children, so that a job
+     * runs as it would without the server. */
+    (void) sigaction(SIGPIPE, NULL, &pipeAction);
+    (void) sigaction(SIGCHLD, NULL, &childAction);
+    (void) signal(SIGPIPE, SIG_IGN);
+    (void) signal(SIGCHLD, ForkServer_OnChild);
+
+    /* The scripts preloaded by the server are written to the snapshot once,
+     * rather than by every job that inherits them. */
+    ps_SaveSnapshot(cx);
+
+    pfds[0].fd = fd;
+    pfds[0].events = POLLIN;
+    pfds[1].fd = ps_ForkPipe[0];
+    pfds[1].events = POLLIN;
+    for (;;) {
+        if (poll(pfds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (pfds[1].revents & POLLIN) {
+            while (read(ps_ForkPipe[0], drain, sizeof(drain)) > 0);
+            ForkServer_Reap(jobs, &njobs);
+        }
+        if (!(pfds[0].revents & POLLIN)) {
+            continue;
+        }
+        conn = accept(fd, NULL, NULL);
+        if (conn < 0) {
+            continue;
+        }
+        if (njobs == maxjobs) {
+            more = (PSForkJob*) realloc(jobs, (maxjobs + 16) *
+                                              sizeof(PSForkJob));
+            if (!more) {
+                (void) close(conn);
+                continue;
+            }
+            jobs = more;
+            maxjobs += 16;
+        }
+
+        /* Nothing buffered is to be written by the child as well. */
+        fflush(stdout);
+        fflush(stderr);
+        pid = fork();
+        if (pid == 0) {
+            /* The child only keeps the connection of its own job, which is
+             * closed once the job has been received. */
+            (void) sigaction(SIGPIPE, &pipeAction, NULL);
+            (void) sigaction(SIGCHLD, &childAction, NULL);
+            (void) close(fd);
+            (void) close(ps_ForkPipe[0]);
+            (void) close(ps_ForkPipe[1]);
+            for (int i = 0; i < njobs; ++i) {
+                (void) close(jobs[i].fd);
+            }
+            free(jobs);
+            if (!ForkServer_Receive(conn, argvp, argcp)) {
+                _exit(1);
+            }
+            (void) close(conn);
+
+            /* The names of the modules included by the server were located
+             * relative to its working directory rather than that of the
+             * job. */
+            ps_ForgetRelativeModuleNames();
+            return JS_TRUE;
+        }
+        if (pid < 0) {
+            (void) close(conn);
+            continue;
+        }
+        jobs[njobs].pid = pid;
+        jobs[njobs].fd = conn;
+        ++njobs;
+    }
+    JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                         PSMSG_FAILED, strerror(errno));
+    return JS_FALSE;
+}
+
+int
+ps_ForkClient(const char *path, char **argv, int argc)
+{
+    union {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(FORKSERVER_FDS * sizeof(int))];
+    } control;
+    struct sockaddr_un addr;
+    struct msghdr msg;
+    struct cmsghdr* cmsg;
+    struct iovec iov;
+    char cwd[PATH_MAX];
+    char* request;
+    uint32 length;
+    size_t offset;
+    ssize_t n;
+    unsigned char code;
+    int fds[FORKSERVER_FDS] = {0, 1, 2};
+    int fd;
+
+    /* The request is the working directory followed by the arguments. */
+    if (!getcwd(cwd, sizeof(cwd))) {
+        fprintf(stderr, "prontoscript: %s\n", strerror(errno));
+        return 1;
+    }
+    length = strlen(cwd) + 1;
+    for (int i = 0; i < argc; ++i) {
+        length += strlen(argv[i]) + 1;
+    }
+    if (length > FORKSERVER_REQUEST_MAX) {
+        fprintf(stderr, "prontoscript: %s\n", strerror(E2BIG));
+        return 1;
+    }
+    request = (char*) malloc(length);
+    if (!request) {
+        fprintf(stderr, "prontoscript: %s\n", strerror(ENOMEM));
+        return 1;
+    }
+    offset = strlen(cwd) + 1;
+    memcpy(request, cwd, offset);
+    for (int i = 0; i < argc; ++i) {
+        memcpy(request + offset, argv[i], strlen(argv[i]) + 1);
+        offset += strlen(argv[i]) + 1;
+    }
+
+    if (!ForkServer_Address(path, &addr) ||
+        (fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 ||
+        connect(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0)
+    {
+        fprintf(stderr, "prontoscript: %s: %s\n", path, strerror(errno));
+        free(request);
+        return 1;
+    }
+
+    /* Pass the standard I/O along with the length of the request. */
+    memset(&msg, 0, sizeof(msg));
+    memset(&control, 0, sizeof(control));
+    iov.iov_base = &length;
+    iov.iov_len = sizeof(length);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+    do {
+        n = sendmsg(fd, &msg, 0);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0 ||
+        !ForkServer_Transfer(fd, (char*) &length + n, sizeof(length) - n,
+                             JS_TRUE) ||
+        !ForkServer_Transfer(fd, request, length, JS_TRUE))
+    {
+        fprintf(stderr, "prontoscript: %s: %s\n", path, strerror(errno));
+        free(request);
+        (void) close(fd);
+        return 1;
+    }
+    free(request);
+
+    /* The job writes straight to the standard output and error, and only
+     * the exit code is sent back. */
+    if (!ForkServer_Transfer(fd, (char*) &code, 1, JS_FALSE)) {
+        fprintf(stderr, "prontoscript: %s: %s\n", path, strerror(errno));
+        (void) close(fd);
+        return 1;
+    }
+    (void) close(fd);
+    return code;
+}
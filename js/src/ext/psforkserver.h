@@ -0,0 +1,71 @@
+/*
+ * ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is the ProntoScript re-implementation October 4, 2025.
+ *
+ * The Initial Developer of the Original Code is Stefan Sinnige.
+ * Portions created by the Initial Developer are Copyright (C) 2025
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either of the GNU General Public License Version 2 or later (the "GPL"),
+ * or the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK *****
+ */
+
+
+#ifndef psforkserver_h___
+#define psforkserver_h___
+
+#include "jsprvtd.h"
+#include "jspubtd.h"
+
+/*
+ * ProntoScipt fork server.
+ *
+ * The server initialises the engine once, optionally running scripts that
+ * include the libraries, and then listens on a Unix socket for jobs. Every job
+ * is run by a forked copy of the server, which shares the initialised engine
+ * copy-on-write. A job passes its working directory, its arguments and its
+ * standard input, output and error to the server, and is sent the exit code
+ * once it has finished.
+ */
+
+JS_BEGIN_EXTERN_C
+
+/* Serve the jobs received on the Unix socket at a path. Only returns in the
+ * server, with the error reported, on failure. Otherwise returns JS_TRUE in a
+ * forked child for each job, with the arguments of the job. */
+extern JSBool
+ps_ForkServer(JSContext *cx, const char *path, char ***argvp, int *argcp);
+
+/* Run a job with the arguments on the fork server listening on the Unix socket
+ * at a path. Returns the exit code of the job. */
+extern int
+ps_ForkClient(const char *path, char **argv, int argc);
+
+JS_END_EXTERN_C
+
+#endif /* psforkserver_h___ */
@@ -0,0 +1,1363 @@
+/*
+ * ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is the ProntoScript re-implementation October 4, 2025.
+ *
+ * The Initial Developer of the Original Code is Stefan Sinnige.
+ * Portions created by the Initial Developer are Copyright (C) 2025
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either of the GNU General Public License Version 2 or later (the "GPL"),
+ * or the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK *****
+ */
+
+#include "jsapi.h"
+#include "jscntxt.h"
+#include "jsfun.h"
+#include "jslock.h"
+#include "jsstr.h"
+#include "jstypes.h"
+#include "psbytebuffer.h"
+#include "psdnsresolver.h"
+#include "pshttpclient.h"
+#include "psselect.h"
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ *Forward declarations
+ */
+static JSBool HTTPClient_GetHTTP(JSContext*, JSObject*, uintN, jsval*, jsval*);
+static JSBool HTTPClient_Request(JSContext*, JSObject*, uintN, jsval*, jsval*);
+static void   HTTPRequest_DT(JSContext*, JSObject*);
+static void   HTTPClient_SelectCallback(JSContext*, JSObject*);
+static void   HTTPClient_SelectErrorCallback(JSContext*, JSObject*);
+static void   HTTPClient_TimeoutCallback(JSContext*, JSObject*);
+static void   HTTPClient_ResolveCallback(JSContext*, JSObject*, const char*,
+                                         JSUint32, const char*);
+static JSBool HTTPClient_Invoke(JSContext*, jsval, uintN, jsval*);
+
+/*
+ * A request fails if it has not completed within HTTPCLIENT_TIMEOUT
+ * milliseconds. Up to HTTPCLIENT_IDLE_MAX connections are kept open for each
+ * host and port, for up to HTTPCLIENT_IDLE_TIMEOUT seconds.
+ */
+#define HTTPCLIENT_TIMEOUT 30000
+#define HTTPCLIENT_IDLE_MAX 4
+#define HTTPCLIENT_IDLE_TIMEOUT 30
+#define HTTPCLIENT_RXBUF_INITIAL 16384
+#define HTTPCLIENT_LINE_MAX 16384
+
+/*
+ * An idle connection, kept open to be reused. Idle connections are not
+ * monitored by the asynchronous handling, so that they do not keep the
+ * script from exiting. Instead, a connection is checked to be still open
+ * when it is taken to be reused.
+ */
+typedef struct _HTTPConnection {
+    struct _HTTPConnection* next;
+    int fd;                 /* The socket file descriptor. */
+    JSUint32 address;       /* The address in network byte order. */
+    JSUint16 port;          /* The port. */
+    time_t idle;            /* The time the connection became idle. */
+} HTTPConnection;
+
+static HTTPConnection* http_Idle = NULL;
+
+/*
+ * The state of a request, from resolving the host name up to having parsed
+ * the complete response.
+ */
+typedef enum {
+    HTTPSTATE_RESOLVING,
+    HTTPSTATE_CONNECTING,
+    HTTPSTATE_SENDING,
+    HTTPSTATE_STATUS,
+    HTTPSTATE_HEADERS,
+    HTTPSTATE_BODY,
+    HTTPSTATE_CHUNK_SIZE,
+    HTTPSTATE_CHUNK_DATA,
+    HTTPSTATE_CHUNK_END,
+    HTTPSTATE_TRAILERS,
+    HTTPSTATE_DONE
+} HTTPState;
+
+/*
+ * The request private instance data. The request object is rooted while the
+ * request is pending, its callback functions are kept in reserved slots.
+ */
+typedef struct {
+    JSObject* self;         /* The rooted request object, or NULL. */
+    HTTPState state;        /* The state of the request. */
+    PSResolveRequest* resolve; /* The pending host name resolution. */
+    PSSelectTimer* timer;   /* The pending request timeout. */
+    int fd;                 /* The socket file descriptor, or -1. */
+    JSBool reused;          /* True if the connection has been idle. */
+    JSUint32 address;       /* The address in network byte order. */
+    JSUint16 port;          /* The port. */
+    char* request;          /* The request to be sent. */
+    size_t reqlength;       /* The number of bytes in the request. */
+    size_t reqoffset;       /* The number of bytes already sent. */
+    char* rxbuf;            /* The received data not yet parsed. */
+    size_t rxlength;        /* The number of bytes not yet parsed. */
+    size_t rxcapacity;      /* The size of the receive buffer. */
+    size_t received;        /* The number of bytes received in total. */
+    char* body;             /* The response body. */
+    size_t bodylength;      /* The number of bytes in the body. */
+    size_t bodycapacity;    /* The size of the body buffer. */
+    int status;             /* The response status code. */
+    JSBool head;            /* True if the response has no body. */
+    JSBool idempotent;      /* True if the request may be sent twice. */
+    JSBool chunked;         /* True if the body is chunked. */
+    JSBool sized;           /* True if the body length is known. */
+    JSBool keepAlive;       /* True if the connection can be reused. */
+    size_t remaining;       /* The bytes left of the body or chunk. */
+} HTTPRequest;
+
+enum httprequest_slot {
+    HTTPREQUEST_SLOT_ONSUCCESS = 0,
+    HTTPREQUEST_SLOT_ONERROR = 1
+};
+
+/**
+ * Definition of the request class, which is not exposed to scripts.
+ */
+static JSClass httprequest_class = {
+    "HTTPRequest",                  /* name */
+    JSCLASS_HAS_PRIVATE | JSCLASS_HAS_RESERVED_SLOTS(2), /* flags */
+    JS_PropertyStub,                /* add property */
+    JS_PropertyStub,                /* del property */
+    JS_PropertyStub,                /* get property */
+    JS_PropertyStub,                /* set property */
+    JS_EnumerateStub,               /* enumerate */
+    JS_ResolveStub,                 /* resolve */
+    JS_ConvertStub,                 /* convert */
+    HTTPRequest_DT,                 /* finalize */
+    JSCLASS_NO_OPTIONAL_MEMBERS
+};
+
+/**
+ * Definition of the class methods
+ */
+static JSFunctionSpec httpclient_functions[] = {
+    /* { name, call, nargs, flags, extra } */
+    {"getHTTP", HTTPClient_GetHTTP, 3, 0, 0},
+    {"request", HTTPClient_Request, 6, 0, 0},
+    {0, 0, 0, 0, 0}
+};
+
+/**
+ * Definition of the class
+ */
+static JSClass httpclient_class = {
+    ps_HTTPClient_str,              /* name */
+    0,                              /* flags */
+    JS_PropertyStub,                /* add property */
+    JS_PropertyStub,                /* del property */
+    JS_PropertyStub,                /* get property */
+    JS_PropertyStub,                /* set property */
+    JS_EnumerateStub,               /* enumerate */
+    JS_ResolveStub,                 /* resolve */
+    JS_ConvertStub,                 /* convert */
+    JS_FinalizeStub,                /* finalize */
+    JSCLASS_NO_OPTIONAL_MEMBERS
+};
+
+/*
+ * Take an idle connection to the host and port that is still open, or
+ * return -1 if there is none. Connections that have been idle for too long
+ * are closed.
+ */
+static int
+HTTPClient_TakeIdle(JSContext *cx, JSUint32 address, JSUint16 port)
+{
+    HTTPConnection** link = &http_Idle;
+    time_t now = time(NULL);
+    char c;
+
+    while (*link) {
+        HTTPConnection* conn = *link;
+        JSBool expired = (now - conn->idle > HTTPCLIENT_IDLE_TIMEOUT);
+        int fd = conn->fd;
+        if (!expired && (conn->address != address || conn->port != port)) {
+            link = &conn->next;
+            continue;
+        }
+        *link = conn->next;
+        JS_free(cx, conn);
+
+        /* A connection that has been closed by the server is readable. */
+        if (!expired && recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT) < 0 &&
+            (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            return fd;
+        }
+        close(fd);
+    }
+    return -1;
+}
+
+/*
+ * A forked child does not reuse the idle connections of its parent, as they
+ * may be reused by the parent or another child at the same time.
+ */
+static void
+HTTPClient_AtForkChild()
+{
+    while (http_Idle) {
+        HTTPConnection* conn = http_Idle;
+        http_Idle = conn->next;
+        close(conn->fd);
+        free(conn);
+    }
+}
+
+static void
+HTTPClient_RegisterAtFork()
+{
+    (void) pthread_atfork(NULL, NULL, HTTPClient_AtForkChild);
+}
+
+/*
+ * Keep a connection open to be reused, unless there are enough idle
+ * connections to the host and port already.
+ */
+static void
+HTTPClient_PutIdle(JSContext *cx, int fd, JSUint32 address, JSUint16 port)
+{
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    HTTPConnection* conn;
+    int count = 0;
+
+    (void) pthread_once(&once, HTTPClient_RegisterAtFork);
+
+    for (conn = http_Idle; conn; conn = conn->next) {
+        if (conn->address == address && conn->port == port) {
+            ++count;
+        }
+    }
+    conn = count < HTTPCLIENT_IDLE_MAX
+         ? (HTTPConnection*) JS_malloc(cx, sizeof(HTTPConnection))
+         : NULL;
+    if (!conn) {
+        close(fd);
+        return;
+    }
+    conn->fd = fd;
+    conn->address = address;
+    conn->port = port;
+    conn->idle = time(NULL);
+    conn->next = http_Idle;
+    http_Idle = conn;
+}
+
+/*
+ * Append data to a growing buffer.
+ */
+static JSBool
+HTTPClient_Append(JSContext *cx, char** buf, size_t* length, size_t* capacity,
+                  const char* data, size_t count)
+{
+    if (*length + count > *capacity) {
+        size_t size = JS_MAX(2 * *capacity, *length + count);
+        char* grown = (char*) JS_realloc(cx, *buf, size);
+        if (!grown) {
+            return JS_FALSE;
+        }
+        *buf = grown;
+        *capacity = size;
+    }
+    memcpy(*buf + *length, data, count);
+    *length += count;
+    return JS_TRUE;
+}
+
+/*
+ * Release the resources of a request. The connection is kept open to be
+ * reused if the response has been received completely and the server allows
+ * it.
+ */
+static void
+HTTPClient_Release(JSContext *cx, HTTPRequest* req)
+{
+    if (req->resolve) {
+        ps_CancelResolve(cx, req->resolve);
+        req->resolve = NULL;
+    }
+    if (req->timer) {
+        ps_RemoveTimer(cx, req->timer);
+        req->timer = NULL;
+    }
+    if (req->fd != -1) {
+        ps_RemoveSelect(cx, req->fd);
+        if (req->state == HTTPSTATE_DONE && req->keepAlive) {
+            HTTPClient_PutIdle(cx, req->fd, req->address, req->port);
+        }
+        else {
+            close(req->fd);
+        }
+        req->fd = -1;
+    }
+}
+
+/*
+ * Complete a request, calling the onSuccess callback with the response body
+ * and status, or the onError callback with the error. Each byte of the body
+ * is a character of the string.
+ */
+static void
+HTTPClient_Finish(JSContext *cx, JSObject *obj, HTTPRequest* req,
+                  const char* error)
+{
+    JSTempValueRooter tvr;
+    jsval argv[2];
+    jsval func;
+    JSString* str;
+    jschar* chars;
+
+    HTTPClient_Release(cx, req);
+    argv[0] = argv[1] = JSVAL_NULL;
+    JS_PUSH_TEMP_ROOT(cx, 2, argv, &tvr);
+    if (error) {
+        str = JS_NewStringCopyZ(cx, error);
+        if (str &&
+            JS_GetReservedSlot(cx, obj, HTTPREQUEST_SLOT_ONERROR, &func) &&
+            JSVAL_IS_FUNCTION(cx, func))
+        {
+            argv[0] = STRING_TO_JSVAL(str);
+            HTTPClient_Invoke(cx, func, 1, argv);
+        }
+    }
+    else {
+        chars = (jschar*) JS_malloc(cx, (req->bodylength + 1) * sizeof(jschar));
+        str = NULL;
+        if (chars) {
+            for (size_t i = 0; i < req->bodylength; ++i) {
+                chars[i] = (unsigned char) req->body[i];
+            }
+            chars[req->bodylength] = 0;
+            str = JS_NewUCString(cx, chars, req->bodylength);
+            if (!str) {
+                JS_free(cx, chars);
+            }
+        }
+        if (str &&
+            JS_GetReservedSlot(cx, obj, HTTPREQUEST_SLOT_ONSUCCESS, &func) &&
+            JSVAL_IS_FUNCTION(cx, func))
+        {
+            argv[0] = STRING_TO_JSVAL(str);
+            argv[1] = INT_TO_JSVAL(req->status);
+            HTTPClient_Invoke(cx, func, 2, argv);
+        }
+    }
+    JS_POP_TEMP_ROOT(cx, &tvr);
+
+    /* The request object may be collected from now on. */
+    if (req->self) {
+        JS_RemoveRoot(cx, &req->self);
+        req->self = NULL;
+    }
+}
+
+/*
+ * Connect to the server, reusing an idle connection if there is one. Returns
+ * NULL on success, otherwise the error.
+ */
+static const char*
+HTTPClient_Connect(JSContext *cx, JSObject *obj, HTTPRequest* req,
+                   JSBool reuse)
+{
+    struct sockaddr_in addr;
+    PSFDSet mask = PSFDSET_WRITE;
+
+    req->fd = reuse ? HTTPClient_TakeIdle(cx, req->address, req->port) : -1;
+    req->reused = (req->fd != -1);
+    if (req->reused) {
+        req->state = HTTPSTATE_SENDING;
+    }
+    else {
+        req->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                         0);
+        if (req->fd < 0) {
+            return strerror(errno);
+        }
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = req->address;
+        addr.sin_port = htons(req->port);
+        req->state = HTTPSTATE_CONNECTING;
+        if (connect(req->fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 &&
+            errno != EINPROGRESS)
+        {
+            return strerror(errno);
+        }
+    }
+    if (!ps_AddSelect(cx, req->fd, mask, obj, &HTTPClient_SelectCallback,
+                      &HTTPClient_SelectErrorCallback, -1))
+    {
+        return "asynchronous socket setup";
+    }
+    return NULL;
+}
+
+/*
+ * Check whether a request method is idempotent, so that the request may be
+ * sent again when the connection closes before the response (RFC 7230,
+ * section 6.3.1).
+ */
+static JSBool
+HTTPClient_Idempotent(const char* method)
+{
+    static const char* const methods[] = {
+        "GET", "HEAD", "PUT", "DELETE", "OPTIONS", "TRACE", NULL
+    };
+
+    for (int i = 0; methods[i]; ++i) {
+        if (strcmp(method, methods[i]) == 0) {
+            return JS_TRUE;
+        }
+    }
+    return JS_FALSE;
+}
+
+/*
+ * Send the request again on a new connection, when a reused connection has
+ * been closed by the server before it responded. Returns JS_FALSE if the
+ * request cannot be retried.
+ */
+static JSBool
+HTTPClient_Retry(JSContext *cx, JSObject *obj, HTTPRequest* req)
+{
+    const char* error;
+
+    if (!req->reused || !req->idempotent || req->received > 0) {
+        return JS_FALSE;
+    }
+    ps_RemoveSelect(cx, req->fd);
+    close(req->fd);
+    req->fd = -1;
+    req->reqoffset = 0;
+    error = HTTPClient_Connect(cx, obj, req, JS_FALSE);
+    if (error) {
+        HTTPClient_Finish(cx, obj, req, error);
+    }
+    return JS_TRUE;
+}
+
+/*
+ * Find the end of a line in the received data, from the given position.
+ * Returns JS_TRUE if a complete line has been received, with its length
+ * without the line ending, and the position of the next line.
+ */
+static JSBool
+HTTPClient_Line(HTTPRequest* req, size_t pos, size_t* length, size_t* next)
+{
+    const char* end = memchr(req->rxbuf + pos, '\n', req->rxlength - pos);
+
+    if (!end) {
+        return JS_FALSE;
+    }
+    *next = end - req->rxbuf + 1;
+    *length = *next - pos - 1;
+    if (*length > 0 && req->rxbuf[pos + *length - 1] == '\r') {
+        --*length;
+    }
+    return JS_TRUE;
+}
+
+/*
+ * Parse a number from a line, in the given base. A sign is not accepted.
+ */
+static JSBool
+HTTPClient_Number(const char* data, size_t length, int base, size_t* number)
+{
+    char digits[32];
+    char* end;
+
+    while (length > 0 && (*data == ' ' || *data == '\t')) {
+        ++data;
+        --length;
+    }
+    if (length == 0 || length >= sizeof(digits) ||
+        !(base == 16 ? isxdigit((unsigned char) *data)
+                     : isdigit((unsigned char) *data)))
+    {
+        return JS_FALSE;
+    }
+    memcpy(digits, data, length);
+    digits[length] = 0;
+    errno = 0;
+    *number = strtoul(digits, &end, base);
+    return end != digits && errno == 0;
+}
+
+/*
+ * Handle a response header. Only the headers that determine the length of
+ * the body and whether the connection can be reused are of interest.
+ */
+static JSBool
+HTTPClient_Header(HTTPRequest* req, const char* line, size_t length)
+{
+    const char* colon = memchr(line, ':', length);
+    const char* value;
+    size_t namelength, valuelength;
+
+    if (!colon) {
+        return JS_FALSE;
+    }
+    namelength = colon - line;
+    value = colon + 1;
+    valuelength = length - namelength - 1;
+    while (valuelength > 0 && (*value == ' ' || *value == '\t')) {
+        ++value;
+        --valuelength;
+    }
+    while (valuelength > 0 &&
+           (value[valuelength - 1] == ' ' || value[valuelength - 1] == '\t'))
+    {
+        --valuelength;
+    }
+
+    if (namelength == 14 && strncasecmp(line, "Content-Length", 14) == 0) {
+        req->sized = JS_TRUE;
+        return HTTPClient_Number(value, valuelength, 10, &req->remaining);
+    }
+    if (namelength == 17 && strncasecmp(line, "Transfer-Encoding", 17) == 0) {
+        req->chunked = valuelength >= 7 &&
+            strncasecmp(value + valuelength - 7, "chunked", 7) == 0;
+    }
+    else if (namelength == 10 && strncasecmp(line, "Connection", 10) == 0) {
+        if (valuelength == 5 && strncasecmp(value, "close", 5) == 0) {
+            req->keepAlive = JS_FALSE;
+        }
+        else if (valuelength == 10 &&
+                 strncasecmp(value, "keep-alive", 10) == 0)
+        {
+            req->keepAlive = JS_TRUE;
+        }
+    }
+    return JS_TRUE;
+}
+
+/*
+ * Parse the received data, taking the parsed data from the receive buffer.
+ * Returns 1 once the response is complete, 0 if more data is needed and -1
+ * if the response is invalid.
+ */
+static int
+HTTPClient_Parse(JSContext *cx, HTTPRequest* req)
+{
+    size_t pos = 0, length, next, count;
+    const char* line;
+    int result = 0;
+
+    while (req->state != HTTPSTATE_DONE && result == 0) {
+        line = req->rxbuf + pos;
+        switch (req->state) {
+            case HTTPSTATE_STATUS:
+                if (!HTTPClient_Line(req, pos, &length, &next)) {
+                    goto more;
+                }
+                if (length < 12 || strncmp(line, "HTTP/1.", 7) != 0 ||
+                    !HTTPClient_Number(line + 9, 3, 10, &count))
+                {
+                    result = -1;
+                    break;
+                }
+                req->status = (int) count;
+                req->keepAlive = (line[7] != '0');
+                req->chunked = JS_FALSE;
+                req->sized = JS_FALSE;
+                req->remaining = 0;
+                req->state = HTTPSTATE_HEADERS;
+                pos = next;
+                break;
+
+            case HTTPSTATE_HEADERS:
+                if (!HTTPClient_Line(req, pos, &length, &next)) {
+                    goto more;
+                }
+                pos = next;
+                if (length > 0) {
+                    if (!HTTPClient_Header(req, line, length)) {
+                        result = -1;
+                    }
+                    break;
+                }
+
+                /* The end of the headers determines how the body ends. An
+                 * interim response is followed by the final response. */
+                if (req->status / 100 == 1) {
+                    req->state = HTTPSTATE_STATUS;
+                }
+                else if (req->head || req->status == 204 ||
+                         req->status == 304)
+                {
+                    req->state = HTTPSTATE_DONE;
+                }
+                else if (req->chunked) {
+                    req->state = HTTPSTATE_CHUNK_SIZE;
+                }
+                else if (req->sized) {
+                    req->state = req->remaining > 0 ? HTTPSTATE_BODY
+                                                    : HTTPSTATE_DONE;
+                }
+                else {
+                    /* The body ends when the connection is closed. */
+                    req->keepAlive = JS_FALSE;
+                    req->state = HTTPSTATE_BODY;
+                }
+                break;
+
+            case HTTPSTATE_BODY:
+            case HTTPSTATE_CHUNK_DATA:
+                count = req->rxlength - pos;
+                if (req->sized || req->chunked) {
+                    count = JS_MIN(count, req->remaining);
+                }
+                if (!HTTPClient_Append(cx, &req->body, &req->bodylength,
+                                       &req->bodycapacity, line, count))
+                {
+                    result = -1;
+                    break;
+                }
+                pos += count;
+                if (!req->sized && !req->chunked) {
+                    goto more;
+                }
+                req->remaining -= count;
+                if (req->remaining > 0) {
+                    goto more;
+                }
+                req->state = req->chunked ? HTTPSTATE_CHUNK_END
+                                          : HTTPSTATE_DONE;
+                break;
+
+            case HTTPSTATE_CHUNK_SIZE:
+                if (!HTTPClient_Line(req, pos, &length, &next)) {
+                    goto more;
+                }
+                /* Ignore any chunk extensions. */
+                for (count = 0; count < length && line[count] != ';';
+                     ++count)
+                {
+                    continue;
+                }
+                if (!HTTPClient_Number(line, count, 16, &req->remaining)) {
+                    result = -1;
+                    break;
+                }
+                req->state = req->remaining > 0 ? HTTPSTATE_CHUNK_DATA
+                                                : HTTPSTATE_TRAILERS;
+                pos = next;
+                break;
+
+            case HTTPSTATE_CHUNK_END:
+                if (!HTTPClient_Line(req, pos, &length, &next)) {
+                    goto more;
+                }
+                req->state = HTTPSTATE_CHUNK_SIZE;
+                pos = next;
+                break;
+
+            case HTTPSTATE_TRAILERS:
+                if (!HTTPClient_Line(req, pos, &length, &next)) {
+                    goto more;
+                }
+                if (length == 0) {
+                    req->state = HTTPSTATE_DONE;
+                }
+                pos = next;
+                break;
+
+            default:
+                result = -1;
+                break;
+        }
+    }
+    if (result < 0) {
+        return -1;
+    }
+
+    /* Data following the response cannot be handled, the connection is not
+     * reused. */
+    if (pos < req->rxlength) {
+        req->keepAlive = JS_FALSE;
+    }
+    req->rxlength = 0;
+    return 1;
+
+more:
+    /* A line that does not end within the maximum line length is invalid. */
+    if (req->rxlength - pos > HTTPCLIENT_LINE_MAX &&
+        req->state != HTTPSTATE_BODY && req->state != HTTPSTATE_CHUNK_DATA)
+    {
+        return -1;
+    }
+    memmove(req->rxbuf, req->rxbuf + pos, req->rxlength - pos);
+    req->rxlength -= pos;
+    return 0;
+}
+
+/*
+ * Receive and parse the available data of the response.
+ */
+static void
+HTTPClient_Receive(JSContext *cx, JSObject *obj, HTTPRequest* req)
+{
+    ssize_t nrecv;
+    int parsed;
+
+    for (;;) {
+        if (req->rxlength == req->rxcapacity) {
+            size_t size = req->rxcapacity == 0 ? HTTPCLIENT_RXBUF_INITIAL
+                                               : 2 * req->rxcapacity;
+            char* grown = (char*) JS_realloc(cx, req->rxbuf, size);
+            if (!grown) {
+                HTTPClient_Finish(cx, obj, req, "out of memory");
+                return;
+            }
+            req->rxbuf = grown;
+            req->rxcapacity = size;
+        }
+        nrecv = recv(req->fd, req->rxbuf + req->rxlength,
+                     req->rxcapacity - req->rxlength, MSG_DONTWAIT);
+        if (nrecv > 0) {
+            req->rxlength += nrecv;
+            req->received += nrecv;
+            parsed = HTTPClient_Parse(cx, req);
+            if (parsed != 0) {
+                HTTPClient_Finish(cx, obj, req,
+                                  parsed < 0 ? "invalid response" : NULL);
+                return;
+            }
+        }
+        else if (nrecv == 0) {
+            /* A body without length ends when the connection is closed. */
+            if (req->state == HTTPSTATE_BODY && !req->sized &&
+                !req->chunked)
+            {
+                req->state = HTTPSTATE_DONE;
+                HTTPClient_Finish(cx, obj, req, NULL);
+            }
+            else if (!HTTPClient_Retry(cx, obj, req)) {
+                HTTPClient_Finish(cx, obj, req, "connection closed");
+            }
+            return;
+        }
+        else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return;
+        }
+        else if (errno != EINTR) {
+            if (!HTTPClient_Retry(cx, obj, req)) {
+                HTTPClient_Finish(cx, obj, req, strerror(errno));
+            }
+            return;
+        }
+    }
+}
+
+/*
+ * Callback when the file descriptor has been triggered. The request is sent
+ * once connected, after which the response is received.
+ */
+static void
+HTTPClient_SelectCallback(JSContext *cx, JSObject *obj)
+{
+    HTTPRequest* req = NULL;
+    socklen_t length = sizeof(int);
+    ssize_t nsent;
+    int error = 0;
+
+    req = (HTTPRequest*) JS_GetPrivate(cx, obj);
+    if (!req || req->fd == -1) {
+        return;
+    }
+
+    if (req->state == HTTPSTATE_CONNECTING) {
+        if (getsockopt(req->fd, SOL_SOCKET, SO_ERROR, &error, &length) < 0) {
+            error = errno;
+        }
+        if (error) {
+            HTTPClient_Finish(cx, obj, req, strerror(error));
+            return;
+        }
+        req->state = HTTPSTATE_SENDING;
+    }
+
+    if (req->state == HTTPSTATE_SENDING) {
+        while (req->reqoffset < req->reqlength) {
+            nsent = send(req->fd, req->request + req->reqoffset,
+                         req->reqlength - req->reqoffset,
+                         MSG_DONTWAIT | MSG_NOSIGNAL);
+            if (nsent < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    return;
+                }
+                if (!HTTPClient_Retry(cx, obj, req)) {
+                    HTTPClient_Finish(cx, obj, req, strerror(errno));
+                }
+                return;
+            }
+            req->reqoffset += nsent;
+        }
+        req->state = HTTPSTATE_STATUS;
+        if (!ps_AddSelect(cx, req->fd, PSFDSET_READ, obj,
+                          &HTTPClient_SelectCallback,
+                          &HTTPClient_SelectErrorCallback, -1))
+        {
+            HTTPClient_Finish(cx, obj, req, "asynchronous socket setup");
+        }
+        return;
+    }
+
+    HTTPClient_Receive(cx, obj, req);
+}
+
+/*
+ * Callback when the file descriptor has triggered an error.
+ */
+static void
+HTTPClient_SelectErrorCallback(JSContext *cx, JSObject *obj)
+{
+    HTTPRequest* req = NULL;
+    int error = 0;
+    socklen_t length = sizeof(error);
+
+    req = (HTTPRequest*) JS_GetPrivate(cx, obj);
+    if (!req || req->fd == -1) {
+        return;
+    }
+    if (getsockopt(req->fd, SOL_SOCKET, SO_ERROR, &error, &length) < 0 ||
+        error == 0)
+    {
+        error = ECONNRESET;
+    }
+    if (!HTTPClient_Retry(cx, obj, req)) {
+        HTTPClient_Finish(cx, obj, req, strerror(error));
+    }
+}
+
+/*
+ * Callback when the request has timed out.
+ */
+static void
+HTTPClient_TimeoutCallback(JSContext *cx, JSObject *obj)
+{
+    HTTPRequest* req = NULL;
+
+    req = (HTTPRequest*) JS_GetPrivate(cx, obj);
+    if (!req) {
+        return;
+    }
+    req->timer = NULL;
+    HTTPClient_Finish(cx, obj, req, "timeout");
+}
+
+/*
+ * Callback when the host name has been resolved.
+ */
+static void
+HTTPClient_ResolveCallback(JSContext *cx, JSObject *obj, const char *name,
+                           JSUint32 address, const char *error)
+{
+    HTTPRequest* req = NULL;
+
+    req = (HTTPRequest*) JS_GetPrivate(cx, obj);
+    if (!req) {
+        return;
+    }
+    req->resolve = NULL;
+    if (!error) {
+        req->address = address;
+        error = HTTPClient_Connect(cx, obj, req, req->idempotent);
+    }
+    if (error) {
+        HTTPClient_Finish(cx, obj, req, error);
+    }
+}
+
+/*
+ * Invoke a callback function with the global object as 'this'.
+ */
+static JSBool
+HTTPClient_Invoke(JSContext *cx, jsval fun, uintN argc, jsval *argv)
+{
+    JSStackFrame* fp;
+    jsval *sp, *oldsp;
+    void *mark;
+    JSBool result;
+
+    /* Allocate call stack frame and push the function, object and argument */
+    sp = js_AllocStack(cx, 2 + argc, &mark);
+    if (!sp) {
+        return JS_FALSE;
+    }
+    *sp++ = fun;
+    *sp++ = OBJECT_TO_JSVAL(cx->globalObject);
+    for (uintN i = 0; i < argc; ++i) {
+        *sp++ = argv[i];
+    }
+
+    /* Lift current frame and call */
+    fp = cx->fp;
+    oldsp = fp->sp;
+    fp->sp = sp;
+    result = js_Invoke(cx, argc, JSINVOKE_INTERNAL | JSINVOKE_SKIP_CALLER);
+
+    /* Pop the call stack frame */
+    fp->sp = oldsp;
+    js_FreeStack(cx, mark);
+    return result;
+}
+
+/**
+ * Destructor.
+ */
+static void
+HTTPRequest_DT(JSContext* cx, JSObject *obj)
+{
+    HTTPRequest* req = NULL;
+
+    req = (HTTPRequest*)JS_GetInstancePrivate(cx, obj, &httprequest_class,
+                                              NULL);
+    if (req) {
+        HTTPClient_Release(cx, req);
+        if (req->request) {
+            JS_free(cx, req->request);
+        }
+        if (req->rxbuf) {
+            JS_free(cx, req->rxbuf);
+        }
+        if (req->body) {
+            JS_free(cx, req->body);
+        }
+        JS_free(cx, req);
+    }
+}
+
+/*
+ * Split an URL into the host name, port and path. The host name is copied
+ * into the buffer. Only the 'http' scheme is supported.
+ */
+static JSBool
+HTTPClient_ParseURL(JSContext *cx, const char* url, char* host,
+                    size_t hostsize, JSUint16* port, const char** path)
+{
+    const char* end;
+    size_t number;
+
+    if (strncasecmp(url, "http://", 7) != 0) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_FAILED, "unsupported URL");
+        return JS_FALSE;
+    }
+    url += 7;
+    end = url + strcspn(url, ":/?#");
+    if (end == url || end - url >= hostsize) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_INVALID_NAME);
+        return JS_FALSE;
+    }
+    memcpy(host, url, end - url);
+    host[end - url] = 0;
+    *port = 80;
+    if (*end == ':') {
+        url = end + 1;
+        end = url + strcspn(url, "/?#");
+        if (!HTTPClient_Number(url, end - url, 10, &number) ||
+            number == 0 || number > 65535)
+        {
+            JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                                 PSMSG_ARGUMENT_OUT_OF_RANGE);
+            return JS_FALSE;
+        }
+        *port = (JSUint16) number;
+    }
+    *path = end;
+    return JS_TRUE;
+}
+
+/*
+ * Compose the request message.
+ */
+static JSBool
+HTTPClient_Compose(JSContext *cx, HTTPRequest* req, const char* method,
+                   const char* host, const char* path, jsval body,
+                   JSObject* headers)
+{
+    char line[512];
+    size_t capacity = 0;
+    size_t pathlength = strcspn(path, "#");
+    const char* bytes = NULL;
+    JSString* str = NULL;
+    size_t length = 0;
+    JSIdArray* ids;
+    jsval name, value;
+    JSBool ok = JS_TRUE;
+
+    /* Get the body, a string or a ByteBuffer. */
+    if (!JSVAL_IS_NULL(body) && !JSVAL_IS_VOID(body)) {
+        bytes = ps_GetByteBufferData(cx, body, &length);
+        if (!bytes) {
+            str = JS_ValueToString(cx, body);
+            if (!str) {
+                return JS_FALSE;
+            }
+            length = JSSTRING_LENGTH(str);
+        }
+    }
+
+    /* The request line and the headers. */
+    if (strlen(method) + pathlength + 16 > sizeof(line) ||
+        strlen(host) + 16 > sizeof(line))
+    {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_ARGUMENT_OUT_OF_RANGE);
+        return JS_FALSE;
+    }
+    snprintf(line, sizeof(line), "%s %s%.*s HTTP/1.1\r\n", method,
+             (pathlength == 0 || *path == '?') ? "/" : "", (int) pathlength,
+             path);
+    ok = HTTPClient_Append(cx, &req->request, &req->reqlength, &capacity,
+                           line, strlen(line));
+    if (req->port == 80) {
+        snprintf(line, sizeof(line), "Host: %s\r\n", host);
+    }
+    else {
+        snprintf(line, sizeof(line), "Host: %s:%u\r\n", host, req->port);
+    }
+    ok = ok && HTTPClient_Append(cx, &req->request, &req->reqlength,
+                                 &capacity, line, strlen(line));
+    if (str || bytes) {
+        snprintf(line, sizeof(line), "Content-Length: %lu\r\n",
+                 (unsigned long) length);
+        ok = ok && HTTPClient_Append(cx, &req->request, &req->reqlength,
+                                     &capacity, line, strlen(line));
+    }
+    if (ok && headers) {
+        ids = JS_Enumerate(cx, headers);
+        if (!ids) {
+            return JS_FALSE;
+        }
+        for (jsint i = 0; ok && i < ids->length; ++i) {
+            JSString* n;
+            JSString* v;
+            ok = JS_IdToValue(cx, ids->vector[i], &name) &&
+                 (n = JS_ValueToString(cx, name)) != NULL &&
+                 JS_GetStringBytes(n) &&
+                 JS_LookupProperty(cx, headers, JS_GetStringBytes(n),
+                                   &value) &&
+                 (v = JS_ValueToString(cx, value)) != NULL;
+            if (ok) {
+                const char* data = JS_GetStringBytes(n);
+                ok = HTTPClient_Append(cx, &req->request, &req->reqlength,
+                                       &capacity, data, strlen(data)) &&
+                     HTTPClient_Append(cx, &req->request, &req->reqlength,
+                                       &capacity, ": ", 2);
+                data = JS_GetStringBytes(v);
+                ok = ok &&
+                     HTTPClient_Append(cx, &req->request, &req->reqlength,
+                                       &capacity, data, strlen(data)) &&
+                     HTTPClient_Append(cx, &req->request, &req->reqlength,
+                                       &capacity, "\r\n", 2);
+            }
+        }
+        JS_DestroyIdArray(cx, ids);
+    }
+    ok = ok && HTTPClient_Append(cx, &req->request, &req->reqlength,
+                                 &capacity, "\r\n", 2);
+
+    /* The body, of which each character of a string is a byte. */
+    if (ok && bytes) {
+        ok = HTTPClient_Append(cx, &req->request, &req->reqlength, &capacity,
+                               bytes, length);
+    }
+    else if (ok && str) {
+        const jschar* chars = JSSTRING_CHARS(str);
+        for (size_t i = 0; ok && i < length; i += sizeof(line)) {
+            size_t count = JS_MIN(length - i, sizeof(line));
+            for (size_t j = 0; j < count; ++j) {
+                line[j] = (char) chars[i + j];
+            }
+            ok = HTTPClient_Append(cx, &req->request, &req->reqlength,
+                                   &capacity, line, count);
+        }
+    }
+    return ok;
+}
+
+/*
+ * Start a request.
+ */
+static JSBool
+HTTPClient_Start(JSContext *cx, const char* method, const char* url,
+                 jsval body, JSObject* headers, jsval onSuccess,
+                 jsval onError, jsval *rval)
+{
+    JSObject* obj;
+    HTTPRequest* req;
+    char host[256];
+    const char* path;
+    const char* error = NULL;
+    JSUint16 port;
+
+    if (!HTTPClient_ParseURL(cx, url, host, sizeof(host), &port, &path)) {
+        return JS_FALSE;
+    }
+
+    /* Create the request object, keeping the callback functions. */
+    obj = JS_NewObject(cx, &httprequest_class, NULL, NULL);
+    if (!obj) {
+        return JS_FALSE;
+    }
+    *rval = OBJECT_TO_JSVAL(obj);
+    if (!JS_SetReservedSlot(cx, obj, HTTPREQUEST_SLOT_ONSUCCESS, onSuccess) ||
+        !JS_SetReservedSlot(cx, obj, HTTPREQUEST_SLOT_ONERROR, onError))
+    {
+        return JS_FALSE;
+    }
+    req = (HTTPRequest*) JS_malloc(cx, sizeof(HTTPRequest));
+    if (!req) {
+        return JS_FALSE;
+    }
+    memset(req, 0, sizeof(HTTPRequest));
+    req->fd = -1;
+    req->port = port;
+    req->head = (strcmp(method, "HEAD") == 0);
+    req->idempotent = HTTPClient_Idempotent(method);
+    req->state = HTTPSTATE_RESOLVING;
+    if (!JS_SetPrivate(cx, obj, req)) {
+        JS_free(cx, req);
+        return JS_FALSE;
+    }
+    if (!HTTPClient_Compose(cx, req, method, host, path, body, headers)) {
+        return JS_FALSE;
+    }
+
+    /* Keep the request object alive while the request is pending. */
+    req->self = obj;
+    if (!JS_AddNamedRoot(cx, &req->self, "HTTPRequest.self")) {
+        req->self = NULL;
+        return JS_FALSE;
+    }
+    req->timer = ps_AddTimer(cx, obj, &HTTPClient_TimeoutCallback,
+                             HTTPCLIENT_TIMEOUT);
+    if (!req->timer) {
+        error = "timer setup";
+    }
+
+    /* Connect right away if the address is known, otherwise resolve the host
+     * name without blocking. */
+    else if (ps_LookupHost(host, &req->address, &error) && !error) {
+        error = HTTPClient_Connect(cx, obj, req, req->idempotent);
+    }
+    else {
+        error = NULL;
+        req->resolve = ps_ResolveHostAsync(cx, host, obj,
+                                           &HTTPClient_ResolveCallback);
+        if (!req->resolve) {
+            error = "lookup error";
+        }
+    }
+    if (error) {
+        HTTPClient_Release(cx, req);
+        JS_RemoveRoot(cx, &req->self);
+        req->self = NULL;
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_FAILED, error);
+        return JS_FALSE;
+    }
+    return JS_TRUE;
+}
+
+/*
+ * Get an optional callback function argument.
+ */
+static JSBool
+HTTPClient_Callback(JSContext *cx, uintN argc, jsval *argv, uintN index,
+                    jsval* func)
+{
+    *func = JSVAL_NULL;
+    if (argc > index && !JSVAL_IS_VOID(argv[index]) &&
+        !JSVAL_IS_NULL(argv[index]))
+    {
+        if (!JSVAL_IS_FUNCTION(cx, argv[index])) {
+            JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                                 PSMSG_ARGUMENT_NOT_A_FUNCTION);
+            return JS_FALSE;
+        }
+        *func = argv[index];
+    }
+    return JS_TRUE;
+}
+
+/**
+ * Synopsis:
+ *      getHTTP(url, onSuccess[, onError])
+ * Purpose:
+ *      Get a resource over HTTP.
+ * Parameters:
+ *      url         String
+ *              The URL of the resource, which must be an 'http' URL.
+ *      onSuccess   Function
+ *              Called with the response body and status code once the
+ *              response has been received.
+ *      onError     Function (opt)
+ *              Called with the error if the request has failed.
+ * Returns:
+ *      Object  The request.
+ * Exceptions:
+ *      Not enough arguments specified
+ *      Argument is not a string
+ *      Argument is not a function
+ *      Argument out of range
+ *      Invalid name
+ *      Failed
+ * Additional Information:
+ *      Compatible with the getHTTP() function of the Philips HttpLibrary, the
+ *      onSuccess callback is also called for a response that is not 2xx.
+ */
+static JSBool
+HTTPClient_GetHTTP(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
+                   jsval *rval)
+{
+    jsval onSuccess, onError;
+
+    if (argc < 2) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_NOT_ENOUGH_ARGUMENTS);
+        return JS_FALSE;
+    }
+    if (JS_TypeOfValue(cx, argv[0]) != JSTYPE_STRING) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_ARGUMENT_NOT_STRING);
+        return JS_FALSE;
+    }
+    if (!HTTPClient_Callback(cx, argc, argv, 1, &onSuccess) ||
+        !HTTPClient_Callback(cx, argc, argv, 2, &onError))
+    {
+        return JS_FALSE;
+    }
+    return HTTPClient_Start(cx, "GET",
+                            JS_GetStringBytes(JSVAL_TO_STRING(argv[0])),
+                            JSVAL_NULL, NULL, onSuccess, onError, rval);
+}
+
+/**
+ * Synopsis:
+ *      request(method, url, body, onSuccess[, onError[, headers]])
+ * Purpose:
+ *      Send an HTTP request.
+ * Parameters:
+ *      method      String
+ *              The request method, such as "GET", "PUT" or "POST".
+ *      url         String
+ *              The URL of the resource, which must be an 'http' URL.
+ *      body        String or ByteBuffer
+ *              The request body, or null if there is none. Each character of
+ *              a string is a byte.
+ *      onSuccess   Function
+ *              Called with the response body and status code once the
+ *              response has been received.
+ *      onError     Function (opt)
+ *              Called with the error if the request has failed.
+ *      headers     Object (opt)
+ *              Additional request headers, each property is a header.
+ * Returns:
+ *      Object  The request.
+ * Exceptions:
+ *      Not enough arguments specified
+ *      Argument is not a string
+ *      Argument is not a function
+ *      Argument out of range
+ *      Invalid name
+ *      Failed
+ */
+static JSBool
+HTTPClient_Request(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
+                   jsval *rval)
+{
+    jsval onSuccess, onError;
+    JSObject* headers = NULL;
+
+    if (argc < 4) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_NOT_ENOUGH_ARGUMENTS);
+        return JS_FALSE;
+    }
+    if (JS_TypeOfValue(cx, argv[0]) != JSTYPE_STRING ||
+        JS_TypeOfValue(cx, argv[1]) != JSTYPE_STRING ||
+        JSSTRING_LENGTH(JSVAL_TO_STRING(argv[0])) == 0)
+    {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_ARGUMENT_NOT_STRING);
+        return JS_FALSE;
+    }
+    if (!HTTPClient_Callback(cx, argc, argv, 3, &onSuccess) ||
+        !HTTPClient_Callback(cx, argc, argv, 4, &onError))
+    {
+        return JS_FALSE;
+    }
+    if (argc > 5 && !JSVAL_IS_PRIMITIVE(argv[5])) {
+        headers = JSVAL_TO_OBJECT(argv[5]);
+    }
+    return HTTPClient_Start(cx, JS_GetStringBytes(JSVAL_TO_STRING(argv[0])),
+                            JS_GetStringBytes(JSVAL_TO_STRING(argv[1])),
+                            argv[2], headers, onSuccess, onError, rval);
+}
+
+/**
+ * HTTPClient class initialiser.
+ */
+JSObject*
+ps_InitHTTPClientClass(JSContext *cx, JSObject *obj)
+{
+    JSObject *proto;
+
+    proto = JS_InitClass(cx, obj, NULL, &httpclient_class, NULL, 0,
+                         NULL, NULL, NULL, httpclient_functions);
+    if (!proto) {
+        return NULL;
+    }
+    return proto;
+}
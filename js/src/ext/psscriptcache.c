@@ -0,0 +1,714 @@
+/*
+ * ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is the ProntoScript re-implementation October 4, 2025.
+ *
+ * The Initial Developer of the Original Code is Stefan Sinnige.
+ * Portions created by the Initial Developer are Copyright (C) 2025
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either of the GNU General Public License Version 2 or later (the "GPL"),
+ * or the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK *****
+ */
+
+#include "jsapi.h"
+#include "jscntxt.h"
+#include "jsxdrapi.h"
+#include "psscriptcache.h"
+#include "pssystem.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/*
+ * A compiled script in the cache. The script object is rooted while it is
+ * cached. A script that is replaced by a newer version, because its file has
+ * been modified, is kept until the cache is destroyed, as it may still be
+ * executing.
+ */
+typedef struct _PSCachedScript {
+    struct _PSCachedScript* next;
+    JSRuntime* rt;          /* The runtime the script is compiled for. */
+    char* path;             /* The canonical path of the script file. */
+    uint32 mtime;           /* The modification time, in seconds. */
+    uint32 mtimensec;       /* The nanoseconds of the modification time. */
+    uint32 size;            /* The size of the file. */
+    JSScript* script;       /* The compiled script. */
+    JSObject* scriptObj;    /* The script object, owning the script. */
+} PSCachedScript;
+
+/*
+ * The cached scripts, newest first, and the directory the compiled script
+ * images are stored in.
+ */
+static PSCachedScript* ps_ScriptCache = NULL;
+static const char* ps_ScriptCacheDir = NULL;
+
+/*
+ * The snapshot of the cached scripts, whether it has been restored, and
+ * whether scripts have been compiled since.
+ */
+static const char* ps_SnapshotPath = NULL;
+static JSBool ps_SnapshotRestored = JS_FALSE;
+static JSBool ps_SnapshotModified = JS_FALSE;
+
+void
+ps_SetScriptCacheDirectory(const char *dir)
+{
+    ps_ScriptCacheDir = dir;
+}
+
+/*
+ * Get the modification time and size of the script file.
+ */
+static void
+ScriptCache_Stat(const struct stat* st, uint32* mtime, uint32* mtimensec,
+                 uint32* size)
+{
+    *mtime = (uint32) st->st_mtime;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+    *mtimensec = (uint32) st->st_mtim.tv_nsec;
+#else
+    *mtimensec = 0;
+#endif
+    *size = (uint32) st->st_size;
+}
+
+/*
+ * Get the path of the compiled script image of a script file. The image is
+ * named after a hash (FNV-1a) of the canonical path of the file.
+ */
+static JSBool
+ScriptCache_ImagePath(const char* path, char* image, size_t length)
+{
+    JSUint32 hash = 2166136261U;
+    int n;
+
+    for (const char* p = path; *p; ++p) {
+        hash = (hash ^ (unsigned char) *p) * 16777619U;
+    }
+    n = snprintf(image, length, "%s/%08x.jsc", ps_ScriptCacheDir,
+                 (unsigned int) hash);
+    return n > 0 && (size_t) n < length;
+}
+
+/*
+ * Encode or decode a string that is known in advance. A decoded string is
+ * checked against it, and JS_FALSE returned if it does not match.
+ */
+static JSBool
+ScriptCache_XDRKnownString(JSXDRState* xdr, const char* known)
+{
+    char* str = (char*) known;
+    JSBool ok;
+
+    if (!JS_XDRCString(xdr, &str)) {
+        return JS_FALSE;
+    }
+    if (xdr->mode == JSXDR_DECODE) {
+        ok = strcmp(str, known) == 0;
+        JS_free(xdr->cx, str);
+        return ok;
+    }
+    return JS_TRUE;
+}
+
+/*
+ * Encode or decode the modification time and size of a script file. Decoded
+ * values are checked against the file, and JS_FALSE returned if they do not
+ * match.
+ */
+static JSBool
+ScriptCache_XDRStat(JSXDRState* xdr, uint32 mtime, uint32 mtimensec,
+                    uint32 size)
+{
+    uint32 values[3];
+
+    values[0] = mtime;
+    values[1] = mtimensec;
+    values[2] = size;
+    for (int i = 0; i < 3; ++i) {
+        uint32 value = values[i];
+        if (!JS_XDRUint32(xdr, &value) ||
+            (xdr->mode == JSXDR_DECODE && value != values[i]))
+        {
+            return JS_FALSE;
+        }
+    }
+    return JS_TRUE;
+}
+
+/*
+ * Encode or decode the engine that scripts are compiled by, being its version,
+ * the version of the compiled script encoding and the checksum of the engine
+ * sources taken by configure. A decoded engine is checked against this one,
+ * and JS_FALSE returned if it does not match.
+ */
+static JSBool
+ScriptCache_XDREngine(JSXDRState* xdr)
+{
+    uint32 magic = JSXDR_MAGIC_SCRIPT_CURRENT;
+
+    if (!ScriptCache_XDRKnownString(xdr, JS_GetImplementationVersion()) ||
+        !JS_XDRUint32(xdr, &magic) || magic != JSXDR_MAGIC_SCRIPT_CURRENT)
+    {
+        return JS_FALSE;
+    }
+    return ScriptCache_XDRKnownString(xdr, PS_ENGINE_HASH);
+}
+
+/*
+ * Encode or decode the header of a compiled script image, which identifies
+ * the engine and the script file it was compiled from. A decoded header is
+ * checked against the engine and the file, and JS_FALSE returned if it does
+ * not match.
+ */
+static JSBool
+ScriptCache_XDRHeader(JSXDRState* xdr, const char* path, uint32 mtime,
+                      uint32 mtimensec, uint32 size)
+{
+    return ScriptCache_XDREngine(xdr) &&
+           ScriptCache_XDRKnownString(xdr, path) &&
+           ScriptCache_XDRStat(xdr, mtime, mtimensec, size);
+}
+
+/*
+ * Read a compiled image into a decoding memory state. Returns NULL, without
+ * an error reported, if the image cannot be read.
+ */
+static JSXDRState*
+ScriptCache_Read(JSContext* cx, const char* image)
+{
+    JSXDRState* xdr;
+    struct stat st;
+    char* data;
+    ssize_t nread;
+    size_t offset = 0;
+    int fd;
+
+    fd = open(image, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &st) < 0 || st.st_size == 0 || st.st_size > UINT32_MAX ||
+        !(data = (char*) JS_malloc(cx, st.st_size)))
+    {
+        (void) close(fd);
+        return NULL;
+    }
+    while (offset < (size_t) st.st_size) {
+        nread = read(fd, data + offset, st.st_size - offset);
+        if (nread <= 0) {
+            if (nread < 0 && errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        offset += nread;
+    }
+    (void) close(fd);
+    if (offset < (size_t) st.st_size) {
+        JS_free(cx, data);
+        return NULL;
+    }
+
+    /* The memory state owns the data from here on. */
+    xdr = JS_XDRNewMem(cx, JSXDR_DECODE);
+    if (!xdr) {
+        JS_free(cx, data);
+        return NULL;
+    }
+    JS_XDRMemSetData(xdr, data, (uint32) st.st_size);
+    return xdr;
+}
+
+/*
+ * Write the data of an encoding memory state to a compiled image. The image
+ * is written to a temporary file first, so that an image is never read
+ * partially written. Any error is ignored, as the image is only an
+ * optimisation.
+ */
+static void
+ScriptCache_Write(JSXDRState* xdr, const char* image)
+{
+    char temp[PATH_MAX];
+    char* data;
+    uint32 length;
+    ssize_t nwritten;
+    size_t offset = 0;
+    int fd;
+    int n;
+
+    n = snprintf(temp, sizeof(temp), "%s.%ld", image, (long) getpid());
+    if (n < 0 || (size_t) n >= sizeof(temp)) {
+        return;
+    }
+    data = (char*) JS_XDRMemGetData(xdr, &length);
+    fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return;
+    }
+    while (offset < length) {
+        nwritten = write(fd, data + offset, length - offset);
+        if (nwritten < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        offset += nwritten;
+    }
+    if (close(fd) < 0 || offset < length || rename(temp, image) < 0) {
+        (void) unlink(temp);
+    }
+}
+
+/*
+ * Load the compiled script image of a script file. Returns NULL if there is
+ * no image, or if it is out of date. Any error decoding the image is not
+ * reported, as the script is then compiled instead.
+ */
+static JSScript*
+ScriptCache_Load(JSContext* cx, const char* path, uint32 mtime,
+                 uint32 mtimensec, uint32 size)
+{
+    JSErrorReporter reporter;
+    JSXDRState* xdr;
+    JSScript* script = NULL;
+    char image[PATH_MAX];
+
+    if (!ScriptCache_ImagePath(path, image, sizeof(image))) {
+        return NULL;
+    }
+    xdr = ScriptCache_Read(cx, image);
+    if (!xdr) {
+        return NULL;
+    }
+    reporter = JS_SetErrorReporter(cx, NULL);
+    if (!ScriptCache_XDRHeader(xdr, path, mtime, mtimensec, size) ||
+        !JS_XDRScript(xdr, &script))
+    {
+        script = NULL;
+        JS_ClearPendingException(cx);
+    }
+    (void) JS_SetErrorReporter(cx, reporter);
+    JS_XDRDestroy(xdr);
+    return script;
+}
+
+/*
+ * Store the compiled script image of a script file.
+ */
+static void
+ScriptCache_Store(JSContext* cx, const char* path, uint32 mtime,
+                  uint32 mtimensec, uint32 size, JSScript* script)
+{
+    JSErrorReporter reporter;
+    JSXDRState* xdr;
+    char image[PATH_MAX];
+
+    if (!ScriptCache_ImagePath(path, image, sizeof(image))) {
+        return;
+    }
+    xdr = JS_XDRNewMem(cx, JSXDR_ENCODE);
+    if (!xdr) {
+        return;
+    }
+    reporter = JS_SetErrorReporter(cx, NULL);
+    if (ScriptCache_XDRHeader(xdr, path, mtime, mtimensec, size) &&
+        JS_XDRScript(xdr, &script))
+    {
+        ScriptCache_Write(xdr, image);
+    }
+    else {
+        JS_ClearPendingException(cx);
+    }
+    (void) JS_SetErrorReporter(cx, reporter);
+    JS_XDRDestroy(xdr);
+}
+
+/*
+ * Add a compiled script to the cache, owned by its rooted script object. The
+ * script is destroyed if it cannot be added.
+ */
+static JSBool
+ScriptCache_Add(JSContext* cx, const char* path, uint32 mtime,
+                uint32 mtimensec, uint32 size, JSScript* script)
+{
+    PSCachedScript* entry;
+
+    entry = (PSCachedScript*) JS_malloc(cx, sizeof(PSCachedScript));
+    if (!entry) {
+        JS_DestroyScript(cx, script);
+        return JS_FALSE;
+    }
+    entry->path = JS_strdup(cx, path);
+    entry->rt = cx->runtime;
+    entry->mtime = mtime;
+    entry->mtimensec = mtimensec;
+    entry->size = size;
+    entry->script = script;
+    entry->scriptObj = entry->path ? JS_NewScriptObject(cx, script) : NULL;
+    if (!entry->scriptObj ||
+        !JS_AddNamedRoot(cx, &entry->scriptObj, "PSCachedScript.scriptObj"))
+    {
+        if (!entry->scriptObj) {
+            JS_DestroyScript(cx, script);
+        }
+        if (entry->path) {
+            JS_free(cx, entry->path);
+        }
+        JS_free(cx, entry);
+        return JS_FALSE;
+    }
+    entry->next = ps_ScriptCache;
+    ps_ScriptCache = entry;
+    return JS_TRUE;
+}
+
+/*
+ * Widen the bytes of a script file to characters. Each byte is a character,
+ * as when the file is read by the token stream. The loop is kept simple so
+ * that it is vectorised by the compiler.
+ */
+static void
+ScriptCache_Inflate(const unsigned char* src, size_t length, jschar* dst)
+{
+    for (size_t i = 0; i < length; ++i) {
+        dst[i] = src[i];
+    }
+}
+
+/*
+ * Compile a memory mapped script file. The characters are widened in a single
+ * pass and scanned straight from the resulting buffer, rather than read and
+ * widened line by line through the file. Returns JS_FALSE, without an error
+ * reported, if the file cannot be mapped.
+ */
+static JSBool
+ScriptCache_CompileMapped(JSContext* cx, JSObject* obj, const char* path,
+                          FILE* file, JSScript** scriptp)
+{
+    const unsigned char* data;
+    const unsigned char* start;
+    jschar* chars;
+    struct stat st;
+    size_t length;
+    void* map;
+
+    if (fstat(fileno(file), &st) < 0 || !S_ISREG(st.st_mode) ||
+        st.st_size == 0 || (uint64_t) st.st_size > SIZE_MAX / sizeof(jschar))
+    {
+        return JS_FALSE;
+    }
+    length = (size_t) st.st_size;
+    map = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+    if (map == MAP_FAILED) {
+        return JS_FALSE;
+    }
+    (void) madvise(map, length, MADV_SEQUENTIAL);
+
+    /* Skip a first line starting with '#', but not the line terminator, so
+     * that the line numbers are kept. */
+    data = start = (const unsigned char*) map;
+    if (*data == '#') {
+        while (data < start + length && *data != '\n' && *data != '\r') {
+            ++data;
+        }
+    }
+    length -= data - start;
+    chars = (jschar*) JS_malloc(cx, (length + 1) * sizeof(jschar));
+    if (chars) {
+        ScriptCache_Inflate(data, length, chars);
+    }
+    (void) munmap(map, (size_t) st.st_size);
+    (void) fclose(file);
+    *scriptp = chars ? JS_CompileUCScript(cx, obj, chars, length, path, 1)
+                     : NULL;
+    JS_free(cx, chars);
+    return JS_TRUE;
+}
+
+JSScript*
+ps_CompileFile(JSContext *cx, JSObject *obj, const char *path, FILE *file)
+{
+    JSScript* script;
+    int ch;
+
+    if (ScriptCache_CompileMapped(cx, obj, path, file, &script)) {
+        return script;
+    }
+
+    /* Read a file that cannot be mapped, such as a pipe, through the token
+     * stream. The first line is skipped if it starts with '#', to support the
+     * UNIX #! shell hack. */
+    ch = fgetc(file);
+    if (ch == '#') {
+        while ((ch = fgetc(file)) != EOF) {
+            if (ch == '\n' || ch == '\r') {
+                break;
+            }
+        }
+    }
+    ungetc(ch, file);
+
+    /* The file is closed once it has been compiled. */
+    script = JS_CompileFileHandle(cx, obj, path, file);
+    return script;
+}
+
+JSScript*
+ps_CompileFileCached(JSContext *cx, JSObject *obj, const char *path)
+{
+    PSCachedScript* entry;
+    JSScript* script;
+    struct stat st;
+    FILE* file;
+    uint32 mtime, mtimensec, size;
+
+    /*
+     * Look up the script by its path. The cached script is used if the file
+     * has not been modified since it was compiled.
+     */
+    if (stat(path, &st) < 0) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_FAILED, strerror(errno));
+        return NULL;
+    }
+    ScriptCache_Stat(&st, &mtime, &mtimensec, &size);
+    for (entry = ps_ScriptCache; entry; entry = entry->next) {
+        if (entry->rt == cx->runtime && strcmp(entry->path, path) == 0) {
+            break;
+        }
+    }
+    if (entry && entry->mtime == mtime && entry->mtimensec == mtimensec &&
+        entry->size == size)
+    {
+        return entry->script;
+    }
+
+    /*
+     * Load the compiled script image, or compile the script and store its
+     * image.
+     */
+    script = NULL;
+    if (ps_ScriptCacheDir) {
+        script = ScriptCache_Load(cx, path, mtime, mtimensec, size);
+    }
+    if (!script) {
+        file = fopen(path, "r");
+        if (!file) {
+            JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                                 PSMSG_FAILED, strerror(errno));
+            return NULL;
+        }
+        script = ps_CompileFile(cx, obj, path, file);
+        if (!script) {
+            return NULL;
+        }
+        if (ps_ScriptCacheDir) {
+            ScriptCache_Store(cx, path, mtime, mtimensec, size, script);
+        }
+    }
+    if (!ScriptCache_Add(cx, path, mtime, mtimensec, size, script)) {
+        return NULL;
+    }
+    ps_SnapshotModified = JS_TRUE;
+    return script;
+}
+
+void
+ps_SetSnapshot(const char *path)
+{
+    ps_SnapshotPath = path;
+}
+
+/*
+ * Encode or decode a snapshot. A snapshot holds the compiled scripts that are
+ * cached and the registered modules. A decoded script is only added to the
+ * cache if its file has not been modified, and JS_FALSE returned otherwise.
+ */
+static JSBool
+ScriptCache_XDRSnapshot(JSXDRState* xdr)
+{
+    JSContext* cx = xdr->cx;
+    PSCachedScript* entry;
+    PSCachedScript* newer;
+    JSScript* script;
+    struct stat st;
+    char* path;
+    uint32 count = 0;
+    uint32 mtime, mtimensec, size;
+
+    if (!ScriptCache_XDREngine(xdr)) {
+        return JS_FALSE;
+    }
+
+    /* Encode the latest version of each script of the runtime. */
+    if (xdr->mode == JSXDR_ENCODE) {
+        for (int pass = 0; pass < 2; ++pass) {
+            for (entry = ps_ScriptCache; entry; entry = entry->next) {
+                if (entry->rt != cx->runtime) {
+                    continue;
+                }
+                for (newer = ps_ScriptCache; newer != entry;
+                     newer = newer->next)
+                {
+                    if (newer->rt == cx->runtime &&
+                        strcmp(newer->path, entry->path) == 0)
+                    {
+                        break;
+                    }
+                }
+                if (newer != entry) {
+                    continue;
+                }
+                if (pass == 0) {
+                    ++count;
+                    continue;
+                }
+                path = entry->path;
+                script = entry->script;
+                if (!JS_XDRCString(xdr, &path) ||
+                    !ScriptCache_XDRStat(xdr, entry->mtime, entry->mtimensec,
+                                         entry->size) ||
+                    !JS_XDRScript(xdr, &script))
+                {
+                    return JS_FALSE;
+                }
+            }
+            if (pass == 0 && !JS_XDRUint32(xdr, &count)) {
+                return JS_FALSE;
+            }
+        }
+        return ps_XDRModules(xdr);
+    }
+
+    /* Decode the scripts, as long as their files have not been modified. */
+    if (!JS_XDRUint32(xdr, &count)) {
+        return JS_FALSE;
+    }
+    for (uint32 i = 0; i < count; ++i) {
+        path = NULL;
+        script = NULL;
+        if (!JS_XDRCString(xdr, &path)) {
+            return JS_FALSE;
+        }
+        if (stat(path, &st) < 0) {
+            JS_free(cx, path);
+            return JS_FALSE;
+        }
+        ScriptCache_Stat(&st, &mtime, &mtimensec, &size);
+        if (!ScriptCache_XDRStat(xdr, mtime, mtimensec, size) ||
+            !JS_XDRScript(xdr, &script) ||
+            !ScriptCache_Add(cx, path, mtime, mtimensec, size, script))
+        {
+            JS_free(cx, path);
+            return JS_FALSE;
+        }
+        JS_free(cx, path);
+    }
+
+    /* Register the modules once all of their scripts are known to be up to
+     * date. */
+    return ps_XDRModules(xdr);
+}
+
+void
+ps_RestoreSnapshot(JSContext *cx)
+{
+    JSErrorReporter reporter;
+    JSXDRState* xdr;
+
+    if (!ps_SnapshotPath || ps_SnapshotRestored) {
+        return;
+    }
+    ps_SnapshotRestored = JS_TRUE;
+    xdr = ScriptCache_Read(cx, ps_SnapshotPath);
+    if (!xdr) {
+        ps_SnapshotModified = JS_TRUE;
+        return;
+    }
+    reporter = JS_SetErrorReporter(cx, NULL);
+    if (!ScriptCache_XDRSnapshot(xdr)) {
+        JS_ClearPendingException(cx);
+        ps_SnapshotModified = JS_TRUE;
+    }
+    (void) JS_SetErrorReporter(cx, reporter);
+    JS_XDRDestroy(xdr);
+}
+
+void
+ps_SaveSnapshot(JSContext *cx)
+{
+    JSErrorReporter reporter;
+    JSXDRState* xdr;
+
+    if (!ps_SnapshotPath || !ps_SnapshotModified) {
+        return;
+    }
+    xdr = JS_XDRNewMem(cx, JSXDR_ENCODE);
+    if (!xdr) {
+        return;
+    }
+    reporter = JS_SetErrorReporter(cx, NULL);
+    if (ScriptCache_XDRSnapshot(xdr)) {
+        ScriptCache_Write(xdr, ps_SnapshotPath);
+    }
+    else {
+        JS_ClearPendingException(cx);
+    }
+    (void) JS_SetErrorReporter(cx, reporter);
+    JS_XDRDestroy(xdr);
+    ps_SnapshotModified = JS_FALSE;
+}
+
+void
+ps_DestroyScriptCache(JSContext *cx)
+{
+    PSCachedScript** link = &ps_ScriptCache;
+    PSCachedScript* entry;
+
+    while ((entry = *link) != NULL) {
+        if (entry->rt != cx->runtime) {
+            link = &entry->next;
+            continue;
+        }
+        *link = entry->next;
+        JS_RemoveRoot(cx, &entry->scriptObj);
+        JS_free(cx, entry->path);
+        JS_free(cx, entry);
+    }
+}
@@ -0,0 +1,98 @@
+/*
+ * ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is the ProntoScript re-implementation October 4, 2025.
+ *
+ * The Initial Developer of the Original Code is Stefan Sinnige.
+ * Portions created by the Initial Developer are Copyright (C) 2025
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either of the GNU General Public License Version 2 or later (the "GPL"),
+ * or the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK *****
+ */
+
+#ifndef psscriptcache_h___
+#define psscriptcache_h___
+
+#include "jsprvtd.h"
+#include "jspubtd.h"
+#include <stdio.h>
+
+/*
+ * ProntoScipt compiled script cache.
+ *
+ * The library scripts that are included are compiled once and kept in memory,
+ * so that including them again only executes them. A cached script is
+ * compiled again once its file has been modified. When a cache directory is
+ * set, the compiled scripts are also stored there as XDR images, so that
+ * later executions of the engine skip compiling them as well.
+ *
+ * A snapshot holds all of the compiled scripts and the module names they were
+ * included by in a single file. It is restored when the first script is
+ * included, so that none of the included scripts are located or compiled.
+ */
+
+JS_BEGIN_EXTERN_C
+
+/* Set the directory to store the compiled scripts in, or NULL to only keep
+ * them in memory. */
+extern void
+ps_SetScriptCacheDirectory(const char *dir);
+
+/* Compile an opened script file, skipping a first line that starts with '#'.
+ * A regular file is memory mapped and compiled from memory. The file is
+ * closed. Returns NULL, with the error reported, on failure. */
+extern JSScript *
+ps_CompileFile(JSContext *cx, JSObject *obj, const char *path, FILE *file);
+
+/* Compile the script file at a canonical path, or take it from the cache.
+ * The script is owned by the cache. Returns NULL, with the error reported, on
+ * failure. */
+extern JSScript *
+ps_CompileFileCached(JSContext *cx, JSObject *obj, const char *path);
+
+/* Set the file to store a snapshot of the compiled scripts and the registered
+ * modules in, or NULL to not use a snapshot. */
+extern void
+ps_SetSnapshot(const char *path);
+
+/* Restore the snapshot, unless it has been restored already. A snapshot that
+ * is out of date is ignored, and written again by ps_SaveSnapshot. */
+extern void
+ps_RestoreSnapshot(JSContext *cx);
+
+/* Write the snapshot if scripts have been compiled since it was restored. */
+extern void
+ps_SaveSnapshot(JSContext *cx);
+
+/* Release the compiled scripts of the context's runtime. */
+extern void
+ps_DestroyScriptCache(JSContext *cx);
+
+JS_END_EXTERN_C
+
+#endif /* psscriptcache_h___ */
@@ -41,13 +41,56 @@
 #include <limits.h>
 #include <stdio.h>
 #include <string.h>
-#include <sys/select.h>
 #include <time.h>
 
+/*
+ * Select the backend that waits for the file-descriptors to be triggered. The
+ * 'epoll' backend keeps the registrations persistent in the kernel and is
+ * used whenever it is available, unless it is disabled at configuration time
+ * ('--disable-epoll'). The 'select' backend is the portable fallback.
+ *
+ * The 'io_uring' backend is preferred over both when it is available at
+ * configuration time ('--disable-io-uring' otherwise) and the running kernel
+ * supports it. It submits the registrations in the same system call as the
+ * wait.
+ */
+#if defined(HAVE_SYS_EPOLL_H)
+#define PS_SELECT_EPOLL 1
+#include <sys/epoll.h>
+#include <unistd.h>
+#else
+#define PS_SELECT_EPOLL 0
+#include <sys/select.h>
+#endif
+
+#if defined(HAVE_LINUX_IO_URING_H)
+#define PS_SELECT_URING 1
+#include <linux/io_uring.h>
+#include <endian.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#define PS_SELECT_URING 0
+#endif
+
 #define NS_PER_SEC 1000000000
-#define NO_TIMEOUT
+#define NS_PER_MSEC 1000000
+
 /*
- * The event structure.
+ * The event structure. The deadline is an absolute CLOCK_MONOTONIC time at
+ * which the event times out. Events with a deadline are kept in the deadline
+ * heap at the 'heapindex' position, which is -1 for events without deadline.
+ * Events with equal deadlines time out in the order they were set, as
+ * recorded by their sequence number.
+ *
+ * A timer is an event without file-descriptor (set to -1). It is removed once
+ * its deadline has expired.
+ *
+ * Released events are kept in a pool to be re-used. The generation is
+ * incremented whenever an event is released, so an event that is waiting to
+ * be handled can be recognised as removed, even if it has been re-used since.
  */
 typedef struct _PSSelectEvent
 {
@@ -56,11 +99,23 @@ typedef struct _PSSelectEvent
     JSObject* obj;
     PSSelectCallback func;
     PSSelectCallback errfunc;
-    struct timespec timeout;
+    struct timespec deadline;
+    uint32 sequence;
+    int heapindex;
+    JSBool expired;
+    uint32 generation;
+    uint32 pollsequence;
+    JSBool polling;
     struct _PSSelectEvent* prev;
     struct _PSSelectEvent* next;
 } PSSelectEvent;
 
+/*
+ * The maximum number of triggered events that are retrieved from the kernel
+ * in a single wait. Any remaining events are retrieved on the next wait.
+ */
+#define PS_MAX_TRIGGERED 256
+
 /*
  * The list of events to be monitored and its access lock.
  */
@@ -71,18 +126,57 @@ static JSLock *ps_EventsLock = NULL;
 static void* ps_EventsLock = NULL;
 #endif
 
+/*
+ * The binary min-heap of events ordered by their deadline. The earliest
+ * deadline is always at the top of the heap.
+ */
+static PSSelectEvent** ps_Heap = NULL;
+static int ps_HeapLength = 0;
+static int ps_HeapCapacity = 0;
+static uint32 ps_HeapSequence = 0;
+
+/*
+ * The events with a file-descriptor, indexed by their file-descriptor. The
+ * table grows to hold the highest file-descriptor that has been added.
+ */
+static PSSelectEvent** ps_FdTable = NULL;
+static int ps_FdTableCapacity = 0;
+
+/*
+ * The events that are ready to be handled. The array is re-used for every
+ * wait and only grows with the number of events that are monitored.
+ */
+typedef struct _PSReadyEvent
+{
+    PSSelectEvent* ev;
+    uint32 generation;
+    JSBool errored;
+} PSReadyEvent;
+
+static PSReadyEvent* ps_Ready = NULL;
+static int ps_ReadyLength = 0;
+static int ps_ReadyCapacity = 0;
+
+/*
+ * The pool of released events, the number of events in the list and whether
+ * the events are being handled.
+ */
+static PSSelectEvent* ps_FreeEvents = NULL;
+static int ps_EventCount = 0;
+static JSBool ps_Dispatching = JS_FALSE;
+
 /*
  * Dealing with no-timeout specification. A no timeout is defined by having
  * both sec and nsec set to '-1'.
  */
 
-int
+static int
 no_timeout(struct timespec timeout)
 {
     return (timeout.tv_sec == -1) && (timeout.tv_nsec == -1);
 }
 
-struct timespec
+static struct timespec
 set_no_timeout()
 {
     struct timespec ts = {-1, -1};
@@ -90,9 +184,10 @@ set_no_timeout()
 }
 
 /*
- * Calculate the difference between two timespec's.
+ * Calculate the difference between two timespec's, limited to zero if the
+ * end lies before the start.
  */
-struct timespec
+static struct timespec
 diff_timespec(struct timespec start, struct timespec end)
 {
     struct timespec diff;
@@ -102,134 +197,506 @@ diff_timespec(struct timespec start, struct timespec end)
         diff.tv_nsec += NS_PER_SEC;
         --diff.tv_sec;
     }
+    if (diff.tv_sec < 0) {
+        diff.tv_sec = 0;
+        diff.tv_nsec = 0;
+    }
     return diff;
 }
 
 /*
- * Subtract a duration from a timeout.
+ * Compare two timespec's, returning a negative, zero or positive value.
  */
-void
-update_timeout(struct timespec duration, struct timespec* timeout)
+static int
+compare_timespec(struct timespec first, struct timespec second)
 {
-    /* If the timeout is not defined, leave it untouched. */
-    if (no_timeout(*timeout)) {
-        return;
+    if (first.tv_sec != second.tv_sec) {
+        return first.tv_sec < second.tv_sec ? -1 : 1;
+    }
+    if (first.tv_nsec != second.tv_nsec) {
+        return first.tv_nsec < second.tv_nsec ? -1 : 1;
+    }
+    return 0;
+}
+
+/*
+ * Calculate the absolute deadline of a timeout in milliseconds from now,
+ * assume that '-1' means no timeout.
+ */
+static struct timespec
+deadline_timespec(int timeout)
+{
+    struct timespec deadline;
+    if (timeout < 0) {
+        return set_no_timeout();
+    }
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout / 1000;
+    deadline.tv_nsec += (timeout % 1000) * NS_PER_MSEC;
+    if (deadline.tv_nsec >= NS_PER_SEC) {
+        deadline.tv_nsec -= NS_PER_SEC;
+        ++deadline.tv_sec;
+    }
+    return deadline;
+}
+
+/*
+ * Deadline heap operations.
+ */
+
+static JSBool
+heap_less(PSSelectEvent* first, PSSelectEvent* second)
+{
+    int cmp = compare_timespec(first->deadline, second->deadline);
+    if (cmp != 0) {
+        return cmp < 0;
+    }
+    return (int32)(first->sequence - second->sequence) < 0;
+}
+
+static void
+heap_set(int index, PSSelectEvent* ev)
+{
+    ps_Heap[index] = ev;
+    ev->heapindex = index;
+}
+
+static void
+heap_sift_up(int index)
+{
+    PSSelectEvent* ev = ps_Heap[index];
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+        if (!heap_less(ev, ps_Heap[parent])) {
+            break;
+        }
+        heap_set(index, ps_Heap[parent]);
+        index = parent;
+    }
+    heap_set(index, ev);
+}
+
+static void
+heap_sift_down(int index)
+{
+    PSSelectEvent* ev = ps_Heap[index];
+    while (1) {
+        int child = 2 * index + 1;
+        if (child >= ps_HeapLength) {
+            break;
+        }
+        if (child + 1 < ps_HeapLength &&
+            heap_less(ps_Heap[child + 1], ps_Heap[child]))
+        {
+            ++child;
+        }
+        if (!heap_less(ps_Heap[child], ev)) {
+            break;
+        }
+        heap_set(index, ps_Heap[child]);
+        index = child;
     }
+    heap_set(index, ev);
+}
 
-    /* Subtract */
-    timeout->tv_sec -= duration.tv_sec;
-    timeout->tv_nsec -= duration.tv_nsec;
-    if (timeout->tv_nsec < 0) {
-        timeout->tv_nsec += NS_PER_SEC;
-        --timeout->tv_sec;
+static JSBool
+heap_insert(JSContext *cx, PSSelectEvent* ev)
+{
+    if (ps_HeapLength == ps_HeapCapacity) {
+        int capacity = ps_HeapCapacity == 0 ? 16 : 2 * ps_HeapCapacity;
+        PSSelectEvent** heap = (PSSelectEvent**) JS_realloc(cx, ps_Heap,
+                capacity * sizeof(PSSelectEvent*));
+        if (!heap) {
+            return JS_FALSE;
+        }
+        ps_Heap = heap;
+        ps_HeapCapacity = capacity;
     }
+    heap_set(ps_HeapLength++, ev);
+    heap_sift_up(ev->heapindex);
+    return JS_TRUE;
+}
 
-    /* If negative, the timeout will be set to 0. */
-    if (timeout->tv_sec < 0) {
-        timeout->tv_sec = 0;
-        timeout->tv_nsec = 0;
+static void
+heap_remove(PSSelectEvent* ev)
+{
+    int index = ev->heapindex;
+    if (index < 0) {
+        return;
+    }
+    ev->heapindex = -1;
+    if (index != --ps_HeapLength) {
+        heap_set(index, ps_Heap[ps_HeapLength]);
+        heap_sift_up(index);
+        heap_sift_down(ps_Heap[index]->heapindex);
     }
 }
 
 /*
- * Return the minimum of two timeouts.
+ * Set the deadline of an event and (re-)position it in the deadline heap.
  */
-struct timespec
-minimum_timeout(struct timespec first, struct timespec second)
+static JSBool
+set_deadline(JSContext *cx, PSSelectEvent* ev, struct timespec deadline)
 {
-    /* If one is no-timeout, return the other one. */
-    if (no_timeout(first)) {
-        return second;
+    ev->deadline = deadline;
+    ev->sequence = ps_HeapSequence++;
+    if (no_timeout(deadline)) {
+        heap_remove(ev);
+        return JS_TRUE;
     }
-    if (no_timeout(second)) {
-        return first;
+    if (ev->heapindex < 0) {
+        return heap_insert(cx, ev);
     }
+    heap_sift_up(ev->heapindex);
+    heap_sift_down(ev->heapindex);
+    return JS_TRUE;
+}
 
-    /* Otherwise, compare their values */
-    if ((first.tv_sec < second.tv_sec) ||
-        (first.tv_sec == second.tv_sec) && (first.tv_nsec < second.tv_nsec))
-    {
-        return first;
+/*
+ * Add an event to, or remove an event from, the list of events.
+ */
+static void
+link_event(PSSelectEvent* ev)
+{
+    ev->prev = NULL;
+    ev->next = ps_Events;
+    if (ps_Events != NULL) {
+        ps_Events->prev = ev;
     }
-    else
-    {
-        return second;
+    ps_Events = ev;
+    ++ps_EventCount;
+}
+
+static void
+unlink_event(PSSelectEvent* ev)
+{
+    if (ev->prev != NULL) {
+        ev->prev->next = ev->next;
     }
+    if (ev->next != NULL) {
+        ev->next->prev = ev->prev;
+    }
+    if (ev == ps_Events) {
+        ps_Events = ev->next;
+    }
+    ev->prev = NULL;
+    ev->next = NULL;
+    --ps_EventCount;
 }
 
 /*
- * Initialise the select mechanism.
+ * Look up the event of a file-descriptor, or NULL if it has not been added.
  */
-JSBool
-ps_InitSelect(JSContext *cx)
+static PSSelectEvent*
+fd_lookup(int fd)
 {
-#ifdef JS_THREADSAFE
-    if (!ps_EventsLock) {
-        ps_EventsLock = JS_NEW_LOCK();
-        if (!ps_EventsLock) {
+    return (fd >= 0 && fd < ps_FdTableCapacity) ? ps_FdTable[fd] : NULL;
+}
+
+/*
+ * Set the event of a file-descriptor, growing the table if needed.
+ */
+static JSBool
+fd_set_event(JSContext *cx, int fd, PSSelectEvent* ev)
+{
+    if (fd >= ps_FdTableCapacity) {
+        int capacity = ps_FdTableCapacity == 0 ? 64 : ps_FdTableCapacity;
+        while (capacity <= fd) {
+            capacity *= 2;
+        }
+        PSSelectEvent** table = (PSSelectEvent**) JS_realloc(cx, ps_FdTable,
+                capacity * sizeof(PSSelectEvent*));
+        if (!table) {
             return JS_FALSE;
         }
+        memset(table + ps_FdTableCapacity, 0,
+               (capacity - ps_FdTableCapacity) * sizeof(PSSelectEvent*));
+        ps_FdTable = table;
+        ps_FdTableCapacity = capacity;
     }
-#endif
+    ps_FdTable[fd] = ev;
     return JS_TRUE;
 }
 
 /*
- * Destroy the select mechanism.
+ * Take an event from the pool, or allocate a new one if the pool is empty.
  */
-void
-ps_DestroySelect(JSContext *cx)
+static PSSelectEvent*
+new_event(JSContext *cx)
 {
-#ifdef JS_THREADSAFE
-    if (ps_EventsLock) {
-        JS_DESTROY_LOCK(ps_EventsLock);
-        ps_EventsLock = NULL;
+    PSSelectEvent* ev = ps_FreeEvents;
+    if (ev != NULL) {
+        ps_FreeEvents = ev->next;
     }
-#endif
+    else {
+        ev = (PSSelectEvent*) JS_malloc(cx, sizeof(PSSelectEvent));
+        if (!ev) {
+            return NULL;
+        }
+        ev->generation = 0;
+        ev->pollsequence = 0;
+    }
+    ev->polling = JS_FALSE;
+    ev->deadline = set_no_timeout();
+    ev->heapindex = -1;
+    ev->expired = JS_FALSE;
+    ev->prev = NULL;
+    ev->next = NULL;
+    return ev;
 }
 
-JSBool
-ps_HandleSelect(JSContext *cx)
+/*
+ * Return an event, which is no longer in the list or the heap, to the pool.
+ */
+static void
+release_event(PSSelectEvent* ev)
 {
-    fd_set rdfs, wrfs, erfs;
-    int max = 0, result;
-    struct timeval tv, *ptv;
-    struct timespec timeout, start, end, duration;
+    ++ev->generation;
+    ev->expired = JS_FALSE;
+    ev->prev = NULL;
+    ev->next = ps_FreeEvents;
+    ps_FreeEvents = ev;
+}
 
-    /* If there are no events to monitor, then there is nothing to do. */
-    if (ps_Events == NULL) {
-        return JS_FALSE;
+/*
+ * Make sure the array of ready events can hold a number of events, and
+ * empty it.
+ */
+static JSBool
+ready_reserve(JSContext *cx, int count)
+{
+    ps_ReadyLength = 0;
+    if (count > ps_ReadyCapacity) {
+        int capacity = ps_ReadyCapacity == 0 ? 16 : ps_ReadyCapacity;
+        while (capacity < count) {
+            capacity *= 2;
+        }
+        PSReadyEvent* ready = (PSReadyEvent*) JS_realloc(cx, ps_Ready,
+                capacity * sizeof(PSReadyEvent));
+        if (!ready) {
+            return JS_FALSE;
+        }
+        ps_Ready = ready;
+        ps_ReadyCapacity = capacity;
+    }
+    return JS_TRUE;
+}
+
+/*
+ * Append an event to the array of ready events.
+ */
+static void
+ready_add(PSSelectEvent* ev, JSBool errored)
+{
+    PSReadyEvent* ready = &ps_Ready[ps_ReadyLength++];
+    ready->ev = ev;
+    ready->generation = ev->generation;
+    ready->errored = errored;
+}
+
+/*
+ * The backend operations. Events are added, modified and removed when their
+ * file-descriptor is registered, its file-descriptor set changes or it is
+ * unregistered. The wait collects the triggered events in the array of ready
+ * events and returns their number, or -1 on failure.
+ */
+typedef struct _PSSelectBackend
+{
+    JSBool (*init)();
+    void (*destroy)();
+    JSBool (*add)(PSSelectEvent* ev);
+    JSBool (*modify)(PSSelectEvent* ev);
+    void (*remove)(PSSelectEvent* ev);
+    int (*wait)(struct timespec timeout);
+} PSSelectBackend;
+
+static const PSSelectBackend* ps_Backend = NULL;
+
+#if PS_SELECT_EPOLL
+
+/*
+ * The 'epoll' backend. The file-descriptors are registered with the kernel
+ * when they are added and are only updated when their file-descriptor set
+ * changes or when they are removed.
+ */
+
+static int ps_EpollFd = -1;
+static struct epoll_event ps_EpollEvents[PS_MAX_TRIGGERED];
+
+static uint32_t
+epoll_backend_mask(PSFDSet fdsetmask)
+{
+    uint32_t mask = 0;
+    if (fdsetmask & PSFDSET_READ) {
+        mask |= EPOLLIN;
+    }
+    if (fdsetmask & PSFDSET_WRITE) {
+        mask |= EPOLLOUT;
     }
+    return mask;
+}
+
+static JSBool
+epoll_backend_init()
+{
+    if (ps_EpollFd == -1) {
+        ps_EpollFd = epoll_create1(EPOLL_CLOEXEC);
+        if (ps_EpollFd == -1) {
+            return JS_FALSE;
+        }
+    }
+    return JS_TRUE;
+}
+
+static void
+epoll_backend_destroy()
+{
+    if (ps_EpollFd != -1) {
+        close(ps_EpollFd);
+        ps_EpollFd = -1;
+    }
+}
+
+static JSBool
+epoll_backend_add(PSSelectEvent* ev)
+{
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = epoll_backend_mask(ev->fdsetmask);
+    event.data.ptr = ev;
+    if (epoll_ctl(ps_EpollFd, EPOLL_CTL_ADD, ev->fd, &event) == 0) {
+        return JS_TRUE;
+    }
+
+    /* The file-descriptor may still be registered if it was closed without
+     * being removed and then re-used. */
+    return errno == EEXIST &&
+           epoll_ctl(ps_EpollFd, EPOLL_CTL_MOD, ev->fd, &event) == 0;
+}
+
+static JSBool
+epoll_backend_modify(PSSelectEvent* ev)
+{
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = epoll_backend_mask(ev->fdsetmask);
+    event.data.ptr = ev;
+    if (epoll_ctl(ps_EpollFd, EPOLL_CTL_MOD, ev->fd, &event) == 0) {
+        return JS_TRUE;
+    }
+
+    /* The kernel drops the registration when the file-descriptor is closed,
+     * so it may have to be registered again. */
+    return errno == ENOENT &&
+           epoll_ctl(ps_EpollFd, EPOLL_CTL_ADD, ev->fd, &event) == 0;
+}
+
+static void
+epoll_backend_remove(PSSelectEvent* ev)
+{
+    /* Ignore failures, the file-descriptor may already have been closed. */
+    (void) epoll_ctl(ps_EpollFd, EPOLL_CTL_DEL, ev->fd, NULL);
+}
+
+static int
+epoll_backend_wait(struct timespec timeout)
+{
+    int msec, result;
+
+    /* Round the timeout up to whole milliseconds, so it is not busy-waiting
+     * on sub-millisecond timeouts. */
+    if (no_timeout(timeout)) {
+        msec = -1;
+    }
+    else
+    if (timeout.tv_sec >= INT_MAX / 1000 - 1) {
+        msec = INT_MAX;
+    }
+    else {
+        msec = timeout.tv_sec * 1000
+             + (timeout.tv_nsec + NS_PER_MSEC - 1) / NS_PER_MSEC;
+    }
+
+    result = epoll_wait(ps_EpollFd, ps_EpollEvents, PS_MAX_TRIGGERED, msec);
+    for (int i = 0; i < result; ++i) {
+        /* An error or hang-up is handled by the callback, just as a select
+         * would mark the file-descriptor as ready. */
+        ready_add((PSSelectEvent*)ps_EpollEvents[i].data.ptr, JS_FALSE);
+    }
+    return result;
+}
+
+static const PSSelectBackend ps_EpollBackend = {
+    epoll_backend_init,
+    epoll_backend_destroy,
+    epoll_backend_add,
+    epoll_backend_modify,
+    epoll_backend_remove,
+    epoll_backend_wait
+};
+
+#else /* !PS_SELECT_EPOLL */
+
+/*
+ * The 'select' backend. The file-descriptor sets are rebuilt from the list of
+ * events on every wait.
+ */
+
+static JSBool
+select_backend_init()
+{
+    return JS_TRUE;
+}
+
+static void
+select_backend_destroy()
+{
+}
+
+static JSBool
+select_backend_add(PSSelectEvent* ev)
+{
+    return ev->fd < FD_SETSIZE;
+}
+
+static JSBool
+select_backend_modify(PSSelectEvent* ev)
+{
+    return JS_TRUE;
+}
+
+static void
+select_backend_remove(PSSelectEvent* ev)
+{
+}
+
+static int
+select_backend_wait(struct timespec timeout)
+{
+    fd_set rdfs, wrfs;
+    int max = 0, result;
+    struct timeval tv, *ptv;
 
     /* Set up the select */
-    timeout = set_no_timeout();
     FD_ZERO(&rdfs);
     FD_ZERO(&wrfs);
-    FD_ZERO(&erfs);
     JS_ACQUIRE_LOCK(ps_EventsLock);
     for (PSSelectEvent* ev = ps_Events; ev != NULL; ev = ev->next) {
-        /* Add the file-descriptor */
+        /* Add the file-descriptor, unless it is a timer */
+        if (ev->fd < 0) {
+            continue;
+        }
         if (ev->fdsetmask & PSFDSET_READ) {
             FD_SET(ev->fd, &rdfs);
         }
         if (ev->fdsetmask & PSFDSET_WRITE) {
             FD_SET(ev->fd, &wrfs);
         }
-        FD_SET(ev->fd, &erfs);
 
         /* Keep track of the maximum file-descriptior. */
         if (max < ev->fd) {
             max = ev->fd;
         }
-
-        /* Keep track of the minimum timeout */
-        timeout = minimum_timeout(timeout, ev->timeout);
-        if ((ev->timeout.tv_sec < tv.tv_sec) ||
-           ((ev->timeout.tv_sec == tv.tv_sec) && (ev->timeout.tv_nsec < tv.tv_usec * 1000)))
-        {
-            tv.tv_sec = ev->timeout.tv_sec;
-            tv.tv_usec = ev->timeout.tv_nsec * 1000;
-        }
     }
     JS_RELEASE_LOCK(ps_EventsLock);
 
@@ -239,100 +706,582 @@ ps_HandleSelect(JSContext *cx)
     }
     else {
         tv.tv_sec = timeout.tv_sec;
-        tv.tv_usec = timeout.tv_nsec * 1000;
+        tv.tv_usec = timeout.tv_nsec / 1000;
         ptv = &tv;
     }
 
-    /* Perform the selection */
-    clock_gettime(CLOCK_MONOTONIC, &start);
-    result = select(max+1, &rdfs, &wrfs, &erfs, ptv);
-    clock_gettime(CLOCK_MONOTONIC, &end);
-    duration = diff_timespec(start, end);
+    /* Perform the selection and collect the triggered events. */
+    result = select(max+1, &rdfs, &wrfs, NULL, ptv);
+    if (result > 0) {
+        JS_ACQUIRE_LOCK(ps_EventsLock);
+        for (PSSelectEvent* ev = ps_Events; ev != NULL; ev = ev->next) {
+            if (ev->fd >= 0 &&
+                (FD_ISSET(ev->fd, &rdfs) || FD_ISSET(ev->fd, &wrfs)))
+            {
+                ready_add(ev, JS_FALSE);
+            }
+        }
+        JS_RELEASE_LOCK(ps_EventsLock);
+    }
+    return result;
+}
 
-    /* Update all timeouts and copy all triggered, errored and timed-out
-     * events */
-    PSSelectEvent *triggered = NULL;
-    PSSelectEvent *timedout = NULL;
-    PSSelectEvent *errored = NULL;
-    JS_ACQUIRE_LOCK(ps_EventsLock);
-    for (PSSelectEvent* ev = ps_Events; ev != NULL; ev = ev->next) {
-        /* Update the timeout of this event. */
-        update_timeout(duration, &(ev->timeout));
-
-        /* Check if this file descriptor was triggered */
-        if (FD_ISSET(ev->fd, &rdfs) || FD_ISSET(ev->fd, &wrfs)) {
-            PSSelectEvent* copy = (PSSelectEvent*)malloc(sizeof(PSSelectEvent));
-            copy->fd = ev->fd;
-            copy->obj = ev->obj;
-            copy->func = ev->func;
-            copy->errfunc = ev->errfunc;
-            copy->timeout = ev->timeout; 
-            copy->next = triggered;
-            triggered = copy;
+static const PSSelectBackend ps_SelectBackend = {
+    select_backend_init,
+    select_backend_destroy,
+    select_backend_add,
+    select_backend_modify,
+    select_backend_remove,
+    select_backend_wait
+};
+
+#endif /* !PS_SELECT_EPOLL */
+
+#if PS_SELECT_URING
+
+/*
+ * The 'io_uring' backend. Each file-descriptor is polled by a one-shot poll
+ * request. The requests are queued and submitted together with the wait. A
+ * poll that has completed is requested again on the next wait, unless its
+ * event has been removed or modified meanwhile. Completions are matched to
+ * their event by file-descriptor and poll sequence number, so that the
+ * completion of a poll that has been removed is ignored.
+ */
+
+#define PS_URING_ENTRIES 256
+
+typedef struct _PSUring
+{
+    int fd;
+    void* ring;
+    size_t ringsize;
+    struct io_uring_sqe* sqes;
+    size_t sqessize;
+    unsigned* sqhead;
+    unsigned* sqtail;
+    unsigned* sqmask;
+    unsigned* sqentries;
+    unsigned* sqarray;
+    unsigned* cqhead;
+    unsigned* cqtail;
+    unsigned* cqmask;
+    struct io_uring_cqe* cqes;
+} PSUring;
+
+static PSUring ps_Uring = { -1 };
+static uint32 ps_UringSequence = 0;
+
+/*
+ * The polls that have completed, to be requested again on the next wait.
+ */
+typedef struct _PSUringRearm
+{
+    int fd;
+    uint32 sequence;
+} PSUringRearm;
+
+static PSUringRearm ps_UringRearm[PS_MAX_TRIGGERED];
+static int ps_UringRearmLength = 0;
+
+static int
+uring_enter(unsigned tosubmit, unsigned mincomplete, unsigned flags,
+            void* arg, size_t argsize)
+{
+    return (int) syscall(__NR_io_uring_enter, ps_Uring.fd, tosubmit,
+                         mincomplete, flags, arg, argsize);
+}
+
+static uint64_t
+uring_user_data(int fd, uint32 sequence)
+{
+    return ((uint64_t)(uint32_t)fd << 32) | sequence;
+}
+
+static unsigned
+uring_pending()
+{
+    return *ps_Uring.sqtail - __atomic_load_n(ps_Uring.sqhead, __ATOMIC_ACQUIRE);
+}
+
+/*
+ * Submit the queued requests without waiting for their completion.
+ */
+static JSBool
+uring_submit()
+{
+    unsigned pending;
+    while ((pending = uring_pending()) > 0) {
+        int result = uring_enter(pending, 0, 0, NULL, 0);
+        if (result < 0 && errno == EINTR) {
+            continue;
         }
+        if (result <= 0) {
+            return JS_FALSE;
+        }
+    }
+    return JS_TRUE;
+}
 
-        /* Check if this file descriptor was timed out */
-        if (ev->timeout.tv_sec == 0 && ev->timeout.tv_nsec == 0) {
-            PSSelectEvent* copy = (PSSelectEvent*)malloc(sizeof(PSSelectEvent));
-            copy->fd = ev->fd;
-            copy->obj = ev->obj;
-            copy->func = ev->func;
-            copy->errfunc = ev->errfunc;
-            copy->timeout = ev->timeout; 
-            copy->next = timedout;
-            timedout = copy;
+/*
+ * Queue a request, submitting the queued requests first if the submission
+ * queue is full.
+ */
+static struct io_uring_sqe*
+uring_get_sqe()
+{
+    if (uring_pending() >= *ps_Uring.sqentries && !uring_submit()) {
+        return NULL;
+    }
+    unsigned index = *ps_Uring.sqtail & *ps_Uring.sqmask;
+    struct io_uring_sqe* sqe = &ps_Uring.sqes[index];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    return sqe;
+}
+
+static void
+uring_queue_sqe()
+{
+    unsigned tail = *ps_Uring.sqtail;
+    ps_Uring.sqarray[tail & *ps_Uring.sqmask] = tail & *ps_Uring.sqmask;
+    __atomic_store_n(ps_Uring.sqtail, tail + 1, __ATOMIC_RELEASE);
+}
+
+static JSBool
+uring_poll_add(PSSelectEvent* ev)
+{
+    unsigned mask = 0;
+    struct io_uring_sqe* sqe = uring_get_sqe();
+    if (!sqe) {
+        return JS_FALSE;
+    }
+    if (ev->fdsetmask & PSFDSET_READ) {
+        mask |= POLLIN;
+    }
+    if (ev->fdsetmask & PSFDSET_WRITE) {
+        mask |= POLLOUT;
+    }
+#if __BYTE_ORDER == __BIG_ENDIAN
+    /* The kernel reads the mask as two swapped half-words. */
+    mask = (mask << 16) | (mask >> 16);
+#endif
+
+    /* The sequence number zero is reserved for requests whose completion is
+     * ignored. */
+    if (++ps_UringSequence == 0) {
+        ++ps_UringSequence;
+    }
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = ev->fd;
+    sqe->poll32_events = mask;
+    sqe->user_data = uring_user_data(ev->fd, ps_UringSequence);
+    uring_queue_sqe();
+    ev->pollsequence = ps_UringSequence;
+    ev->polling = JS_TRUE;
+    return JS_TRUE;
+}
+
+static JSBool
+uring_poll_remove(PSSelectEvent* ev)
+{
+    struct io_uring_sqe* sqe;
+    if (!ev->polling) {
+        return JS_TRUE;
+    }
+    sqe = uring_get_sqe();
+    if (!sqe) {
+        return JS_FALSE;
+    }
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = uring_user_data(ev->fd, ev->pollsequence);
+    sqe->user_data = uring_user_data(0, 0);
+    uring_queue_sqe();
+    ev->polling = JS_FALSE;
+    return JS_TRUE;
+}
+
+static void
+uring_backend_destroy()
+{
+    if (ps_Uring.ring != NULL) {
+        munmap(ps_Uring.ring, ps_Uring.ringsize);
+        ps_Uring.ring = NULL;
+    }
+    if (ps_Uring.sqes != NULL) {
+        munmap(ps_Uring.sqes, ps_Uring.sqessize);
+        ps_Uring.sqes = NULL;
+    }
+    if (ps_Uring.fd != -1) {
+        close(ps_Uring.fd);
+        ps_Uring.fd = -1;
+    }
+    ps_UringRearmLength = 0;
+}
+
+static JSBool
+uring_backend_init()
+{
+    struct io_uring_params params;
+    size_t sqsize, cqsize;
+    char* ring;
+
+    if (ps_Uring.fd != -1) {
+        return JS_TRUE;
+    }
+
+    /* The kernel may not support io_uring, or not all of the features that
+     * are used, in which case another backend is used. */
+    memset(&params, 0, sizeof(params));
+    ps_Uring.fd = (int) syscall(__NR_io_uring_setup, PS_URING_ENTRIES, &params);
+    if (ps_Uring.fd == -1) {
+        return JS_FALSE;
+    }
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) ||
+        !(params.features & IORING_FEAT_NODROP) ||
+        !(params.features & IORING_FEAT_EXT_ARG))
+    {
+        uring_backend_destroy();
+        return JS_FALSE;
+    }
+
+    /* Map the submission and completion queue rings, which share a single
+     * mapping, and the submission queue entries. */
+    sqsize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqsize = params.cq_off.cqes
+           + params.cq_entries * sizeof(struct io_uring_cqe);
+    ps_Uring.ringsize = sqsize > cqsize ? sqsize : cqsize;
+    ring = mmap(NULL, ps_Uring.ringsize, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, ps_Uring.fd, IORING_OFF_SQ_RING);
+    if (ring == MAP_FAILED) {
+        uring_backend_destroy();
+        return JS_FALSE;
+    }
+    ps_Uring.ring = ring;
+    ps_Uring.sqessize = params.sq_entries * sizeof(struct io_uring_sqe);
+    ps_Uring.sqes = mmap(NULL, ps_Uring.sqessize, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, ps_Uring.fd,
+                         IORING_OFF_SQES);
+    if (ps_Uring.sqes == MAP_FAILED) {
+        ps_Uring.sqes = NULL;
+        uring_backend_destroy();
+        return JS_FALSE;
+    }
+    ps_Uring.sqhead = (unsigned*)(ring + params.sq_off.head);
+    ps_Uring.sqtail = (unsigned*)(ring + params.sq_off.tail);
+    ps_Uring.sqmask = (unsigned*)(ring + params.sq_off.ring_mask);
+    ps_Uring.sqentries = (unsigned*)(ring + params.sq_off.ring_entries);
+    ps_Uring.sqarray = (unsigned*)(ring + params.sq_off.array);
+    ps_Uring.cqhead = (unsigned*)(ring + params.cq_off.head);
+    ps_Uring.cqtail = (unsigned*)(ring + params.cq_off.tail);
+    ps_Uring.cqmask = (unsigned*)(ring + params.cq_off.ring_mask);
+    ps_Uring.cqes = (struct io_uring_cqe*)(ring + params.cq_off.cqes);
+    return JS_TRUE;
+}
+
+static JSBool
+uring_backend_add(PSSelectEvent* ev)
+{
+    return uring_poll_add(ev);
+}
+
+static JSBool
+uring_backend_modify(PSSelectEvent* ev)
+{
+    return uring_poll_remove(ev) && uring_poll_add(ev);
+}
+
+static void
+uring_backend_remove(PSSelectEvent* ev)
+{
+    /* Submit the removal right away, as the kernel keeps a reference to the
+     * file-descriptor while it is being polled. */
+    if (uring_poll_remove(ev)) {
+        (void) uring_submit();
+    }
+}
+
+static int
+uring_backend_wait(struct timespec timeout)
+{
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    unsigned head, tail;
+    int result, count = 0;
+
+    /* Request the completed polls again. */
+    for (int i = 0; i < ps_UringRearmLength; ++i) {
+        PSSelectEvent* ev = fd_lookup(ps_UringRearm[i].fd);
+        if (ev != NULL && !ev->polling &&
+            ev->pollsequence == ps_UringRearm[i].sequence &&
+            !uring_poll_add(ev))
+        {
+            return -1;
         }
+    }
+    ps_UringRearmLength = 0;
 
-        /* Check if this file descriptor was errored */
-        if (FD_ISSET(ev->fd, &erfs)) {
-            PSSelectEvent* copy = (PSSelectEvent*)malloc(sizeof(PSSelectEvent));
-            copy->fd = ev->fd;
-            copy->obj = ev->obj;
-            copy->func = ev->func;
-            copy->errfunc = ev->errfunc;
-            copy->timeout = ev->timeout; 
-            copy->next = errored;
-            errored = copy;
+    /* Submit the queued requests and wait for a completion, unless there are
+     * completions left from the previous wait. */
+    memset(&arg, 0, sizeof(arg));
+    if (!no_timeout(timeout)) {
+        ts.tv_sec = timeout.tv_sec;
+        ts.tv_nsec = timeout.tv_nsec;
+        arg.ts = (uint64_t)(uintptr_t)&ts;
+    }
+    result = uring_enter(uring_pending(), 1,
+                         IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+                         &arg, sizeof(arg));
+    if (result < 0 && errno != ETIME) {
+        return -1;
+    }
+
+    /* Collect the completed polls of the events that are still polled. A
+     * failed poll is handled as an error of its event. */
+    head = *ps_Uring.cqhead;
+    tail = __atomic_load_n(ps_Uring.cqtail, __ATOMIC_ACQUIRE);
+    while (head != tail && ps_UringRearmLength < PS_MAX_TRIGGERED) {
+        struct io_uring_cqe* cqe = &ps_Uring.cqes[head & *ps_Uring.cqmask];
+        int fd = (int)(cqe->user_data >> 32);
+        uint32 sequence = (uint32)cqe->user_data;
+        PSSelectEvent* ev = fd_lookup(fd);
+        ++head;
+        if (sequence == 0 || ev == NULL || !ev->polling ||
+            ev->pollsequence != sequence)
+        {
+            continue;
         }
+        ev->polling = JS_FALSE;
+        if (cqe->res < 0) {
+            ready_add(ev, JS_TRUE);
+        }
+        else {
+            ready_add(ev, JS_FALSE);
+            ps_UringRearm[ps_UringRearmLength].fd = fd;
+            ps_UringRearm[ps_UringRearmLength].sequence = sequence;
+            ++ps_UringRearmLength;
+        }
+        ++count;
+    }
+    __atomic_store_n(ps_Uring.cqhead, head, __ATOMIC_RELEASE);
+    return count;
+}
 
+static const PSSelectBackend ps_UringBackend = {
+    uring_backend_init,
+    uring_backend_destroy,
+    uring_backend_add,
+    uring_backend_modify,
+    uring_backend_remove,
+    uring_backend_wait
+};
+
+#endif /* PS_SELECT_URING */
+
+/*
+ * Initialise the backend, preferring the 'io_uring' backend if the kernel
+ * supports it.
+ */
+static JSBool
+backend_init()
+{
+    if (ps_Backend != NULL) {
+        return JS_TRUE;
     }
-    JS_RELEASE_LOCK(ps_EventsLock);
+#if PS_SELECT_URING
+    if (ps_UringBackend.init()) {
+        ps_Backend = &ps_UringBackend;
+        return JS_TRUE;
+    }
+#endif
+#if PS_SELECT_EPOLL
+    ps_Backend = &ps_EpollBackend;
+#else
+    ps_Backend = &ps_SelectBackend;
+#endif
+    if (!ps_Backend->init()) {
+        ps_Backend = NULL;
+        return JS_FALSE;
+    }
+    return JS_TRUE;
+}
 
-    /* Handle the result */
-    if (result > 0) {
-        for (PSSelectEvent* ev = triggered; ev != NULL; ev = ev->next) {
-            ev->func(cx, ev->obj);
+static void
+backend_destroy()
+{
+    if (ps_Backend != NULL) {
+        ps_Backend->destroy();
+        ps_Backend = NULL;
+    }
+}
+
+/*
+ * Initialise the select mechanism.
+ */
+JSBool
+ps_InitSelect(JSContext *cx)
+{
+#ifdef JS_THREADSAFE
+    if (!ps_EventsLock) {
+        ps_EventsLock = JS_NEW_LOCK();
+        if (!ps_EventsLock) {
+            return JS_FALSE;
         }
     }
-    else
-    if (result == 0) {
-        for (PSSelectEvent* ev = timedout; ev != NULL; ev = ev->next) {
+#endif
+    return backend_init();
+}
+
+/*
+ * Destroy the select mechanism. A nested execution (for example of an
+ * included script) destroys the mechanism as well, so it is only destroyed
+ * when there are no more events to monitor.
+ */
+void
+ps_DestroySelect(JSContext *cx)
+{
+    if (ps_Events != NULL || ps_Dispatching) {
+        return;
+    }
+    backend_destroy();
+    while (ps_FreeEvents != NULL) {
+        PSSelectEvent* ev = ps_FreeEvents;
+        ps_FreeEvents = ev->next;
+        JS_free(cx, ev);
+    }
+    if (ps_Heap != NULL) {
+        JS_free(cx, ps_Heap);
+        ps_Heap = NULL;
+        ps_HeapCapacity = 0;
+    }
+    if (ps_FdTable != NULL) {
+        JS_free(cx, ps_FdTable);
+        ps_FdTable = NULL;
+        ps_FdTableCapacity = 0;
+    }
+    if (ps_Ready != NULL) {
+        JS_free(cx, ps_Ready);
+        ps_Ready = NULL;
+        ps_ReadyCapacity = 0;
+    }
+#ifdef JS_THREADSAFE
+    if (ps_EventsLock) {
+        JS_DESTROY_LOCK(ps_EventsLock);
+        ps_EventsLock = NULL;
+    }
+#endif
+}
+
+/*
+ * Handle the ready events. An event that has been removed by the callback of
+ * an earlier event is skipped. An expired timer is released once it has been
+ * handled.
+ */
+static void
+dispatch_ready(JSContext *cx)
+{
+    for (int i = 0; i < ps_ReadyLength; ++i) {
+        PSReadyEvent* ready = &ps_Ready[i];
+        PSSelectEvent* ev = ready->ev;
+        if (ev->generation != ready->generation) {
+            continue;
+        }
+        if (ready->errored) {
+            ev->errfunc(cx, ev->obj);
+        }
+        else {
             ev->func(cx, ev->obj);
         }
+        if (ev->expired && ev->generation == ready->generation) {
+            JS_ACQUIRE_LOCK(ps_EventsLock);
+            release_event(ev);
+            JS_RELEASE_LOCK(ps_EventsLock);
+        }
+    }
+    ps_ReadyLength = 0;
+}
+
+JSBool
+ps_HandleSelect(JSContext *cx)
+{
+    int result;
+    struct timespec timeout, now;
+
+    /* If there are no events to monitor, then there is nothing to do. The
+     * events are not handled by a nested execution from within a callback,
+     * they are handled once the callback returns. */
+    if (ps_Events == NULL || ps_Dispatching) {
+        return JS_FALSE;
+    }
+
+    /* The timeout is the time left until the earliest deadline. */
+    JS_ACQUIRE_LOCK(ps_EventsLock);
+    if (ps_HeapLength == 0) {
+        timeout = set_no_timeout();
     }
     else {
-        for (PSSelectEvent* ev = errored; ev != NULL; ev = ev->next) {
-            ev->errfunc(cx, ev->obj);
-        }
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        timeout = diff_timespec(now, ps_Heap[0]->deadline);
     }
+    JS_RELEASE_LOCK(ps_EventsLock);
 
-    /* Cleanup the temporary copies */
-    for (PSSelectEvent* ev = triggered; ev != NULL; /* Updated inside */) {
-        PSSelectEvent* next = ev->next;
-        free(next);
-        ev = next;
+    /* Wait for the file-descriptors to be triggered. Each event is ready at
+     * most once. */
+    if (!ready_reserve(cx, ps_EventCount)) {
+        return JS_FALSE;
     }
-    for (PSSelectEvent* ev = timedout; ev != NULL; /* Updated inside */) {
-        PSSelectEvent* next = ev->next;
-        free(next);
-        ev = next;
+    result = ps_Backend->wait(timeout);
+    if (result < 0 && errno == EINTR) {
+        /* Interrupted by a signal, just try again. */
+        return JS_TRUE;
     }
-    for (PSSelectEvent* ev = errored; ev != NULL; /* Updated inside */) {
-        PSSelectEvent* next = ev->next;
-        free(next);
-        ev = next;
+
+    /* If the wait failed, all the file descriptors are errored */
+    if (result < 0) {
+        JS_ACQUIRE_LOCK(ps_EventsLock);
+        ps_ReadyLength = 0;
+        for (PSSelectEvent* ev = ps_Events; ev != NULL; ev = ev->next) {
+            if (ev->fd >= 0) {
+                ready_add(ev, JS_TRUE);
+            }
+        }
+        JS_RELEASE_LOCK(ps_EventsLock);
     }
 
+    /* Handle the triggered or errored events */
+    ps_Dispatching = JS_TRUE;
+    dispatch_ready(cx);
+    ps_Dispatching = JS_FALSE;
+
+    /* Take all the events from the deadline heap whose deadline has passed.
+     * This is done after handling the triggered events, as their callbacks
+     * may have set a new deadline. A deadline only expires once, it needs to
+     * be set again to time out again. Expired timers are taken out of the
+     * list of events, in the order of their deadline, and are only released
+     * once they are handled. */
+    if (!ready_reserve(cx, ps_HeapLength)) {
+        return JS_FALSE;
+    }
+    JS_ACQUIRE_LOCK(ps_EventsLock);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    while (ps_HeapLength > 0 &&
+           compare_timespec(ps_Heap[0]->deadline, now) <= 0)
+    {
+        PSSelectEvent* ev = ps_Heap[0];
+        heap_remove(ev);
+        ev->deadline = set_no_timeout();
+        if (ev->fd < 0) {
+            unlink_event(ev);
+            ev->expired = JS_TRUE;
+        }
+        ready_add(ev, JS_FALSE);
+    }
+    JS_RELEASE_LOCK(ps_EventsLock);
+
+    /* Handle the timed-out events and expired timers. */
+    ps_Dispatching = JS_TRUE;
+    dispatch_ready(cx);
+    ps_Dispatching = JS_FALSE;
+
     return JS_TRUE;
 }
 
@@ -342,9 +1291,38 @@ ps_AddSelect(JSContext *cx, int fd, PSFDSet fdsetmask, JSObject* obj,
              int timeout)
 {
     PSSelectEvent* event;
+    JSBool ok;
+
+    /* The mechanism may have been destroyed by a nested execution. */
+    if (fd < 0 || !ps_InitSelect(cx)) {
+        return JS_FALSE;
+    }
+
+    /* Re-use any existing event with matching file-descriptor, so the
+     * registration with the backend is only modified. */
+    JS_ACQUIRE_LOCK(ps_EventsLock);
+    event = fd_lookup(fd);
+    if (event != NULL) {
+        /* Update the existing event in place. */
+        PSFDSet oldmask = event->fdsetmask;
+        event->fdsetmask = fdsetmask;
+        event->obj = obj;
+        event->func = func;
+        event->errfunc = errfunc;
+        ok = set_deadline(cx, event, deadline_timespec(timeout)) &&
+             ((oldmask == fdsetmask) || ps_Backend->modify(event));
+        JS_RELEASE_LOCK(ps_EventsLock);
+        if (!ok) {
+            ps_RemoveSelect(cx, fd);
+        }
+        return ok;
+    }
+    JS_RELEASE_LOCK(ps_EventsLock);
 
     /* Create a new event structure */
-    event = (PSSelectEvent*) JS_malloc(cx, sizeof(PSSelectEvent));
+    JS_ACQUIRE_LOCK(ps_EventsLock);
+    event = new_event(cx);
+    JS_RELEASE_LOCK(ps_EventsLock);
     if (!event) {
         return JS_FALSE;
     }
@@ -353,53 +1331,100 @@ ps_AddSelect(JSContext *cx, int fd, PSFDSet fdsetmask, JSObject* obj,
     event->obj = obj;
     event->func = func;
     event->errfunc = errfunc;
-    event->prev = NULL;
-    event->next = NULL;
 
-    /* Set the timeout, assume that '-1' means no timeout. */
-    if (timeout == -1) {
-        event->timeout = set_no_timeout();
+    /* Register with the backend and add the new event to the list and the
+     * deadline heap. */
+    JS_ACQUIRE_LOCK(ps_EventsLock);
+    ok = fd_set_event(cx, fd, event) &&
+         set_deadline(cx, event, deadline_timespec(timeout));
+    if (ok && !ps_Backend->add(event)) {
+        heap_remove(event);
+        ok = JS_FALSE;
     }
-    else {
-        event->timeout.tv_sec = timeout / 1000;
-        event->timeout.tv_nsec = (timeout % 1000) * 1000000;
+    if (ok) {
+        link_event(event);
     }
-
-    /* Remove any existing event with matching file-descriptor. */
-    ps_RemoveSelect(cx, fd);
-
-    /* Add the new event to the list. */
-    JS_ACQUIRE_LOCK(ps_EventsLock);
-    if (ps_Events != NULL) {
-        event->next = ps_Events;
-        ps_Events->prev = event;
+    else {
+        if (fd < ps_FdTableCapacity && ps_FdTable[fd] == event) {
+            ps_FdTable[fd] = NULL;
+        }
+        release_event(event);
     }
-    ps_Events = event;
     JS_RELEASE_LOCK(ps_EventsLock);
 
-    return JS_TRUE;
+    return ok;
 }
 
 JSBool
 ps_RemoveSelect(JSContext *cx, int fd)
 {
+    /* Timers are not associated with a file-descriptor. */
+    if (fd < 0) {
+        return JS_TRUE;
+    }
+
     /* Remove any existing event with matching file-descriptor. */
     JS_ACQUIRE_LOCK(ps_EventsLock);
-    for (PSSelectEvent* ev = ps_Events; ev != NULL; ev = ev->next) {
-        if (ev->fd == fd) {
-            if (ev->prev != NULL) {
-                ev->prev = ev->next;
-            }
-            if (ev->next != NULL) {
-                ev->next->prev = ev->prev;
-            }
-            if (ev == ps_Events) {
-                ps_Events = ev->next;
-            }
-            JS_free(cx, ev);
-        }
+    PSSelectEvent* ev = fd_lookup(fd);
+    if (ev != NULL) {
+        ps_FdTable[fd] = NULL;
+        ps_Backend->remove(ev);
+        heap_remove(ev);
+        unlink_event(ev);
+        release_event(ev);
     }
     JS_RELEASE_LOCK(ps_EventsLock);
     return JS_TRUE;
 }
 
+PSSelectTimer*
+ps_AddTimer(JSContext *cx, JSObject* obj, PSSelectCallback func, int timeout)
+{
+    PSSelectEvent* event;
+    JSBool ok;
+
+    /* The mechanism may have been destroyed by a nested execution. */
+    if (!ps_InitSelect(cx)) {
+        return NULL;
+    }
+
+    /* Create a new event structure without file-descriptor */
+    JS_ACQUIRE_LOCK(ps_EventsLock);
+    event = new_event(cx);
+    JS_RELEASE_LOCK(ps_EventsLock);
+    if (!event) {
+        return NULL;
+    }
+    event->fd = -1;
+    event->fdsetmask = 0;
+    event->obj = obj;
+    event->func = func;
+    event->errfunc = NULL;
+
+    /* Add the new event to the list and the deadline heap. */
+    JS_ACQUIRE_LOCK(ps_EventsLock);
+    ok = set_deadline(cx, event, deadline_timespec(timeout < 0 ? 0 : timeout));
+    if (ok) {
+        link_event(event);
+    }
+    else {
+        release_event(event);
+    }
+    JS_RELEASE_LOCK(ps_EventsLock);
+
+    return ok ? event : NULL;
+}
+
+void
+ps_RemoveTimer(JSContext *cx, PSSelectTimer* timer)
+{
+    /* An expired timer is no longer in the list or the heap, releasing it
+     * makes sure it is not handled anymore. */
+    JS_ACQUIRE_LOCK(ps_EventsLock);
+    if (!timer->expired) {
+        heap_remove(timer);
+        unlink_event(timer);
+    }
+    release_event(timer);
+    JS_RELEASE_LOCK(ps_EventsLock);
+}
@@ -44,7 +44,9 @@
  * ProntoScipt asynchronous handling.
  *
  * Asynchronous handling utilises the `select` mechanism that can wait for
- * multiple file-descriptor events simultaneously. The selecting mechanims is
+ * multiple file-descriptor events simultaneously. Where available, `epoll` is
+ * used instead, which keeps the file-descriptors registered with the kernel
+ * rather than passing all of them on every wait. The selecting mechanims is
  * only handled at the end of the script execution and will be in effect while
  * there are still file-desccriptors left to be monitored. The script will
  * typically initialise and start the file-descriptor monitoting, for example,
@@ -65,6 +67,10 @@ typedef enum PSFDSet {
  * refers to the javascript object that owns the file-descriptor. */
 typedef void (*PSSelectCallback)(JSContext *cx, JSObject *obj);
 
+/* The handle of a timer, an event that is not associated with a
+ * file-descriptor. */
+typedef struct _PSSelectEvent PSSelectTimer;
+
 /* Initialise the ProntoScript select mechanism. */
 JSBool ps_InitSelect(JSContext *cx);
 
@@ -84,6 +90,16 @@ JSBool ps_AddSelect(JSContext* cx, int fd, PSFDSet fdsetmask, JSObject *obj,
 /* Remove the file-descriptor from the asynchroneous mechanism. */
 JSBool ps_RemoveSelect(JSContext* cx, int fd);
 
+/* Add a timer to the asynchroneous mechanism and register the function to
+ * call once, when the timeout (in milliseconds) has expired. Returns NULL if
+ * the timer could not be added. */
+PSSelectTimer* ps_AddTimer(JSContext* cx, JSObject *obj,
+        PSSelectCallback func, int timeout);
+
+/* Remove a timer from the asynchroneous mechanism before it is handled. The
+ * timer handle is no longer valid once its function has been called. */
+void ps_RemoveTimer(JSContext* cx, PSSelectTimer *timer);
+
 JS_END_EXTERN_C
 
 #endif /* psselect_h___ */
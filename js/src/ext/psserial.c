@@ -0,0 +1,1415 @@
+/*
+ * ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is the ProntoScript re-implementation October 4, 2025.
+ *
+ * The Initial Developer of the Original Code is Stefan Sinnige.
+ * Portions created by the Initial Developer are Copyright (C) 2025
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either of the GNU General Public License Version 2 or later (the "GPL"),
+ * or the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK *****
+ */
+
+/* Required for cfmakeraw and memmem. */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "jsapi.h"
+#include "jscntxt.h"
+#include "jsfun.h"
+#include "jslock.h"
+#include "jstypes.h"
+#include "psbytebuffer.h"
+#include "psselect.h"
+#include "psserial.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef HAVE_PTY_H
+#include <pty.h>
+#endif
+#ifdef HAVE_UTIL_H
+#include <util.h>
+#endif
+
+/*
+ *Forward declarations
+ */
+static JSBool Serial_GetProperty(JSContext*, JSObject*, jsval, jsval*);
+static JSBool Serial_SetProperty(JSContext*, JSObject*, jsval, jsval*);
+static JSBool Serial_Send(JSContext*, JSObject*, uintN, jsval*, jsval*);
+static JSBool Serial_Receive(JSContext*, JSObject*, uintN, jsval*, jsval*);
+static JSBool Serial_Match(JSContext*, JSObject*, uintN, jsval*, jsval*);
+static JSBool Serial_Close(JSContext*, JSObject*, uintN, jsval*, jsval*);
+static JSBool Serial_CT(JSContext*, JSObject*, uintN, jsval*, jsval*);
+static void   Serial_DT(JSContext*, JSObject*);
+static uint32 Serial_Mark(JSContext*, JSObject*, void*);
+static void   Serial_SelectCallback(JSContext*, JSObject*);
+static void   Serial_SelectErrorCallback(JSContext*, JSObject*);
+static void   Serial_TimeoutCallback(JSContext*, JSObject*);
+static JSBool Serial_Invoke(JSContext*, JSObject*, jsval, uintN, jsval*);
+
+/*
+ * The size of the receive buffer. The data that is received while there is
+ * nothing to pass it to is kept in the buffer, until it is full and the
+ * oldest half is dropped.
+ */
+#define SERIAL_BUFFER_MAX (64 * 1024)
+
+/*
+ * The receive request that is outstanding.
+ */
+typedef enum {
+    SERIALREQUEST_NONE,     /* Pass all data to onData as it arrives. */
+    SERIALREQUEST_RECEIVE,  /* Wait for a number of bytes. */
+    SERIALREQUEST_MATCH     /* Wait for a terminator. */
+} SerialRequest;
+
+/*
+ * The Serial class private instance data.
+ */
+
+typedef struct {
+    JSObject* self;         /* The instance, rooted while open. */
+    jsval onData;           /* The on-data callback function. */
+    jsval onError;          /* The on-error callback function. */
+    jsval onTimeout;        /* The on-timeout callback function. */
+    int fd;                 /* The terminal descriptor, or -1. */
+    int peer;               /* The pseudo-terminal slave descriptor, or -1. */
+    JSBool pty;             /* True if the terminal is a pseudo-terminal. */
+    char* path;             /* The path of the terminal device. */
+    int bitrate;            /* The bit rate. */
+    int databits;           /* The number of data bits, 7 or 8. */
+    int parity;             /* None (0), odd (1) or even (2) parity. */
+    int stopbits;           /* The number of stop bits, 1 or 2. */
+    char* rxbuffer;         /* The received data. */
+    size_t rxlength;        /* The number of bytes received. */
+    SerialRequest request;  /* The outstanding receive request. */
+    size_t count;           /* The number of bytes to receive. */
+    char* terminator;       /* The terminator to match. */
+    size_t termlength;      /* The length of the terminator. */
+    PSSelectTimer* timer;   /* The timer of the request, or NULL. */
+    char* txbuffer;         /* The data still to be sent. */
+    size_t txlength;        /* The number of bytes still to be sent. */
+} Serial;
+
+/*
+ * The supported bit rates.
+ */
+static const struct {
+    int bitrate;
+    speed_t speed;
+} serial_speeds[] = {
+    {300, B300},
+    {600, B600},
+    {1200, B1200},
+    {2400, B2400},
+    {4800, B4800},
+    {9600, B9600},
+    {19200, B19200},
+    {38400, B38400},
+    {57600, B57600},
+    {115200, B115200},
+#ifdef B230400
+    {230400, B230400},
+#endif
+    {0, B0}
+};
+
+/**
+ * Definition of the class properties
+ */
+enum serial_tinyid {
+    SERIAL_PATH = -1,
+    SERIAL_BITRATE = -2,
+    SERIAL_DATABITS = -3,
+    SERIAL_PARITY = -4,
+    SERIAL_STOPBITS = -5,
+    SERIAL_ONDATA = -6,
+    SERIAL_ONERROR = -7,
+    SERIAL_ONTIMEOUT = -8
+};
+
+#define SERIAL_PROP_ATTRS (JSPROP_PERMANENT)
+
+static JSPropertySpec serial_props[] = {
+    /* { name, tinyid, flags, getter, setter } */
+    {"path", SERIAL_PATH, SERIAL_PROP_ATTRS | JSPROP_READONLY, 0, 0},
+    {"bitrate", SERIAL_BITRATE, SERIAL_PROP_ATTRS , 0, 0},
+    {"databits", SERIAL_DATABITS, SERIAL_PROP_ATTRS , 0, 0},
+    {"parity", SERIAL_PARITY, SERIAL_PROP_ATTRS , 0, 0},
+    {"stopbits", SERIAL_STOPBITS, SERIAL_PROP_ATTRS , 0, 0},
+    {"onData", SERIAL_ONDATA, SERIAL_PROP_ATTRS , 0, 0},
+    {"onError", SERIAL_ONERROR, SERIAL_PROP_ATTRS , 0, 0},
+    {"onTimeout", SERIAL_ONTIMEOUT, SERIAL_PROP_ATTRS , 0, 0},
+    {0, 0, 0, 0, 0}
+};
+
+/**
+ * Definition of the class methods
+ */
+static JSFunctionSpec serial_methods[] = {
+    /* { name, call, nargs, flags, extra } */
+    {"send", Serial_Send, 1, 0, 0},
+    {"receive", Serial_Receive, 3, 0, 0},
+    {"match", Serial_Match, 3, 0, 0},
+    {"close", Serial_Close, 0, 0, 0},
+    {0, 0, 0, 0, 0}
+};
+
+/**
+ * Definition of the class
+ */
+static JSClass serial_class = {
+    ps_Serial_str,                  /* name */
+    JSCLASS_HAS_PRIVATE,            /* flags */
+    JS_PropertyStub,                /* add property */
+    JS_PropertyStub,                /* del property */
+    Serial_GetProperty,             /* get property */
+    Serial_SetProperty,             /* set property */
+    JS_EnumerateStub,               /* enumerate */
+    JS_ResolveStub,                 /* resolve */
+    JS_ConvertStub,                 /* convert */
+    Serial_DT,                      /* finalize */
+    NULL,                           /* get object ops */
+    NULL,                           /* check access */
+    NULL,                           /* call */
+    NULL,                           /* construct */
+    NULL,                           /* xdr object */
+    NULL,                           /* has instance */
+    Serial_Mark,                    /* mark */
+    0                               /* reserve slots */
+};
+
+/*
+ * Create and destroy the serial port instance.
+ */
+
+static Serial*
+Serial_New(JSContext *cx)
+{
+    Serial *ser = NULL;
+    ser = (Serial*) JS_malloc(cx, sizeof(Serial));
+    if (!ser) {
+        return NULL;
+    }
+    ser->rxbuffer = (char*) JS_malloc(cx, SERIAL_BUFFER_MAX);
+    if (!ser->rxbuffer) {
+        JS_free(cx, ser);
+        return NULL;
+    }
+    ser->self = NULL;
+    ser->onData = JSVAL_VOID;
+    ser->onError = JSVAL_VOID;
+    ser->onTimeout = JSVAL_VOID;
+    ser->fd = -1;
+    ser->peer = -1;
+    ser->pty = JS_FALSE;
+    ser->path = NULL;
+    ser->bitrate = 9600;
+    ser->databits = 8;
+    ser->parity = 0;
+    ser->stopbits = 1;
+    ser->rxlength = 0;
+    ser->request = SERIALREQUEST_NONE;
+    ser->count = 0;
+    ser->terminator = NULL;
+    ser->termlength = 0;
+    ser->timer = NULL;
+    ser->txbuffer = NULL;
+    ser->txlength = 0;
+    return ser;
+}
+
+/*
+ * End the outstanding receive request.
+ */
+static void
+Serial_EndRequest(JSContext* cx, Serial* ser)
+{
+    if (ser->timer) {
+        ps_RemoveTimer(cx, ser->timer);
+        ser->timer = NULL;
+    }
+    if (ser->terminator) {
+        JS_free(cx, ser->terminator);
+        ser->terminator = NULL;
+    }
+    ser->termlength = 0;
+    ser->count = 0;
+    ser->request = SERIALREQUEST_NONE;
+}
+
+/*
+ * Close the terminal, and unroot the instance.
+ */
+static void
+Serial_Shutdown(JSContext* cx, Serial* ser)
+{
+    Serial_EndRequest(cx, ser);
+    if (ser->fd != -1) {
+        ps_RemoveSelect(cx, ser->fd);
+        (void) close(ser->fd);
+        ser->fd = -1;
+    }
+    if (ser->peer != -1) {
+        (void) close(ser->peer);
+        ser->peer = -1;
+    }
+    if (ser->txbuffer) {
+        JS_free(cx, ser->txbuffer);
+        ser->txbuffer = NULL;
+    }
+    ser->txlength = 0;
+    if (ser->self) {
+        JS_RemoveRoot(cx, &ser->self);
+        ser->self = NULL;
+    }
+}
+
+static void
+Serial_Delete(JSContext* cx, Serial* ser)
+{
+    Serial_Shutdown(cx, ser);
+    if (ser->path) {
+        JS_free(cx, ser->path);
+    }
+    JS_free(cx, ser->rxbuffer);
+    JS_free(cx, ser);
+}
+
+/*
+ * Check whether a terminal is the slave side of a pseudo-terminal, such as
+ * the device side of a Serial created without a path.
+ */
+static JSBool
+Serial_IsPseudoTerminal(int fd)
+{
+    const char* name = ttyname(fd);
+
+    return name && strncmp(name, "/dev/pts/", 9) == 0;
+}
+
+/*
+ * Apply the line settings to the terminal. The terminal is put in raw mode,
+ * so that the data is passed on unchanged. The settings of a pseudo-terminal
+ * are applied to its slave side.
+ */
+static JSBool
+Serial_Configure(JSContext* cx, Serial* ser)
+{
+    struct termios tio;
+    speed_t speed = B0;
+    int fd;
+
+    if (ser->fd == -1) {
+        return JS_TRUE;
+    }
+    fd = ser->peer != -1 ? ser->peer : ser->fd;
+    for (int i = 0; serial_speeds[i].bitrate != 0; ++i) {
+        if (serial_speeds[i].bitrate == ser->bitrate) {
+            speed = serial_speeds[i].speed;
+        }
+    }
+    if (tcgetattr(fd, &tio) < 0) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_FAILED, strerror(errno));
+        return JS_FALSE;
+    }
+    cfmakeraw(&tio);
+    tio.c_cflag &= ~(CSIZE | PARENB | PARODD | CSTOPB | CRTSCTS);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cflag |= ser->databits == 7 ? CS7 : CS8;
+    if (ser->parity != 0) {
+        tio.c_cflag |= PARENB;
+        if (ser->parity == 1) {
+            tio.c_cflag |= PARODD;
+        }
+    }
+    if (ser->stopbits == 2) {
+        tio.c_cflag |= CSTOPB;
+    }
+
+    /* A non-blocking read fails with EAGAIN while there is no data, so that a
+     * read of 0 bytes means the terminal has been hung up. */
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+    if (cfsetispeed(&tio, speed) < 0 || cfsetospeed(&tio, speed) < 0) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_FAILED, strerror(errno));
+        return JS_FALSE;
+    }
+    if (tcsetattr(fd, TCSANOW, &tio) < 0) {
+        /* A pseudo-terminal may reject a parity or a character size other
+         * than 8 bits, as it has no character framing. These are left out
+         * for a pseudo-terminal only, a device reports the error. */
+        if (ser->pty && errno == EINVAL) {
+            tio.c_cflag &= ~(CSIZE | PARENB | PARODD);
+            tio.c_cflag |= CS8;
+            if (tcsetattr(fd, TCSANOW, &tio) == 0) {
+                return JS_TRUE;
+            }
+        }
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_FAILED, strerror(errno));
+        return JS_FALSE;
+    }
+    return JS_TRUE;
+}
+
+/*
+ * The number of bytes at the start of the receive buffer that satisfy the
+ * outstanding request, or 0 if it is not satisfied yet. Without a request,
+ * all of the data is passed on.
+ */
+static size_t
+Serial_RxReady(Serial* ser)
+{
+    char* found;
+
+    if (ser->rxlength == 0) {
+        return 0;
+    }
+    switch (ser->request) {
+        case SERIALREQUEST_NONE:
+            return ser->rxlength;
+        case SERIALREQUEST_RECEIVE:
+            return ser->rxlength >= ser->count ? ser->count : 0;
+        case SERIALREQUEST_MATCH:
+            found = (char*) memmem(ser->rxbuffer, ser->rxlength,
+                                   ser->terminator, ser->termlength);
+            return found ? found - ser->rxbuffer + ser->termlength : 0;
+    }
+    return 0;
+}
+
+/*
+ * Update the asynchronous select registration. The terminal is always
+ * watched for data, and for being writable while there is data queued to be
+ * sent. If buffered data satisfies the request already, the callback is
+ * triggered right away.
+ */
+static JSBool
+Serial_Update(JSContext* cx, JSObject* obj, Serial* ser)
+{
+    PSFDSet mask = PSFDSET_READ;
+
+    if (ser->fd == -1) {
+        return JS_TRUE;
+    }
+    if (ser->txlength > 0) {
+        mask |= PSFDSET_WRITE;
+    }
+    if (!ps_AddSelect(cx, ser->fd, mask, obj, &Serial_SelectCallback,
+                      &Serial_SelectErrorCallback,
+                      JSVAL_IS_FUNCTION(cx, ser->onData) &&
+                      Serial_RxReady(ser) > 0 ? 0 : -1))
+    {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_FAILED, "asynchronous serial setup");
+        return JS_FALSE;
+    }
+    return JS_TRUE;
+}
+
+/*
+ * Read all the available data into the receive buffer. Returns -1 on an
+ * error, or when the terminal has been hung up, otherwise the number of bytes
+ * read.
+ */
+static ssize_t
+Serial_RxFill(Serial* ser)
+{
+    ssize_t nread;
+    ssize_t total = 0;
+
+    for (;;) {
+        if (ser->rxlength == SERIAL_BUFFER_MAX) {
+            memmove(ser->rxbuffer, ser->rxbuffer + SERIAL_BUFFER_MAX / 2,
+                    SERIAL_BUFFER_MAX / 2);
+            ser->rxlength = SERIAL_BUFFER_MAX / 2;
+        }
+        nread = read(ser->fd, ser->rxbuffer + ser->rxlength,
+                     SERIAL_BUFFER_MAX - ser->rxlength);
+        if (nread > 0) {
+            ser->rxlength += nread;
+            total += nread;
+            continue;
+        }
+        if (nread == 0) {
+            errno = EIO;
+            return -1;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return total;
+        }
+        return -1;
+    }
+}
+
+/*
+ * Remove a number of bytes from the start of the receive buffer, and return
+ * them as a string in which each character is a byte.
+ */
+static JSString*
+Serial_RxTake(JSContext* cx, Serial* ser, size_t length)
+{
+    JSString* str;
+    jschar* chars;
+
+    chars = (jschar*) JS_malloc(cx, (length + 1) * sizeof(jschar));
+    if (!chars) {
+        return NULL;
+    }
+    for (size_t i = 0; i < length; ++i) {
+        chars[i] = (unsigned char) ser->rxbuffer[i];
+    }
+    chars[length] = 0;
+    str = JS_NewUCString(cx, chars, length);
+    if (!str) {
+        JS_free(cx, chars);
+        return NULL;
+    }
+    ser->rxlength -= length;
+    memmove(ser->rxbuffer, ser->rxbuffer + length, ser->rxlength);
+    return str;
+}
+
+/*
+ * Send as much of the queued data as the terminal accepts. Returns JS_FALSE
+ * on an error.
+ */
+static JSBool
+Serial_TxFlush(Serial* ser)
+{
+    ssize_t nwritten;
+
+    while (ser->txlength > 0) {
+        nwritten = write(ser->fd, ser->txbuffer, ser->txlength);
+        if (nwritten < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        ser->txlength -= nwritten;
+        memmove(ser->txbuffer, ser->txbuffer + nwritten, ser->txlength);
+    }
+    return JS_TRUE;
+}
+
+/*
+ * Wait for the terminal to become ready, for at most the timeout in
+ * milliseconds, or indefinitely for a negative timeout. Returns -1 on an
+ * error, 0 on a timeout, otherwise 1.
+ */
+static int
+Serial_Wait(Serial* ser, short events, int timeout)
+{
+    struct pollfd pfd;
+    int n;
+
+    pfd.fd = ser->fd;
+    pfd.events = events;
+    do {
+        n = poll(&pfd, 1, timeout);
+    } while (n < 0 && errno == EINTR);
+    return n;
+}
+
+/*
+ * The current monotonic time in milliseconds.
+ */
+static jsdouble
+Serial_Now()
+{
+    struct timespec ts;
+    (void) clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (jsdouble) ts.tv_sec * 1000 + (jsdouble) ts.tv_nsec / 1000000;
+}
+
+static JSBool
+Serial_GetProperty(JSContext *cx, JSObject *obj, jsval id, jsval *vp)
+{
+    Serial* ser = NULL;
+    JSString* str;
+    jsint slot;
+
+    /* Get the property's slot */
+    if (!JSVAL_IS_INT(id)) {
+        return JS_TRUE;
+    }
+    slot = JSVAL_TO_INT(id);
+
+    /* Get the value */
+    JS_LOCK_OBJ(cx, obj);
+    ser = (Serial*)JS_GetInstancePrivate(cx, obj, &serial_class, NULL);
+    if (ser) {
+        switch (slot) {
+            case SERIAL_PATH:
+                *vp = JSVAL_NULL;
+                if (ser->path) {
+                    str = JS_NewStringCopyZ(cx, ser->path);
+                    if (str) {
+                        *vp = STRING_TO_JSVAL(str);
+                    }
+                }
+                break;
+            case SERIAL_BITRATE:
+                *vp = INT_TO_JSVAL(ser->bitrate);
+                break;
+            case SERIAL_DATABITS:
+                *vp = INT_TO_JSVAL(ser->databits);
+                break;
+            case SERIAL_PARITY:
+                *vp = INT_TO_JSVAL(ser->parity);
+                break;
+            case SERIAL_STOPBITS:
+                *vp = INT_TO_JSVAL(ser->stopbits);
+                break;
+            case SERIAL_ONDATA:
+                *vp = ser->onData;
+                break;
+            case SERIAL_ONERROR:
+                *vp = ser->onError;
+                break;
+            case SERIAL_ONTIMEOUT:
+                *vp = ser->onTimeout;
+                break;
+            default:
+                break;
+        }
+    }
+    JS_UNLOCK_OBJ(cx, obj);
+    return JS_TRUE;
+}
+
+/*
+ * Check whether a line setting is one of the supported values.
+ */
+static JSBool
+Serial_ValidSetting(jsint slot, jsint value)
+{
+    switch (slot) {
+        case SERIAL_BITRATE:
+            for (int i = 0; serial_speeds[i].bitrate != 0; ++i) {
+                if (serial_speeds[i].bitrate == value) {
+                    return JS_TRUE;
+                }
+            }
+            return JS_FALSE;
+        case SERIAL_DATABITS:
+            return value == 7 || value == 8;
+        case SERIAL_PARITY:
+            return value >= 0 && value <= 2;
+        case SERIAL_STOPBITS:
+            return value == 1 || value == 2;
+    }
+    return JS_FALSE;
+}
+
+static JSBool
+Serial_SetProperty(JSContext *cx, JSObject *obj, jsval id, jsval *vp)
+{
+    Serial* ser = NULL;
+    jsint slot;
+
+    /* Get the property's slot */
+    if (!JSVAL_IS_INT(id)) {
+        return JS_TRUE;
+    }
+    slot = JSVAL_TO_INT(id);
+
+    /* The line settings are applied to the terminal right away. */
+    ser = (Serial*)JS_GetInstancePrivate(cx, obj, &serial_class, NULL);
+    if (!ser) {
+        return JS_TRUE;
+    }
+    switch (slot) {
+        case SERIAL_BITRATE:
+        case SERIAL_DATABITS:
+        case SERIAL_PARITY:
+        case SERIAL_STOPBITS:
+            if (!JSVAL_IS_INT(*vp)) {
+                JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                                     PSMSG_ARGUMENT_NOT_INT);
+                return JS_FALSE;
+            }
+            if (!Serial_ValidSetting(slot, JSVAL_TO_INT(*vp))) {
+                JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                                     PSMSG_ARGUMENT_OUT_OF_RANGE);
+                return JS_FALSE;
+            }
+            break;
+    }
+
+    /* Set the value */
+    JS_LOCK_OBJ(cx, obj);
+    switch (slot) {
+        case SERIAL_PATH:
+            break;
+        case SERIAL_BITRATE:
+            ser->bitrate = JSVAL_TO_INT(*vp);
+            break;
+        case SERIAL_DATABITS:
+            ser->databits = JSVAL_TO_INT(*vp);
+            break;
+        case SERIAL_PARITY:
+            ser->parity = JSVAL_TO_INT(*vp);
+            break;
+        case SERIAL_STOPBITS:
+            ser->stopbits = JSVAL_TO_INT(*vp);
+            break;
+        case SERIAL_ONDATA:
+            if (JSVAL_IS_FUNCTION(cx, *vp)) {
+                ser->onData = *vp;
+            }
+            else if (JSVAL_IS_NULL(*vp) || JSVAL_IS_VOID(*vp)) {
+                ser->onData = JSVAL_VOID;
+            }
+            break;
+        case SERIAL_ONERROR:
+            if (JSVAL_IS_FUNCTION(cx, *vp)) {
+                ser->onError = *vp;
+            }
+            break;
+        case SERIAL_ONTIMEOUT:
+            if (JSVAL_IS_FUNCTION(cx, *vp)) {
+                ser->onTimeout = *vp;
+            }
+            break;
+    }
+    JS_UNLOCK_OBJ(cx, obj);
+
+    switch (slot) {
+        case SERIAL_BITRATE:
+        case SERIAL_DATABITS:
+        case SERIAL_PARITY:
+        case SERIAL_STOPBITS:
+            return Serial_Configure(cx, ser);
+        case SERIAL_ONDATA:
+            return Serial_Update(cx, obj, ser);
+    }
+    return JS_TRUE;
+}
+
+/*
+ * Pass an error to the onError callback, and close the terminal.
+ */
+static void
+Serial_Fail(JSContext *cx, JSObject *obj, Serial* ser, const char* error)
+{
+    JSString* str;
+    jsval argv[1];
+
+    Serial_Shutdown(cx, ser);
+    if (!JSVAL_IS_VOID(ser->onError)) {
+        str = JS_NewStringCopyZ(cx, error);
+        if (str) {
+            argv[0] = STRING_TO_JSVAL(str);
+            Serial_Invoke(cx, obj, ser->onError, 1, argv);
+        }
+    }
+}
+
+/*
+ * Callback when the terminal has been triggered. Any queued data is sent, and
+ * the received data is read into the buffer. The data is passed to onData
+ * for as long as it satisfies the request, as the callback may start a new
+ * request that is satisfied by the buffered data already.
+ */
+static void
+Serial_SelectCallback(JSContext *cx, JSObject *obj)
+{
+    Serial* ser = NULL;
+    JSString* str;
+    jsval argv[1];
+    size_t ready;
+
+    ser = (Serial*) JS_GetPrivate(cx, obj);
+    if (!ser || ser->fd == -1) {
+        return;
+    }
+    if (!Serial_TxFlush(ser) || Serial_RxFill(ser) < 0) {
+        Serial_Fail(cx, obj, ser, strerror(errno));
+        return;
+    }
+    while (ser->fd != -1 && JSVAL_IS_FUNCTION(cx, ser->onData) &&
+           (ready = Serial_RxReady(ser)) > 0)
+    {
+        Serial_EndRequest(cx, ser);
+        str = Serial_RxTake(cx, ser, ready);
+        if (!str) {
+            break;
+        }
+        argv[0] = STRING_TO_JSVAL(str);
+        Serial_Invoke(cx, obj, ser->onData, 1, argv);
+    }
+    (void) Serial_Update(cx, obj, ser);
+}
+
+/*
+ * Callback when the terminal has triggered an error, typically because it
+ * has been hung up.
+ */
+static void
+Serial_SelectErrorCallback(JSContext *cx, JSObject *obj)
+{
+    Serial* ser = NULL;
+
+    ser = (Serial*) JS_GetPrivate(cx, obj);
+    if (!ser) {
+        return;
+    }
+    Serial_Fail(cx, obj, ser, "terminal hung up");
+}
+
+/*
+ * Callback when the timeout of a request has expired. The data received so
+ * far is passed to onTimeout. Without an onTimeout callback, the data is kept
+ * to be passed to onData.
+ */
+static void
+Serial_TimeoutCallback(JSContext *cx, JSObject *obj)
+{
+    Serial* ser = NULL;
+    JSString* str;
+    jsval argv[1];
+
+    ser = (Serial*) JS_GetPrivate(cx, obj);
+    if (!ser) {
+        return;
+    }
+    ser->timer = NULL;
+    if (ser->request == SERIALREQUEST_NONE) {
+        return;
+    }
+    Serial_EndRequest(cx, ser);
+    if (JSVAL_IS_FUNCTION(cx, ser->onTimeout)) {
+        str = Serial_RxTake(cx, ser, ser->rxlength);
+        if (str) {
+            argv[0] = STRING_TO_JSVAL(str);
+            Serial_Invoke(cx, obj, ser->onTimeout, 1, argv);
+        }
+    }
+    (void) Serial_Update(cx, obj, ser);
+}
+
+/*
+ * Invoke a callback function.
+ */
+static JSBool
+Serial_Invoke(JSContext *cx, JSObject *obj, jsval fun, uintN argc,
+              jsval *argv)
+{
+    JSStackFrame* fp;
+    jsval *sp, *oldsp;
+    void *mark;
+    JSBool result;
+
+    /* Allocate call stack frame and push the function, object and argument */
+    sp = js_AllocStack(cx, 2 + argc, &mark);
+    if (!sp) {
+        return JS_FALSE;
+    }
+    *sp++ = fun;
+    *sp++ = OBJECT_TO_JSVAL(obj);
+    for (int i = 0; i < argc; ++i) {
+        *sp++ = argv[i];
+    }
+
+    /* Lift current frame and call */
+    fp = cx->fp;
+    oldsp = fp->sp;
+    fp->sp = sp;
+    result = js_Invoke(cx, argc, JSINVOKE_INTERNAL | JSINVOKE_SKIP_CALLER);
+
+    /* Pop the call stack frame */
+    fp->sp = oldsp;
+    js_FreeStack(cx, mark);
+    return result;
+}
+
+/*
+ * Queue data to be sent, and send as much of it as possible right away. A
+ * blocking send waits until all of the data has been sent.
+ */
+static JSBool
+Serial_Write(JSContext *cx, JSObject* obj, Serial* ser, jsval v,
+             JSBool blocking)
+{
+    JSString* str = NULL;
+    const jschar* chars;
+    const char* bytes;
+    char* buffer;
+    size_t length;
+
+    bytes = ps_GetByteBufferData(cx, v, &length);
+    if (!bytes) {
+        if (JS_TypeOfValue(cx, v) != JSTYPE_STRING) {
+            JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                                 PSMSG_ARGUMENT_NOT_STRING);
+            return JS_FALSE;
+        }
+        str = JSVAL_TO_STRING(v);
+        length = JSSTRING_LENGTH(str);
+    }
+    if (ser->fd == -1) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_FAILED, "not open");
+        return JS_FALSE;
+    }
+    if (length == 0) {
+        return JS_TRUE;
+    }
+
+    /*
+     * Append the data to the queue. Each character of a string is a byte.
+     */
+    buffer = (char*) JS_realloc(cx, ser->txbuffer, ser->txlength + length);
+    if (!buffer) {
+        return JS_FALSE;
+    }
+    ser->txbuffer = buffer;
+    if (bytes) {
+        memcpy(ser->txbuffer + ser->txlength, bytes, length);
+    }
+    else {
+        chars = JSSTRING_CHARS(str);
+        for (size_t i = 0; i < length; ++i) {
+            ser->txbuffer[ser->txlength + i] = (char) chars[i];
+        }
+    }
+    ser->txlength += length;
+
+    /*
+     * Send the data.
+     */
+    for (;;) {
+        if (!Serial_TxFlush(ser)) {
+            JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                                 PSMSG_FAILED, strerror(errno));
+            return JS_FALSE;
+        }
+        if (!blocking || ser->txlength == 0) {
+            break;
+        }
+        if (Serial_Wait(ser, POLLOUT, -1) < 0) {
+            JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                                 PSMSG_FAILED, strerror(errno));
+            return JS_FALSE;
+        }
+    }
+    return Serial_Update(cx, obj, ser);
+}
+
+/*
+ * Start a receive request. An asynchronous request calls onData once it has
+ * been satisfied, or onTimeout when the timeout expires first. A blocking
+ * request waits and returns the data, or the data received so far when the
+ * timeout expires.
+ */
+static JSBool
+Serial_Request(JSContext *cx, JSObject *obj, Serial* ser,
+               SerialRequest request, uintN argc, jsval *argv, jsval *rval)
+{
+    JSString* str = NULL;
+    JSBool blocking;
+    jsdouble deadline = 0;
+    size_t ready;
+    int timeout = -1;
+    int remaining;
+
+    /*
+     * Extract the data to send, the count or terminator, and the timeout.
+     */
+    if (argc < 2) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_NOT_ENOUGH_ARGUMENTS);
+        return JS_FALSE;
+    }
+    if (request == SERIALREQUEST_RECEIVE) {
+        if (!JSVAL_IS_INT(argv[1])) {
+            JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                                 PSMSG_ARGUMENT_NOT_INT);
+            return JS_FALSE;
+        }
+        if (JSVAL_TO_INT(argv[1]) < 1 ||
+            JSVAL_TO_INT(argv[1]) > SERIAL_BUFFER_MAX / 2)
+        {
+            JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                                 PSMSG_ARGUMENT_OUT_OF_RANGE);
+            return JS_FALSE;
+        }
+    }
+    else {
+        if (JS_TypeOfValue(cx, argv[1]) != JSTYPE_STRING) {
+            JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                                 PSMSG_ARGUMENT_NOT_STRING);
+            return JS_FALSE;
+        }
+        str = JSVAL_TO_STRING(argv[1]);
+        if (JSSTRING_LENGTH(str) == 0) {
+            JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                                 PSMSG_ARGUMENT_OUT_OF_RANGE);
+            return JS_FALSE;
+        }
+    }
+    if (argc > 2 && !JSVAL_IS_VOID(argv[2])) {
+        if (!JSVAL_IS_INT(argv[2])) {
+            JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                                 PSMSG_ARGUMENT_NOT_INT);
+            return JS_FALSE;
+        }
+        timeout = JSVAL_TO_INT(argv[2]);
+    }
+
+    /*
+     * Bail out if a request is outstanding already.
+     */
+    if (ser->request != SERIALREQUEST_NONE) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_FAILED, "request outstanding");
+        return JS_FALSE;
+    }
+
+    /*
+     * Send the data. The request is blocking if there is no onData callback.
+     */
+    blocking = !JSVAL_IS_FUNCTION(cx, ser->onData);
+    if (!Serial_Write(cx, obj, ser, argv[0], blocking)) {
+        return JS_FALSE;
+    }
+
+    /*
+     * Set up the request.
+     */
+    ser->request = request;
+    if (request == SERIALREQUEST_RECEIVE) {
+        ser->count = JSVAL_TO_INT(argv[1]);
+    }
+    else {
+        const jschar* chars = JSSTRING_CHARS(str);
+        ser->termlength = JSSTRING_LENGTH(str);
+        ser->terminator = (char*) JS_malloc(cx, ser->termlength);
+        if (!ser->terminator) {
+            Serial_EndRequest(cx, ser);
+            return JS_FALSE;
+        }
+        for (size_t i = 0; i < ser->termlength; ++i) {
+            ser->terminator[i] = (char) chars[i];
+        }
+    }
+
+    /*
+     * An asynchronous request is handled by the select callback, or by the
+     * timer if it expires first.
+     */
+    if (!blocking) {
+        if (timeout >= 0) {
+            ser->timer = ps_AddTimer(cx, obj, &Serial_TimeoutCallback,
+                                     timeout);
+            if (!ser->timer) {
+                Serial_EndRequest(cx, ser);
+                JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                                     PSMSG_FAILED, "timer setup");
+                return JS_FALSE;
+            }
+        }
+        return Serial_Update(cx, obj, ser);
+    }
+
+    /*
+     * A blocking request reads until it is satisfied, or until the timeout
+     * expires.
+     */
+    if (timeout >= 0) {
+        deadline = Serial_Now() + timeout;
+    }
+    while ((ready = Serial_RxReady(ser)) == 0) {
+        if (timeout >= 0) {
+            remaining = (int) (deadline - Serial_Now());
+            if (remaining <= 0) {
+                ready = ser->rxlength;
+                break;
+            }
+        }
+        else {
+            remaining = -1;
+        }
+        if (Serial_Wait(ser, POLLIN, remaining) < 0 ||
+            Serial_RxFill(ser) < 0)
+        {
+            Serial_EndRequest(cx, ser);
+            JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                                 PSMSG_FAILED, strerror(errno));
+            return JS_FALSE;
+        }
+    }
+    Serial_EndRequest(cx, ser);
+    str = Serial_RxTake(cx, ser, ready);
+    if (!str) {
+        return JS_FALSE;
+    }
+    *rval = STRING_TO_JSVAL(str);
+    return JS_TRUE;
+}
+
+/**
+ * Synopsis:
+ *      Serial([path])
+ * Purpose:
+ *      Open a serial port.
+ * Parameters:
+ *      path    String (opt)
+ *          The path of the terminal device, for example "/dev/ttyUSB0". If
+ *          omitted, a new pseudo-terminal is opened, which stands in for the
+ *          device that is attached to a serial port. Its path property holds
+ *          the path of the serial port to open.
+ * Returns:
+ *      A new Serial instance.
+ * Exceptions:
+ *      Argument is not a string
+ *      Failed
+ * Additional Information:
+ *      The port is set to 9600 bit/s, 8 data bits, no parity and 1 stop bit,
+ *      until the line settings are changed. The port is kept open until it is
+ *      closed.
+ */
+static JSBool
+Serial_CT(JSContext* cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
+{
+    JSBool ok = JS_TRUE;
+    Serial* ser = NULL;
+    const char* path = NULL;
+#ifdef HAVE_OPENPTY
+    int flags;
+#endif
+
+    if (argc > 0 && !JSVAL_IS_VOID(argv[0])) {
+        if (JS_TypeOfValue(cx, argv[0]) != JSTYPE_STRING) {
+            JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                                 PSMSG_ARGUMENT_NOT_STRING);
+            return JS_FALSE;
+        }
+        path = JS_GetStringBytes(JSVAL_TO_STRING(argv[0]));
+    }
+
+    /* Create the object */
+    if (!obj) {
+        obj = js_NewObject(cx, &serial_class, NULL, NULL);
+        if (!obj) {
+            return JS_FALSE;
+        }
+    }
+
+    /* Set the private instance state object, which closes the terminal when
+     * the instance is finalized. */
+    ser = Serial_New(cx);
+    if (!ser) {
+        return JS_FALSE;
+    }
+    JS_LOCK_OBJ(cx, obj);
+    ok = JS_SetPrivate(cx, obj, ser);
+    JS_UNLOCK_OBJ(cx, obj);
+    if (!ok) {
+        Serial_Delete(cx, ser);
+        return JS_FALSE;
+    }
+
+    /*
+     * Open the terminal device, or a new pseudo-terminal.
+     */
+    if (path) {
+        ser->fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+        if (ser->fd < 0) {
+            JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                                 PSMSG_FAILED, strerror(errno));
+            return JS_FALSE;
+        }
+        if (!isatty(ser->fd)) {
+            Serial_Shutdown(cx, ser);
+            JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                                 PSMSG_FAILED, "not a terminal");
+            return JS_FALSE;
+        }
+        ser->pty = Serial_IsPseudoTerminal(ser->fd);
+    }
+    else {
+#ifdef HAVE_OPENPTY
+        /* The slave side is kept open, so that the pseudo-terminal is not
+         * hung up while the serial port is closed. */
+        if (openpty(&ser->fd, &ser->peer, NULL, NULL, NULL) < 0) {
+            JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                                 PSMSG_FAILED, strerror(errno));
+            return JS_FALSE;
+        }
+        path = ttyname(ser->peer);
+        if ((flags = fcntl(ser->fd, F_GETFL, 0)) < 0 ||
+            fcntl(ser->fd, F_SETFL, flags | O_NONBLOCK) < 0 ||
+            fcntl(ser->fd, F_SETFD, FD_CLOEXEC) < 0 ||
+            fcntl(ser->peer, F_SETFD, FD_CLOEXEC) < 0 || !path)
+        {
+            Serial_Shutdown(cx, ser);
+            JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                                 PSMSG_FAILED, strerror(errno));
+            return JS_FALSE;
+        }
+        ser->pty = JS_TRUE;
+#else
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_FAILED, "pseudo-terminals not supported");
+        return JS_FALSE;
+#endif
+    }
+    ser->path = JS_strdup(cx, path);
+    if (!ser->path || !Serial_Configure(cx, ser)) {
+        Serial_Shutdown(cx, ser);
+        return JS_FALSE;
+    }
+
+    /* Add the terminal to the asynchroneous select mechanism. The instance
+     * is kept alive until it is closed. */
+    ser->self = obj;
+    if (!JS_AddNamedRoot(cx, &ser->self, "Serial.self")) {
+        ser->self = NULL;
+        Serial_Shutdown(cx, ser);
+        return JS_FALSE;
+    }
+    if (!Serial_Update(cx, obj, ser)) {
+        Serial_Shutdown(cx, ser);
+        return JS_FALSE;
+    }
+    return JS_TRUE;
+}
+
+/**
+ * Destructor.
+ */
+static void
+Serial_DT(JSContext* cx, JSObject *obj)
+{
+    Serial* ser = NULL;
+    ser = (Serial*)JS_GetInstancePrivate(cx, obj, &serial_class, NULL);
+    if (ser) {
+        Serial_Delete(cx, ser);
+    }
+}
+
+/**
+ * Mark the callback functions, which are only referenced from the private
+ * instance data.
+ */
+static uint32
+Serial_Mark(JSContext* cx, JSObject *obj, void *arg)
+{
+    Serial* ser = NULL;
+
+    ser = (Serial*)JS_GetInstancePrivate(cx, obj, &serial_class, NULL);
+    if (ser) {
+        if (JSVAL_IS_GCTHING(ser->onData)) {
+            JS_MarkGCThing(cx, JSVAL_TO_GCTHING(ser->onData),
+                           "Serial callback", arg);
+        }
+        if (JSVAL_IS_GCTHING(ser->onError)) {
+            JS_MarkGCThing(cx, JSVAL_TO_GCTHING(ser->onError),
+                           "Serial callback", arg);
+        }
+        if (JSVAL_IS_GCTHING(ser->onTimeout)) {
+            JS_MarkGCThing(cx, JSVAL_TO_GCTHING(ser->onTimeout),
+                           "Serial callback", arg);
+        }
+    }
+    return 0;
+}
+
+/**
+ * Synopsis:
+ *      send(s)
+ * Purpose:
+ *      Send data over the serial port.
+ * Parameters:
+ *      s       String or ByteBuffer
+ *          The data to send. Each character of a string is sent as a byte.
+ * Exceptions:
+ *      Not enough arguments specified
+ *      Argument is not a string
+ *      Failed
+ * Additional Information:
+ *      Without an onData callback, send() blocks until all of the data has
+ *      been sent. Otherwise the data that cannot be sent right away is queued
+ *      and sent asynchronously.
+ */
+static JSBool
+Serial_Send(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
+            jsval *rval)
+{
+    Serial* ser = NULL;
+
+    ser = (Serial*) JS_GetPrivate(cx, obj);
+    if (!ser) {
+        return JS_FALSE;
+    }
+    if (argc < 1) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_NOT_ENOUGH_ARGUMENTS);
+        return JS_FALSE;
+    }
+    return Serial_Write(cx, obj, ser, argv[0],
+                        !JSVAL_IS_FUNCTION(cx, ser->onData));
+}
+
+/**
+ * Synopsis:
+ *      receive(s, count[, timeout])
+ * Purpose:
+ *      Send data, and receive a number of bytes.
+ * Parameters:
+ *      s       String or ByteBuffer
+ *          The data to send, which may be empty.
+ *      count   Integer
+ *          The number of bytes to receive.
+ *      timeout Integer (opt)
+ *          The maximum time to wait in milliseconds. If omitted, wait
+ *          indefinitely.
+ * Returns:
+ *      The received data, or the data received so far if the timeout
+ *      expired, if there is no onData callback. Otherwise nothing.
+ * Exceptions:
+ *      Not enough arguments specified
+ *      Argument is not a string
+ *      Argument is not an integer
+ *      Argument out of range
+ *      Failed
+ * Additional Information:
+ *      With an onData callback, receive() returns immediately. The onData
+ *      callback is called with the data once it has been received, or the
+ *      onTimeout callback with the data received so far once the timeout
+ *      expires.
+ */
+static JSBool
+Serial_Receive(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
+               jsval *rval)
+{
+    Serial* ser = NULL;
+
+    ser = (Serial*) JS_GetPrivate(cx, obj);
+    if (!ser) {
+        return JS_FALSE;
+    }
+    return Serial_Request(cx, obj, ser, SERIALREQUEST_RECEIVE, argc, argv,
+                          rval);
+}
+
+/**
+ * Synopsis:
+ *      match(s, terminator[, timeout])
+ * Purpose:
+ *      Send data, and receive up to and including a terminator.
+ * Parameters:
+ *      s           String or ByteBuffer
+ *          The data to send, which may be empty.
+ *      terminator  String
+ *          The string that ends the data to receive, for example "\r".
+ *      timeout     Integer (opt)
+ *          The maximum time to wait in milliseconds. If omitted, wait
+ *          indefinitely.
+ * Returns:
+ *      The received data, or the data received so far if the timeout
+ *      expired, if there is no onData callback. Otherwise nothing.
+ * Exceptions:
+ *      Not enough arguments specified
+ *      Argument is not a string
+ *      Argument is not an integer
+ *      Argument out of range
+ *      Failed
+ * Additional Information:
+ *      With an onData callback, match() returns immediately. The onData
+ *      callback is called with the data once the terminator has been
+ *      received, or the onTimeout callback with the data received so far
+ *      once the timeout expires.
+ */
+static JSBool
+Serial_Match(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
+             jsval *rval)
+{
+    Serial* ser = NULL;
+
+    ser = (Serial*) JS_GetPrivate(cx, obj);
+    if (!ser) {
+        return JS_FALSE;
+    }
+    return Serial_Request(cx, obj, ser, SERIALREQUEST_MATCH, argc, argv,
+                          rval);
+}
+
+/**
+ * Synopsis:
+ *      close()
+ * Purpose:
+ *      Close the serial port. Any data still queued to be sent is dropped.
+ * Parameters:
+ *      None
+ */
+static JSBool
+Serial_Close(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
+             jsval *rval)
+{
+    Serial* ser = NULL;
+
+    ser = (Serial*) JS_GetPrivate(cx, obj);
+    if (!ser) {
+        return JS_FALSE;
+    }
+    Serial_Shutdown(cx, ser);
+    return JS_TRUE;
+}
+
+/**
+ * Serial class initialiser.
+ */
+JSObject*
+ps_InitSerialClass(JSContext *cx, JSObject *obj)
+{
+    JSObject *proto;
+
+    proto = JS_InitClass(cx, obj, NULL, &serial_class, Serial_CT, 0,
+                         serial_props, serial_methods, NULL, NULL);
+    if (!proto) {
+        return NULL;
+    }
+    return proto;
+}
@@ -37,14 +37,315 @@
 
 #include "jsapi.h"
 #include "jscntxt.h"
+#include "jshash.h"
+#include "jsprf.h"
 #include "jsstr.h"
+#include "jsxdrapi.h"
+#include "psscriptcache.h"
 #include "pssystem.h"
+#include <limits.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
-#include <sys/stat.h>
+#include <unistd.h>
 
 extern FILE *gOutFile;
 
+/*
+ * A module included with System.include. A module is registered under its
+ * canonical path, and under each of the names it has been included by.
+ */
+typedef struct {
+    char* path;             /* The canonical path of the module. */
+    JSBool loaded;          /* True once the module has been executed. */
+} PSModule;
+
+/* The initial size of the module tables. */
+#define PS_MODULE_TABLE_SIZE 64
+
+static JSHashTable* ps_ModuleNames = NULL;
+static JSHashTable* ps_ModulePaths = NULL;
+static char** ps_ModuleSearchPaths = NULL;
+static int ps_ModuleSearchPathCount = 0;
+
+static intN
+System_CompareNames(const void *v1, const void *v2)
+{
+    return strcmp((const char*) v1, (const char*) v2) == 0;
+}
+
+JSBool
+ps_AddModulePath(const char *paths)
+{
+    const char* end;
+    char** list;
+    size_t length;
+
+    /* Append each of the colon separated directories to the search paths. */
+    while (*paths) {
+        end = strchr(paths, ':');
+        length = end ? (size_t) (end - paths) : strlen(paths);
+        if (length > 0) {
+            list = (char**) realloc(ps_ModuleSearchPaths,
+                                    (ps_ModuleSearchPathCount + 1) *
+                                    sizeof(char*));
+            if (!list) {
+                return JS_FALSE;
+            }
+            ps_ModuleSearchPaths = list;
+            list[ps_ModuleSearchPathCount] = strndup(paths, length);
+            if (!list[ps_ModuleSearchPathCount]) {
+                return JS_FALSE;
+            }
+            ++ps_ModuleSearchPathCount;
+        }
+        paths += length;
+        if (*paths == ':') {
+            ++paths;
+        }
+    }
+    return JS_TRUE;
+}
+
+/*
+ * Get the canonical path of a module, located either in the current working
+ * directory or in one of the module search paths. Returns NULL if the module
+ * cannot be found.
+ */
+static char*
+System_Locate(const char* name)
+{
+    char* candidate;
+    char* path;
+
+    path = realpath(name, NULL);
+    if (path || name[0] == '/') {
+        return path;
+    }
+    for (int i = 0; i < ps_ModuleSearchPathCount; ++i) {
+        candidate = JS_smprintf("%s/%s", ps_ModuleSearchPaths[i], name);
+        if (!candidate) {
+            return NULL;
+        }
+        path = realpath(candidate, NULL);
+        JS_smprintf_free(candidate);
+        if (path) {
+            return path;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Create the module tables. Returns JS_FALSE, with the error reported, if out
+ * of memory.
+ */
+static JSBool
+System_InitModules(JSContext* cx)
+{
+    if (!ps_ModuleNames) {
+        ps_ModuleNames = JS_NewHashTable(PS_MODULE_TABLE_SIZE, JS_HashString,
+                                         System_CompareNames, JS_CompareValues,
+                                         NULL, NULL);
+        ps_ModulePaths = JS_NewHashTable(PS_MODULE_TABLE_SIZE, JS_HashString,
+                                         System_CompareNames, JS_CompareValues,
+                                         NULL, NULL);
+        if (!ps_ModuleNames || !ps_ModulePaths) {
+            JS_ReportOutOfMemory(cx);
+            return JS_FALSE;
+        }
+    }
+    return JS_TRUE;
+}
+
+/*
+ * Register a name of the module at a canonical path, which may have been
+ * registered already under a different name. The path is owned by the
+ * registry. Returns NULL, with the error reported, if out of memory.
+ */
+static PSModule*
+System_Register(JSContext* cx, const char* name, char* path)
+{
+    PSModule* module;
+    char* key;
+
+    module = (PSModule*) JS_HashTableLookup(ps_ModulePaths, path);
+    if (module) {
+        free(path);
+    }
+    else {
+        module = (PSModule*) malloc(sizeof(PSModule));
+        if (!module) {
+            free(path);
+            JS_ReportOutOfMemory(cx);
+            return NULL;
+        }
+        module->path = path;
+        module->loaded = JS_FALSE;
+        if (!JS_HashTableAdd(ps_ModulePaths, module->path, module)) {
+            free(module->path);
+            free(module);
+            JS_ReportOutOfMemory(cx);
+            return NULL;
+        }
+    }
+    key = strdup(name);
+    if (!key || !JS_HashTableAdd(ps_ModuleNames, key, module)) {
+        free(key);
+        JS_ReportOutOfMemory(cx);
+        return NULL;
+    }
+    return module;
+}
+
+/*
+ * Get the module included by a name. A name is only located once, after
+ * which the module is looked up by that name.
+ */
+static PSModule*
+System_Resolve(JSContext* cx, const char* name)
+{
+    PSModule* module;
+    char* path;
+
+    if (!System_InitModules(cx)) {
+        return NULL;
+    }
+    module = (PSModule*) JS_HashTableLookup(ps_ModuleNames, name);
+    if (module) {
+        return module;
+    }
+    path = System_Locate(name);
+    if (!path) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_INVALID_NAME);
+        return NULL;
+    }
+    return System_Register(cx, name, path);
+}
+
+/*
+ * Forget a relative module name, freeing the name.
+ */
+static intN
+System_ForgetRelativeName(JSHashEntry *he, intN i, void *arg)
+{
+    char* name = (char*) he->key;
+
+    if (name[0] == '/') {
+        return HT_ENUMERATE_NEXT;
+    }
+    free(name);
+    return HT_ENUMERATE_REMOVE;
+}
+
+void
+ps_ForgetRelativeModuleNames(void)
+{
+    /* The modules themselves are kept, so that a module located again at the
+     * same path is not executed again. */
+    if (ps_ModuleNames) {
+        (void) JS_HashTableEnumerateEntries(ps_ModuleNames,
+                                            System_ForgetRelativeName, NULL);
+    }
+}
+
+/*
+ * Encode or decode a string that is known in advance. A decoded string is
+ * checked against it, and JS_FALSE returned if it does not match.
+ */
+static JSBool
+System_XDRKnownString(JSXDRState* xdr, const char* known)
+{
+    char* str = (char*) known;
+    JSBool ok;
+
+    if (!JS_XDRCString(xdr, &str)) {
+        return JS_FALSE;
+    }
+    if (xdr->mode == JSXDR_DECODE) {
+        ok = strcmp(str, known) == 0;
+        JS_free(xdr->cx, str);
+        return ok;
+    }
+    return JS_TRUE;
+}
+
+/*
+ * Encode a registered module name and the canonical path of its module.
+ */
+static intN
+System_XDRModuleName(JSHashEntry *he, intN i, void *arg)
+{
+    JSXDRState* xdr = (JSXDRState*) arg;
+    char* name = (char*) he->key;
+    char* path = ((PSModule*) he->value)->path;
+
+    if (!JS_XDRCString(xdr, &name) || !JS_XDRCString(xdr, &path)) {
+        return HT_ENUMERATE_STOP;
+    }
+    return HT_ENUMERATE_NEXT;
+}
+
+JSBool
+ps_XDRModules(JSXDRState *xdr)
+{
+    JSContext* cx = xdr->cx;
+    char cwd[PATH_MAX];
+    char* name;
+    char* path;
+    uint32 count;
+
+    /* The names are located relative to the current working directory and
+     * the search paths, which are to be the same when decoded. */
+    if (!getcwd(cwd, sizeof(cwd)) || !System_XDRKnownString(xdr, cwd)) {
+        return JS_FALSE;
+    }
+    count = (uint32) ps_ModuleSearchPathCount;
+    if (!JS_XDRUint32(xdr, &count) ||
+        count != (uint32) ps_ModuleSearchPathCount)
+    {
+        return JS_FALSE;
+    }
+    for (int i = 0; i < ps_ModuleSearchPathCount; ++i) {
+        if (!System_XDRKnownString(xdr, ps_ModuleSearchPaths[i])) {
+            return JS_FALSE;
+        }
+    }
+
+    if (!System_InitModules(cx)) {
+        return JS_FALSE;
+    }
+    if (xdr->mode == JSXDR_ENCODE) {
+        count = ps_ModuleNames->nentries;
+        return JS_XDRUint32(xdr, &count) &&
+               JS_HashTableEnumerateEntries(ps_ModuleNames,
+                                            System_XDRModuleName, xdr) ==
+               (intN) count;
+    }
+    if (!JS_XDRUint32(xdr, &count)) {
+        return JS_FALSE;
+    }
+    for (uint32 i = 0; i < count; ++i) {
+        name = NULL;
+        path = NULL;
+        if (!JS_XDRCString(xdr, &name) || !JS_XDRCString(xdr, &path)) {
+            JS_free(cx, name);
+            return JS_FALSE;
+        }
+        if (!JS_HashTableLookup(ps_ModuleNames, name) &&
+            !System_Register(cx, name, strdup(path)))
+        {
+            JS_free(cx, name);
+            JS_free(cx, path);
+            return JS_FALSE;
+        }
+        JS_free(cx, name);
+        JS_free(cx, path);
+    }
+    return JS_TRUE;
+}
+
 /**
  * Synopsis:
  *      System.include(name)
@@ -58,48 +359,53 @@ extern FILE *gOutFile;
  * Exceptions:
  *      No argument specified
  *      Invalid name
+ * Additional Information:
+ *      A library script is only executed the first time it is included, also
+ *      when it is included again by a different name. It is located in the
+ *      current working directory, or else in the module search paths in the
+ *      order they have been given.
  */
 static JSBool
 System_Include(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
                jsval *rval)
 {
-    /* Access the (formerly static) 'Process' function from 'js.c' to execute
-     * the specified file and the module path. */
-    extern void Process(JSContext*, JSObject*, char*);
-    extern const char* gModulePath;
-
     JSString* str;
-    char* name;
-    struct stat statbuf;
-    char path[255];
+    JSScript* script;
+    PSModule* module;
+    jsval result;
 
     /* Get the filename */
     str = JS_ValueToString(cx, argv[0]);
-    name = js_GetStringBytes(str);
-
-    /* Locate the file, either in current working directory or in the module
-     * path. */
-    strlcpy(path, name, sizeof(path));
-    if (stat(path, &statbuf) != 0) {
-        if (gModulePath != NULL) {
-            strlcpy(path, gModulePath, sizeof(path));
-            strlcat(path, "/", sizeof(path));
-            strlcat(path, name, sizeof(path));
-            if (stat(path, &statbuf) != 0) {
-                JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
-                                     PSMSG_INVALID_NAME);
-                return JS_FALSE;
-            }
-        }
-        else {
-            JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
-                                 PSMSG_INVALID_NAME);
-            return JS_FALSE;
-        }
+    if (!str) {
+        return JS_FALSE;
     }
 
-    /* Execute the script with the global object scope. */
-    Process(cx, cx->globalObject,  path);
+    /* Restore the snapshot of the modules and their compiled scripts on the
+     * first include. */
+    ps_RestoreSnapshot(cx);
+
+    /* Nothing is to be done when the module has been included already.
+     * Otherwise it is marked as included before it is executed, so that a
+     * module including itself, directly or indirectly, is not executed
+     * again. */
+    module = System_Resolve(cx, js_GetStringBytes(str));
+    if (!module) {
+        return JS_FALSE;
+    }
+    if (module->loaded) {
+        return JS_TRUE;
+    }
+    module->loaded = JS_TRUE;
+
+    /* Execute the script with the global object scope. The compiled script is
+     * cached, and only compiled again when the file has been modified. */
+    script = ps_CompileFileCached(cx, cx->globalObject, module->path);
+    if (!script ||
+        !JS_ExecuteScript(cx, cx->globalObject, script, &result))
+    {
+        module->loaded = JS_FALSE;
+        return JS_FALSE;
+    }
     return JS_TRUE;
 }
 
@@ -51,6 +51,22 @@ JS_BEGIN_EXTERN_C
 extern JSObject *
 ps_InitSystemClass(JSContext *cx, JSObject *obj);
 
+/* Add colon separated directories to the paths searched for the scripts
+ * included with System.include. Returns JS_FALSE if out of memory. */
+extern JSBool
+ps_AddModulePath(const char *paths);
+
+/* Forget the relative module names, so that they are located again once the
+ * working directory has changed. */
+extern void
+ps_ForgetRelativeModuleNames(void);
+
+/* Encode the registered module names, or decode and register them. Returns
+ * JS_FALSE if the names were registered with a different working directory
+ * or different search paths. */
+extern JSBool
+ps_XDRModules(JSXDRState *xdr);
+
 JS_END_EXTERN_C
 
 #endif /* pssystem_h___ */
@@ -0,0 +1,715 @@
+/*
+ * ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is the ProntoScript re-implementation October 4, 2025.
+ *
+ * The Initial Developer of the Original Code is Stefan Sinnige.
+ * Portions created by the Initial Developer are Copyright (C) 2025
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either of the GNU General Public License Version 2 or later (the "GPL"),
+ * or the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK *****
+ */
+
+/* Required for accept4. */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "jsapi.h"
+#include "jscntxt.h"
+#include "jsfun.h"
+#include "jslock.h"
+#include "jstypes.h"
+#include "psselect.h"
+#include "pstcpserver.h"
+#include "pstcpsocket.h"
+#include <errno.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ *Forward declarations
+ */
+static JSBool TCPServer_GetProperty(JSContext*, JSObject*, jsval, jsval*);
+static JSBool TCPServer_SetProperty(JSContext*, JSObject*, jsval, jsval*);
+static JSBool TCPServer_Listen(JSContext*, JSObject*, uintN, jsval*, jsval*);
+static JSBool TCPServer_Close(JSContext*, JSObject*, uintN, jsval*, jsval*);
+static JSBool TCPServer_CT(JSContext*, JSObject*, uintN, jsval*, jsval*);
+static void   TCPServer_DT(JSContext*, JSObject*);
+static uint32 TCPServer_Mark(JSContext*, JSObject*, void*);
+static void   TCPServer_SelectCallback(JSContext*, JSObject*);
+static void   TCPServer_SelectErrorCallback(JSContext*, JSObject*);
+static void   TCPServer_ResumeCallback(JSContext*, JSObject*);
+static JSBool TCPServer_Invoke(JSContext*, JSObject*, jsval, uintN, jsval*);
+
+/*
+ * The maximum number of connections accepted on a single trigger of the
+ * listening socket. Any connections left are accepted on the next pass, so
+ * that other events are not held up under a high connection rate.
+ */
+#define TCPSERVER_MAX_ACCEPT 64
+
+/*
+ * The delay in milliseconds before accepting again, once accepting has failed
+ * because the process or the system has run out of file descriptors.
+ */
+#define TCPSERVER_RESUME_DELAY 100
+
+/*
+ * The TCPServer class private instance data.
+ */
+
+typedef struct {
+    JSObject* self;         /* The instance, rooted while listening. */
+    jsval onAccept;         /* The on-accept callback function. */
+    jsval onIOError;        /* The on-error callback function. */
+    JSBool reusePort;       /* True if the port may be shared. */
+    int fd;                 /* The listening socket descriptor, or -1. */
+    int port;               /* The local port listened on, or -1. */
+    PSSelectTimer* resume;  /* The timer to accept again, or NULL. */
+} TCPServer;
+
+/**
+ * Definition of the class properties
+ */
+enum tcpserver_tinyid {
+    TCPSERVER_LISTENING = -1,
+    TCPSERVER_PORT = -2,
+    TCPSERVER_REUSEPORT = -3,
+    TCPSERVER_ONACCEPT = -4,
+    TCPSERVER_ONIOERROR = -5
+};
+
+#define TCPSERVER_PROP_ATTRS (JSPROP_PERMANENT)
+
+static JSPropertySpec tcpserver_props[] = {
+    /* { name, tinyid, flags, getter, setter } */
+    {"listening", TCPSERVER_LISTENING, TCPSERVER_PROP_ATTRS | JSPROP_READONLY, 0, 0},
+    {"port", TCPSERVER_PORT, TCPSERVER_PROP_ATTRS | JSPROP_READONLY, 0, 0},
+    {"reusePort", TCPSERVER_REUSEPORT, TCPSERVER_PROP_ATTRS , 0, 0},
+    {"onAccept", TCPSERVER_ONACCEPT, TCPSERVER_PROP_ATTRS , 0, 0},
+    {"onIOError", TCPSERVER_ONIOERROR, TCPSERVER_PROP_ATTRS , 0, 0},
+    {0, 0, 0, 0, 0}
+};
+
+/**
+ * Definition of the class methods
+ */
+static JSFunctionSpec tcpserver_methods[] = {
+    /* { name, call, nargs, flags, extra } */
+    {"listen", TCPServer_Listen, 0, 0, 0},
+    {"close", TCPServer_Close, 0, 0, 0},
+    {0, 0, 0, 0, 0}
+};
+
+/**
+ * Definition of the class
+ */
+static JSClass tcpserver_class = {
+    ps_TCPServer_str,               /* name */
+    JSCLASS_HAS_PRIVATE,            /* flags */
+    JS_PropertyStub,                /* add property */
+    JS_PropertyStub,                /* del property */
+    TCPServer_GetProperty,          /* get property */
+    TCPServer_SetProperty,          /* set property */
+    JS_EnumerateStub,               /* enumerate */
+    JS_ResolveStub,                 /* resolve */
+    JS_ConvertStub,                 /* convert */
+    TCPServer_DT,                   /* finalize */
+    NULL,                           /* get object ops */
+    NULL,                           /* check access */
+    NULL,                           /* call */
+    NULL,                           /* construct */
+    NULL,                           /* xdr object */
+    NULL,                           /* has instance */
+    TCPServer_Mark,                 /* mark */
+    0                               /* reserve slots */
+};
+
+/*
+ * Create and destroy the server instance.
+ */
+
+static TCPServer*
+TCPServer_New(JSContext *cx)
+{
+    TCPServer *srv = NULL;
+    srv = (TCPServer*) JS_malloc(cx, sizeof(TCPServer));
+    if (!srv) {
+        return NULL;
+    }
+    srv->self = NULL;
+    srv->onAccept = JSVAL_VOID;
+    srv->onIOError = JSVAL_VOID;
+    srv->reusePort = JS_FALSE;
+    srv->fd = -1;
+    srv->port = -1;
+    srv->resume = NULL;
+    return srv;
+}
+
+/*
+ * Stop listening, and unroot the instance.
+ */
+static void
+TCPServer_Shutdown(JSContext* cx, TCPServer* srv)
+{
+    if (srv->fd != -1) {
+        ps_RemoveSelect(cx, srv->fd);
+        (void) close(srv->fd);
+        srv->fd = -1;
+    }
+    if (srv->resume) {
+        ps_RemoveTimer(cx, srv->resume);
+        srv->resume = NULL;
+    }
+    srv->port = -1;
+    if (srv->self) {
+        JS_RemoveRoot(cx, &srv->self);
+        srv->self = NULL;
+    }
+}
+
+static void
+TCPServer_Delete(JSContext* cx, TCPServer* srv)
+{
+    TCPServer_Shutdown(cx, srv);
+    JS_free(cx, srv);
+}
+
+static JSBool
+TCPServer_GetProperty(JSContext *cx, JSObject *obj, jsval id, jsval *vp)
+{
+    TCPServer* srv = NULL;
+    jsint slot;
+
+    /* Get the property's slot */
+    if (!JSVAL_IS_INT(id)) {
+        return JS_TRUE;
+    }
+    slot = JSVAL_TO_INT(id);
+
+    /* Get the value */
+    JS_LOCK_OBJ(cx, obj);
+    srv = (TCPServer*)JS_GetInstancePrivate(cx, obj, &tcpserver_class, NULL);
+    if (srv) {
+        switch (slot) {
+            case TCPSERVER_LISTENING:
+                *vp = BOOLEAN_TO_JSVAL(srv->fd != -1);
+                break;
+            case TCPSERVER_PORT:
+                *vp = INT_TO_JSVAL(srv->port);
+                break;
+            case TCPSERVER_REUSEPORT:
+                *vp = BOOLEAN_TO_JSVAL(srv->reusePort);
+                break;
+            case TCPSERVER_ONACCEPT:
+                *vp = srv->onAccept;
+                break;
+            case TCPSERVER_ONIOERROR:
+                *vp = srv->onIOError;
+                break;
+            default:
+                break;
+        }
+    }
+    JS_UNLOCK_OBJ(cx, obj);
+    return JS_TRUE;
+}
+
+static JSBool
+TCPServer_SetProperty(JSContext *cx, JSObject *obj, jsval id, jsval *vp)
+{
+    TCPServer* srv = NULL;
+    jsint slot;
+
+    /* Get the property's slot */
+    if (!JSVAL_IS_INT(id)) {
+        return JS_TRUE;
+    }
+    slot = JSVAL_TO_INT(id);
+
+    /* Set the value */
+    JS_LOCK_OBJ(cx, obj);
+    srv = (TCPServer*)JS_GetInstancePrivate(cx, obj, &tcpserver_class, NULL);
+    switch (slot) {
+        case TCPSERVER_LISTENING:
+        case TCPSERVER_PORT:
+            break;
+        case TCPSERVER_REUSEPORT:
+            (void) JS_ValueToBoolean(cx, *vp, &srv->reusePort);
+            break;
+        case TCPSERVER_ONACCEPT:
+            if (JSVAL_IS_FUNCTION(cx, *vp)) {
+                srv->onAccept = *vp;
+            }
+            break;
+        case TCPSERVER_ONIOERROR:
+            if (JSVAL_IS_FUNCTION(cx, *vp)) {
+                srv->onIOError = *vp;
+            }
+            break;
+    }
+    JS_UNLOCK_OBJ(cx, obj);
+    return JS_TRUE;
+}
+
+/*
+ * Callback when the listening socket has been triggered. The pending
+ * connections are accepted in a batch and each is handed over to the onAccept
+ * callback as a connected asynchronous TCPSocket. Connections are closed
+ * right away if there is no onAccept callback.
+ */
+static void
+TCPServer_SelectCallback(JSContext *cx, JSObject *obj)
+{
+    TCPServer* srv = NULL;
+    JSObject* sock;
+    jsval argv[1];
+    int fd, error;
+
+    srv = (TCPServer*) JS_GetPrivate(cx, obj);
+    if (!srv) {
+        return;
+    }
+
+    for (int n = 0; n < TCPSERVER_MAX_ACCEPT && srv->fd != -1; ++n) {
+        fd = accept4(srv->fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            error = errno;
+            if (error == EINTR || error == ECONNABORTED || error == EPROTO) {
+                continue;
+            }
+            if (error != EAGAIN && error != EWOULDBLOCK &&
+                !JSVAL_IS_VOID(srv->onIOError))
+            {
+                JSString* data = JS_NewStringCopyZ(cx, strerror(error));
+                if (data) {
+                    argv[0] = STRING_TO_JSVAL(data);
+                    TCPServer_Invoke(cx, obj, srv->onIOError, 1, argv);
+                }
+            }
+
+            /* The pending connection stays readable until a descriptor is
+             * free, so the socket is not watched until a while later. */
+            if ((error == EMFILE || error == ENFILE) && srv->fd != -1 &&
+                !srv->resume)
+            {
+                srv->resume = ps_AddTimer(cx, obj, &TCPServer_ResumeCallback,
+                                          TCPSERVER_RESUME_DELAY);
+                if (srv->resume) {
+                    ps_RemoveSelect(cx, srv->fd);
+                }
+            }
+            break;
+        }
+        if (JSVAL_IS_VOID(srv->onAccept)) {
+            (void) close(fd);
+            continue;
+        }
+        sock = ps_NewTCPSocket(cx, fd);
+        if (!sock) {
+            break;
+        }
+        argv[0] = OBJECT_TO_JSVAL(sock);
+        TCPServer_Invoke(cx, obj, srv->onAccept, 1, argv);
+    }
+}
+
+/*
+ * Callback to watch the listening socket again, after accepting has run out
+ * of file descriptors.
+ */
+static void
+TCPServer_ResumeCallback(JSContext *cx, JSObject *obj)
+{
+    TCPServer* srv = NULL;
+
+    srv = (TCPServer*) JS_GetPrivate(cx, obj);
+    if (!srv) {
+        return;
+    }
+    srv->resume = NULL;
+    if (srv->fd != -1 &&
+        !ps_AddSelect(cx, srv->fd, PSFDSET_READ,
+                      obj, &TCPServer_SelectCallback,
+                      &TCPServer_SelectErrorCallback, -1))
+    {
+        TCPServer_Shutdown(cx, srv);
+        if (!JSVAL_IS_VOID(srv->onIOError)) {
+            TCPServer_Invoke(cx, obj, srv->onIOError, 0, NULL);
+        }
+    }
+}
+
+/*
+ * Callback when the listening socket has triggered an error.
+ */
+static void
+TCPServer_SelectErrorCallback(JSContext *cx, JSObject *obj)
+{
+    TCPServer* srv = NULL;
+
+    srv = (TCPServer*) JS_GetPrivate(cx, obj);
+    if (!srv) {
+        return;
+    }
+
+    /*
+     * Invoke the callback
+     */
+    if (!JSVAL_IS_VOID(srv->onIOError)) {
+        TCPServer_Invoke(cx, obj, srv->onIOError, 0, NULL);
+    }
+
+    /* Ensure to stop listening. */
+    TCPServer_Shutdown(cx, srv);
+}
+
+/*
+ * Invoke a callback function.
+ */
+static JSBool
+TCPServer_Invoke(JSContext *cx, JSObject *obj, jsval fun, uintN argc,
+                 jsval *argv)
+{
+    JSStackFrame* fp;
+    jsval *sp, *oldsp;
+    void *mark;
+    JSBool result;
+
+    /* Allocate call stack frame and push the function, object and argument */
+    sp = js_AllocStack(cx, 2 + argc, &mark);
+    if (!sp) {
+        return JS_FALSE;
+    }
+    *sp++ = fun;
+    *sp++ = OBJECT_TO_JSVAL(obj);
+    for (int i = 0; i < argc; ++i) {
+        *sp++ = argv[i];
+    }
+
+    /* Lift current frame and call */
+    fp = cx->fp;
+    oldsp = fp->sp;
+    fp->sp = sp;
+    result = js_Invoke(cx, argc, JSINVOKE_INTERNAL | JSINVOKE_SKIP_CALLER);
+
+    /* Pop the call stack frame */
+    fp->sp = oldsp;
+    js_FreeStack(cx, mark);
+    return result;
+}
+
+/**
+ * Synopsis:
+ *      TCPServer()
+ * Purpose:
+ *      Create a new TCPServer instance.
+ * Parameters:
+ *      None
+ * Returns:
+ *      A new TCPServer instance.
+ */
+static JSBool
+TCPServer_CT(JSContext* cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
+{
+    JSBool ok = JS_TRUE;
+    TCPServer* srv = NULL;
+
+    /* Create the object */
+    if (!obj) {
+        obj = js_NewObject(cx, &tcpserver_class, NULL, NULL);
+        if (!obj) {
+            return JS_FALSE;
+        }
+    }
+
+    /* Set the private instance state object */
+    srv = TCPServer_New(cx);
+    if (!srv) {
+        return JS_FALSE;
+    }
+    JS_LOCK_OBJ(cx, obj);
+    ok = JS_SetPrivate(cx, obj, srv);
+    JS_UNLOCK_OBJ(cx, obj);
+    if (!ok) {
+        JS_free(cx, srv);
+        return JS_FALSE;
+    }
+    return JS_TRUE;
+}
+
+/**
+ * Destructor.
+ */
+static void
+TCPServer_DT(JSContext* cx, JSObject *obj)
+{
+    TCPServer* srv = NULL;
+    srv = (TCPServer*)JS_GetInstancePrivate(cx, obj, &tcpserver_class, NULL);
+    if (srv) {
+        TCPServer_Delete(cx, srv);
+    }
+}
+
+/**
+ * Mark the callback functions, which are only referenced from the private
+ * instance data.
+ */
+static uint32
+TCPServer_Mark(JSContext* cx, JSObject *obj, void *arg)
+{
+    TCPServer* srv = NULL;
+
+    srv = (TCPServer*)JS_GetInstancePrivate(cx, obj, &tcpserver_class, NULL);
+    if (srv) {
+        if (JSVAL_IS_GCTHING(srv->onAccept)) {
+            JS_MarkGCThing(cx, JSVAL_TO_GCTHING(srv->onAccept),
+                           "TCPServer callback", arg);
+        }
+        if (JSVAL_IS_GCTHING(srv->onIOError)) {
+            JS_MarkGCThing(cx, JSVAL_TO_GCTHING(srv->onIOError),
+                           "TCPServer callback", arg);
+        }
+    }
+    return 0;
+}
+
+/**
+ * Synopsis:
+ *      listen(port[, ip[, backlog]])
+ * Purpose:
+ *      Listen for incoming connections. Each accepted connection is passed to
+ *      the onAccept callback as a connected TCPSocket.
+ * Parameter:
+ *      port    Integer
+ *          Port number to listen on, or 0 for any free port. The port property
+ *          holds the port listened on.
+ *      ip      String (opt)
+ *          IP address of the local interface to listen on. If omitted, listen
+ *          on all interfaces.
+ *      backlog Integer (opt)
+ *          Maximum number of pending connections.
+ * Exceptions:
+ *      Not enough arguments specified
+ *      Argument is not a string
+ *      Argument is not an integer
+ *      Argument out of range
+ *      Address already in use
+ *      Socket error
+ *      Failed
+ * Additional Information:
+ *      When the reusePort property is set before listening, several servers
+ *      (typically in different processes) may listen on the same port, with
+ *      the incoming connections distributed between them.
+ */
+static JSBool
+TCPServer_Listen(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
+                 jsval *rval)
+{
+    TCPServer* srv = NULL;
+    struct sockaddr_in addr;
+    socklen_t len;
+    int backlog = SOMAXCONN;
+    int port;
+    int on = 1;
+
+    srv = (TCPServer*) JS_GetPrivate(cx, obj);
+    if (!srv) {
+        return JS_FALSE;
+    }
+
+    /*
+     * Extract the port, address and backlog.
+     */
+    memset(&addr, 0, sizeof(struct sockaddr_in));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (argc < 1) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_NOT_ENOUGH_ARGUMENTS);
+        return JS_FALSE;
+    }
+    if (!JSVAL_IS_INT(argv[0])) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_ARGUMENT_NOT_INT);
+        return JS_FALSE;
+    }
+    port = JSVAL_TO_INT(argv[0]);
+    if (port < 0 || port > 65535) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_ARGUMENT_OUT_OF_RANGE);
+        return JS_FALSE;
+    }
+    addr.sin_port = htons(port);
+    if (argc > 1 && !JSVAL_IS_VOID(argv[1])) {
+        if (JS_TypeOfValue(cx, argv[1]) != JSTYPE_STRING) {
+            JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                                 PSMSG_ARGUMENT_NOT_STRING);
+            return JS_FALSE;
+        }
+        if (inet_pton(AF_INET, JS_GetStringBytes(JSVAL_TO_STRING(argv[1])),
+                      &addr.sin_addr) != 1)
+        {
+            JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                                 PSMSG_FAILED, "invalid address");
+            return JS_FALSE;
+        }
+    }
+    if (argc > 2) {
+        if (!JSVAL_IS_INT(argv[2])) {
+            JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                                 PSMSG_ARGUMENT_NOT_INT);
+            return JS_FALSE;
+        }
+        backlog = JSVAL_TO_INT(argv[2]);
+    }
+
+    /*
+     * Bail out if already listening.
+     */
+    if (srv->fd != -1) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_FAILED, "already listening");
+        return JS_FALSE;
+    }
+
+    /*
+     * Create the non-blocking listening socket.
+     */
+    srv->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (srv->fd < 0) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL, PSMSG_SOCKET_ERROR);
+        return JS_FALSE;
+    }
+    if (setsockopt(srv->fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) < 0) {
+        TCPServer_Shutdown(cx, srv);
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL, PSMSG_SOCKET_ERROR);
+        return JS_FALSE;
+    }
+#ifdef SO_REUSEPORT
+    if (srv->reusePort &&
+        setsockopt(srv->fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0)
+    {
+        TCPServer_Shutdown(cx, srv);
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL, PSMSG_SOCKET_ERROR);
+        return JS_FALSE;
+    }
+#endif
+
+    /*
+     * Bind and listen.
+     */
+    if (bind(srv->fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        int error = errno;
+        TCPServer_Shutdown(cx, srv);
+        if (error == EADDRINUSE) {
+            JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                                 PSMSG_ADDRESS_IN_USE);
+        }
+        else {
+            JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                                 PSMSG_FAILED, strerror(error));
+        }
+        return JS_FALSE;
+    }
+    if (listen(srv->fd, backlog) < 0) {
+        TCPServer_Shutdown(cx, srv);
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL, PSMSG_SOCKET_ERROR);
+        return JS_FALSE;
+    }
+    len = sizeof(addr);
+    if (getsockname(srv->fd, (struct sockaddr*)&addr, &len) == 0) {
+        srv->port = ntohs(addr.sin_port);
+    }
+
+    /*
+     * Add the socket to the asynchroneous select mechanism, keeping the
+     * instance alive while listening.
+     */
+    srv->self = obj;
+    if (!JS_AddNamedRoot(cx, &srv->self, "TCPServer.self")) {
+        srv->self = NULL;
+        TCPServer_Shutdown(cx, srv);
+        return JS_FALSE;
+    }
+    if (!ps_AddSelect(cx, srv->fd, PSFDSET_READ,
+                      obj, &TCPServer_SelectCallback,
+                      &TCPServer_SelectErrorCallback, -1))
+    {
+        TCPServer_Shutdown(cx, srv);
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_FAILED, "asynchronous socket setup");
+        return JS_FALSE;
+    }
+    return JS_TRUE;
+}
+
+/**
+ * Synopsis:
+ *      close()
+ * Purpose:
+ *      Stop listening for incoming connections. The connections that have
+ *      been accepted already are not affected.
+ * Parameters:
+ *      None
+ */
+static JSBool
+TCPServer_Close(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
+                jsval *rval)
+{
+    TCPServer* srv = NULL;
+
+    srv = (TCPServer*) JS_GetPrivate(cx, obj);
+    if (!srv) {
+        return JS_FALSE;
+    }
+    TCPServer_Shutdown(cx, srv);
+    return JS_TRUE;
+}
+
+/**
+ * TCPServer class initialiser.
+ */
+JSObject*
+ps_InitTCPServerClass(JSContext *cx, JSObject *obj)
+{
+    JSObject *proto;
+
+    proto = JS_InitClass(cx, obj, NULL, &tcpserver_class, TCPServer_CT, 0,
+                         tcpserver_props, tcpserver_methods, NULL, NULL);
+    if (!proto) {
+        return NULL;
+    }
+    return proto;
+}
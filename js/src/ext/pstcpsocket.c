@@ -40,16 +40,28 @@
 #include "jsfun.h"
 #include "jslock.h"
 #include "jstypes.h"
+#include "psbytebuffer.h"
+#include "psdnsresolver.h"
 #include "psselect.h"
 #include "pstcpsocket.h"
 #include <errno.h>
 #include <fcntl.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+#ifdef HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#endif
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stddef.h>
 #include <string.h>
-#include <netdb.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <stdio.h>
@@ -63,10 +75,16 @@ static JSBool TCPSocket_Connect(JSContext*, JSObject*, uintN, jsval*, jsval*);
 static JSBool TCPSocket_Close(JSContext*, JSObject*, uintN, jsval*, jsval*);
 static JSBool TCPSocket_Read(JSContext*, JSObject*, uintN, jsval*, jsval*);
 static JSBool TCPSocket_Write(JSContext*, JSObject*, uintN, jsval*, jsval*);
+static JSBool TCPSocket_SendFile(JSContext*, JSObject*, uintN, jsval*, jsval*);
 static JSBool TCPSocket_CT(JSContext*, JSObject*, uintN, jsval*, jsval*);
 static void   TCPSocket_DT(JSContext*, JSObject*);
+static uint32 TCPSocket_Mark(JSContext*, JSObject*, void*);
 static void   TCPSocket_SelectCallback(JSContext*, JSObject*);
 static void   TCPSocket_SelectErrorCallback(JSContext*, JSObject*);
+static void   TCPSocket_AttemptCallback(JSContext*, JSObject*);
+static void   TCPSocket_AttemptTimeout(JSContext*, JSObject*);
+static void   TCPSocket_ResolveCallback(JSContext*, JSObject*, const char*,
+                                        const PSAddressList*, const char*);
 static JSBool TCPSocket_Invoke(JSContext*, JSObject*, jsval, uintN, jsval*);
 
 /*
@@ -75,20 +93,112 @@ static JSBool TCPSocket_Invoke(JSContext*, JSObject*, jsval, uintN, jsval*);
 
 typedef enum {
     TCPSTATE_UNCONNECTED,
+    TCPSTATE_RESOLVING,
     TCPSTATE_CONNECTING,
     TCPSTATE_CONNECTED
 } TCPSocketState;
 
+/*
+ * The received data is kept in a ring buffer, which grows from its initial
+ * size up to its maximum size. Receiving is paused while the buffer is full,
+ * until data is read from it.
+ */
+#define TCPSOCKET_RXBUF_INITIAL 16384
+#define TCPSOCKET_RXBUF_MAX (1024 * 1024)
+
+/*
+ * The data to be sent is queued in chunks, one for every write that could
+ * not be sent right away. Up to TCPSOCKET_TX_IOV chunks are sent with a
+ * single system call. A chunk can also refer to a part of a file, which is
+ * sent straight from the file. Without sendfile(), it is read in blocks of
+ * TCPSOCKET_TX_FILEBUF bytes.
+ */
+#define TCPSOCKET_TX_IOV 64
+#define TCPSOCKET_TX_FILEBUF 65536
+
+/*
+ * The received data can be split into frames, either on a delimiter or by a
+ * big-endian length header of 1, 2 or 4 bytes. A frame must fit in the
+ * receive buffer at its maximum size.
+ */
+#define TCPSOCKET_DELIMITER_MAX 16
+
+/*
+ * An asynchronous socket connects to the addresses of a host name as RFC 8305
+ * describes. While the earlier connection attempts are pending, an attempt to
+ * the next address is started every TCPSOCKET_ATTEMPT_DELAY milliseconds, or
+ * right away once an attempt has failed. The first attempt to succeed is
+ * used.
+ */
+#define TCPSOCKET_ATTEMPT_DELAY 250
+
+/*
+ * The socket options are applied to every socket the instance uses, and to
+ * the connected socket when they are changed. Nagle's algorithm is disabled
+ * by default, as it holds back the short writes of a command and response
+ * exchange until the delayed acknowledgement of the previous write arrives.
+ */
+#define TCPSOCKET_NODELAY_DEFAULT JS_TRUE
+
+typedef struct _TCPSocketChunk {
+    struct _TCPSocketChunk* next;
+    size_t length;          /* The number of bytes in the chunk. */
+    size_t offset;          /* The number of bytes already sent. */
+    int file;               /* The file to send from, or -1 for data. */
+    off_t position;         /* The position of the part of the file. */
+    char data[1];
+} TCPSocketChunk;
+
 typedef struct {
+    JSObject* self;         /* The instance, rooted while in use. */
     JSBool blocking;        /* True if blocking IO is to be used. */
+    JSBool binary;          /* True if data is read as a ByteBuffer. */
     jsval onConnect;        /* The on-connect callback function. */
     jsval onData;           /* The on-data callback function. */
     jsval onClose;          /* The on-close callback function. */
     jsval onIOError;        /* The on-error callback function. */
+    jsval onDrain;          /* The on-drain callback function. */
     int fd;                 /* The socket file descriptor, or -1. */
     TCPSocketState state;   /* Connection state. */
+    PSResolveRequest* resolve; /* The pending host name resolution. */
+    JSUint16 port;          /* The port to connect to once resolved. */
+    JSUint32 timeout;       /* The connect timeout once resolved. */
+    PSAddressList addrs;    /* The addresses to connect to. */
+    int attempted;          /* The number of addresses attempted. */
+    int attempts[PS_DNS_ADDRESSES]; /* The attempts' sockets, or -1. */
+    int attemptError;       /* The error of the last failed attempt. */
+    PSSelectTimer* attemptTimer; /* The timer for the next attempt. */
+    jsdouble deadline;      /* The time the connect times out. */
+    char* rxbuf;            /* The receive ring buffer, or NULL. */
+    size_t rxcapacity;      /* The receive buffer size, a power of two. */
+    size_t rxhead;          /* The position of the first received byte. */
+    size_t rxlength;        /* The number of received bytes. */
+    JSBool rxpaused;        /* True if receiving is paused. */
+    size_t rxscanned;       /* The number of bytes without a delimiter. */
+    char delimiter[TCPSOCKET_DELIMITER_MAX]; /* The frame delimiter. */
+    size_t delimlength;     /* The delimiter length, or 0 if not used. */
+    int lengthPrefix;       /* The frame header length, or 0 if not used. */
+    TCPSocketChunk* txhead; /* The first chunk to be sent, or NULL. */
+    TCPSocketChunk* txtail; /* The last chunk to be sent, or NULL. */
+    size_t txlength;        /* The number of bytes to be sent. */
+    JSBool noDelay;         /* True if Nagle's algorithm is disabled. */
+    JSBool quickAck;        /* True if acknowledgements are not delayed. */
+    JSBool keepAlive;       /* True if keep-alive probes are sent. */
+    JSBool quickAckSet;     /* True once quickAck has been assigned. */
+    JSBool keepAliveSet;    /* True once keepAlive has been assigned. */
+    int keepAliveIdle;      /* Idle seconds before probing, or 0. */
+    int keepAliveInterval;  /* Seconds between the probes, or 0. */
+    int keepAliveCount;     /* Number of unanswered probes, or 0. */
+    int receiveBufferSize;  /* The socket receive buffer size, or 0. */
+    int sendBufferSize;     /* The socket send buffer size, or 0. */
+    int linger;             /* Seconds to linger on close, or -1. */
 } TCPSocket;
 
+static void   TCPSocket_TxClear(JSContext*, TCPSocket*);
+static void   TCPSocket_AttemptsClear(JSContext*, TCPSocket*);
+static JSBool TCPSocket_Arm(JSContext*, JSObject*, TCPSocket*);
+static JSBool TCPSocket_RxReady(TCPSocket*);
+
 /**
  * Definition of the class properties
  */
@@ -97,7 +207,21 @@ enum tcpsocket_tinyid {
     TCPSOCKET_ONCONNECT = -2,
     TCPSOCKET_ONDATA = -3,
     TCPSOCKET_ONCLOSE = -4,
-    TCPSOCKET_ONIOERROR = -5
+    TCPSOCKET_ONIOERROR = -5,
+    TCPSOCKET_ONDRAIN = -6,
+    TCPSOCKET_QUEUEDBYTES = -7,
+    TCPSOCKET_BINARY = -8,
+    TCPSOCKET_DELIMITER = -9,
+    TCPSOCKET_LENGTHPREFIX = -10,
+    TCPSOCKET_NODELAY = -11,
+    TCPSOCKET_QUICKACK = -12,
+    TCPSOCKET_KEEPALIVE = -13,
+    TCPSOCKET_KEEPALIVEIDLE = -14,
+    TCPSOCKET_KEEPALIVEINTERVAL = -15,
+    TCPSOCKET_KEEPALIVECOUNT = -16,
+    TCPSOCKET_RECEIVEBUFFERSIZE = -17,
+    TCPSOCKET_SENDBUFFERSIZE = -18,
+    TCPSOCKET_LINGER = -19
 };
 
 #define TCPSOCKET_PROP_ATTRS (JSPROP_PERMANENT)
@@ -109,6 +233,20 @@ static JSPropertySpec tcpsocket_props[] = {
     {"onData", TCPSOCKET_ONDATA, TCPSOCKET_PROP_ATTRS , 0, 0},
     {"onClose", TCPSOCKET_ONCLOSE, TCPSOCKET_PROP_ATTRS , 0, 0},
     {"onIOError", TCPSOCKET_ONIOERROR, TCPSOCKET_PROP_ATTRS , 0, 0},
+    {"onDrain", TCPSOCKET_ONDRAIN, TCPSOCKET_PROP_ATTRS , 0, 0},
+    {"queuedBytes", TCPSOCKET_QUEUEDBYTES, TCPSOCKET_PROP_ATTRS | JSPROP_READONLY, 0, 0},
+    {"binary", TCPSOCKET_BINARY, TCPSOCKET_PROP_ATTRS , 0, 0},
+    {"delimiter", TCPSOCKET_DELIMITER, TCPSOCKET_PROP_ATTRS , 0, 0},
+    {"lengthPrefix", TCPSOCKET_LENGTHPREFIX, TCPSOCKET_PROP_ATTRS , 0, 0},
+    {"noDelay", TCPSOCKET_NODELAY, TCPSOCKET_PROP_ATTRS , 0, 0},
+    {"quickAck", TCPSOCKET_QUICKACK, TCPSOCKET_PROP_ATTRS , 0, 0},
+    {"keepAlive", TCPSOCKET_KEEPALIVE, TCPSOCKET_PROP_ATTRS , 0, 0},
+    {"keepAliveIdle", TCPSOCKET_KEEPALIVEIDLE, TCPSOCKET_PROP_ATTRS , 0, 0},
+    {"keepAliveInterval", TCPSOCKET_KEEPALIVEINTERVAL, TCPSOCKET_PROP_ATTRS , 0, 0},
+    {"keepAliveCount", TCPSOCKET_KEEPALIVECOUNT, TCPSOCKET_PROP_ATTRS , 0, 0},
+    {"receiveBufferSize", TCPSOCKET_RECEIVEBUFFERSIZE, TCPSOCKET_PROP_ATTRS , 0, 0},
+    {"sendBufferSize", TCPSOCKET_SENDBUFFERSIZE, TCPSOCKET_PROP_ATTRS , 0, 0},
+    {"linger", TCPSOCKET_LINGER, TCPSOCKET_PROP_ATTRS , 0, 0},
     {0, 0, 0, 0, 0}
 };
 
@@ -121,6 +259,7 @@ static JSFunctionSpec tcpsocket_methods[] = {
     {"close", TCPSocket_Close, 0, 0, 0},
     {"read", TCPSocket_Read, 0, 0, 0},
     {"write", TCPSocket_Write, 0, 0, 0},
+    {"sendFile", TCPSocket_SendFile, 0, 0, 0},
     {0, 0, 0, 0, 0}
 };
 
@@ -138,7 +277,14 @@ static JSClass tcpsocket_class = {
     JS_ResolveStub,                 /* resolve */
     JS_ConvertStub,                 /* convert */
     TCPSocket_DT,                   /* finalize */
-    JSCLASS_NO_OPTIONAL_MEMBERS
+    NULL,                           /* get object ops */
+    NULL,                           /* check access */
+    NULL,                           /* call */
+    NULL,                           /* construct */
+    NULL,                           /* xdr object */
+    NULL,                           /* has instance */
+    TCPSocket_Mark,                 /* mark */
+    0                               /* reserve slots */
 };
 
 /*
@@ -153,30 +299,177 @@ TCPSocket_New(JSContext *cx, JSBool blocking)
     if (!tcp) {
         return NULL;
     }
+    tcp->self = NULL;
     tcp->blocking = blocking;
+    tcp->binary = JS_FALSE;
     tcp->onConnect = JSVAL_VOID;
     tcp->onData = JSVAL_VOID;
     tcp->onClose = JSVAL_VOID;
     tcp->onIOError = JSVAL_VOID;
+    tcp->onDrain = JSVAL_VOID;
     tcp->fd = -1;
     tcp->state = TCPSTATE_UNCONNECTED;
+    tcp->resolve = NULL;
+    tcp->port = 0;
+    tcp->timeout = 0;
+    tcp->addrs.count = 0;
+    tcp->attempted = 0;
+    for (int i = 0; i < PS_DNS_ADDRESSES; ++i) {
+        tcp->attempts[i] = -1;
+    }
+    tcp->attemptError = 0;
+    tcp->attemptTimer = NULL;
+    tcp->deadline = 0;
+    tcp->rxbuf = NULL;
+    tcp->rxcapacity = 0;
+    tcp->rxhead = 0;
+    tcp->rxlength = 0;
+    tcp->rxpaused = JS_FALSE;
+    tcp->rxscanned = 0;
+    tcp->delimlength = 0;
+    tcp->lengthPrefix = 0;
+    tcp->txhead = NULL;
+    tcp->txtail = NULL;
+    tcp->txlength = 0;
+    tcp->noDelay = TCPSOCKET_NODELAY_DEFAULT;
+    tcp->quickAck = JS_FALSE;
+    tcp->keepAlive = JS_FALSE;
+    tcp->quickAckSet = JS_FALSE;
+    tcp->keepAliveSet = JS_FALSE;
+    tcp->keepAliveIdle = 0;
+    tcp->keepAliveInterval = 0;
+    tcp->keepAliveCount = 0;
+    tcp->receiveBufferSize = 0;
+    tcp->sendBufferSize = 0;
+    tcp->linger = -1;
     return tcp;
 }
 
+/*
+ * Apply the socket options to a socket. The options that are left at 0, and
+ * quickAck and keepAlive until they are assigned, keep the system default.
+ * The options that the system does not provide are ignored. Returns -1 on
+ * error.
+ */
+static int
+TCPSocket_ApplyOptions(TCPSocket* tcp, int fd)
+{
+    struct linger lg;
+    int on;
+
+    on = tcp->noDelay;
+    if (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)) < 0) {
+        return -1;
+    }
+#ifdef TCP_QUICKACK
+    on = tcp->quickAck;
+    if (tcp->quickAckSet &&
+        setsockopt(fd, IPPROTO_TCP, TCP_QUICKACK, &on, sizeof(on)) < 0)
+    {
+        return -1;
+    }
+#endif
+    on = tcp->keepAlive;
+    if (tcp->keepAliveSet &&
+        setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on)) < 0)
+    {
+        return -1;
+    }
+#ifdef TCP_KEEPIDLE
+    if (tcp->keepAliveIdle > 0 &&
+        setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &tcp->keepAliveIdle,
+                   sizeof(int)) < 0)
+    {
+        return -1;
+    }
+#endif
+#ifdef TCP_KEEPINTVL
+    if (tcp->keepAliveInterval > 0 &&
+        setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &tcp->keepAliveInterval,
+                   sizeof(int)) < 0)
+    {
+        return -1;
+    }
+#endif
+#ifdef TCP_KEEPCNT
+    if (tcp->keepAliveCount > 0 &&
+        setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &tcp->keepAliveCount,
+                   sizeof(int)) < 0)
+    {
+        return -1;
+    }
+#endif
+    if (tcp->receiveBufferSize > 0 &&
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &tcp->receiveBufferSize,
+                   sizeof(int)) < 0)
+    {
+        return -1;
+    }
+    if (tcp->sendBufferSize > 0 &&
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &tcp->sendBufferSize,
+                   sizeof(int)) < 0)
+    {
+        return -1;
+    }
+    lg.l_onoff = tcp->linger >= 0;
+    lg.l_linger = tcp->linger >= 0 ? tcp->linger : 0;
+    if (setsockopt(fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg)) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
 void
 TCPSocket_Delete(JSContext* cx, TCPSocket* tcp)
 {
+    if (tcp->self) {
+        JS_RemoveRoot(cx, &tcp->self);
+    }
+    if (tcp->resolve) {
+        ps_CancelResolve(cx, tcp->resolve);
+    }
+    TCPSocket_AttemptsClear(cx, tcp);
     if (tcp->fd != -1) {
+        ps_RemoveSelect(cx, tcp->fd);
         (void) shutdown(tcp->fd, SHUT_WR);
         (void) close(tcp->fd);
     }
+    if (tcp->rxbuf) {
+        JS_free(cx, tcp->rxbuf);
+    }
+    TCPSocket_TxClear(cx, tcp);
     JS_free(cx, tcp);
 }
 
+/*
+ * Change the connection state. An asynchronous socket is rooted while it is
+ * connecting or connected, so that it is not collected while its callbacks
+ * may still be called, even if the script holds no reference to it.
+ */
+static void
+TCPSocket_SetState(JSContext* cx, JSObject* obj, TCPSocket* tcp,
+                   TCPSocketState state)
+{
+    tcp->state = state;
+    if (state == TCPSTATE_UNCONNECTED || tcp->blocking) {
+        if (tcp->self) {
+            JS_RemoveRoot(cx, &tcp->self);
+            tcp->self = NULL;
+        }
+    }
+    else if (!tcp->self) {
+        tcp->self = obj;
+        if (!JS_AddNamedRoot(cx, &tcp->self, "TCPSocket.self")) {
+            tcp->self = NULL;
+        }
+    }
+}
+
 static JSBool
 TCPSocket_GetProperty(JSContext *cx, JSObject *obj, jsval id, jsval *vp)
 {   
     TCPSocket* tcp = NULL;
+    JSString* str;
     jsint slot;
 
     /* Get the property's slot */
@@ -205,6 +498,60 @@ TCPSocket_GetProperty(JSContext *cx, JSObject *obj, jsval id, jsval *vp)
             case TCPSOCKET_ONIOERROR:
                 *vp = tcp->onIOError;
                 break;
+            case TCPSOCKET_ONDRAIN:
+                *vp = tcp->onDrain;
+                break;
+            case TCPSOCKET_QUEUEDBYTES:
+                if (!JS_NewNumberValue(cx, (jsdouble) tcp->txlength, vp)) {
+                    JS_UNLOCK_OBJ(cx, obj);
+                    return JS_FALSE;
+                }
+                break;
+            case TCPSOCKET_BINARY:
+                *vp = BOOLEAN_TO_JSVAL(tcp->binary);
+                break;
+            case TCPSOCKET_DELIMITER:
+                if (tcp->delimlength == 0) {
+                    *vp = JSVAL_NULL;
+                    break;
+                }
+                str = JS_NewStringCopyN(cx, tcp->delimiter, tcp->delimlength);
+                if (!str) {
+                    JS_UNLOCK_OBJ(cx, obj);
+                    return JS_FALSE;
+                }
+                *vp = STRING_TO_JSVAL(str);
+                break;
+            case TCPSOCKET_LENGTHPREFIX:
+                *vp = INT_TO_JSVAL(tcp->lengthPrefix);
+                break;
+            case TCPSOCKET_NODELAY:
+                *vp = BOOLEAN_TO_JSVAL(tcp->noDelay);
+                break;
+            case TCPSOCKET_QUICKACK:
+                *vp = BOOLEAN_TO_JSVAL(tcp->quickAck);
+                break;
+            case TCPSOCKET_KEEPALIVE:
+                *vp = BOOLEAN_TO_JSVAL(tcp->keepAlive);
+                break;
+            case TCPSOCKET_KEEPALIVEIDLE:
+                *vp = INT_TO_JSVAL(tcp->keepAliveIdle);
+                break;
+            case TCPSOCKET_KEEPALIVEINTERVAL:
+                *vp = INT_TO_JSVAL(tcp->keepAliveInterval);
+                break;
+            case TCPSOCKET_KEEPALIVECOUNT:
+                *vp = INT_TO_JSVAL(tcp->keepAliveCount);
+                break;
+            case TCPSOCKET_RECEIVEBUFFERSIZE:
+                *vp = INT_TO_JSVAL(tcp->receiveBufferSize);
+                break;
+            case TCPSOCKET_SENDBUFFERSIZE:
+                *vp = INT_TO_JSVAL(tcp->sendBufferSize);
+                break;
+            case TCPSOCKET_LINGER:
+                *vp = INT_TO_JSVAL(tcp->linger);
+                break;
             default:
                 break;
         }
@@ -213,10 +560,60 @@ TCPSocket_GetProperty(JSContext *cx, JSObject *obj, jsval id, jsval *vp)
     return JS_TRUE;
 }
 
+/*
+ * Get the integer value of a socket option, which must be at least the
+ * minimum.
+ */
+static JSBool
+TCPSocket_IntOption(JSContext *cx, jsval v, int minimum, int* value)
+{
+    if (!JSVAL_IS_INT(v)) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_ARGUMENT_NOT_INT);
+        return JS_FALSE;
+    }
+    if (JSVAL_TO_INT(v) < minimum) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_ARGUMENT_OUT_OF_RANGE);
+        return JS_FALSE;
+    }
+    *value = JSVAL_TO_INT(v);
+    return JS_TRUE;
+}
+
+/*
+ * Apply the changed socket options to the connected socket, or to the
+ * pending connection attempts.
+ */
+static JSBool
+TCPSocket_SetOptions(JSContext *cx, TCPSocket* tcp)
+{
+    int failed = 0;
+
+    if (tcp->fd != -1) {
+        failed = TCPSocket_ApplyOptions(tcp, tcp->fd);
+    }
+    for (int i = 0; i < tcp->attempted && failed == 0; ++i) {
+        if (tcp->attempts[i] != -1) {
+            failed = TCPSocket_ApplyOptions(tcp, tcp->attempts[i]);
+        }
+    }
+    if (failed) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_FAILED, strerror(errno));
+        return JS_FALSE;
+    }
+    return JS_TRUE;
+}
+
 static JSBool
 TCPSocket_SetProperty(JSContext *cx, JSObject *obj, jsval id, jsval *vp)
 {
     TCPSocket* tcp = NULL;
+    JSBool armed = JS_FALSE;
+    JSBool option = JS_FALSE;
+    JSBool ok = JS_TRUE;
+    JSString* str;
     jsint slot;
 
     /* Get the property's slot */
@@ -228,6 +625,10 @@ TCPSocket_SetProperty(JSContext *cx, JSObject *obj, jsval id, jsval *vp)
     /* Set the value */
     JS_LOCK_OBJ(cx, obj);
     tcp = (TCPSocket*)JS_GetInstancePrivate(cx, obj, &tcpsocket_class, NULL);
+    if (!tcp) {
+        JS_UNLOCK_OBJ(cx, obj);
+        return JS_TRUE;
+    }
     switch (slot) {
         case TCPSOCKET_TCPSTATE_CONNECTED:
             break;
@@ -239,6 +640,8 @@ TCPSocket_SetProperty(JSContext *cx, JSObject *obj, jsval id, jsval *vp)
         case TCPSOCKET_ONDATA:
             if (JSVAL_IS_FUNCTION(cx, *vp)) {
                 tcp->onData = *vp;
+                armed = tcp->state == TCPSTATE_CONNECTED && !tcp->blocking &&
+                        TCPSocket_RxReady(tcp);
             }
             break;
         case TCPSOCKET_ONCLOSE:
@@ -251,151 +654,1177 @@ TCPSocket_SetProperty(JSContext *cx, JSObject *obj, jsval id, jsval *vp)
                 tcp->onIOError = *vp;
             }
             break;
+        case TCPSOCKET_ONDRAIN:
+            if (JSVAL_IS_FUNCTION(cx, *vp)) {
+                tcp->onDrain = *vp;
+            }
+            break;
+        case TCPSOCKET_QUEUEDBYTES:
+            break;
+        case TCPSOCKET_BINARY:
+            ok = JS_ValueToBoolean(cx, *vp, &tcp->binary);
+            break;
+        case TCPSOCKET_DELIMITER:
+            /* Each character of the delimiter is a byte, an empty delimiter
+             * or null stops splitting on a delimiter. */
+            if (JSVAL_IS_NULL(*vp) || JSVAL_IS_VOID(*vp)) {
+                tcp->delimlength = 0;
+            }
+            else if (JS_TypeOfValue(cx, *vp) != JSTYPE_STRING) {
+                JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                                     PSMSG_ARGUMENT_NOT_STRING);
+                ok = JS_FALSE;
+            }
+            else {
+                str = JSVAL_TO_STRING(*vp);
+                if (JSSTRING_LENGTH(str) > TCPSOCKET_DELIMITER_MAX) {
+                    JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                                         PSMSG_ARGUMENT_OUT_OF_RANGE);
+                    ok = JS_FALSE;
+                }
+                else {
+                    tcp->delimlength = JSSTRING_LENGTH(str);
+                    for (size_t i = 0; i < tcp->delimlength; ++i) {
+                        tcp->delimiter[i] = (char) JSSTRING_CHARS(str)[i];
+                    }
+                    if (tcp->delimlength > 0) {
+                        tcp->lengthPrefix = 0;
+                    }
+                }
+            }
+            tcp->rxscanned = 0;
+            armed = ok && tcp->state == TCPSTATE_CONNECTED &&
+                    !tcp->blocking && TCPSocket_RxReady(tcp);
+            break;
+        case TCPSOCKET_LENGTHPREFIX:
+            if (!JSVAL_IS_INT(*vp)) {
+                JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                                     PSMSG_ARGUMENT_NOT_INT);
+                ok = JS_FALSE;
+            }
+            else if (JSVAL_TO_INT(*vp) != 0 && JSVAL_TO_INT(*vp) != 1 &&
+                     JSVAL_TO_INT(*vp) != 2 && JSVAL_TO_INT(*vp) != 4)
+            {
+                JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                                     PSMSG_ARGUMENT_OUT_OF_RANGE);
+                ok = JS_FALSE;
+            }
+            else {
+                tcp->lengthPrefix = JSVAL_TO_INT(*vp);
+                if (tcp->lengthPrefix > 0) {
+                    tcp->delimlength = 0;
+                }
+            }
+            armed = ok && tcp->state == TCPSTATE_CONNECTED &&
+                    !tcp->blocking && TCPSocket_RxReady(tcp);
+            break;
+        case TCPSOCKET_NODELAY:
+            ok = option = JS_ValueToBoolean(cx, *vp, &tcp->noDelay);
+            break;
+        case TCPSOCKET_QUICKACK:
+            ok = option = JS_ValueToBoolean(cx, *vp, &tcp->quickAck);
+            tcp->quickAckSet = JS_TRUE;
+            break;
+        case TCPSOCKET_KEEPALIVE:
+            ok = option = JS_ValueToBoolean(cx, *vp, &tcp->keepAlive);
+            tcp->keepAliveSet = JS_TRUE;
+            break;
+        case TCPSOCKET_KEEPALIVEIDLE:
+            ok = option = TCPSocket_IntOption(cx, *vp, 0,
+                                              &tcp->keepAliveIdle);
+            break;
+        case TCPSOCKET_KEEPALIVEINTERVAL:
+            ok = option = TCPSocket_IntOption(cx, *vp, 0,
+                                              &tcp->keepAliveInterval);
+            break;
+        case TCPSOCKET_KEEPALIVECOUNT:
+            ok = option = TCPSocket_IntOption(cx, *vp, 0,
+                                              &tcp->keepAliveCount);
+            break;
+        case TCPSOCKET_RECEIVEBUFFERSIZE:
+            ok = option = TCPSocket_IntOption(cx, *vp, 0,
+                                              &tcp->receiveBufferSize);
+            break;
+        case TCPSOCKET_SENDBUFFERSIZE:
+            ok = option = TCPSocket_IntOption(cx, *vp, 0,
+                                              &tcp->sendBufferSize);
+            break;
+        case TCPSOCKET_LINGER:
+            ok = option = TCPSocket_IntOption(cx, *vp, -1, &tcp->linger);
+            break;
     }
     JS_UNLOCK_OBJ(cx, obj);
+    if (!ok) {
+        return JS_FALSE;
+    }
+    if (option) {
+        return TCPSocket_SetOptions(cx, tcp);
+    }
+
+    /* Data that has been received before the onData callback was set, is
+     * handled on the next pass. */
+    if (armed) {
+        return TCPSocket_Arm(cx, obj, tcp);
+    }
     return JS_TRUE;
 }
 
 /*
- * Callback when the file descriptor has been triggered.
+ * Make sure there is free space in the receive buffer, growing it if it is
+ * full. Returns false if the buffer is full at its maximum size.
  */
-static void
-TCPSocket_SelectCallback(JSContext *cx, JSObject *obj)
+static JSBool
+TCPSocket_RxReserve(JSContext *cx, TCPSocket* tcp)
 {
-    TCPSocket* tcp = NULL;
-    jsval func;
+    size_t capacity;
+    char* rxbuf;
 
-    tcp = (TCPSocket*) JS_GetPrivate(cx, obj);
-    if (!tcp) {
-        return;
+    if (tcp->rxlength < tcp->rxcapacity) {
+        return JS_TRUE;
+    }
+    if (tcp->rxcapacity >= TCPSOCKET_RXBUF_MAX) {
+        return JS_FALSE;
     }
 
-    /*
-     * Bail out if blocking.
-     */
-    if (tcp->blocking) {
-        (void) ps_RemoveSelect(cx, tcp->fd);
-        return;
+    /* Grow the buffer and move the data to its start. */
+    capacity = tcp->rxcapacity == 0 ? TCPSOCKET_RXBUF_INITIAL
+                                    : 2 * tcp->rxcapacity;
+    rxbuf = (char*) JS_malloc(cx, capacity);
+    if (!rxbuf) {
+        return JS_FALSE;
+    }
+    if (tcp->rxbuf) {
+        size_t first = tcp->rxcapacity - tcp->rxhead;
+        memcpy(rxbuf, tcp->rxbuf + tcp->rxhead, first);
+        memcpy(rxbuf + first, tcp->rxbuf, tcp->rxhead);
+        JS_free(cx, tcp->rxbuf);
     }
+    tcp->rxbuf = rxbuf;
+    tcp->rxcapacity = capacity;
+    tcp->rxhead = 0;
+    return JS_TRUE;
+}
 
-    /*
-     * Bail out if unconnected.
-     */
-    if (tcp->state == TCPSTATE_UNCONNECTED) {
-        return;
+/*
+ * Receive data into the free space of the receive buffer with a single
+ * system call. Returns the number of bytes received, 0 on end-of-file or -1
+ * on error.
+ */
+static ssize_t
+TCPSocket_RxRecv(TCPSocket* tcp, int flags)
+{
+    struct iovec iov[2];
+    struct msghdr msg;
+    size_t mask = tcp->rxcapacity - 1;
+    size_t tail = (tcp->rxhead + tcp->rxlength) & mask;
+    size_t space = tcp->rxcapacity - tcp->rxlength;
+    ssize_t nrecv;
+
+    /* The free space wraps around the end of the buffer if the data does
+     * not. */
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    iov[0].iov_base = tcp->rxbuf + tail;
+    if (tail + space <= tcp->rxcapacity) {
+        iov[0].iov_len = space;
+        msg.msg_iovlen = 1;
     }
+    else {
+        iov[0].iov_len = tcp->rxcapacity - tail;
+        iov[1].iov_base = tcp->rxbuf;
+        iov[1].iov_len = space - iov[0].iov_len;
+        msg.msg_iovlen = 2;
+    }
+    nrecv = recvmsg(tcp->fd, &msg, flags);
+    if (nrecv > 0) {
+        tcp->rxlength += nrecv;
+    }
+    return nrecv;
+}
 
-    /*
-     * If connecting, check if we are successfully connected. Otherwise,
-     * there is data to be read.
-     */
-    uintN argc = 0;
-    jsval argv[1];
-    if (tcp->state == TCPSTATE_CONNECTING) {
-        /* Connecting: check if we are successfully connected. */
-        struct sockaddr_in addr;
-        socklen_t addrlen = sizeof(addr);
-        memset(&addr, 0, addrlen);
-        if (getpeername(tcp->fd, (struct sockaddr*)&addr, &addrlen) == 0) {
-            tcp->state = TCPSTATE_CONNECTED;
-            func = tcp->onConnect;
-            argc = 0;
+/*
+ * Receive all the data that is available without blocking into the receive
+ * buffer, or until the buffer is full. Returns the number of bytes received
+ * or -1 on error. End-of-file is only flagged if no data has been received.
+ */
+static ssize_t
+TCPSocket_Receive(JSContext *cx, TCPSocket* tcp, JSBool* eof)
+{
+    ssize_t total = 0;
+
+    *eof = JS_FALSE;
+    while (TCPSocket_RxReserve(cx, tcp)) {
+        size_t space = tcp->rxcapacity - tcp->rxlength;
+        ssize_t nrecv = TCPSocket_RxRecv(tcp, MSG_DONTWAIT);
+        if (nrecv > 0) {
+            total += nrecv;
+            if (nrecv < space) {
+                /* Everything available has been received. */
+                break;
+            }
         }
-        else {
-            /* Failure to connect, remove the descriptor so we're not
-             * triggered over and over again. */
-            const char* errmsg = strerror(errno);
-            ps_RemoveSelect(cx, tcp->fd);
-            tcp->state = TCPSTATE_UNCONNECTED;
-            func = tcp->onIOError;
-            JSString* data = JS_NewStringCopyZ(cx, errmsg);
-            if (!data) {
-                return;
+        else if (nrecv == 0) {
+            *eof = (total == 0);
+            break;
+        }
+        else if (errno != EINTR) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || total > 0) {
+                break;
             }
-            argc = 1;
-            argv[0] = STRING_TO_JSVAL(data);
+            return -1;
+        }
+    }
+#ifdef TCP_QUICKACK
+    /* The system falls back to delayed acknowledgements, so that quick
+     * acknowledgements are asked for again after every receive. */
+    if (tcp->quickAck && total > 0) {
+        int on = 1;
+        (void) setsockopt(tcp->fd, IPPROTO_TCP, TCP_QUICKACK, &on, sizeof(on));
+    }
+#endif
+    return total;
+}
+
+/*
+ * Discard data from the start of the receive buffer.
+ */
+static void
+TCPSocket_RxSkip(TCPSocket* tcp, size_t count)
+{
+    /* Start at the beginning of the buffer when it is empty, so that the
+     * next receive is not split. */
+    tcp->rxlength -= count;
+    tcp->rxhead = tcp->rxlength == 0
+                ? 0
+                : (tcp->rxhead + count) & (tcp->rxcapacity - 1);
+    tcp->rxscanned = 0;
+}
+
+/*
+ * Take data from the receive buffer, with a single allocation. The data is
+ * taken as a ByteBuffer for a binary socket, otherwise as a string of which
+ * each byte is a character.
+ */
+static JSBool
+TCPSocket_RxTake(JSContext *cx, TCPSocket* tcp, size_t count, jsval* vp)
+{
+    size_t mask = tcp->rxcapacity - 1;
+    JSObject* buf;
+    JSString* str;
+    jschar* chars;
+    char* bytes;
+
+    if (count > tcp->rxlength) {
+        count = tcp->rxlength;
+    }
+    if (tcp->binary) {
+        size_t first = JS_MIN(count, tcp->rxcapacity - tcp->rxhead);
+        buf = ps_NewByteBuffer(cx, count, &bytes);
+        if (!buf) {
+            return JS_FALSE;
+        }
+        if (count > 0) {
+            memcpy(bytes, tcp->rxbuf + tcp->rxhead, first);
+            memcpy(bytes + first, tcp->rxbuf, count - first);
+        }
+        *vp = OBJECT_TO_JSVAL(buf);
+    }
+    else {
+        chars = (jschar*) JS_malloc(cx, (count + 1) * sizeof(jschar));
+        if (!chars) {
+            return JS_FALSE;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            chars[i] = (unsigned char) tcp->rxbuf[(tcp->rxhead + i) & mask];
+        }
+        chars[count] = 0;
+        str = JS_NewUCString(cx, chars, count);
+        if (!str) {
+            JS_free(cx, chars);
+            return JS_FALSE;
+        }
+        *vp = STRING_TO_JSVAL(str);
+    }
+
+    TCPSocket_RxSkip(tcp, count);
+    return JS_TRUE;
+}
+
+/*
+ * Find the next frame in the receive buffer. The frame is preceded by a
+ * header and followed by a trailer, either of which is skipped. Returns 1 if
+ * a complete frame has been received, 0 if not and -1 if the frame does not
+ * fit in the receive buffer.
+ */
+static int
+TCPSocket_RxFrame(TCPSocket* tcp, size_t* header, size_t* length,
+                  size_t* trailer)
+{
+    size_t mask = tcp->rxcapacity - 1;
+    size_t pos, count;
+
+    if (tcp->lengthPrefix > 0) {
+        if (tcp->rxlength < tcp->lengthPrefix) {
+            return 0;
+        }
+        count = 0;
+        for (int i = 0; i < tcp->lengthPrefix; ++i) {
+            count = (count << 8) |
+                    (unsigned char) tcp->rxbuf[(tcp->rxhead + i) & mask];
+        }
+        if (count > TCPSOCKET_RXBUF_MAX - tcp->lengthPrefix) {
+            return -1;
+        }
+        if (tcp->rxlength < tcp->lengthPrefix + count) {
+            return 0;
+        }
+        *header = tcp->lengthPrefix;
+        *length = count;
+        *trailer = 0;
+        return 1;
+    }
+
+    /* Look for the first byte of the delimiter in each contiguous part of
+     * the buffer, skipping the part that has been scanned before. */
+    pos = tcp->rxscanned;
+    while (pos + tcp->delimlength <= tcp->rxlength) {
+        size_t start = (tcp->rxhead + pos) & mask;
+        size_t span = JS_MIN(tcp->rxlength - pos, tcp->rxcapacity - start);
+        const char* found = memchr(tcp->rxbuf + start, tcp->delimiter[0], span);
+        size_t i;
+        if (!found) {
+            pos += span;
+            continue;
+        }
+        pos += found - (tcp->rxbuf + start);
+        if (pos + tcp->delimlength > tcp->rxlength) {
+            break;
+        }
+        for (i = 1; i < tcp->delimlength; ++i) {
+            if (tcp->rxbuf[(tcp->rxhead + pos + i) & mask] !=
+                tcp->delimiter[i])
+            {
+                break;
+            }
+        }
+        if (i == tcp->delimlength) {
+            tcp->rxscanned = pos;
+            *header = 0;
+            *length = pos;
+            *trailer = tcp->delimlength;
+            return 1;
         }
+        ++pos;
+    }
+    tcp->rxscanned = JS_MIN(pos, tcp->rxlength);
+    return tcp->rxlength >= TCPSOCKET_RXBUF_MAX ? -1 : 0;
+}
+
+/*
+ * Whether there is received data for the onData callback, which is a
+ * complete frame when the data is split into frames.
+ */
+static JSBool
+TCPSocket_RxReady(TCPSocket* tcp)
+{
+    size_t header, length, trailer;
+
+    if (tcp->lengthPrefix == 0 && tcp->delimlength == 0) {
+        return tcp->rxlength > 0;
+    }
+    return TCPSocket_RxFrame(tcp, &header, &length, &trailer) == 1;
+}
+
+/*
+ * Append a chunk to the queue of data to be sent.
+ */
+static void
+TCPSocket_TxAppend(TCPSocket* tcp, TCPSocketChunk* chunk)
+{
+    if (tcp->txtail) {
+        tcp->txtail->next = chunk;
+    }
+    else {
+        tcp->txhead = chunk;
+    }
+    tcp->txtail = chunk;
+    tcp->txlength += chunk->length;
+}
+
+/*
+ * Release a chunk that has been sent or is discarded.
+ */
+static void
+TCPSocket_TxRelease(JSContext *cx, TCPSocketChunk* chunk)
+{
+    if (chunk->file != -1) {
+        (void) close(chunk->file);
+    }
+    JS_free(cx, chunk);
+}
+
+/*
+ * Queue data to be sent once the socket is writable.
+ */
+static JSBool
+TCPSocket_TxQueue(JSContext *cx, TCPSocket* tcp, const char* data,
+                  size_t length)
+{
+    TCPSocketChunk* chunk = (TCPSocketChunk*) JS_malloc(cx,
+            offsetof(TCPSocketChunk, data) + length);
+    if (!chunk) {
+        return JS_FALSE;
+    }
+    memcpy(chunk->data, data, length);
+    chunk->next = NULL;
+    chunk->length = length;
+    chunk->offset = 0;
+    chunk->file = -1;
+    chunk->position = 0;
+    TCPSocket_TxAppend(tcp, chunk);
+    return JS_TRUE;
+}
+
+/*
+ * Queue a part of a file to be sent once the socket is writable. The file is
+ * closed once it has been sent.
+ */
+static JSBool
+TCPSocket_TxQueueFile(JSContext *cx, TCPSocket* tcp, int file,
+                      off_t position, size_t length)
+{
+    TCPSocketChunk* chunk = (TCPSocketChunk*) JS_malloc(cx,
+            sizeof(TCPSocketChunk));
+    if (!chunk) {
+        return JS_FALSE;
+    }
+    chunk->next = NULL;
+    chunk->length = length;
+    chunk->offset = 0;
+    chunk->file = file;
+    chunk->position = position;
+    TCPSocket_TxAppend(tcp, chunk);
+    return JS_TRUE;
+}
+
+/*
+ * Send from the file of a queued chunk, without the data passing through
+ * user space if sendfile() is available. Returns the number of bytes sent,
+ * 0 at the end of the file, or -1 on error.
+ */
+static ssize_t
+TCPSocket_TxSendFile(TCPSocket* tcp, TCPSocketChunk* chunk)
+{
+    off_t position = chunk->position + chunk->offset;
+    size_t count = chunk->length - chunk->offset;
+#if defined(HAVE_SYS_SENDFILE_H) && defined(HAVE_SENDFILE)
+    static const struct timespec zero = {0, 0};
+    sigset_t sigpipe, pending, mask;
+    JSBool raised;
+    ssize_t nsent;
+    int error;
+
+    /* Unlike send(), sendfile() cannot be told not to raise SIGPIPE when the
+     * peer has closed the connection. The signal is blocked instead, and
+     * taken if it has been raised by the call, so that the error is
+     * reported. It may be raised by a call that has sent part of the data. */
+    sigemptyset(&sigpipe);
+    sigaddset(&sigpipe, SIGPIPE);
+    sigpending(&pending);
+    raised = sigismember(&pending, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &sigpipe, &mask);
+    nsent = sendfile(tcp->fd, chunk->file, &position, count);
+    error = errno;
+    sigpending(&pending);
+    if (!raised && sigismember(&pending, SIGPIPE)) {
+        while (sigtimedwait(&sigpipe, NULL, &zero) < 0 && errno == EINTR);
+    }
+    pthread_sigmask(SIG_SETMASK, &mask, NULL);
+    errno = error;
+    return nsent;
+#else
+    char buffer[TCPSOCKET_TX_FILEBUF];
+    ssize_t nread;
+
+    nread = pread(chunk->file, buffer, JS_MIN(count, sizeof(buffer)),
+                  position);
+    if (nread <= 0) {
+        return nread;
+    }
+    return send(tcp->fd, buffer, nread,
+                tcp->blocking ? MSG_NOSIGNAL : MSG_DONTWAIT | MSG_NOSIGNAL);
+#endif
+}
+
+/*
+ * Send as much of the queued data as possible without blocking, gathering
+ * the queued chunks in a single system call. A part of a file is sent by
+ * itself. Returns false on error.
+ */
+static JSBool
+TCPSocket_TxFlush(JSContext *cx, TCPSocket* tcp)
+{
+    while (tcp->txhead != NULL) {
+        struct iovec iov[TCPSOCKET_TX_IOV];
+        struct msghdr msg;
+        TCPSocketChunk* chunk;
+        size_t requested = 0;
+        size_t sent;
+        ssize_t nsent;
+        int n = 0;
+
+        if (tcp->txhead->file != -1) {
+            requested = tcp->txhead->length - tcp->txhead->offset;
+            nsent = TCPSocket_TxSendFile(tcp, tcp->txhead);
+
+            /* The file has been truncated since it was queued. */
+            if (nsent == 0) {
+                errno = EIO;
+                nsent = -1;
+            }
+        }
+        else {
+            memset(&msg, 0, sizeof(msg));
+            for (chunk = tcp->txhead;
+                 chunk != NULL && chunk->file == -1 && n < TCPSOCKET_TX_IOV;
+                 chunk = chunk->next, ++n)
+            {
+                iov[n].iov_base = chunk->data + chunk->offset;
+                iov[n].iov_len = chunk->length - chunk->offset;
+                requested += iov[n].iov_len;
+            }
+            msg.msg_iov = iov;
+            msg.msg_iovlen = n;
+            nsent = sendmsg(tcp->fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+        }
+        if (nsent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+
+        /* Release the chunks that have been sent completely. */
+        sent = nsent;
+        tcp->txlength -= sent;
+        while (nsent > 0) {
+            chunk = tcp->txhead;
+            if (nsent < chunk->length - chunk->offset) {
+                chunk->offset += nsent;
+                break;
+            }
+            nsent -= chunk->length - chunk->offset;
+            tcp->txhead = chunk->next;
+            TCPSocket_TxRelease(cx, chunk);
+        }
+        if (tcp->txhead == NULL) {
+            tcp->txtail = NULL;
+        }
+
+        /* Stop if not all has been sent, the socket buffer is full. */
+        if (sent < requested) {
+            break;
+        }
+    }
+    return JS_TRUE;
+}
+
+/*
+ * Discard the queued data.
+ */
+static void
+TCPSocket_TxClear(JSContext *cx, TCPSocket* tcp)
+{
+    while (tcp->txhead != NULL) {
+        TCPSocketChunk* chunk = tcp->txhead;
+        tcp->txhead = chunk->next;
+        TCPSocket_TxRelease(cx, chunk);
+    }
+    tcp->txtail = NULL;
+    tcp->txlength = 0;
+}
+
+/*
+ * Set up the selection of a connected socket: readable unless receiving is
+ * paused, and writable while there is data queued. Just as the socket
+ * remains readable while not all data has been read, the selection times out
+ * right away while there is received data left in the buffer, so the onData
+ * callback is called again on the next pass.
+ */
+static JSBool
+TCPSocket_Arm(JSContext *cx, JSObject *obj, TCPSocket* tcp)
+{
+    PSFDSet mask = 0;
+    int timeout = -1;
+
+    if (!tcp->rxpaused) {
+        mask |= PSFDSET_READ;
+        if (!JSVAL_IS_VOID(tcp->onData) && TCPSocket_RxReady(tcp)) {
+            timeout = 0;
+        }
+    }
+    if (tcp->txlength > 0) {
+        mask |= PSFDSET_WRITE;
+    }
+    if (mask == 0) {
+        return ps_RemoveSelect(cx, tcp->fd);
+    }
+    if (!ps_AddSelect(cx, tcp->fd, mask, obj, &TCPSocket_SelectCallback,
+                      &TCPSocket_SelectErrorCallback, timeout))
+    {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_FAILED, "asynchronous socket setup");
+        return JS_FALSE;
+    }
+    return JS_TRUE;
+}
+
+/*
+ * Call the onData callback for each complete frame in the receive buffer,
+ * with the frame as its argument. The connection is dropped if a frame does
+ * not fit in the receive buffer.
+ */
+static void
+TCPSocket_RxFrames(JSContext *cx, JSObject *obj, TCPSocket* tcp)
+{
+    JSTempValueRooter tvr;
+    jsval argv[1];
+    size_t header, length, trailer;
+    JSString* str;
+    int found = 0;
+
+    argv[0] = JSVAL_NULL;
+    JS_PUSH_TEMP_ROOT(cx, 1, argv, &tvr);
+    while (tcp->state == TCPSTATE_CONNECTED && !JSVAL_IS_VOID(tcp->onData) &&
+           (tcp->lengthPrefix > 0 || tcp->delimlength > 0) &&
+           (found = TCPSocket_RxFrame(tcp, &header, &length, &trailer)) == 1)
+    {
+        TCPSocket_RxSkip(tcp, header);
+        if (!TCPSocket_RxTake(cx, tcp, length, &argv[0])) {
+            break;
+        }
+        TCPSocket_RxSkip(tcp, trailer);
+        TCPSocket_Invoke(cx, obj, tcp->onData, 1, argv);
+    }
+    JS_POP_TEMP_ROOT(cx, &tvr);
+
+    /* Receiving resumes once frames have been taken from a full buffer. */
+    if (tcp->rxpaused && tcp->rxlength < tcp->rxcapacity) {
+        tcp->rxpaused = JS_FALSE;
+    }
+    if (found < 0 && tcp->state == TCPSTATE_CONNECTED) {
+        ps_RemoveSelect(cx, tcp->fd);
+        TCPSocket_TxClear(cx, tcp);
+        TCPSocket_SetState(cx, obj, tcp, TCPSTATE_UNCONNECTED);
+        if (!JSVAL_IS_VOID(tcp->onIOError)) {
+            str = JS_NewStringCopyZ(cx, "frame too large");
+            if (str) {
+                argv[0] = STRING_TO_JSVAL(str);
+                TCPSocket_Invoke(cx, obj, tcp->onIOError, 1, argv);
+            }
+        }
+    }
+}
+
+/*
+ * Callback when the file descriptor has been triggered.
+ */
+static void
+TCPSocket_SelectCallback(JSContext *cx, JSObject *obj)
+{
+    TCPSocket* tcp = NULL;
+    jsval func;
+
+    tcp = (TCPSocket*) JS_GetPrivate(cx, obj);
+    if (!tcp) {
+        return;
+    }
+
+    /*
+     * Bail out if blocking.
+     */
+    if (tcp->blocking) {
+        (void) ps_RemoveSelect(cx, tcp->fd);
+        return;
+    }
+
+    /*
+     * Bail out unless connected, the connection attempts while connecting
+     * have a callback of their own.
+     */
+    if (tcp->state != TCPSTATE_CONNECTED) {
+        return;
+    }
+
+    /*
+     * Send the queued data and receive the available data into the receive
+     * buffer. If there is no data available, assume that the connection is
+     * closed by peer. Any data left in the buffer is handled first, the
+     * closure is then noticed on a next trigger.
+     */
+    uintN argc = 0;
+    jsval argv[1];
+    JSBool drained = JS_FALSE;
+    JSBool framed = JS_FALSE;
+    const char* errmsg = NULL;
+    JSBool eof = JS_FALSE;
+    if (tcp->txlength > 0) {
+        if (!TCPSocket_TxFlush(cx, tcp)) {
+            errmsg = strerror(errno);
+        }
+        drained = (tcp->txlength == 0);
+    }
+    if (!errmsg && TCPSocket_Receive(cx, tcp, &eof) < 0) {
+        errmsg = strerror(errno);
+    }
+    if (errmsg) {
+        /* Failure to send or receive data, remove the descriptor so
+         * we're not triggered over and over again. */
+        ps_RemoveSelect(cx, tcp->fd);
+        TCPSocket_TxClear(cx, tcp);
+        TCPSocket_SetState(cx, obj, tcp, TCPSTATE_UNCONNECTED);
+        drained = JS_FALSE;
+        func = tcp->onIOError;
+        JSString* data = JS_NewStringCopyZ(cx, errmsg);
+        if (!data) {
+            return;
+        }
+        argc = 1;
+        argv[0] = STRING_TO_JSVAL(data);
+    }
+    else if (eof && !TCPSocket_RxReady(tcp)) {
+        ps_RemoveSelect(cx, tcp->fd);
+        TCPSocket_TxClear(cx, tcp);
+        (void) shutdown(tcp->fd, SHUT_WR);
+        (void) close(tcp->fd);
+        TCPSocket_SetState(cx, obj, tcp, TCPSTATE_UNCONNECTED);
+        tcp->fd = -1;
+        drained = JS_FALSE;
+        argc = 0;
+        func = tcp->onClose;
+    }
+    else {
+        /* Pause receiving while the buffer is full, it is resumed once
+         * data is read from the buffer. Nothing may have been received,
+         * when it has already been read by the script, but there may be
+         * data left in the buffer. */
+        if (tcp->rxlength == tcp->rxcapacity) {
+            tcp->rxpaused = JS_TRUE;
+        }
+        argc = 0;
+        func = tcp->rxlength > 0 ? tcp->onData : JSVAL_VOID;
+        framed = tcp->lengthPrefix > 0 || tcp->delimlength > 0;
+    }
+
+    /*
+     * Invoke the callbacks. The onDrain callback is called once all queued
+     * data has been sent.
+     */
+    if (framed) {
+        TCPSocket_RxFrames(cx, obj, tcp);
+    }
+    else if (!JSVAL_IS_VOID(func)) {
+        TCPSocket_Invoke(cx, obj, func, argc, argv);
+    }
+    if (drained && tcp->state == TCPSTATE_CONNECTED && tcp->txlength == 0 &&
+        !JSVAL_IS_VOID(tcp->onDrain))
+    {
+        TCPSocket_Invoke(cx, obj, tcp->onDrain, 0, NULL);
+    }
+
+    /*
+     * Set up the selection again if we're still connected, which reflects
+     * what the callbacks have read and written.
+     */
+    if (tcp->state == TCPSTATE_CONNECTED) {
+        (void) TCPSocket_Arm(cx, obj, tcp);
+    }
+}
+
+/*
+ * Callback when the file descriptor has triggered an error.
+ */
+static void
+TCPSocket_SelectErrorCallback(JSContext *cx, JSObject *obj)
+{
+    TCPSocket* tcp = NULL;
+    jsval rval;
+    jsval func;
+    uintN argc = 0;
+    jsval argv[1];
+
+    tcp = (TCPSocket*) JS_GetPrivate(cx, obj);
+    if (!tcp) {
+        return;
+    }
+
+    /*
+     * Invoke the callback
+     */
+    TCPSocket_Invoke(cx, obj, tcp->onIOError, argc, argv);
+
+    /* Ensure to close the socket. */
+    TCPSocket_Close(cx, obj, 0, NULL, &rval);
+}
+
+/*
+ * The monotonic time in milliseconds.
+ */
+static jsdouble
+TCPSocket_Now()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (jsdouble) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/*
+ * Create a socket and connect it to an address. A non-blocking socket is
+ * still connecting once this returns. Returns the socket, or -1 with errno
+ * set if the connection has failed.
+ */
+static int
+TCPSocket_AttemptOpen(TCPSocket* tcp, const PSSockAddr* addr)
+{
+    PSSockAddr peer = *addr;
+    socklen_t length;
+    int fd, flags, error;
+
+    /*
+     * Complete the address with the port.
+     */
+    if (peer.sa.sa_family == AF_INET6) {
+        peer.sin6.sin6_port = htons(tcp->port);
+        length = sizeof(struct sockaddr_in6);
+    }
+    else {
+        peer.sin.sin_port = htons(tcp->port);
+        length = sizeof(struct sockaddr_in);
+    }
+
+    /*
+     * Create the socket. Set to non-blocking if requested.
+     */
+    fd = socket(peer.sa.sa_family, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (!tcp->blocking) {
+        if ((flags = fcntl(fd, F_GETFL, 0)) < 0) {
+            goto failed;
+        }
+        flags |= O_NONBLOCK;
+        if (fcntl(fd, F_SETFL, flags) < 0) {
+            goto failed;
+        }
+    }
+
+    /*
+     * Apply the socket options. The buffer sizes must be set before
+     * connecting, as the window scaling is agreed on while connecting.
+     */
+    if (TCPSocket_ApplyOptions(tcp, fd) < 0) {
+        goto failed;
+    }
+
+    /*
+     * Connect.
+     */
+    if (connect(fd, &peer.sa, length) == -1 &&
+        (tcp->blocking || errno != EINPROGRESS))
+    {
+        goto failed;
+    }
+    return fd;
+
+failed:
+    error = errno;
+    (void) close(fd);
+    errno = error;
+    return -1;
+}
+
+/*
+ * Start a connection attempt to the next address that can be attempted.
+ * Returns JS_FALSE if there are no addresses left.
+ */
+static JSBool
+TCPSocket_AttemptNext(JSContext *cx, JSObject *obj, TCPSocket* tcp)
+{
+    while (tcp->attempted < tcp->addrs.count) {
+        int i = tcp->attempted++;
+        int fd = TCPSocket_AttemptOpen(tcp, &tcp->addrs.addrs[i]);
+        if (fd < 0) {
+            tcp->attemptError = errno;
+            continue;
+        }
+        if (!ps_AddSelect(cx, fd, PSFDSET_WRITE, obj,
+                          &TCPSocket_AttemptCallback,
+                          &TCPSocket_AttemptCallback, -1))
+        {
+            tcp->attemptError = ENOMEM;
+            (void) close(fd);
+            continue;
+        }
+        tcp->attempts[i] = fd;
+        return JS_TRUE;
+    }
+    return JS_FALSE;
+}
+
+/*
+ * Set the timer for the next connection attempt, or for the connect timeout
+ * if all addresses have been attempted.
+ */
+static JSBool
+TCPSocket_AttemptArm(JSContext *cx, JSObject *obj, TCPSocket* tcp)
+{
+    jsdouble delay = tcp->deadline - TCPSocket_Now();
+
+    if (tcp->attemptTimer) {
+        ps_RemoveTimer(cx, tcp->attemptTimer);
+    }
+    if (tcp->attempted < tcp->addrs.count) {
+        delay = JS_MIN(delay, TCPSOCKET_ATTEMPT_DELAY);
+    }
+    tcp->attemptTimer = ps_AddTimer(cx, obj, &TCPSocket_AttemptTimeout,
+                                    (int) JS_MAX(delay, 0));
+    return tcp->attemptTimer != NULL;
+}
+
+/*
+ * Abandon the pending connection attempts.
+ */
+static void
+TCPSocket_AttemptsClear(JSContext *cx, TCPSocket* tcp)
+{
+    for (int i = 0; i < PS_DNS_ADDRESSES; ++i) {
+        if (tcp->attempts[i] != -1) {
+            ps_RemoveSelect(cx, tcp->attempts[i]);
+            (void) close(tcp->attempts[i]);
+            tcp->attempts[i] = -1;
+        }
+    }
+    if (tcp->attemptTimer) {
+        ps_RemoveTimer(cx, tcp->attemptTimer);
+        tcp->attemptTimer = NULL;
+    }
+}
+
+/*
+ * Report that the connection could not be established.
+ */
+static void
+TCPSocket_AttemptsFailed(JSContext *cx, JSObject *obj, TCPSocket* tcp,
+                         int error)
+{
+    JSString* data;
+    jsval argv[1];
+
+    TCPSocket_AttemptsClear(cx, tcp);
+    TCPSocket_SetState(cx, obj, tcp, TCPSTATE_UNCONNECTED);
+    if (!JSVAL_IS_VOID(tcp->onIOError)) {
+        data = JS_NewStringCopyZ(cx, strerror(error));
+        if (!data) {
+            return;
+        }
+        argv[0] = STRING_TO_JSVAL(data);
+        TCPSocket_Invoke(cx, obj, tcp->onIOError, 1, argv);
+    }
+}
+
+/*
+ * Callback when one or more connection attempts have completed. The first
+ * attempt that has succeeded becomes the connection, the others are
+ * abandoned.
+ */
+static void
+TCPSocket_AttemptCallback(JSContext *cx, JSObject *obj)
+{
+    TCPSocket* tcp = NULL;
+    struct pollfd fds[PS_DNS_ADDRESSES];
+    int index[PS_DNS_ADDRESSES];
+    socklen_t length;
+    JSBool failed = JS_FALSE;
+    JSBool pending = JS_FALSE;
+    int n = 0, error;
+
+    tcp = (TCPSocket*) JS_GetPrivate(cx, obj);
+    if (!tcp || tcp->state != TCPSTATE_CONNECTING) {
+        return;
+    }
+
+    /*
+     * Check which of the attempts have completed.
+     */
+    for (int i = 0; i < PS_DNS_ADDRESSES; ++i) {
+        if (tcp->attempts[i] != -1) {
+            fds[n].fd = tcp->attempts[i];
+            fds[n].events = POLLOUT;
+            fds[n].revents = 0;
+            index[n++] = i;
+        }
+    }
+    if (poll(fds, n, 0) < 0) {
+        return;
+    }
+    for (int k = 0; k < n; ++k) {
+        int i = index[k];
+        if (fds[k].revents == 0) {
+            pending = JS_TRUE;
+            continue;
+        }
+        length = sizeof(error);
+        if (getsockopt(tcp->attempts[i], SOL_SOCKET, SO_ERROR, &error,
+                       &length) < 0)
+        {
+            error = errno;
+        }
+        if (error == 0 && tcp->fd == -1) {
+            tcp->fd = tcp->attempts[i];
+            tcp->attempts[i] = -1;
+            continue;
+        }
+        if (error != 0) {
+            tcp->attemptError = error;
+            failed = JS_TRUE;
+            ps_RemoveSelect(cx, tcp->attempts[i]);
+            (void) close(tcp->attempts[i]);
+            tcp->attempts[i] = -1;
+        }
+    }
+
+    /*
+     * Connected: abandon the other attempts and set up the selection of the
+     * connected socket.
+     */
+    if (tcp->fd != -1) {
+        ps_RemoveSelect(cx, tcp->fd);
+        TCPSocket_AttemptsClear(cx, tcp);
+        TCPSocket_SetState(cx, obj, tcp, TCPSTATE_CONNECTED);
+        if (!JSVAL_IS_VOID(tcp->onConnect)) {
+            TCPSocket_Invoke(cx, obj, tcp->onConnect, 0, NULL);
+        }
+        if (tcp->state == TCPSTATE_CONNECTED) {
+            (void) TCPSocket_Arm(cx, obj, tcp);
+        }
+        return;
+    }
+
+    /*
+     * Move on to the next address right away if an attempt has failed.
+     */
+    if (failed) {
+        if (TCPSocket_AttemptNext(cx, obj, tcp)) {
+            (void) TCPSocket_AttemptArm(cx, obj, tcp);
+        }
+        else if (!pending) {
+            TCPSocket_AttemptsFailed(cx, obj, tcp, tcp->attemptError);
+        }
+    }
+}
+
+/*
+ * Callback when the next connection attempt is due, or when the connection
+ * has timed out.
+ */
+static void
+TCPSocket_AttemptTimeout(JSContext *cx, JSObject *obj)
+{
+    TCPSocket* tcp = NULL;
+
+    tcp = (TCPSocket*) JS_GetPrivate(cx, obj);
+    if (!tcp) {
+        return;
+    }
+    tcp->attemptTimer = NULL;
+    if (tcp->state != TCPSTATE_CONNECTING) {
+        return;
     }
-    else {
-        /* Connected: expecting data. If there is no data available, assume that
-         * the connection is closed by peer. */
-        char dummy;
-        ssize_t npeek = recv(tcp->fd, &dummy, 1, MSG_PEEK);
-        if (npeek == 0) {
-            ps_RemoveSelect(cx, tcp->fd);
-            (void) shutdown(tcp->fd, SHUT_WR);
-            (void) close(tcp->fd);
-            tcp->state = TCPSTATE_UNCONNECTED;
-            tcp->fd = -1;
-            argc = 0;
-            func = tcp->onClose;
-        }
-        else if (npeek < 0) {
-            /* Failure to read data, remove the descriptor so we're not
-             * triggered over and over again. */
-            const char* errmsg = strerror(errno);
-            ps_RemoveSelect(cx, tcp->fd);
-            tcp->state = TCPSTATE_UNCONNECTED;
-            func = tcp->onIOError;
-            JSString* data = JS_NewStringCopyZ(cx, errmsg);
-            if (!data) {
-                return;
-            }
-            argc = 1;
-            argv[0] = STRING_TO_JSVAL(data);
-        }
-	else {
-            argc = 0;
-            func = tcp->onData;
-        }
+    if (TCPSocket_Now() >= tcp->deadline) {
+        TCPSocket_AttemptsFailed(cx, obj, tcp, ETIMEDOUT);
+        return;
+    }
+    (void) TCPSocket_AttemptNext(cx, obj, tcp);
+    if (!TCPSocket_AttemptArm(cx, obj, tcp)) {
+        TCPSocket_AttemptsFailed(cx, obj, tcp, ENOMEM);
     }
+}
 
-    /*
-     * By default, set up a selection without timeout if we're connected. This
-     * may be overwritten with a user-defined timeout, or canceled, when the
-     * callback is called.
-     */
-    if (tcp->state == TCPSTATE_CONNECTED) {
-        if (!ps_AddSelect(cx, tcp->fd, PSFDSET_READ,
-                          obj, &TCPSocket_SelectCallback,
-                          &TCPSocket_SelectErrorCallback, -1))
-        {
-            JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
-                                 PSMSG_FAILED, "asynchronous socket setup");
-            return;
+/*
+ * Create the socket and connect to the addresses. A synchronous socket
+ * attempts the addresses one after the other. An asynchronous socket is
+ * connecting once this returns, the onConnect callback is called once the
+ * connection is established. Returns NULL on success, otherwise the error.
+ */
+static const char*
+TCPSocket_Open(JSContext *cx, JSObject *obj, TCPSocket* tcp,
+               const PSAddressList* addrs)
+{
+    tcp->addrs = *addrs;
+    tcp->attempted = 0;
+    tcp->attemptError = ENOTCONN;
+
+    if (tcp->blocking) {
+        while (tcp->attempted < tcp->addrs.count) {
+            tcp->fd = TCPSocket_AttemptOpen(tcp,
+                                            &tcp->addrs.addrs[tcp->attempted++]);
+            if (tcp->fd != -1) {
+                TCPSocket_SetState(cx, obj, tcp, TCPSTATE_CONNECTED);
+                return NULL;
+            }
+            tcp->attemptError = errno;
         }
+        return strerror(tcp->attemptError);
     }
 
-    /*
-     * Invoke the callback
-     */
-    TCPSocket_Invoke(cx, obj, func, argc, argv);
+    tcp->deadline = TCPSocket_Now() + tcp->timeout;
+    if (!TCPSocket_AttemptNext(cx, obj, tcp)) {
+        return strerror(tcp->attemptError);
+    }
+    TCPSocket_SetState(cx, obj, tcp, TCPSTATE_CONNECTING);
+    if (!TCPSocket_AttemptArm(cx, obj, tcp)) {
+        TCPSocket_AttemptsClear(cx, tcp);
+        TCPSocket_SetState(cx, obj, tcp, TCPSTATE_UNCONNECTED);
+        return "asynchronous socket setup";
+    }
+    return NULL;
 }
 
 /*
- * Callback when the file descriptor has triggered an error.
+ * Callback when the host name of the peer has been resolved.
  */
 static void
-TCPSocket_SelectErrorCallback(JSContext *cx, JSObject *obj)
+TCPSocket_ResolveCallback(JSContext *cx, JSObject *obj, const char *name,
+                          const PSAddressList *addrs, const char *error)
 {
     TCPSocket* tcp = NULL;
-    jsval rval;
-    jsval func;
-    uintN argc = 0;
+    JSString* data;
     jsval argv[1];
 
     tcp = (TCPSocket*) JS_GetPrivate(cx, obj);
     if (!tcp) {
         return;
     }
+    tcp->resolve = NULL;
 
     /*
-     * Invoke the callback
+     * Connect, or report the failure to resolve or connect.
      */
-    TCPSocket_Invoke(cx, obj, tcp->onIOError, argc, argv);
-
-    /* Ensure to close the socket. */
-    TCPSocket_Close(cx, obj, 0, NULL, &rval);
+    if (error == NULL) {
+        error = TCPSocket_Open(cx, obj, tcp, addrs);
+    }
+    if (error != NULL) {
+        TCPSocket_SetState(cx, obj, tcp, TCPSTATE_UNCONNECTED);
+        if (!JSVAL_IS_VOID(tcp->onIOError)) {
+            data = JS_NewStringCopyZ(cx, error);
+            if (!data) {
+                return;
+            }
+            argv[0] = STRING_TO_JSVAL(data);
+            TCPSocket_Invoke(cx, obj, tcp->onIOError, 1, argv);
+        }
+    }
 }
 
 /*
@@ -506,6 +1935,33 @@ TCPSocket_DT(JSContext* cx, JSObject *obj)
     }
 }
 
+/**
+ * Mark the callback functions, which are only referenced from the private
+ * instance data.
+ */
+static uint32
+TCPSocket_Mark(JSContext* cx, JSObject *obj, void *arg)
+{
+    TCPSocket* tcp = NULL;
+    jsval* funcs[5];
+
+    tcp = (TCPSocket*)JS_GetInstancePrivate(cx, obj, &tcpsocket_class, NULL);
+    if (tcp) {
+        funcs[0] = &tcp->onConnect;
+        funcs[1] = &tcp->onData;
+        funcs[2] = &tcp->onClose;
+        funcs[3] = &tcp->onIOError;
+        funcs[4] = &tcp->onDrain;
+        for (int i = 0; i < 5; ++i) {
+            if (JSVAL_IS_GCTHING(*funcs[i])) {
+                JS_MarkGCThing(cx, JSVAL_TO_GCTHING(*funcs[i]),
+                               "TCPSocket callback", arg);
+            }
+        }
+    }
+    return 0;
+}
+
 /**
  * Synopsis:
  *      connect(ip, port, timeout)
@@ -513,7 +1969,7 @@ TCPSocket_DT(JSContext* cx, JSObject *obj)
  *      Create a connection to a TCP server.
  * Parameter:
  *      ip      String
- *          IP Address or host name to connect to.
+ *          IPv4 or IPv6 address or host name to connect to.
  *      port    Integer
  *          Port number to connect to.
  *      timeout Integer (opt)
@@ -531,7 +1987,11 @@ TCPSocket_DT(JSContext* cx, JSObject *obj)
  *      established, or failed.
  *
  *      For an asynchronous socket, it returns immediately and the onConnect
- *      is called as soon as the connection is effective.
+ *      is called as soon as the connection is effective. A host name is
+ *      resolved without blocking, the onIOError is called if it cannot be
+ *      resolved. The addresses of a host name are attempted concurrently,
+ *      each starting a short while after the previous one, and the first
+ *      connection to be established is used.
  */
 static JSBool
 TCPSocket_Connect(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
@@ -539,13 +1999,10 @@ TCPSocket_Connect(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
 {
     TCPSocket* tcp = NULL;
     char* peer = "";
-    JSUint32 ip = 0;
+    const char* error;
+    PSAddressList addrs;
     JSUint16 port = 0;
     JSUint32 timeout = 5000;
-    struct sockaddr_in addr;
-    socklen_t len;
-    int result;
-    int dotted = 1;
 
     tcp = (TCPSocket*) JS_GetPrivate(cx, obj);
     if (!tcp) {
@@ -582,109 +2039,65 @@ TCPSocket_Connect(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
     }
 
     /* 
-     * Get the IP address from the peer
+     * If already connected, or connecting, close it first.
      */
-    for (char* cp = peer; *cp != '\0'; ++cp) {
-        if ((*cp < '0' || *cp > '9' ) && *cp != '.') {
-            dotted = 0;
-            break;
-        }
-    }
-    if (dotted) {
-        ip = inet_addr(peer);
-    }
-    else {
-        struct addrinfo* infos;
-        struct addrinfo* info;
-        struct addrinfo hint;
-
-        // Define any lookup hints
-        memset(&hint, 0, sizeof(struct addrinfo));
-        hint.ai_family = AF_INET;
-        hint.ai_socktype = SOCK_STREAM;
-        hint.ai_protocol = IPPROTO_TCP;
-
-        // Perform the lookup (this is likely to be expensive)
-        result = getaddrinfo(peer, NULL, &hint, &infos);
-        if (result != 0) {
-            JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
-                                 PSMSG_FAILED, "lookup error");
-            return JS_FALSE;
-        }
-        for (info = infos; info != NULL; info = info->ai_next)
-        {
-            // Use the first match
-            ip = ((struct sockaddr_in*)info->ai_addr)->sin_addr.s_addr;
-            break;
-        }
-        freeaddrinfo(infos);
+    if (tcp->resolve) {
+        ps_CancelResolve(cx, tcp->resolve);
+        tcp->resolve = NULL;
     }
-
-    /*
-     * Create the address structure.
-     */
-    len = sizeof(addr);
-    memset(&addr, 0, sizeof(struct sockaddr_in));
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(port);
-    addr.sin_addr.s_addr = ip;
-
-    /* 
-     * If already connected, close it first.
-     */
-    if (tcp->state == TCPSTATE_CONNECTED) {
+    TCPSocket_AttemptsClear(cx, tcp);
+    if (tcp->fd != -1) {
+        ps_RemoveSelect(cx, tcp->fd);
         (void) shutdown(tcp->fd, SHUT_WR);
         (void) close(tcp->fd);
-        tcp->state = TCPSTATE_UNCONNECTED;
         tcp->fd = -1;
     }
+    TCPSocket_SetState(cx, obj, tcp, TCPSTATE_UNCONNECTED);
 
     /*
-     * Create the socket. Set to non-blocking if requested.
+     * Discard any data left from a previous connection.
      */
+    tcp->rxhead = 0;
+    tcp->rxlength = 0;
+    tcp->rxpaused = JS_FALSE;
+    TCPSocket_TxClear(cx, tcp);
+    tcp->port = port;
+    tcp->timeout = timeout;
 
-    tcp->fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (!tcp->blocking) {
-        int flags;
-        if ((flags = fcntl(tcp->fd, F_GETFL, 0)) < 0) {
-            JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
-                                PSMSG_SOCKET_ERROR);
-            return JS_FALSE;
-        }
-        flags |= O_NONBLOCK;
-        if (fcntl(tcp->fd, F_SETFL, O_NONBLOCK, flags) < 0) {
+    /* 
+     * Get the IP addresses of the peer. An asynchronous socket resolves a
+     * host name that is not cached without blocking, and connects once it
+     * has been resolved.
+     */
+    if (tcp->blocking) {
+        error = ps_ResolveHostAddresses(cx, peer, &addrs);
+    }
+    else if (!ps_LookupHostAddresses(peer, &addrs, &error)) {
+        tcp->resolve = ps_ResolveHostAddressesAsync(cx, peer, obj,
+                                                    &TCPSocket_ResolveCallback);
+        if (!tcp->resolve) {
             JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
-                                PSMSG_SOCKET_ERROR);
+                                 PSMSG_FAILED, "asynchronous socket setup");
             return JS_FALSE;
         }
+        TCPSocket_SetState(cx, obj, tcp, TCPSTATE_RESOLVING);
+        return JS_TRUE;
+    }
+    if (error) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_FAILED, "lookup error");
+        return JS_FALSE;
     }
 
     /*
      * Connect.
      */
-    result = connect(tcp->fd, (struct sockaddr*)&addr, len);
-    if (result == -1) {
-        if (!tcp->blocking && errno == EINPROGRESS) {
-            tcp->state = TCPSTATE_CONNECTING;
-            if (!ps_AddSelect(cx, tcp->fd, PSFDSET_WRITE,
-                              obj, &TCPSocket_SelectCallback,
-                              &TCPSocket_SelectErrorCallback, timeout))
-            {
-                JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
-                                     PSMSG_FAILED, "asynchronous socket setup");
-                return JS_FALSE;
-            }
-        }
-        else {
-            JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
-                                PSMSG_FAILED, strerror(errno));
-            return JS_FALSE;
-        }
-    }
-    else {
-        tcp->state = TCPSTATE_CONNECTED;
+    error = TCPSocket_Open(cx, obj, tcp, &addrs);
+    if (error) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_FAILED, error);
+        return JS_FALSE;
     }
-
     return JS_TRUE;    
 }
 
@@ -708,12 +2121,23 @@ TCPSocket_Close(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
     if (!tcp) {
         return JS_FALSE;
     }
+    if (tcp->resolve) {
+        ps_CancelResolve(cx, tcp->resolve);
+        tcp->resolve = NULL;
+    }
+    TCPSocket_AttemptsClear(cx, tcp);
     if (tcp->fd != -1) {
+        /* Send what can still be sent of the queued data. */
+        if (tcp->state == TCPSTATE_CONNECTED) {
+            (void) TCPSocket_TxFlush(cx, tcp);
+        }
+        TCPSocket_TxClear(cx, tcp);
         ps_RemoveSelect(cx, tcp->fd);
         (void) shutdown(tcp->fd, SHUT_WR);
         (void) close(tcp->fd);
         tcp->fd = -1;
     }
+    TCPSocket_SetState(cx, obj, tcp, TCPSTATE_UNCONNECTED);
     return JS_TRUE;
 }
 
@@ -732,8 +2156,10 @@ TCPSocket_Close(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
  *              currently available data.
  * Returns:
  *      String  The available socket data in case of a synchronous socket. For
- *              asynchronous sockets, returns immediately and the onData
- *              callback is called when the data is received.
+ *              asynchronous sockets, returns immediately with the data that
+ *              has been received so far, the onData callback is called when
+ *              more data is received. The data is a ByteBuffer instead if the
+ *              binary property is set.
  * Exceptions:
  *      Argument is not an integer
  *      Argument is not a positive integer
@@ -747,10 +2173,10 @@ TCPSocket_Read(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
                   jsval *rval)
 {
     TCPSocket* tcp = NULL;
-    JSUint16 count = 65535;
+    size_t count = (size_t) -1;
     JSUint32 timeout = 0;
-    JSString* data;
-    ssize_t nread = 0;
+    jsval data;
+    JSBool eof;
 
     tcp = (TCPSocket*) JS_GetPrivate(cx, obj);
     if (!tcp) {
@@ -761,63 +2187,85 @@ TCPSocket_Read(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
      * Extract the count and timeout.
      */
     if (argc > 0) {
-        if (JS_TypeOfValue(cx, argv[0]) != JSTYPE_NUMBER) {
+        if (!JSVAL_IS_INT(argv[0])) {
+            JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                                 PSMSG_ARGUMENT_NOT_INT);
+            return JS_FALSE;
+        }
+        if (JSVAL_TO_INT(argv[0]) < 0) {
             JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
-                                 PSMSG_ARGUMENT_NOT_STRING);
+                                 PSMSG_ARGUMENT_NOT_POSITIVE_INT);
             return JS_FALSE;
         }
         count = JSVAL_TO_INT(argv[0]);
+        if (tcp->blocking && count > TCPSOCKET_RXBUF_MAX) {
+            JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                                 PSMSG_MAXIMUM_BLOCKING_READ);
+            return JS_FALSE;
+        }
         if (argc > 1) {
-            if (JS_TypeOfValue(cx, argv[0]) != JSTYPE_NUMBER) {
+            if (!JSVAL_IS_INT(argv[1])) {
                 JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
-                                    PSMSG_ARGUMENT_NOT_STRING);
+                                    PSMSG_ARGUMENT_NOT_INT);
                 return JS_FALSE;
             }
-            timeout = JSVAL_TO_INT(argv[0]);
+            timeout = JSVAL_TO_INT(argv[1]);
         }
     }
 
     /*
-     * Bail out if not connected.
+     * Bail out if not connected, unless there is received data left.
      */
-    if (tcp->state != TCPSTATE_CONNECTED) {
+    if (tcp->state != TCPSTATE_CONNECTED && tcp->rxlength == 0) {
         JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
                              PSMSG_FAILED, "not connected");
         return JS_FALSE;
     }
 
     /*
-     * Read the data.
+     * Receive the data into the receive buffer, if it does not hold enough
+     * data already. A synchronous read with a count blocks until that many
+     * bytes have been received, or the connection is closed.
      */
-    data = JS_NewGrowableString(cx, NULL, 0);
-    while (nread != count) {
-        char buf[256];
-        ssize_t buflen;
-
-        /* Determing how many bytes to read, either to fill up the local buffer
-         * or the remaining bytes left to read, whichever is the smallest. */
-        if ((count -nread) < sizeof(buf)) {
-            buflen = count - nread;
-        }
-        else {
-            buflen = sizeof(buf);
-        }
-
-        /* Read the buffer and concatenate to the result. */
-        buflen = recv(tcp->fd, buf, buflen, 0);
-        if (buflen == -1) {
+    if (tcp->state == TCPSTATE_CONNECTED && tcp->rxlength < count) {
+        if (TCPSocket_Receive(cx, tcp, &eof) < 0) {
             JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
                                 PSMSG_SOCKET_ERROR);
             return JS_FALSE;
         }
-        if (buflen == 0) {
-            break;
+        while (tcp->blocking && !eof && tcp->rxlength < count &&
+               count != (size_t) -1 && TCPSocket_RxReserve(cx, tcp))
+        {
+            ssize_t nrecv = TCPSocket_RxRecv(tcp, 0);
+            if (nrecv == 0) {
+                break;
+            }
+            if (nrecv < 0 && errno != EINTR) {
+                JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                                    PSMSG_SOCKET_ERROR);
+                return JS_FALSE;
+            }
+        }
+    }
+
+    /*
+     * Take the data from the receive buffer.
+     */
+    if (!TCPSocket_RxTake(cx, tcp, count, &data)) {
+        return JS_FALSE;
+    }
+
+    /*
+     * Resume receiving if it has been paused on a full buffer.
+     */
+    if (tcp->rxpaused && tcp->rxlength < tcp->rxcapacity) {
+        tcp->rxpaused = JS_FALSE;
+        if (tcp->state == TCPSTATE_CONNECTED && !TCPSocket_Arm(cx, obj, tcp)) {
+            return JS_FALSE;
         }
-        data = JS_ConcatStrings(cx, data, JS_NewStringCopyN(cx, buf, buflen));
-        nread += buflen;
     }
 
-    *rval = STRING_TO_JSVAL(data);
+    *rval = data;
     return JS_TRUE;
 }
 
@@ -825,12 +2273,17 @@ TCPSocket_Read(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
  * Synopsis:
  *      write()
  * Purpose:
- *      Write data to the socket.
+ *      Write data to the socket. For asynchronous sockets, the data that
+ *      cannot be sent right away is queued and sent when the socket becomes
+ *      writable. The queuedBytes property holds the number of bytes queued
+ *      and the onDrain callback is called once the queue has been sent.
  * Parameters:
- *      data    String
- *              THe data to be transmitted, may contain binary data.
+ *      data    String or ByteBuffer
+ *              The data to be transmitted, may contain binary data. Each
+ *              character of a string is a byte.
  * Exceptions:
  *      Not enough arguments specified
+ *      Argument is not a string
  *      Socket not ready
  *      Socket error
  */
@@ -840,7 +2293,137 @@ TCPSocket_Write(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
 {
     TCPSocket* tcp = NULL;
     JSString* data;
+    const jschar* chars;
+    char* bytes;
+    char* copy = NULL;
+    size_t length;
+    size_t offset = 0;
     ssize_t nwritten;
+    JSBool ok = JS_TRUE;
+
+    tcp = (TCPSocket*) JS_GetPrivate(cx, obj);
+    if (!tcp) {
+        return JS_FALSE;
+    }
+
+    /*
+     * Extract the data to write.
+     */
+    if (argc == 0) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_NOT_ENOUGH_ARGUMENTS);
+        return JS_FALSE;
+    }
+    bytes = ps_GetByteBufferData(cx, argv[0], &length);
+    if (!bytes && JS_TypeOfValue(cx, argv[0]) != JSTYPE_STRING) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_ARGUMENT_NOT_STRING);
+        return JS_FALSE;
+    }
+
+    /*
+     * Bail out if not connected.
+     */
+    if (tcp->state != TCPSTATE_CONNECTED) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_FAILED, "not connected");
+        return JS_FALSE;
+    }
+
+    /*
+     * Each character of a string is a byte, the data of a ByteBuffer is sent
+     * as it is.
+     */
+    if (!bytes) {
+        data = JSVAL_TO_STRING(argv[0]);
+        chars = JSSTRING_CHARS(data);
+        length = JSSTRING_LENGTH(data);
+        copy = bytes = (char*) JS_malloc(cx, length + 1);
+        if (!copy) {
+            return JS_FALSE;
+        }
+        for (size_t i = 0; i < length; ++i) {
+            copy[i] = (char) chars[i];
+        }
+    }
+
+    /*
+     * Send the data, unless earlier data is still queued. A synchronous
+     * socket blocks until all has been sent.
+     */
+    while (tcp->txlength == 0 && offset < length) {
+        nwritten = send(tcp->fd, bytes + offset, length - offset,
+                        tcp->blocking ? MSG_NOSIGNAL
+                                      : MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (nwritten == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (!tcp->blocking && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            }
+            JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                                 PSMSG_SOCKET_ERROR);
+            ok = JS_FALSE;
+            break;
+        }
+        offset += nwritten;
+    }
+
+    /*
+     * Queue what has not been sent.
+     */
+    if (ok && offset < length) {
+        ok = TCPSocket_TxQueue(cx, tcp, bytes + offset, length - offset) &&
+             TCPSocket_Arm(cx, obj, tcp);
+    }
+    if (copy) {
+        JS_free(cx, copy);
+    }
+    return ok;
+}
+
+/**
+ * Synopsis:
+ *      sendFile(path[, offset[, length]])
+ * Purpose:
+ *      Send (a part of) a file over the socket. The file is sent straight
+ *      from the file system, its contents are not read into a string. For
+ *      asynchronous sockets, it is queued after any data that is still
+ *      queued and sent as the socket becomes writable.
+ * Parameters:
+ *      path    String
+ *              The path of the file to send.
+ *      offset  Integer (opt)
+ *              The position in the file to start sending from. If omitted,
+ *              start from the beginning of the file.
+ *      length  Integer (opt)
+ *              The number of bytes to send. If omitted, send up to the end of
+ *              the file.
+ * Exceptions:
+ *      Not enough arguments specified
+ *      Argument is not a string
+ *      Argument is not a positive integer
+ *      Argument out of range
+ *      Socket error
+ *      Failed
+ * Additional Information:
+ *      The queuedBytes property includes the part of the file that has not
+ *      been sent yet, and the onDrain callback is called once it has been
+ *      sent.
+ */
+static JSBool
+TCPSocket_SendFile(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
+                   jsval *rval)
+{
+    TCPSocket* tcp = NULL;
+    const char* path;
+    struct stat st;
+    jsdouble offset = 0;
+    jsdouble length = -1;
+    JSBool flush;
+    JSBool ok = JS_TRUE;
+    int file;
 
     tcp = (TCPSocket*) JS_GetPrivate(cx, obj);
     if (!tcp) {
@@ -848,7 +2431,7 @@ TCPSocket_Write(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
     }
 
     /*
-     * Extract the string to write.
+     * Extract the arguments.
      */
     if (argc == 0) {
         JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
@@ -860,7 +2443,19 @@ TCPSocket_Write(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
                              PSMSG_ARGUMENT_NOT_STRING);
         return JS_FALSE;
     }
-    data = JSVAL_TO_STRING(argv[0]);
+    path = JS_GetStringBytes(JSVAL_TO_STRING(argv[0]));
+    if ((argc > 1 && !JS_ValueToNumber(cx, argv[1], &offset)) ||
+        (argc > 2 && !JS_ValueToNumber(cx, argv[2], &length)))
+    {
+        return JS_FALSE;
+    }
+    if (offset < 0 || offset != (off_t) offset ||
+        (argc > 2 && (length < 0 || length != (size_t) length)))
+    {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_ARGUMENT_NOT_POSITIVE_INT);
+        return JS_FALSE;
+    }
 
     /*
      * Bail out if not connected.
@@ -872,20 +2467,95 @@ TCPSocket_Write(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
     }
 
     /*
-     * Send the data.
+     * Open the file and check that the part to send lies within it.
+     */
+    file = open(path, O_RDONLY | O_CLOEXEC);
+    if (file < 0 || fstat(file, &st) < 0) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_FAILED, strerror(errno));
+        if (file >= 0) {
+            (void) close(file);
+        }
+        return JS_FALSE;
+    }
+    if (length < 0) {
+        length = offset <= st.st_size ? st.st_size - offset : -1;
+    }
+    if (length < 0 || offset + length > st.st_size) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_ARGUMENT_OUT_OF_RANGE);
+        (void) close(file);
+        return JS_FALSE;
+    }
+    if (length == 0) {
+        (void) close(file);
+        return JS_TRUE;
+    }
+
+    /*
+     * Queue the part of the file and send it right away, unless earlier data
+     * is still queued. A synchronous socket blocks until all has been sent.
      */
-    nwritten = send(tcp->fd,
-                    js_GetStringBytes(data),
-                    JSSTRING_LENGTH(data),
-                    0);
-    if (nwritten == -1) {
+    flush = (tcp->txlength == 0);
+    if (!TCPSocket_TxQueueFile(cx, tcp, file, (off_t) offset,
+                               (size_t) length))
+    {
+        (void) close(file);
+        return JS_FALSE;
+    }
+    while (ok && flush && tcp->txlength > 0) {
+        ok = TCPSocket_TxFlush(cx, tcp);
+        flush = tcp->blocking;
+    }
+    if (!ok) {
+        TCPSocket_TxClear(cx, tcp);
         JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
                              PSMSG_SOCKET_ERROR);
         return JS_FALSE;
     }
+    if (tcp->txlength > 0) {
+        return TCPSocket_Arm(cx, obj, tcp);
+    }
     return JS_TRUE;
 }
 
+/*
+ * Create an asynchronous TCPSocket instance for a connected socket, such as
+ * one accepted by a TCPServer.
+ */
+JSObject*
+ps_NewTCPSocket(JSContext *cx, int fd)
+{
+    JSObject* obj;
+    TCPSocket* tcp;
+
+    obj = js_NewObject(cx, &tcpsocket_class, NULL, NULL);
+    if (!obj) {
+        (void) close(fd);
+        return NULL;
+    }
+    tcp = TCPSocket_New(cx, JS_FALSE);
+    if (!tcp) {
+        (void) close(fd);
+        return NULL;
+    }
+    tcp->fd = fd;
+    if (!JS_SetPrivate(cx, obj, tcp)) {
+        TCPSocket_Delete(cx, tcp);
+        return NULL;
+    }
+    (void) TCPSocket_ApplyOptions(tcp, fd);
+    TCPSocket_SetState(cx, obj, tcp, TCPSTATE_CONNECTED);
+    if (!TCPSocket_Arm(cx, obj, tcp)) {
+        /* Unroot the object, so that it is collected with the socket. */
+        (void) close(tcp->fd);
+        tcp->fd = -1;
+        TCPSocket_SetState(cx, obj, tcp, TCPSTATE_UNCONNECTED);
+        return NULL;
+    }
+    return obj;
+}
+
 /**
  * System class initialiser.
  */
@@ -899,6 +2569,5 @@ ps_InitTCPSocketClass(JSContext *cx, JSObject *obj)
     if (!proto) {
         return NULL;
     }
-    /* What else */
     return proto;
 }
@@ -51,6 +51,12 @@ JS_BEGIN_EXTERN_C
 extern JSObject *
 ps_InitTCPSocketClass(JSContext *cx, JSObject *obj);
 
+/* Create an asynchronous 'TCPSocket' instance for a connected socket. The
+ * instance takes ownership of the file descriptor, which is closed on
+ * failure. */
+extern JSObject *
+ps_NewTCPSocket(JSContext *cx, int fd);
+
 JS_END_EXTERN_C
 
 #endif /* pstcpsocket_h___ */
@@ -0,0 +1,453 @@
+/*
+ * ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is the ProntoScript re-implementation October 4, 2025.
+ *
+ * The Initial Developer of the Original Code is Stefan Sinnige.
+ * Portions created by the Initial Developer are Copyright (C) 2025
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either of the GNU General Public License Version 2 or later (the "GPL"),
+ * or the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK *****
+ */
+
+#include "jsapi.h"
+#include "jscntxt.h"
+#include "jsfun.h"
+#include "jslock.h"
+#include "jstypes.h"
+#include "psselect.h"
+#include "pstimer.h"
+
+/*
+ *Forward declarations
+ */
+static JSBool Timer_ScheduleAfter(JSContext*, JSObject*, uintN, jsval*, jsval*);
+static JSBool Timer_SetTimeout(JSContext*, JSObject*, uintN, jsval*, jsval*);
+static JSBool Timer_SetInterval(JSContext*, JSObject*, uintN, jsval*, jsval*);
+static JSBool Timer_Clear(JSContext*, JSObject*, uintN, jsval*, jsval*);
+static void   Timer_DT(JSContext*, JSObject*);
+static void   Timer_SelectCallback(JSContext*, JSObject*);
+static JSBool Timer_Invoke(JSContext*, JSObject*, jsval, JSObject*);
+
+/*
+ * The timer private instance data. The timer object is rooted while the
+ * timer is pending, the function and its arguments are kept in reserved
+ * slots of the timer object.
+ */
+
+typedef struct {
+    JSObject* self;         /* The rooted timer object, or NULL. */
+    PSSelectTimer* timer;   /* The pending timer, or NULL. */
+    int32 interval;         /* The repeat interval, or -1 if not repeating. */
+    JSBool invoking;        /* True while the function is being invoked. */
+} Timer;
+
+enum timer_slot {
+    TIMER_SLOT_FUNCTION = 0,
+    TIMER_SLOT_ARGUMENTS = 1
+};
+
+/**
+ * Definition of the timer class
+ */
+static JSClass timer_class = {
+    "Timer",                        /* name */
+    JSCLASS_HAS_PRIVATE | JSCLASS_HAS_RESERVED_SLOTS(2), /* flags */
+    JS_PropertyStub,                /* add property */
+    JS_PropertyStub,                /* del property */
+    JS_PropertyStub,                /* get property */
+    JS_PropertyStub,                /* set property */
+    JS_EnumerateStub,               /* enumerate */
+    JS_ResolveStub,                 /* resolve */
+    JS_ConvertStub,                 /* convert */
+    Timer_DT,                       /* finalize */
+    JSCLASS_NO_OPTIONAL_MEMBERS
+};
+
+/**
+ * Definition of the global timer functions
+ */
+static JSFunctionSpec timer_functions[] = {
+    /* { name, call, nargs, flags, extra } */
+    {"scheduleAfter", Timer_ScheduleAfter, 2, 0, 0},
+    {"setTimeout", Timer_SetTimeout, 2, 0, 0},
+    {"setInterval", Timer_SetInterval, 2, 0, 0},
+    {"clearTimeout", Timer_Clear, 1, 0, 0},
+    {"clearInterval", Timer_Clear, 1, 0, 0},
+    {0, 0, 0, 0, 0}
+};
+
+/*
+ * Release the timer. Cancels the timer if it is still pending and unroots the
+ * timer object, unless its function is being invoked.
+ */
+static void
+Timer_Release(JSContext *cx, Timer *t)
+{
+    if (t->timer != NULL) {
+        ps_RemoveTimer(cx, t->timer);
+        t->timer = NULL;
+    }
+    t->interval = -1;
+    if (t->self != NULL && !t->invoking) {
+        JS_RemoveRoot(cx, &t->self);
+        t->self = NULL;
+    }
+}
+
+/*
+ * Create a timer object that calls the function with the arguments once the
+ * delay has expired, and then every interval if the interval is not -1.
+ */
+static JSBool
+Timer_Schedule(JSContext *cx, jsval func, uintN argc, jsval *argv,
+               int32 delay, int32 interval, jsval *rval)
+{
+    JSObject* obj;
+    JSObject* args;
+    Timer* t;
+
+    if (!JSVAL_IS_FUNCTION(cx, func)) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_ARGUMENT_NOT_A_FUNCTION);
+        return JS_FALSE;
+    }
+
+    /* Create the timer object, keeping the function and its arguments. */
+    obj = JS_NewObject(cx, &timer_class, NULL, NULL);
+    if (!obj) {
+        return JS_FALSE;
+    }
+    *rval = OBJECT_TO_JSVAL(obj);
+    args = JS_NewArrayObject(cx, argc, argv);
+    if (!args ||
+        !JS_SetReservedSlot(cx, obj, TIMER_SLOT_FUNCTION, func) ||
+        !JS_SetReservedSlot(cx, obj, TIMER_SLOT_ARGUMENTS,
+                            OBJECT_TO_JSVAL(args)))
+    {
+        return JS_FALSE;
+    }
+    t = (Timer*) JS_malloc(cx, sizeof(Timer));
+    if (!t) {
+        return JS_FALSE;
+    }
+    t->self = NULL;
+    t->timer = NULL;
+    t->interval = interval;
+    t->invoking = JS_FALSE;
+    if (!JS_SetPrivate(cx, obj, t)) {
+        JS_free(cx, t);
+        return JS_FALSE;
+    }
+
+    /* Keep the timer object alive while the timer is pending. */
+    t->self = obj;
+    if (!JS_AddNamedRoot(cx, &t->self, "Timer.self")) {
+        t->self = NULL;
+        return JS_FALSE;
+    }
+    t->timer = ps_AddTimer(cx, obj, &Timer_SelectCallback, delay);
+    if (!t->timer) {
+        Timer_Release(cx, t);
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_FAILED, "timer setup");
+        return JS_FALSE;
+    }
+    return JS_TRUE;
+}
+
+/*
+ * Get the delay argument in milliseconds, where negative delays are treated as
+ * no delay.
+ */
+static JSBool
+Timer_GetDelay(JSContext *cx, uintN argc, jsval *argv, uintN index,
+               int32 *delay)
+{
+    *delay = 0;
+    if (argc > index && !JSVAL_IS_VOID(argv[index])) {
+        if (JS_TypeOfValue(cx, argv[index]) != JSTYPE_NUMBER) {
+            JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                                 PSMSG_ARGUMENT_NOT_INT);
+            return JS_FALSE;
+        }
+        if (!JS_ValueToECMAInt32(cx, argv[index], delay)) {
+            return JS_FALSE;
+        }
+        if (*delay < 0) {
+            *delay = 0;
+        }
+    }
+    return JS_TRUE;
+}
+
+/*
+ * Callback when the timer has expired.
+ */
+static void
+Timer_SelectCallback(JSContext *cx, JSObject *obj)
+{
+    Timer* t = NULL;
+    jsval func, args;
+
+    t = (Timer*) JS_GetPrivate(cx, obj);
+    if (!t) {
+        return;
+    }
+    t->timer = NULL;
+
+    /* Re-arm a repeating timer before invoking the function, so that it can
+     * be cleared from within the function. */
+    if (t->interval >= 0) {
+        t->timer = ps_AddTimer(cx, obj, &Timer_SelectCallback, t->interval);
+    }
+
+    /*
+     * Invoke the callback
+     */
+    if (JS_GetReservedSlot(cx, obj, TIMER_SLOT_FUNCTION, &func) &&
+        JS_GetReservedSlot(cx, obj, TIMER_SLOT_ARGUMENTS, &args))
+    {
+        t->invoking = JS_TRUE;
+        Timer_Invoke(cx, obj, func, JSVAL_TO_OBJECT(args));
+        t->invoking = JS_FALSE;
+    }
+
+    /* Release a timer that is no longer pending. */
+    if (t->timer == NULL) {
+        Timer_Release(cx, t);
+    }
+}
+
+/*
+ * Invoke the timer function with the global object as 'this'.
+ */
+static JSBool
+Timer_Invoke(JSContext *cx, JSObject *obj, jsval fun, JSObject *args)
+{
+    JSStackFrame* fp;
+    jsval *sp, *oldsp;
+    jsuint argc;
+    void *mark;
+    JSBool result;
+
+    if (!JS_GetArrayLength(cx, args, &argc)) {
+        return JS_FALSE;
+    }
+
+    /* Allocate call stack frame and push the function, object and argument */
+    sp = js_AllocStack(cx, 2 + argc, &mark);
+    if (!sp) {
+        return JS_FALSE;
+    }
+    *sp++ = fun;
+    *sp++ = OBJECT_TO_JSVAL(cx->globalObject);
+    for (jsuint i = 0; i < argc; ++i) {
+        if (!JS_GetElement(cx, args, i, sp++)) {
+            js_FreeStack(cx, mark);
+            return JS_FALSE;
+        }
+    }
+
+    /* Lift current frame and call */
+    fp = cx->fp;
+    oldsp = fp->sp;
+    fp->sp = sp;
+    result = js_Invoke(cx, argc, JSINVOKE_INTERNAL | JSINVOKE_SKIP_CALLER);
+
+    /* Pop the call stack frame */
+    fp->sp = oldsp;
+    js_FreeStack(cx, mark);
+    return result;
+}
+
+/**
+ * Destructor.
+ */
+static void
+Timer_DT(JSContext* cx, JSObject *obj)
+{
+    Timer* t = NULL;
+    t = (Timer*)JS_GetInstancePrivate(cx, obj, &timer_class, NULL);
+    if (t) {
+        JS_free(cx, t);
+    }
+}
+
+/**
+ * Synopsis:
+ *      scheduleAfter(duration, onAfter[, id])
+ * Purpose:
+ *      Schedule a function to be called once after a specified duration.
+ * Parameters:
+ *      duration    Integer
+ *          Time in milliseconds after which the function is called.
+ *      onAfter     Function
+ *          The function to call.
+ *      id          Object (opt)
+ *          The argument to pass to the function.
+ * Returns:
+ *      A timer object that can be passed to clearTimeout().
+ * Exceptions:
+ *      Not enough arguments specified
+ *      Argument is not an integer
+ *      Argument is not a function
+ */
+static JSBool
+Timer_ScheduleAfter(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
+                    jsval *rval)
+{
+    int32 delay;
+
+    if (argc < 2) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_NOT_ENOUGH_ARGUMENTS);
+        return JS_FALSE;
+    }
+    if (!Timer_GetDelay(cx, argc, argv, 0, &delay)) {
+        return JS_FALSE;
+    }
+    return Timer_Schedule(cx, argv[1], argc > 2 ? 1 : 0, argv + 2, delay, -1,
+                          rval);
+}
+
+/**
+ * Synopsis:
+ *      setTimeout(func[, delay[, arg...]])
+ * Purpose:
+ *      Call a function once after a delay.
+ * Parameters:
+ *      func    Function
+ *          The function to call.
+ *      delay   Integer (opt)
+ *          Time in milliseconds after which the function is called. If
+ *          omitted, the function is called as soon as possible.
+ *      arg     Object (opt)
+ *          Any arguments to pass to the function.
+ * Returns:
+ *      A timer object that can be passed to clearTimeout().
+ * Exceptions:
+ *      Not enough arguments specified
+ *      Argument is not an integer
+ *      Argument is not a function
+ */
+static JSBool
+Timer_SetTimeout(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
+                 jsval *rval)
+{
+    int32 delay;
+
+    if (argc < 1) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_NOT_ENOUGH_ARGUMENTS);
+        return JS_FALSE;
+    }
+    if (!Timer_GetDelay(cx, argc, argv, 1, &delay)) {
+        return JS_FALSE;
+    }
+    return Timer_Schedule(cx, argv[0], argc > 2 ? argc - 2 : 0, argv + 2,
+                          delay, -1, rval);
+}
+
+/**
+ * Synopsis:
+ *      setInterval(func[, interval[, arg...]])
+ * Purpose:
+ *      Call a function repeatedly, every interval.
+ * Parameters:
+ *      func        Function
+ *          The function to call.
+ *      interval    Integer (opt)
+ *          Time in milliseconds between the calls of the function.
+ *      arg         Object (opt)
+ *          Any arguments to pass to the function.
+ * Returns:
+ *      A timer object that can be passed to clearInterval().
+ * Exceptions:
+ *      Not enough arguments specified
+ *      Argument is not an integer
+ *      Argument is not a function
+ */
+static JSBool
+Timer_SetInterval(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
+                  jsval *rval)
+{
+    int32 interval;
+
+    if (argc < 1) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_NOT_ENOUGH_ARGUMENTS);
+        return JS_FALSE;
+    }
+    if (!Timer_GetDelay(cx, argc, argv, 1, &interval)) {
+        return JS_FALSE;
+    }
+    return Timer_Schedule(cx, argv[0], argc > 2 ? argc - 2 : 0, argv + 2,
+                          interval, interval, rval);
+}
+
+/**
+ * Synopsis:
+ *      clearTimeout(timer)
+ *      clearInterval(timer)
+ * Purpose:
+ *      Cancel a timer. Cancelling a timer that has already expired, or
+ *      passing anything other than a timer, has no effect.
+ * Parameters:
+ *      timer   Object
+ *          The timer returned by scheduleAfter(), setTimeout() or
+ *          setInterval().
+ */
+static JSBool
+Timer_Clear(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
+            jsval *rval)
+{
+    Timer* t = NULL;
+
+    if (argc < 1 || !JSVAL_IS_OBJECT(argv[0]) || JSVAL_IS_NULL(argv[0])) {
+        return JS_TRUE;
+    }
+    t = (Timer*)JS_GetInstancePrivate(cx, JSVAL_TO_OBJECT(argv[0]),
+                                      &timer_class, NULL);
+    if (t) {
+        Timer_Release(cx, t);
+    }
+    return JS_TRUE;
+}
+
+/**
+ * Timer functions initialiser.
+ */
+JSObject*
+ps_InitTimerFunctions(JSContext *cx, JSObject *obj)
+{
+    if (!JS_DefineFunctions(cx, obj, timer_functions)) {
+        return NULL;
+    }
+    return obj;
+}
@@ -35,11 +35,18 @@
  * ***** END LICENSE BLOCK *****
  */
 
+/* Required for recvmmsg and sendmmsg. */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include "jsapi.h"
 #include "jscntxt.h"
 #include "jsfun.h"
 #include "jslock.h"
 #include "jstypes.h"
+#include "psbytebuffer.h"
+#include "psdnsresolver.h"
 #include "psselect.h"
 #include "psudpsocket.h"
 #include <errno.h>
@@ -48,8 +55,8 @@
 #include <netinet/in.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <string.h>
-#include <netdb.h>
 #include <unistd.h>
 
 #include <stdio.h>
@@ -63,21 +70,46 @@ static JSBool UDPSocket_Connect(JSContext*, JSObject*, uintN, jsval*, jsval*);
 static JSBool UDPSocket_Close(JSContext*, JSObject*, uintN, jsval*, jsval*);
 static JSBool UDPSocket_Read(JSContext*, JSObject*, uintN, jsval*, jsval*);
 static JSBool UDPSocket_Send(JSContext*, JSObject*, uintN, jsval*, jsval*);
+static JSBool UDPSocket_SendBatch(JSContext*, JSObject*, uintN, jsval*, jsval*);
+static JSBool UDPSocket_JoinGroup(JSContext*, JSObject*, uintN, jsval*, jsval*);
+static JSBool UDPSocket_LeaveGroup(JSContext*, JSObject*, uintN, jsval*, jsval*);
+static JSBool UDPSocket_Discover(JSContext*, JSObject*, uintN, jsval*, jsval*);
 static JSBool UDPSocket_CT(JSContext*, JSObject*, uintN, jsval*, jsval*);
 static void   UDPSocket_DT(JSContext*, JSObject*);
+static uint32 UDPSocket_Mark(JSContext*, JSObject*, void*);
 static void   UDPSocket_SelectCallback(JSContext*, JSObject*);
 static void   UDPSocket_SelectErrorCallback(JSContext*, JSObject*);
+static void   UDPSocket_DiscoverCallback(JSContext*, JSObject*);
 static JSBool UDPSocket_Invoke(JSContext*, JSObject*, jsval, uintN, jsval*);
 
+/*
+ * The datagrams are received in batches of UDPSOCKET_BATCH, each into a buffer
+ * that can hold the largest datagram. The buffers are shared by all sockets,
+ * as their callbacks are never nested.
+ */
+#define UDPSOCKET_BATCH 16
+#define UDPSOCKET_DATAGRAM_MAX 65536
+
+static char* udp_RxBuffers = NULL;
+
 /*
  * The UDPSocket socket class private instance data.
  */
 
 typedef struct {
+    JSObject* self;         /* The instance, rooted while open. */
     JSBool blocking;        /* True if blocking IO is to be used. */
+    JSBool binary;          /* True if data is received as a ByteBuffer. */
     jsval onData;           /* The on-data callback function. */
     jsval onIOError;        /* The on-error callback function. */
+    jsval onDiscoverEnd;    /* The end-of-discovery callback function. */
+    PSSelectTimer* discovery; /* The discovery deadline, or NULL. */
+    JSBool broadcast;       /* True if sending to broadcast addresses. */
+    JSBool multicastLoop;   /* True if own multicast packets are received. */
+    int multicastTTL;       /* The time-to-live of multicast packets. */
+    struct in_addr multicastInterface; /* The multicast interface. */
     int fd;                 /* The socket file descriptor, or -1. */
+    int family;             /* The address family of the socket. */
     int port;               /* The port number, or -1. */
 } UDPSocket;
 
@@ -86,7 +118,13 @@ typedef struct {
  */
 enum udpsocket_tinyid {
     UDPSOCKET_ONDATA = -1,
-    UDPSOCKET_ONIOERROR = -2
+    UDPSOCKET_ONIOERROR = -2,
+    UDPSOCKET_ONDISCOVEREND = -3,
+    UDPSOCKET_BROADCAST = -4,
+    UDPSOCKET_MULTICASTLOOP = -5,
+    UDPSOCKET_MULTICASTTTL = -6,
+    UDPSOCKET_MULTICASTINTERFACE = -7,
+    UDPSOCKET_BINARY = -8
 };
 
 #define UDPSOCKET_PROP_ATTRS (JSPROP_PERMANENT)
@@ -95,6 +133,13 @@ static JSPropertySpec udpsocket_props[] = {
     /* { name, tinyid, flags, getter, setter } */
     {"onData", UDPSOCKET_ONDATA, UDPSOCKET_PROP_ATTRS , 0, 0},
     {"onIOError", UDPSOCKET_ONIOERROR, UDPSOCKET_PROP_ATTRS , 0, 0},
+    {"onDiscoverEnd", UDPSOCKET_ONDISCOVEREND, UDPSOCKET_PROP_ATTRS , 0, 0},
+    {"broadcast", UDPSOCKET_BROADCAST, UDPSOCKET_PROP_ATTRS , 0, 0},
+    {"multicastLoop", UDPSOCKET_MULTICASTLOOP, UDPSOCKET_PROP_ATTRS , 0, 0},
+    {"multicastTTL", UDPSOCKET_MULTICASTTTL, UDPSOCKET_PROP_ATTRS , 0, 0},
+    {"multicastInterface", UDPSOCKET_MULTICASTINTERFACE,
+        UDPSOCKET_PROP_ATTRS , 0, 0},
+    {"binary", UDPSOCKET_BINARY, UDPSOCKET_PROP_ATTRS , 0, 0},
     {0, 0, 0, 0, 0}
 };
 
@@ -104,7 +149,11 @@ static JSPropertySpec udpsocket_props[] = {
 static JSFunctionSpec udpsocket_methods[] = {
     /* { name, call, nargs, flags, extra } */
     {"close", UDPSocket_Close, 0, 0, 0},
+    {"discover", UDPSocket_Discover, 4, 0, 0},
+    {"joinGroup", UDPSocket_JoinGroup, 1, 0, 0},
+    {"leaveGroup", UDPSocket_LeaveGroup, 1, 0, 0},
     {"send", UDPSocket_Send, 0, 0, 0},
+    {"sendBatch", UDPSocket_SendBatch, 1, 0, 0},
     {0, 0, 0, 0, 0}
 };
 
@@ -122,7 +171,14 @@ static JSClass udpsocket_class = {
     JS_ResolveStub,                 /* resolve */
     JS_ConvertStub,                 /* convert */
     UDPSocket_DT,                   /* finalize */
-    JSCLASS_NO_OPTIONAL_MEMBERS
+    NULL,                           /* get object ops */
+    NULL,                           /* check access */
+    NULL,                           /* call */
+    NULL,                           /* construct */
+    NULL,                           /* xdr object */
+    NULL,                           /* has instance */
+    UDPSocket_Mark,                 /* mark */
+    0                               /* reserve slots */
 };
 
 /*
@@ -137,8 +193,17 @@ UDPSocket_New(JSContext *cx, JSBool blocking)
     if (!udp) {
         return NULL;
     }
+    udp->self = NULL;
+    udp->blocking = blocking;
+    udp->binary = JS_FALSE;
     udp->onData = JSVAL_VOID;
     udp->onIOError = JSVAL_VOID;
+    udp->onDiscoverEnd = JSVAL_VOID;
+    udp->discovery = NULL;
+    udp->broadcast = JS_FALSE;
+    udp->multicastLoop = JS_TRUE;
+    udp->multicastTTL = 1;
+    udp->multicastInterface.s_addr = INADDR_ANY;
     udp->fd = -1;
     udp->port = -1;
     return udp;
@@ -147,16 +212,111 @@ UDPSocket_New(JSContext *cx, JSBool blocking)
 void
 UDPSocket_Delete(JSContext* cx, UDPSocket* udp)
 {
+    if (udp->self) {
+        JS_RemoveRoot(cx, &udp->self);
+    }
+    if (udp->discovery) {
+        ps_RemoveTimer(cx, udp->discovery);
+    }
     if (udp->fd != -1) {
+        ps_RemoveSelect(cx, udp->fd);
         close(udp->fd);
     }
     JS_free(cx, udp);
 }
 
+/*
+ * Set an integer or boolean socket option. The multicast options of IPv4 take
+ * a single byte, which Linux accepts as well as an integer.
+ */
+static JSBool
+UDPSocket_SetOption(JSContext *cx, UDPSocket* udp, int level, int name,
+                    int value)
+{
+    unsigned char byte = (unsigned char) value;
+    int result;
+
+    if (level == IPPROTO_IP) {
+        result = setsockopt(udp->fd, level, name, &byte, sizeof(byte));
+    }
+    else {
+        result = setsockopt(udp->fd, level, name, &value, sizeof(value));
+    }
+    if (result < 0) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL, PSMSG_SOCKET_ERROR);
+        return JS_FALSE;
+    }
+    return JS_TRUE;
+}
+
+/*
+ * The length of an IPv4 or IPv6 socket address.
+ */
+static socklen_t
+UDPSocket_AddressLength(const PSSockAddr* addr)
+{
+    return addr->sa.sa_family == AF_INET6 ? sizeof(struct sockaddr_in6)
+                                          : sizeof(struct sockaddr_in);
+}
+
+/*
+ * Set a multicast option. An IPv6 socket sends to IPv4 groups as well, so
+ * the option is set for both IPv4 and IPv6.
+ */
+static JSBool
+UDPSocket_SetMulticastOption(JSContext *cx, UDPSocket* udp, int name,
+                             int name6, int value)
+{
+    if (!UDPSocket_SetOption(cx, udp, IPPROTO_IP, name, value)) {
+        return JS_FALSE;
+    }
+    if (udp->family == AF_INET6) {
+        return UDPSocket_SetOption(cx, udp, IPPROTO_IPV6, name6, value);
+    }
+    return JS_TRUE;
+}
+
+/*
+ * Get the IP address of a local interface, or of a multicast group. An
+ * interface is always an IP address, so no host name is resolved.
+ */
+static JSBool
+UDPSocket_InterfaceAddress(JSContext *cx, jsval v, struct in_addr* addr)
+{
+    if (JS_TypeOfValue(cx, v) != JSTYPE_STRING) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_ARGUMENT_NOT_STRING);
+        return JS_FALSE;
+    }
+    if (!inet_aton(JS_GetStringBytes(JSVAL_TO_STRING(v)), addr)) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_FAILED, "invalid IP address");
+        return JS_FALSE;
+    }
+    return JS_TRUE;
+}
+
+/*
+ * Set the interface to send multicast packets from.
+ */
+static JSBool
+UDPSocket_ApplyInterface(JSContext *cx, UDPSocket* udp)
+{
+    if (setsockopt(udp->fd, IPPROTO_IP, IP_MULTICAST_IF,
+                   &udp->multicastInterface,
+                   sizeof(udp->multicastInterface)) < 0)
+    {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL, PSMSG_SOCKET_ERROR);
+        return JS_FALSE;
+    }
+    return JS_TRUE;
+}
+
 static JSBool
 UDPSocket_GetProperty(JSContext *cx, JSObject *obj, jsval id, jsval *vp)
 {   
     UDPSocket* udp = NULL;
+    JSString* str;
     jsint slot;
 
     /* Get the property's slot */
@@ -176,6 +336,26 @@ UDPSocket_GetProperty(JSContext *cx, JSObject *obj, jsval id, jsval *vp)
             case UDPSOCKET_ONIOERROR:
                 *vp = udp->onIOError;
                 break;
+            case UDPSOCKET_ONDISCOVEREND:
+                *vp = udp->onDiscoverEnd;
+                break;
+            case UDPSOCKET_BROADCAST:
+                *vp = BOOLEAN_TO_JSVAL(udp->broadcast);
+                break;
+            case UDPSOCKET_MULTICASTLOOP:
+                *vp = BOOLEAN_TO_JSVAL(udp->multicastLoop);
+                break;
+            case UDPSOCKET_MULTICASTTTL:
+                *vp = INT_TO_JSVAL(udp->multicastTTL);
+                break;
+            case UDPSOCKET_MULTICASTINTERFACE:
+                str = JS_NewStringCopyZ(cx,
+                        inet_ntoa(udp->multicastInterface));
+                *vp = str ? STRING_TO_JSVAL(str) : JSVAL_NULL;
+                break;
+            case UDPSOCKET_BINARY:
+                *vp = BOOLEAN_TO_JSVAL(udp->binary);
+                break;
             default:
                 break;
         }
@@ -188,6 +368,9 @@ static JSBool
 UDPSocket_SetProperty(JSContext *cx, JSObject *obj, jsval id, jsval *vp)
 {
     UDPSocket* udp = NULL;
+    JSBool ok = JS_TRUE;
+    JSBool b;
+    int32 i;
     jsint slot;
 
     /* Get the property's slot */
@@ -199,6 +382,10 @@ UDPSocket_SetProperty(JSContext *cx, JSObject *obj, jsval id, jsval *vp)
     /* Set the value */
     JS_LOCK_OBJ(cx, obj);
     udp = (UDPSocket*)JS_GetInstancePrivate(cx, obj, &udpsocket_class, NULL);
+    if (!udp) {
+        JS_UNLOCK_OBJ(cx, obj);
+        return JS_TRUE;
+    }
     switch (slot) {
         case UDPSOCKET_ONDATA:
             if (JSVAL_IS_FUNCTION(cx, *vp)) {
@@ -210,25 +397,165 @@ UDPSocket_SetProperty(JSContext *cx, JSObject *obj, jsval id, jsval *vp)
                 udp->onIOError = *vp;
             }
             break;
+        case UDPSOCKET_ONDISCOVEREND:
+            if (JSVAL_IS_FUNCTION(cx, *vp)) {
+                udp->onDiscoverEnd = *vp;
+            }
+            break;
+        case UDPSOCKET_BROADCAST:
+            ok = JS_ValueToBoolean(cx, *vp, &b) &&
+                 UDPSocket_SetOption(cx, udp, SOL_SOCKET, SO_BROADCAST, b);
+            if (ok) {
+                udp->broadcast = b;
+            }
+            break;
+        case UDPSOCKET_MULTICASTLOOP:
+            ok = JS_ValueToBoolean(cx, *vp, &b) &&
+                 UDPSocket_SetMulticastOption(cx, udp, IP_MULTICAST_LOOP,
+                                              IPV6_MULTICAST_LOOP, b);
+            if (ok) {
+                udp->multicastLoop = b;
+            }
+            break;
+        case UDPSOCKET_MULTICASTTTL:
+            if (!JSVAL_IS_INT(*vp)) {
+                JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                                     PSMSG_ARGUMENT_NOT_INT);
+                ok = JS_FALSE;
+                break;
+            }
+            i = JSVAL_TO_INT(*vp);
+            if (i < 0 || i > 255) {
+                JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                                     PSMSG_ARGUMENT_OUT_OF_RANGE);
+                ok = JS_FALSE;
+                break;
+            }
+            ok = UDPSocket_SetMulticastOption(cx, udp, IP_MULTICAST_TTL,
+                                              IPV6_MULTICAST_HOPS, i);
+            if (ok) {
+                udp->multicastTTL = i;
+            }
+            break;
+        case UDPSOCKET_MULTICASTINTERFACE:
+            ok = UDPSocket_InterfaceAddress(cx, *vp,
+                                            &udp->multicastInterface) &&
+                 UDPSocket_ApplyInterface(cx, udp);
+            break;
+        case UDPSOCKET_BINARY:
+            ok = JS_ValueToBoolean(cx, *vp, &udp->binary);
+            break;
     }
     JS_UNLOCK_OBJ(cx, obj);
+    return ok;
+}
+
+/*
+ * Receive a batch of datagrams without blocking, each into its own buffer.
+ * Returns the number of datagrams received, or -1 on error.
+ */
+static int
+UDPSocket_Receive(UDPSocket* udp, PSSockAddr* addrs, size_t* lengths)
+{
+#ifdef HAVE_RECVMMSG
+    struct mmsghdr msgs[UDPSOCKET_BATCH];
+    struct iovec iovs[UDPSOCKET_BATCH];
+    int n;
+
+    memset(msgs, 0, sizeof(msgs));
+    for (int i = 0; i < UDPSOCKET_BATCH; ++i) {
+        iovs[i].iov_base = udp_RxBuffers + i * UDPSOCKET_DATAGRAM_MAX;
+        iovs[i].iov_len = UDPSOCKET_DATAGRAM_MAX;
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = &addrs[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+    }
+    do {
+        n = recvmmsg(udp->fd, msgs, UDPSOCKET_BATCH, MSG_DONTWAIT, NULL);
+    } while (n < 0 && errno == EINTR);
+    for (int i = 0; i < n; ++i) {
+        lengths[i] = msgs[i].msg_len;
+    }
+    return n;
+#else
+    int n;
+
+    for (n = 0; n < UDPSOCKET_BATCH; ++n) {
+        socklen_t len = sizeof(addrs[n]);
+        ssize_t nread = recvfrom(udp->fd,
+                                 udp_RxBuffers + n * UDPSOCKET_DATAGRAM_MAX,
+                                 UDPSOCKET_DATAGRAM_MAX, MSG_DONTWAIT,
+                                 (struct sockaddr*)&addrs[n], &len);
+        if (nread < 0) {
+            if (errno == EINTR) {
+                --n;
+                continue;
+            }
+            return n > 0 ? n : -1;
+        }
+        lengths[n] = nread;
+    }
+    return n;
+#endif
+}
+
+/*
+ * Create the value of the received data, with a single allocation. The data
+ * is a ByteBuffer for a binary socket, otherwise a string of which each byte
+ * is a character.
+ */
+static JSBool
+UDPSocket_NewData(JSContext *cx, UDPSocket* udp, const char* bytes,
+                  size_t length, jsval* vp)
+{
+    JSObject* buf;
+    JSString* str;
+    jschar* chars;
+    char* data;
+
+    if (udp->binary) {
+        buf = ps_NewByteBuffer(cx, length, &data);
+        if (!buf) {
+            return JS_FALSE;
+        }
+        memcpy(data, bytes, length);
+        *vp = OBJECT_TO_JSVAL(buf);
+        return JS_TRUE;
+    }
+    chars = (jschar*) JS_malloc(cx, (length + 1) * sizeof(jschar));
+    if (!chars) {
+        return JS_FALSE;
+    }
+    for (size_t i = 0; i < length; ++i) {
+        chars[i] = (unsigned char) bytes[i];
+    }
+    chars[length] = 0;
+    str = JS_NewUCString(cx, chars, length);
+    if (!str) {
+        JS_free(cx, chars);
+        return JS_FALSE;
+    }
+    *vp = STRING_TO_JSVAL(str);
     return JS_TRUE;
 }
 
 /*
  * Callback when the file descriptor has been triggered. That means that there
- * is data available on the socket.
+ * are datagrams available on the socket. The onData callback is called for
+ * each datagram, with its data and the address and port of its sender.
  */
 static void
 UDPSocket_SelectCallback(JSContext *cx, JSObject *obj)
 {
     UDPSocket* udp = NULL;
-    JSString* data;
-    JSString* host;
-    jsval func;
-    struct sockaddr_in addr;
-    socklen_t len = sizeof(addr);
-    ssize_t nread;
+    PSSockAddr addrs[UDPSOCKET_BATCH];
+    size_t lengths[UDPSOCKET_BATCH];
+    char host[INET6_ADDRSTRLEN];
+    JSString* str;
+    JSTempValueRooter tvr;
+    jsval argv[3];
+    int n;
 
     udp = (UDPSocket*) JS_GetPrivate(cx, obj);
     if (!udp) {
@@ -236,42 +563,55 @@ UDPSocket_SelectCallback(JSContext *cx, JSObject *obj)
     }
 
     /* 
-     * Receive the datagram.
+     * Receive the datagrams.
      */
-    memset(&addr, 0, sizeof(addr));
-    data = JS_NewGrowableString(cx, NULL, 0);
-    while (1) {
-        char buf[256];
-        nread = recvfrom(udp->fd, buf, sizeof(buf), 0,
-                         (struct sockaddr*)&addr, &len);
-        if (nread < 0) {
-            if (errno == EAGAIN) {
-                /* No more data */
-                break;
-            }
-            JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
-                                 PSMSG_SOCKET_ERROR);
+    if (!udp_RxBuffers) {
+        udp_RxBuffers = (char*) JS_malloc(cx,
+                UDPSOCKET_BATCH * UDPSOCKET_DATAGRAM_MAX);
+        if (!udp_RxBuffers) {
             return;
         }
-        data = JS_ConcatStrings(cx, data, JS_NewStringCopyN(cx, buf, nread));
     }
-    host = JS_NewStringCopyZ(cx, inet_ntoa(addr.sin_addr));
-
-    /*
-     * The select callback would indicate that data is ready to be received.
-     */
-
-    uintN argc = 3;
-    jsval argv[3];
-    argv[0] = STRING_TO_JSVAL(data);
-    argv[1] = STRING_TO_JSVAL(host);
-    argv[2] = INT_TO_JSVAL(ntohs(addr.sin_port));
-    func = udp->onData;
+    n = UDPSocket_Receive(udp, addrs, lengths);
+    if (n < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK &&
+            !JSVAL_IS_VOID(udp->onIOError))
+        {
+            str = JS_NewStringCopyZ(cx, strerror(errno));
+            if (str) {
+                argv[0] = STRING_TO_JSVAL(str);
+                UDPSocket_Invoke(cx, obj, udp->onIOError, 1, argv);
+            }
+        }
+        return;
+    }
 
     /*
-     * Invoke the callback
+     * Invoke the callback for each datagram, unless the socket is closed by
+     * the callback.
      */
-    UDPSocket_Invoke(cx, obj, func, argc, argv);
+    argv[0] = argv[1] = argv[2] = JSVAL_NULL;
+    JS_PUSH_TEMP_ROOT(cx, 3, argv, &tvr);
+    for (int i = 0; i < n && udp->fd != -1 && !JSVAL_IS_VOID(udp->onData);
+         ++i)
+    {
+        if (!UDPSocket_NewData(cx, udp,
+                               udp_RxBuffers + i * UDPSOCKET_DATAGRAM_MAX,
+                               lengths[i], &argv[0]))
+        {
+            break;
+        }
+        str = JS_NewStringCopyZ(cx, ps_FormatAddress(&addrs[i], host));
+        if (!str) {
+            break;
+        }
+        argv[1] = STRING_TO_JSVAL(str);
+        argv[2] = INT_TO_JSVAL(ntohs(addrs[i].sa.sa_family == AF_INET6
+                                     ? addrs[i].sin6.sin6_port
+                                     : addrs[i].sin.sin_port));
+        UDPSocket_Invoke(cx, obj, udp->onData, 3, argv);
+    }
+    JS_POP_TEMP_ROOT(cx, &tvr);
 }
 
 /*
@@ -300,6 +640,28 @@ UDPSocket_SelectErrorCallback(JSContext *cx, JSObject *obj)
     UDPSocket_Close(cx, obj, 0, NULL, &rval);
 }
 
+/*
+ * Callback when the deadline of a discovery has expired. Any responses have
+ * already been passed to the onData callback as they arrived.
+ */
+static void
+UDPSocket_DiscoverCallback(JSContext *cx, JSObject *obj)
+{
+    UDPSocket* udp = NULL;
+    jsval argv[1];
+
+    udp = (UDPSocket*) JS_GetPrivate(cx, obj);
+    if (!udp) {
+        return;
+    }
+
+    /* The timer is released once it has expired. */
+    udp->discovery = NULL;
+    if (!JSVAL_IS_VOID(udp->onDiscoverEnd)) {
+        UDPSocket_Invoke(cx, obj, udp->onDiscoverEnd, 0, argv);
+    }
+}
+
 /*
  * Invoke a callback function.
  */
@@ -360,11 +722,10 @@ UDPSocket_CT(JSContext* cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
 {
     JSBool ok = JS_TRUE;
     UDPSocket* udp = NULL;
-    JSUint16 port;
-    JSString* str;
+    int port = -1;
     JSBool blocking = JS_FALSE;
-    struct sockaddr_in addr;
-    int flags;
+    PSSockAddr addr;
+    int flags, v6only = 0;
 
     /* Create the object */
     if (!obj) {
@@ -373,22 +734,51 @@ UDPSocket_CT(JSContext* cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
             return JS_FALSE;
         }
     }
-    udp = UDPSocket_New(cx, blocking);
 
     /* Get the optional 'port' argument */
-    if (argc >= 0) {
-        if (JS_TypeOfValue(cx, argv[0]) != JSTYPE_NUMBER) {
-            port = JSVAL_TO_INT(argv[0]);
-        }
-        else {
+    if (argc > 0 && !JSVAL_IS_VOID(argv[0])) {
+        if (!JSVAL_IS_INT(argv[0])) {
             JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
                                  PSMSG_ARGUMENT_NOT_INT);
             return JS_FALSE;
         }
+        port = JSVAL_TO_INT(argv[0]);
+        if (port < 0 || port > 65535) {
+            JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                                 PSMSG_ARGUMENT_OUT_OF_RANGE);
+            return JS_FALSE;
+        }
+    }
+
+    /* Set the private instance state object, which closes the socket when
+     * the instance is finalized. */
+    udp = UDPSocket_New(cx, blocking);
+    if (!udp) {
+        return JS_FALSE;
+    }
+    JS_LOCK_OBJ(cx, obj);
+    ok = JS_SetPrivate(cx, obj, udp);
+    JS_UNLOCK_OBJ(cx, obj);
+    if (!ok) {
+        JS_free(cx, udp);
+        return JS_FALSE;
     }
 
-    /* Create the UDP socket */
-    udp->fd = socket(AF_INET, SOCK_DGRAM, 0);
+    /* Create the UDP socket. An IPv6 socket that also sends to and receives
+     * from IPv4 addresses is used, unless IPv6 is not available. */
+    udp->family = AF_INET6;
+    udp->fd = socket(AF_INET6, SOCK_DGRAM, 0);
+    if (udp->fd >= 0 &&
+        setsockopt(udp->fd, IPPROTO_IPV6, IPV6_V6ONLY, &v6only,
+                   sizeof(v6only)) < 0)
+    {
+        (void) close(udp->fd);
+        udp->fd = -1;
+    }
+    if (udp->fd < 0) {
+        udp->family = AF_INET;
+        udp->fd = socket(AF_INET, SOCK_DGRAM, 0);
+    }
     udp->port = port;
     if (udp->fd < 0) {
         JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL, PSMSG_SOCKET_ERROR);
@@ -397,13 +787,21 @@ UDPSocket_CT(JSContext* cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
 
     /* If a port has been specified, bind to it. */
     if (udp->port != -1) {
-        memset(&addr, 0, sizeof(struct sockaddr_in));
-        addr.sin_family = AF_INET;
-        addr.sin_addr.s_addr = INADDR_ANY;
-        addr.sin_port = htons(port);
-        if (bind(udp->fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        memset(&addr, 0, sizeof(addr));
+        if (udp->family == AF_INET6) {
+            addr.sin6.sin6_family = AF_INET6;
+            addr.sin6.sin6_addr = in6addr_any;
+            addr.sin6.sin6_port = htons(port);
+        }
+        else {
+            addr.sin.sin_family = AF_INET;
+            addr.sin.sin_addr.s_addr = INADDR_ANY;
+            addr.sin.sin_port = htons(port);
+        }
+        if (bind(udp->fd, &addr.sa, UDPSocket_AddressLength(&addr)) < 0) {
             JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
-                                 PSMSG_SOCKET_ERROR);
+                                 errno == EADDRINUSE ? PSMSG_ADDRESS_IN_USE
+                                                     : PSMSG_SOCKET_ERROR);
             return JS_FALSE;
         }
     }
@@ -415,14 +813,15 @@ UDPSocket_CT(JSContext* cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
         return JS_FALSE;
     }
     flags |= O_NONBLOCK;
-    if (fcntl(udp->fd, F_SETFL, O_NONBLOCK, flags) < 0) {
+    if (fcntl(udp->fd, F_SETFL, flags) < 0) {
         JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
                              PSMSG_SOCKET_ERROR);
         return JS_FALSE;
     }
 
     /* Add the file descriptor to the asynchroneous select mechanism that
-     * will be triggered when UDP packets are available on the socket. */
+     * will be triggered when UDP packets are available on the socket. The
+     * instance is kept alive until it is closed. */
     if (!ps_AddSelect(cx, udp->fd, PSFDSET_READ,
                       obj, &UDPSocket_SelectCallback,
                       &UDPSocket_SelectErrorCallback, -1))
@@ -431,12 +830,9 @@ UDPSocket_CT(JSContext* cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
                              PSMSG_FAILED, "asynchronous socket setup");
         return JS_FALSE;
     }
-
-    /* Set the private instance state object */
-    JS_LOCK_OBJ(cx, obj);
-    ok = JS_SetPrivate(cx, obj, udp);
-    JS_UNLOCK_OBJ(cx, obj);
-    if (!ok) {
+    udp->self = obj;
+    if (!JS_AddNamedRoot(cx, &udp->self, "UDPSocket.self")) {
+        udp->self = NULL;
         return JS_FALSE;
     }
     return JS_TRUE;
@@ -455,6 +851,33 @@ UDPSocket_DT(JSContext* cx, JSObject *obj)
     }
 }
 
+/**
+ * Mark the callback functions, which are only referenced from the private
+ * instance data.
+ */
+static uint32
+UDPSocket_Mark(JSContext* cx, JSObject *obj, void *arg)
+{
+    UDPSocket* udp = NULL;
+
+    udp = (UDPSocket*)JS_GetInstancePrivate(cx, obj, &udpsocket_class, NULL);
+    if (udp) {
+        if (JSVAL_IS_GCTHING(udp->onData)) {
+            JS_MarkGCThing(cx, JSVAL_TO_GCTHING(udp->onData),
+                           "UDPSocket callback", arg);
+        }
+        if (JSVAL_IS_GCTHING(udp->onIOError)) {
+            JS_MarkGCThing(cx, JSVAL_TO_GCTHING(udp->onIOError),
+                           "UDPSocket callback", arg);
+        }
+        if (JSVAL_IS_GCTHING(udp->onDiscoverEnd)) {
+            JS_MarkGCThing(cx, JSVAL_TO_GCTHING(udp->onDiscoverEnd),
+                           "UDPSocket callback", arg);
+        }
+    }
+    return 0;
+}
+
 /**
  * Synopsis:
  *      close()
@@ -475,22 +898,133 @@ UDPSocket_Close(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
     if (!udp) {
         return JS_FALSE;
     }
+    if (udp->discovery) {
+        ps_RemoveTimer(cx, udp->discovery);
+        udp->discovery = NULL;
+    }
     if (udp->fd != -1) {
         ps_RemoveSelect(cx, udp->fd);
         close(udp->fd);
         udp->fd = -1;
     }
+    if (udp->self) {
+        JS_RemoveRoot(cx, &udp->self);
+        udp->self = NULL;
+    }
     return JS_TRUE;
 }
 
+/*
+ * Get the destination address of a datagram. Host names are resolved through
+ * the host name cache, so that each destination is only parsed or resolved
+ * once while it is cached. An IPv6 socket sends to an IPv4 address as an
+ * IPv4-mapped IPv6 address.
+ */
+static JSBool
+UDPSocket_Address(JSContext *cx, UDPSocket* udp, jsval host, jsval port,
+                  PSSockAddr* addr)
+{
+    PSAddressList addrs;
+    int i = 0;
+
+    if (JS_TypeOfValue(cx, host) != JSTYPE_STRING) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_ARGUMENT_NOT_STRING);
+        return JS_FALSE;
+    }
+    if (!JSVAL_IS_INT(port)) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_ARGUMENT_NOT_INT);
+        return JS_FALSE;
+    }
+    if (JSVAL_TO_INT(port) < 0 || JSVAL_TO_INT(port) > 65535) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_ARGUMENT_OUT_OF_RANGE);
+        return JS_FALSE;
+    }
+    if (ps_ResolveHostAddresses(cx, JS_GetStringBytes(JSVAL_TO_STRING(host)),
+                                &addrs))
+    {
+        addrs.count = 0;
+    }
+    if (udp->family == AF_INET) {
+        while (i < addrs.count && addrs.addrs[i].sa.sa_family != AF_INET) {
+            ++i;
+        }
+    }
+    if (i >= addrs.count) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_FAILED, "lookup error");
+        return JS_FALSE;
+    }
+    *addr = addrs.addrs[i];
+    if (udp->family == AF_INET6 && addr->sa.sa_family == AF_INET) {
+        struct in_addr ip = addr->sin.sin_addr;
+        memset(addr, 0, sizeof(PSSockAddr));
+        addr->sin6.sin6_family = AF_INET6;
+        addr->sin6.sin6_addr.s6_addr[10] = 0xff;
+        addr->sin6.sin6_addr.s6_addr[11] = 0xff;
+        memcpy(&addr->sin6.sin6_addr.s6_addr[12], &ip, sizeof(ip));
+    }
+    if (addr->sa.sa_family == AF_INET6) {
+        addr->sin6.sin6_port = htons(JSVAL_TO_INT(port));
+    }
+    else {
+        addr->sin.sin_port = htons(JSVAL_TO_INT(port));
+    }
+    return JS_TRUE;
+}
+
+/*
+ * Get the data of a datagram, which is either the data of a ByteBuffer or a
+ * string.
+ */
+static JSBool
+UDPSocket_Payload(JSContext *cx, jsval v, const char** bytes, JSString** str,
+                  size_t* length)
+{
+    *str = NULL;
+    *bytes = ps_GetByteBufferData(cx, v, length);
+    if (!*bytes) {
+        if (JS_TypeOfValue(cx, v) != JSTYPE_STRING) {
+            JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                                 PSMSG_ARGUMENT_NOT_STRING);
+            return JS_FALSE;
+        }
+        *str = JSVAL_TO_STRING(v);
+        *length = JSSTRING_LENGTH(*str);
+    }
+    if (*length > UDPSOCKET_DATAGRAM_MAX) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_ARGUMENT_OUT_OF_RANGE);
+        return JS_FALSE;
+    }
+    return JS_TRUE;
+}
+
+/*
+ * Copy the data of a datagram. Each character of the string is a byte.
+ */
+static void
+UDPSocket_GetBytes(JSString* str, char* bytes)
+{
+    const jschar* chars = JSSTRING_CHARS(str);
+    size_t length = JSSTRING_LENGTH(str);
+
+    for (size_t i = 0; i < length; ++i) {
+        bytes[i] = (char) chars[i];
+    }
+}
+
 /**
  * Synopsis:
  *      send(s, host, port)
  * Purpose:
  *      Send a UDP packet.
  * Parameters:
- *      s       String
- *              The data to be transmitted, may contain binary data.
+ *      s       String or ByteBuffer
+ *              The data to be transmitted, may contain binary data. Each
+ *              character of a string is a byte.
  *      host    String
  *              The destination IP address of the packet.
  *      port    Integer
@@ -509,14 +1043,11 @@ UDPSocket_Send(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
                   jsval *rval)
 {
     UDPSocket* udp = NULL;
-    char* peer = NULL;
-    JSUint32 ip = 0;
-    JSUint16 port = 0;
     JSString* data = NULL;
-    struct sockaddr_in addr;
-    socklen_t len;
-    int result;
-    int dotted = 1;
+    const char* bytes;
+    size_t length;
+    PSSockAddr addr;
+    char buf[UDPSOCKET_DATAGRAM_MAX];
     ssize_t nwritten;
 
     udp = (UDPSocket*) JS_GetPrivate(cx, obj);
@@ -532,84 +1063,447 @@ UDPSocket_Send(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
                              PSMSG_NOT_ENOUGH_ARGUMENTS);
         return JS_FALSE;
     }
-    if (JS_TypeOfValue(cx, argv[0]) != JSTYPE_STRING) {
+    if (!UDPSocket_Payload(cx, argv[0], &bytes, &data, &length)) {
+        return JS_FALSE;
+    }
+    if (!UDPSocket_Address(cx, udp, argv[1], argv[2], &addr)) {
+        return JS_FALSE;
+    }
+
+    /*
+     * Send the data, a string is copied first.
+     */
+    if (data) {
+        UDPSocket_GetBytes(data, buf);
+        bytes = buf;
+    }
+    nwritten = sendto(udp->fd, bytes, length, 0,
+                      &addr.sa, UDPSocket_AddressLength(&addr));
+    if (nwritten == -1) {
         JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
-                             PSMSG_ARGUMENT_NOT_STRING);
+                             PSMSG_SOCKET_ERROR);
+        return JS_FALSE;
+    }
+
+    return JS_TRUE;
+}
+
+/*
+ * Send a batch of prepared datagrams with a single system call. Returns the
+ * number of datagrams sent, which is less than requested if the socket buffer
+ * is full, or -1 on error.
+ */
+static int
+UDPSocket_SendDatagrams(UDPSocket* udp, struct iovec* iovs,
+                        PSSockAddr* addrs, int count)
+{
+#ifdef HAVE_SENDMMSG
+    struct mmsghdr msgs[UDPSOCKET_BATCH];
+    int n;
+
+    memset(msgs, 0, count * sizeof(struct mmsghdr));
+    for (int i = 0; i < count; ++i) {
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = &addrs[i];
+        msgs[i].msg_hdr.msg_namelen = UDPSocket_AddressLength(&addrs[i]);
+    }
+    do {
+        n = sendmmsg(udp->fd, msgs, count, 0);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        n = 0;
+    }
+    return n;
+#else
+    int n;
+
+    for (n = 0; n < count; ++n) {
+        if (sendto(udp->fd, iovs[n].iov_base, iovs[n].iov_len, 0,
+                   &addrs[n].sa, UDPSocket_AddressLength(&addrs[n])) < 0)
+        {
+            if (errno == EINTR) {
+                --n;
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK || n > 0) {
+                break;
+            }
+            return -1;
+        }
+    }
+    return n;
+#endif
+}
+
+/**
+ * Synopsis:
+ *      sendBatch(datagrams)
+ * Purpose:
+ *      Send a number of UDP packets at once.
+ * Parameters:
+ *      datagrams   Array
+ *              The packets to be transmitted, each an array holding the data,
+ *              the destination IP address and the destination port, as the
+ *              arguments of send(). The data of a ByteBuffer is not copied.
+ * Returns:
+ *      Integer The number of packets that have been sent. This is less than
+ *              the number of packets if the socket buffer is full, in which
+ *              case the remaining packets can be sent again later.
+ * Exceptions:
+ *      Not enough arguments specified
+ *      Argument out of range
+ *      Argument is not a string
+ *      Argument is not an integer
+ *      Socket error
+ *      Failed
+ */
+static JSBool
+UDPSocket_SendBatch(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
+                    jsval *rval)
+{
+    UDPSocket* udp = NULL;
+    JSObject* datagrams;
+    JSObject* datagram;
+    jsuint count, total = 0;
+    size_t length;
+    struct iovec iovs[UDPSOCKET_BATCH];
+    PSSockAddr addrs[UDPSOCKET_BATCH];
+    jsval fields[3];
+    JSBool copied[UDPSOCKET_BATCH];
+    JSString* str;
+    const char* payload;
+    char* bytes = NULL;
+    size_t size = 0;
+    int batch, sent = 0;
+
+    udp = (UDPSocket*) JS_GetPrivate(cx, obj);
+    if (!udp) {
         return JS_FALSE;
     }
-    data = JSVAL_TO_STRING(argv[0]);
-    if (JS_TypeOfValue(cx, argv[1]) != JSTYPE_STRING) {
+
+    /*
+     * Extract the datagrams.
+     */
+    if (argc < 1) {
         JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
-                             PSMSG_ARGUMENT_NOT_STRING);
+                             PSMSG_NOT_ENOUGH_ARGUMENTS);
         return JS_FALSE;
     }
-    peer = JS_GetStringBytes(JSVAL_TO_STRING(argv[1]));
-    if (JS_TypeOfValue(cx, argv[2]) != JSTYPE_NUMBER) {
+    if (JSVAL_IS_PRIMITIVE(argv[0]) ||
+        !JS_IsArrayObject(cx, JSVAL_TO_OBJECT(argv[0])))
+    {
         JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
-                             PSMSG_ARGUMENT_NOT_INT);
+                             PSMSG_FAILED, "argument is not an array");
+        return JS_FALSE;
+    }
+    datagrams = JSVAL_TO_OBJECT(argv[0]);
+    if (!JS_GetArrayLength(cx, datagrams, &count)) {
         return JS_FALSE;
     }
-    port = JSVAL_TO_INT(argv[2]);
 
-    /* 
-     * Get the IP address from the peer
+    /*
+     * Prepare and send the datagrams in batches, each batch with a single
+     * system call. The data of a batch is copied into a single buffer.
      */
-    for (char* cp = peer; *cp != '\0'; ++cp) {
-        if ((*cp < '0' || *cp > '9' ) && *cp != '.') {
-            dotted = 0;
+    while (total < count) {
+        size_t offset = 0;
+        batch = 0;
+        for (jsuint i = total; i < count && batch < UDPSOCKET_BATCH; ++i) {
+            if (!JS_GetElement(cx, datagrams, i, &fields[0])) {
+                goto failed;
+            }
+            if (JSVAL_IS_PRIMITIVE(fields[0]) ||
+                !JS_IsArrayObject(cx, JSVAL_TO_OBJECT(fields[0])))
+            {
+                JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                                     PSMSG_FAILED, "datagram is not an array");
+                goto failed;
+            }
+            datagram = JSVAL_TO_OBJECT(fields[0]);
+            if (!JS_GetElement(cx, datagram, 0, &fields[0]) ||
+                !JS_GetElement(cx, datagram, 1, &fields[1]) ||
+                !JS_GetElement(cx, datagram, 2, &fields[2]))
+            {
+                goto failed;
+            }
+            if (!UDPSocket_Payload(cx, fields[0], &payload, &str, &length)) {
+                goto failed;
+            }
+            if (!UDPSocket_Address(cx, udp, fields[1], fields[2],
+                                   &addrs[batch]))
+            {
+                goto failed;
+            }
+
+            /* The data of a ByteBuffer is sent as it is. */
+            copied[batch] = (str != NULL);
+            if (!str) {
+                iovs[batch].iov_base = (char*) payload;
+                iovs[batch].iov_len = length;
+                ++batch;
+                continue;
+            }
+            if (offset + length > size) {
+                char* grown;
+                size = 2 * (offset + length);
+                grown = (char*) JS_realloc(cx, bytes, size);
+                if (!grown) {
+                    goto failed;
+                }
+                /* Move the prepared data along with the buffer. */
+                for (int j = 0; j < batch; ++j) {
+                    if (copied[j]) {
+                        iovs[j].iov_base = grown +
+                                ((char*) iovs[j].iov_base - bytes);
+                    }
+                }
+                bytes = grown;
+            }
+            UDPSocket_GetBytes(str, bytes + offset);
+            iovs[batch].iov_base = bytes + offset;
+            iovs[batch].iov_len = length;
+            offset += length;
+            ++batch;
+        }
+
+        sent = UDPSocket_SendDatagrams(udp, iovs, addrs, batch);
+        if (sent < 0) {
+            JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                                 PSMSG_SOCKET_ERROR);
+            goto failed;
+        }
+        total += sent;
+        if (sent < batch) {
             break;
         }
     }
-    if (dotted) {
-        ip = inet_addr(peer);
+
+    if (bytes) {
+        JS_free(cx, bytes);
     }
-    else {
-        struct addrinfo* infos;
-        struct addrinfo* info;
-        struct addrinfo hint;
-
-        // Define any lookup hints
-        memset(&hint, 0, sizeof(struct addrinfo));
-        hint.ai_family = AF_INET;
-        hint.ai_socktype = SOCK_STREAM;
-        hint.ai_protocol = IPPROTO_TCP;
-
-        // Perform the lookup (this is likely to be expensive)
-        result = getaddrinfo(peer, NULL, &hint, &infos);
-        if (result != 0) {
+    return JS_NewNumberValue(cx, (jsdouble) total, rval);
+
+failed:
+    if (bytes) {
+        JS_free(cx, bytes);
+    }
+    return JS_FALSE;
+}
+
+/*
+ * Join or leave a multicast group.
+ */
+static JSBool
+UDPSocket_Membership(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
+                     int name)
+{
+    UDPSocket* udp = NULL;
+    struct ip_mreq mreq;
+    struct ipv6_mreq mreq6;
+
+    udp = (UDPSocket*) JS_GetPrivate(cx, obj);
+    if (!udp) {
+        return JS_FALSE;
+    }
+
+    /*
+     * Extract the parameters
+     */
+    if (argc < 1) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_NOT_ENOUGH_ARGUMENTS);
+        return JS_FALSE;
+    }
+
+    /*
+     * An IPv6 group is joined on the interface chosen by the system.
+     */
+    if (udp->family == AF_INET6 &&
+        JS_TypeOfValue(cx, argv[0]) == JSTYPE_STRING &&
+        inet_pton(AF_INET6, JS_GetStringBytes(JSVAL_TO_STRING(argv[0])),
+                  &mreq6.ipv6mr_multiaddr) == 1)
+    {
+        if (!IN6_IS_ADDR_MULTICAST(&mreq6.ipv6mr_multiaddr)) {
             JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
-                                 PSMSG_FAILED, "lookup error");
+                                 PSMSG_FAILED, "not a multicast address");
             return JS_FALSE;
         }
-        for (info = infos; info != NULL; info = info->ai_next)
+        mreq6.ipv6mr_interface = 0;
+        if (setsockopt(udp->fd, IPPROTO_IPV6,
+                       name == IP_ADD_MEMBERSHIP ? IPV6_JOIN_GROUP
+                                                 : IPV6_LEAVE_GROUP,
+                       &mreq6, sizeof(mreq6)) < 0)
         {
-            // Use the first match
-            ip = ((struct sockaddr_in*)info->ai_addr)->sin_addr.s_addr;
-            break;
+            JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                                 errno == EADDRINUSE ? PSMSG_ADDRESS_IN_USE
+                                                     : PSMSG_SOCKET_ERROR);
+            return JS_FALSE;
         }
-        freeaddrinfo(infos);
+        return JS_TRUE;
+    }
+    if (!UDPSocket_InterfaceAddress(cx, argv[0], &mreq.imr_multiaddr)) {
+        return JS_FALSE;
+    }
+    if (!IN_MULTICAST(ntohl(mreq.imr_multiaddr.s_addr))) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_FAILED, "not a multicast address");
+        return JS_FALSE;
+    }
+    mreq.imr_interface.s_addr = INADDR_ANY;
+    if (argc > 1 && !JSVAL_IS_VOID(argv[1]) &&
+        !UDPSocket_InterfaceAddress(cx, argv[1], &mreq.imr_interface))
+    {
+        return JS_FALSE;
     }
 
     /*
-     * Create the address structure.
+     * Change the membership.
      */
-    len = sizeof(addr);
-    memset(&addr, 0, sizeof(struct sockaddr_in));
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(port);
-    addr.sin_addr.s_addr = ip;
+    if (setsockopt(udp->fd, IPPROTO_IP, name, &mreq, sizeof(mreq)) < 0) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             errno == EADDRINUSE ? PSMSG_ADDRESS_IN_USE
+                                                 : PSMSG_SOCKET_ERROR);
+        return JS_FALSE;
+    }
+    return JS_TRUE;
+}
+
+/**
+ * Synopsis:
+ *      joinGroup(group, interface)
+ * Purpose:
+ *      Receive the UDP packets sent to a multicast group.
+ * Parameters:
+ *      group       String
+ *              The IP address of the multicast group. This may be an IPv6
+ *              address if the system supports IPv6.
+ *      interface   String (opt)
+ *              The IP address of the local interface to receive the packets
+ *              on. If omitted, or for an IPv6 group, the interface is chosen
+ *              by the system.
+ * Exceptions:
+ *      Not enough arguments specified
+ *      Argument is not a string
+ *      Address already in use
+ *      Socket error
+ *      Failed
+ * Additional Information:
+ *      The socket must have been created with the port the packets of the
+ *      group are sent to.
+ */
+static JSBool
+UDPSocket_JoinGroup(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
+                    jsval *rval)
+{
+    return UDPSocket_Membership(cx, obj, argc, argv, IP_ADD_MEMBERSHIP);
+}
+
+/**
+ * Synopsis:
+ *      leaveGroup(group, interface)
+ * Purpose:
+ *      Stop receiving the UDP packets sent to a multicast group.
+ * Parameters:
+ *      group       String
+ *              The IP address of the multicast group.
+ *      interface   String (opt)
+ *              The IP address of the local interface the group was joined on.
+ * Exceptions:
+ *      Not enough arguments specified
+ *      Argument is not a string
+ *      Socket error
+ *      Failed
+ */
+static JSBool
+UDPSocket_LeaveGroup(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
+                     jsval *rval)
+{
+    return UDPSocket_Membership(cx, obj, argc, argv, IP_DROP_MEMBERSHIP);
+}
+
+/**
+ * Synopsis:
+ *      discover(probe, host, port, timeout)
+ * Purpose:
+ *      Send a discovery probe and collect the responses until a deadline.
+ * Parameters:
+ *      probe   String or ByteBuffer
+ *              The data of the probe, may contain binary data.
+ *      host    String
+ *              The destination IP address of the probe, typically a multicast
+ *              group or a broadcast address.
+ *      port    Integer
+ *              The destination port of the probe.
+ *      timeout Integer
+ *              The time in milliseconds to wait for responses.
+ * Exceptions:
+ *      Not enough arguments specified
+ *      Argument out of range
+ *      Argument is not a string
+ *      Argument is not an integer
+ *      Socket error
+ *      Failed
+ * Additional Information:
+ *      Each response is passed to onData as soon as it arrives. When the
+ *      timeout expires, onDiscoverEnd is called, which would typically close
+ *      the socket. A discovery that is still in progress is ended without
+ *      calling onDiscoverEnd when a new probe is sent.
+ */
+static JSBool
+UDPSocket_Discover(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
+                   jsval *rval)
+{
+    UDPSocket* udp = NULL;
+    int timeout;
+
+    udp = (UDPSocket*) JS_GetPrivate(cx, obj);
+    if (!udp) {
+        return JS_FALSE;
+    }
 
     /*
-     * Send the data.
+     * Extract the timeout, the other parameters are those of send().
      */
-    nwritten = sendto(udp->fd, js_GetStringBytes(data), JSSTRING_LENGTH(data),
-                      0, (struct sockaddr*)&addr, sizeof(addr));
-    if (nwritten == -1) {
+    if (argc != 4) {
         JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
-                             PSMSG_SOCKET_ERROR);
+                             PSMSG_NOT_ENOUGH_ARGUMENTS);
+        return JS_FALSE;
+    }
+    if (!JSVAL_IS_INT(argv[3])) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_ARGUMENT_NOT_INT);
+        return JS_FALSE;
+    }
+    timeout = JSVAL_TO_INT(argv[3]);
+    if (timeout < 0) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_ARGUMENT_OUT_OF_RANGE);
+        return JS_FALSE;
+    }
+    if (udp->fd == -1) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_SOCKET_NOT_READY);
         return JS_FALSE;
     }
 
+    /*
+     * Send the probe and (re)start the deadline. The instance is rooted
+     * while it is open, which keeps it alive until the deadline.
+     */
+    if (!UDPSocket_Send(cx, obj, 3, argv, rval)) {
+        return JS_FALSE;
+    }
+    if (udp->discovery) {
+        ps_RemoveTimer(cx, udp->discovery);
+    }
+    udp->discovery = ps_AddTimer(cx, obj, &UDPSocket_DiscoverCallback,
+                                 timeout);
+    if (!udp->discovery) {
+        JS_ReportErrorNumber(cx, js_GetErrorMessage, NULL,
+                             PSMSG_FAILED, "discovery timer setup");
+        return JS_FALSE;
+    }
     return JS_TRUE;
 }
 
@@ -62,6 +62,9 @@
 #include "jsparse.h"
 #include "jsscope.h"
 #include "jsscript.h"
+#include "ext/psforkserver.h"
+#include "ext/psscriptcache.h"
+#include "ext/pssystem.h"
 
 #ifdef PERLCONNECT
 #include "perlconnect/jsperl.h"
@@ -104,7 +107,6 @@ int gExitCode = 0;
 JSBool gQuitting = JS_FALSE;
 FILE *gErrFile = NULL;
 FILE *gOutFile = NULL;
-const char *gModulePath = NULL;
 
 #ifdef JSDEBUGGER
 static JSDContext *_jsdc;
@@ -206,22 +208,15 @@ Process(JSContext *cx, JSObject *obj, char *filename)
 
     if (!isatty(fileno(file))) {
         /*
-         * It's not interactive - just execute it.
+         * It's not interactive - just execute it. A regular file is memory
+         * mapped and compiled from memory.
          *
          * Support the UNIX #! shell hack; gobble the first line if it starts
          * with '#'.  TODO - this isn't quite compatible with sharp variables,
          * as a legal js program (using sharp variables) might start with '#'.
          * But that would require multi-character lookahead.
          */
-        int ch = fgetc(file);
-        if (ch == '#') {
-            while((ch = fgetc(file)) != EOF) {
-                if (ch == '\n' || ch == '\r')
-                    break;
-            }
-        }
-        ungetc(ch, file);
-        script = JS_CompileFileHandle(cx, obj, filename, file);
+        script = ps_CompileFile(cx, obj, filename, file);
         if (script) {
             if (!compileOnly)
                 (void)JS_ExecuteScript(cx, obj, script, &result);
@@ -279,7 +274,8 @@ static int
 usage(void)
 {
     fprintf(gErrFile, "%s\n", JS_GetImplementationVersion());
-    fprintf(gErrFile, "usage: js [-PswWxC] [-b branchlimit] [-c stackchunksize] [-v version] [-m modulepath] [-f scriptfile] [-e script] [-S maxstacksize] [scriptfile] [scriptarg...]\n");
+    fprintf(gErrFile, "usage: js [-PswWxC] [-b branchlimit] [-c stackchunksize] [-v version] [-m modulepath] [-k cachedir] [-I snapshot] [-F socket] [-f scriptfile] [-e script] [-S maxstacksize] [scriptfile] [scriptarg...]\n");
+    fprintf(gErrFile, "       js -J socket [arg...]\n");
     return 2;
 }
 
@@ -333,6 +329,9 @@ ProcessArgs(JSContext *cx, JSObject *obj, char **argv, int argc)
           case 'c':
           case 'f':
           case 'e':
+          case 'F':
+          case 'I':
+          case 'k':
           case 'm':
           case 'v':
           case 'S':
@@ -428,9 +427,45 @@ ProcessArgs(JSContext *cx, JSObject *obj, char **argv, int argc)
             if (++i == argc) {
                 return usage();
             }
-            gModulePath = argv[i];
+            if (!ps_AddModulePath(argv[i])) {
+                return 1;
+            }
+            break;
+
+        case 'k':
+            if (++i == argc) {
+                return usage();
+            }
+            ps_SetScriptCacheDirectory(argv[i]);
+            break;
+
+        case 'I':
+            if (++i == argc) {
+                return usage();
+            }
+            ps_SetSnapshot(argv[i]);
             break;
 
+        case 'F':
+        {
+            char **jobArgv;
+            int jobArgc;
+
+            if (++i == argc) {
+                return usage();
+            }
+
+            /*
+             * Serve jobs, each of which is run by a forked copy of this
+             * process with the arguments of the job.
+             */
+            if (!ps_ForkServer(cx, argv[i], &jobArgv, &jobArgc)) {
+                return 1;
+            }
+            gExitCode = 0;
+            return ProcessArgs(cx, obj, jobArgv, jobArgc);
+        }
+
         case 'f':
             if (++i == argc) {
                 return usage();
@@ -2530,6 +2565,12 @@ main(int argc, char **argv, char **envp)
     argc--;
     argv++;
 
+    /*
+     * Run a job on a fork server, which has initialised the engine already.
+     */
+    if (argc >= 2 && strcmp(argv[0], "-J") == 0)
+        return ps_ForkClient(argv[1], argv + 2, argc - 2);
+
     rt = JS_NewRuntime(64L * 1024L * 1024L);
     if (!rt)
         return 1;
@@ -2634,6 +2675,8 @@ main(int argc, char **argv, char **envp)
         JSD_DebuggerOff(_jsdc);
 #endif  /* JSDEBUGGER */
 
+    ps_SaveSnapshot(cx);
+    ps_DestroyScriptCache(cx);
     JS_DestroyContext(cx);
     JS_DestroyRuntime(rt);
     JS_ShutDown();
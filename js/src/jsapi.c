@@ -78,8 +78,14 @@
 #include "jsstr.h"
 #include "prmjtime.h"
 #include "ext/jsunit.h"
+#include "ext/psbytebuffer.h"
+#include "ext/psdnsresolver.h"
+#include "ext/pshttpclient.h"
+#include "ext/psserial.h"
 #include "ext/pssystem.h"
+#include "ext/pstcpserver.h"
 #include "ext/pstcpsocket.h"
+#include "ext/pstimer.h"
 #include "ext/psudpsocket.h"
 
 #if JS_HAS_FILE_OBJECT
@@ -1196,8 +1202,14 @@ JS_InitStandardClasses(JSContext *cx, JSObject *obj)
 #endif
            js_InitDateClass(cx, obj) &&
            js_InitJSUnitClass(cx, obj) &&
+           ps_InitByteBufferClass(cx, obj) &&
+           ps_InitDNSResolverClass(cx, obj) &&
+           ps_InitHTTPClientClass(cx, obj) &&
+           ps_InitSerialClass(cx, obj) &&
            ps_InitSystemClass(cx, obj) &&
+           ps_InitTCPServerClass(cx, obj) &&
            ps_InitTCPSocketClass(cx, obj) &&
+           ps_InitTimerFunctions(cx, obj) &&
            ps_InitUDPSocketClass(cx, obj);
 }
 
@@ -1241,7 +1253,12 @@ static struct {
     {js_InitFileClass,              ATOM_OFFSET(File)},
 #endif
     {js_InitJSUnitClass,            ATOM_OFFSET(JSUnit)},
+    {ps_InitByteBufferClass,        ATOM_OFFSET(ByteBuffer)},
+    {ps_InitDNSResolverClass,       ATOM_OFFSET(DNSResolver)},
+    {ps_InitHTTPClientClass,        ATOM_OFFSET(HTTPClient)},
+    {ps_InitSerialClass,            ATOM_OFFSET(Serial)},
     {ps_InitSystemClass,            ATOM_OFFSET(System)},
+    {ps_InitTCPServerClass,         ATOM_OFFSET(TCPServer)},
     {ps_InitTCPSocketClass,         ATOM_OFFSET(TCPSocket)},
     {ps_InitUDPSocketClass,         ATOM_OFFSET(UDPSocket)},
     {NULL,                          0}
@@ -1279,6 +1296,7 @@ StdNameToAtom(JSContext *cx, JSStdName *stdn)
 
 #define EAGERLY_PINNED_ATOM(name)   ATOM_OFFSET(name), NULL
 #define LAZILY_PINNED_ATOM(name)    ATOM_OFFSET(lazy.name), js_##name##_str
+#define LAZILY_PINNED_PS_ATOM(name) ATOM_OFFSET(lazy.name), ps_##name##_str
 
 static JSStdName standard_class_names[] = {
     /* ECMA requires that eval be a direct property of the global object. */
@@ -1322,6 +1340,13 @@ static JSStdName standard_class_names[] = {
     {js_InitXMLClass,           LAZILY_PINNED_ATOM(isXMLName)},
 #endif
 
+    /* ProntoScript timer functions. */
+    {ps_InitTimerFunctions,     LAZILY_PINNED_PS_ATOM(scheduleAfter)},
+    {ps_InitTimerFunctions,     LAZILY_PINNED_PS_ATOM(setTimeout)},
+    {ps_InitTimerFunctions,     LAZILY_PINNED_PS_ATOM(setInterval)},
+    {ps_InitTimerFunctions,     LAZILY_PINNED_PS_ATOM(clearTimeout)},
+    {ps_InitTimerFunctions,     LAZILY_PINNED_PS_ATOM(clearInterval)},
+
     {NULL,                      0, NULL}
 };
 
@@ -1357,6 +1382,7 @@ static JSStdName object_prototype_names[] = {
 
 #undef EAGERLY_PINNED_ATOM
 #undef LAZILY_PINNED_ATOM
+#undef LAZILY_PINNED_PS_ATOM
 
 JS_PUBLIC_API(JSBool)
 JS_ResolveStandardClass(JSContext *cx, JSObject *obj, jsval id,
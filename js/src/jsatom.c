@@ -145,9 +145,19 @@ const char js_xml_str[]             = "xml";
 #endif
 
 const char js_JSUnit_str[]          = "JSUnit";
+const char ps_ByteBuffer_str[]      = "ByteBuffer";
+const char ps_DNSResolver_str[]     = "DNSResolver";
+const char ps_HTTPClient_str[]      = "HTTPClient";
+const char ps_Serial_str[]          = "Serial";
 const char ps_System_str[]          = "System";
+const char ps_TCPServer_str[]       = "TCPServer";
 const char ps_TCPSocket_str[]       = "TCPSocket";
 const char ps_UDPSocket_str[]       = "UDPSocket";
+const char ps_clearInterval_str[]   = "clearInterval";
+const char ps_clearTimeout_str[]    = "clearTimeout";
+const char ps_scheduleAfter_str[]   = "scheduleAfter";
+const char ps_setInterval_str[]     = "setInterval";
+const char ps_setTimeout_str[]      = "setTimeout";
 
 #ifdef NARCISSUS
 const char js_call_str[]             = "__call__";
@@ -366,7 +376,12 @@ js_InitPinnedAtoms(JSContext *cx, JSAtomState *state)
 #endif
 
     FROB(JSUnitAtom,              js_JSUnit_str);
+    FROB(ByteBufferAtom,          ps_ByteBuffer_str);
+    FROB(DNSResolverAtom,         ps_DNSResolver_str);
+    FROB(HTTPClientAtom,          ps_HTTPClient_str);
+    FROB(SerialAtom,              ps_Serial_str);
     FROB(SystemAtom,              ps_System_str);
+    FROB(TCPServerAtom,           ps_TCPServer_str);
     FROB(TCPSocketAtom,           ps_TCPSocket_str);
     FROB(UDPSocketAtom,           ps_UDPSocket_str);
 
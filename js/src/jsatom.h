@@ -219,7 +219,12 @@ struct JSAtomState {
 
     /* ProntoScript atoms */
     JSAtom              *JSUnitAtom;
+    JSAtom              *ByteBufferAtom;
+    JSAtom              *DNSResolverAtom;
+    JSAtom              *HTTPClientAtom;
+    JSAtom              *SerialAtom;
     JSAtom              *SystemAtom;
+    JSAtom              *TCPServerAtom;
     JSAtom              *TCPSocketAtom;
     JSAtom              *UDPSocketAtom;
 
@@ -259,6 +264,13 @@ struct JSAtomState {
         JSAtom          *unevalAtom;
         JSAtom          *unwatchAtom;
         JSAtom          *watchAtom;
+
+        /* ProntoScript atoms */
+        JSAtom          *clearIntervalAtom;
+        JSAtom          *clearTimeoutAtom;
+        JSAtom          *scheduleAfterAtom;
+        JSAtom          *setIntervalAtom;
+        JSAtom          *setTimeoutAtom;
     } lazy;
 
 #ifdef JS_THREADSAFE
@@ -336,9 +348,19 @@ extern const char   js_xml_str[];
 extern const char   js_JSUnit_str[];
 
 /* ProntoScript strings */
+extern const char   ps_ByteBuffer_str[];
+extern const char   ps_DNSResolver_str[];
+extern const char   ps_HTTPClient_str[];
+extern const char   ps_Serial_str[];
 extern const char   ps_System_str[];
+extern const char   ps_TCPServer_str[];
 extern const char   ps_TCPSocket_str[];
 extern const char   ps_UDPSocket_str[];
+extern const char   ps_clearInterval_str[];
+extern const char   ps_clearTimeout_str[];
+extern const char   ps_scheduleAfter_str[];
+extern const char   ps_setInterval_str[];
+extern const char   ps_setTimeout_str[];
 
 #ifdef NARCISSUS
 extern const char   js_call_str[];
@@ -0,0 +1,89 @@
+/*
+ * Binary data in a byte buffer
+ */
+
+function accessorTest() {
+    var buffer = new ByteBuffer(8);
+    suite.assert(8, buffer.length);
+    suite.assert(0, buffer.getUint32(4));
+    buffer.setUint16(0, 0xabcd);
+    buffer.setUint32(2, 0xdeadbeef, true);
+    buffer.setInt8(6, -2);
+    suite.assert(0xab, buffer.getUint8(0));
+    suite.assert(0xabcd, buffer.getUint16(0));
+    suite.assert(0xcdab, buffer.getUint16(0, true));
+    suite.assert(-21555, buffer.getInt16(0));
+    suite.assert(0xdeadbeef, buffer.getUint32(2, true));
+    suite.assert(-559038737, buffer.getInt32(2, true));
+    suite.assert(-2, buffer.getInt8(6));
+    suite.assert(254, buffer.getUint8(6));
+    var failed = false;
+    try {
+        buffer.getUint32(6);
+    }
+    catch (e) {
+        failed = true;
+    }
+    suite.assert(true, failed);
+}
+
+function sliceTest() {
+    var buffer = new ByteBuffer("\x00\x01\x02\x03\xff");
+    var slice = buffer.slice(1, -1);
+    suite.assert(3, slice.length);
+    suite.assert("\x01\x02\x03", slice.toString());
+    slice.setUint8(0, 0x80);
+    suite.assert(0x80, buffer.getUint8(1));
+    buffer.set(new ByteBuffer("ab"), 3);
+    suite.assert("\x80\x02a", slice.toString());
+    suite.assert("b", buffer.slice(-1).toString());
+    suite.assert(0, buffer.slice(4, 2).length);
+}
+
+function socketTest() {
+    var server = new TCPServer();
+    var message = new ByteBuffer(1024);
+    var received = null;
+    for (var i = 0; i < message.length; ++i) {
+        message.setUint8(i, i);
+    }
+    server.onAccept = function(socket) {
+        socket.binary = true;
+        socket.onData = function() {
+            this.write(this.read());
+        };
+        socket.onClose = function() {
+            server.close();
+        };
+    };
+    server.listen(0, "127.0.0.1");
+
+    var socket = new TCPSocket(false);
+    socket.binary = true;
+    socket.onConnect = function() {
+        this.write(message);
+    };
+    socket.onData = function() {
+        var data = this.read();
+        var total = (received ? received.length : 0) + data.length;
+        var buffer = new ByteBuffer(total);
+        if (received) {
+            buffer.set(received);
+        }
+        buffer.set(data, total - data.length);
+        received = buffer;
+        if (received.length == message.length) {
+            this.close();
+        }
+    };
+    socket.connect("127.0.0.1", server.port, 3000);
+    suite.events();
+    suite.assert(true, received instanceof ByteBuffer);
+    suite.assert(message.toString(), received.toString());
+}
+
+var suite = new JSUnit("Byte buffers");
+suite.add("Get and set integers", accessorTest);
+suite.add("Share bytes with a slice", sliceTest);
+suite.add("Send and receive binary data", socketTest);
+suite.run();
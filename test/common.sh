@@ -0,0 +1,37 @@
+# Common part of the test cases that run the prontoscript executable with its
+# command line options. The cases are reported in the same way as the JSUnit
+# test cases, and the test fails if any of them fails. Each test works in a
+# temporary directory of its own, which is removed when the test ends.
+
+PRONTOSCRIPT="$(pwd)/../js/src/prontoscript"
+WORK="$(mktemp -d)" || exit 1
+trap 'rm -rf "$WORK"' EXIT
+cd "$WORK" || exit 1
+
+total=0
+failed=0
+
+# check description command [argument...]
+check() {
+    description="$1"
+    shift
+    total=$((total + 1))
+    if "$@"; then
+        echo "PASS: $description"
+    else
+        echo "FAIL: $description"
+        failed=$((failed + 1))
+    fi
+}
+
+# Check the output of a script run, being its standard output.
+output_is() {
+    expected="$1"
+    shift
+    [ "$("$@" 2>/dev/null)" = "$expected" ]
+}
+
+finish() {
+    echo "Total: $total  Pass: $((total - failed))  Fail: $failed"
+    [ "$failed" -eq 0 ]
+}
@@ -0,0 +1,49 @@
+/*
+ * Resolving host names
+ */
+
+function resolveTest() {
+    var resolver = new DNSResolver();
+    var resolved = [];
+    resolver.onResolve = function(name, address) {
+        resolved.push(name + "=" + address);
+    };
+    resolver.resolve("localhost");
+    resolver.resolve("127.0.0.2");
+    resolver.resolve("localhost");
+    suite.assert(0, resolved.length);
+    suite.events();
+    suite.assert(3, resolved.length);
+    suite.assert(true, resolved.indexOf("localhost=127.0.0.1") != -1);
+    suite.assert(true, resolved.indexOf("127.0.0.2=127.0.0.2") != -1);
+}
+
+function resolveBlockingTest() {
+    var resolver = new DNSResolver(true);
+    suite.assert("127.0.0.1", resolver.resolve("localhost"));
+    suite.assert("127.0.0.1", resolver.resolve("localhost"));
+}
+
+function connectTest() {
+    var server = new TCPServer();
+    var socket = new TCPSocket(false);
+    var connected = false;
+    server.onAccept = function(accepted) {
+        accepted.close();
+        server.close();
+    };
+    server.listen(0, "127.0.0.1");
+    socket.onConnect = function() {
+        connected = true;
+        socket.close();
+    };
+    socket.connect("localhost", server.port, 3000);
+    suite.events();
+    suite.assert(true, connected);
+}
+
+var suite = new JSUnit("DNS resolver");
+suite.add("Resolve host names asynchronously", resolveTest);
+suite.add("Resolve a host name blocking", resolveBlockingTest);
+suite.add("Connect to a host name", connectTest);
+suite.run();
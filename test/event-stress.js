@@ -0,0 +1,44 @@
+/*
+ * Stress the asynchronous event handling with a large number of events
+ */
+
+function chainTest() {
+    var chains = 100;
+    var length = 1000;
+    var count = 0;
+    function step(remaining) {
+        ++count;
+        if (remaining > 1) {
+            setTimeout(step, 0, remaining - 1);
+        }
+    }
+    for (var i = 0; i < chains; ++i) {
+        setTimeout(step, 0, length);
+    }
+    suite.events();
+    suite.assert(chains * length, count);
+}
+
+function cancelTest() {
+    var timers = [];
+    var count = 0;
+    function cancel() {
+        /* Cancel all the other timers, which have expired in the same pass
+         * but are not handled yet. */
+        ++count;
+        for (var i = 0; i < timers.length; ++i) {
+            clearTimeout(timers[i]);
+        }
+        timers = [];
+    }
+    for (var i = 0; i < 1000; ++i) {
+        timers.push(setTimeout(cancel, 0));
+    }
+    suite.events();
+    suite.assert(1, count);
+}
+
+var suite = new JSUnit("Event stress");
+suite.add("Handle 100000 chained timers", chainTest);
+suite.add("Cancel timers while handling events", cancelTest);
+suite.run();
@@ -0,0 +1,38 @@
+# Jobs run on a fork server with -F socket and -J socket
+
+. "${srcdir:-.}/common.sh"
+
+"$PRONTOSCRIPT" -F "$WORK/socket" > /dev/null 2>&1 &
+server=$!
+trap 'kill $server 2>/dev/null; rm -rf "$WORK"' EXIT
+for i in $(seq 50); do
+    [ -S socket ] && break
+    sleep 0.1
+done
+
+echo 'print("hello " + arguments[0]);' > print.js
+echo 'quit(5);' > quit.js
+echo 'throw new Error("thrown");' > throw.js
+
+job() {
+    "$PRONTOSCRIPT" -J "$WORK/socket" "$@"
+}
+
+# exits_with code command [argument...]
+exits_with() {
+    expected="$1"
+    shift
+    "$@" > /dev/null 2>&1
+    [ $? -eq "$expected" ]
+}
+
+error_passed() {
+    job throw.js 2>&1 >/dev/null | grep -q thrown
+}
+
+check "Pass the standard output through" output_is "hello world" job print.js world
+check "Relay the exit code of a job" exits_with 0 job print.js world
+check "Relay the exit code of quit()" exits_with 5 job quit.js
+check "Relay the exit code of an exception" exits_with 3 job throw.js
+check "Pass the standard error through" error_passed
+finish
@@ -0,0 +1,98 @@
+/*
+ * Sending HTTP requests
+ */
+
+System.include("json2.js");
+
+function getTest() {
+    var status = 0;
+    var body = null;
+    HTTPClient.getHTTP("http://localhost:52001/large", function(data, code) {
+        body = data;
+        status = code;
+    });
+    suite.events();
+    suite.assert(200, status);
+    suite.assert(200, JSON.parse(body).length);
+}
+
+function postTest() {
+    var body = "0123456789";
+    while (body.length < 100000) {
+        body += body;
+    }
+    var response = null;
+    HTTPClient.request("POST", "http://localhost:52001/echo", body,
+        function(data) {
+            response = data;
+        });
+    suite.events();
+    suite.assert(body, response);
+}
+
+function errorTest() {
+    var error = null;
+    HTTPClient.getHTTP("http://127.0.0.1:1/", function() {
+        error = "success";
+    }, function(message) {
+        error = message;
+    });
+    suite.events();
+    suite.assert(true, error != null && error != "success");
+}
+
+/*
+ * Serve the responses on the connections that are accepted, counting the
+ * number of connections.
+ */
+function serve(aResponses, aConnections) {
+    var server = new TCPServer();
+    server.onAccept = function(socket) {
+        var request = "";
+        ++aConnections.count;
+        socket.onData = function() {
+            request += socket.read();
+            while (request.indexOf("\r\n\r\n") >= 0) {
+                request = request.substring(request.indexOf("\r\n\r\n") + 4);
+                socket.write(aResponses.shift());
+                if (aResponses.length == 0) {
+                    server.close();
+                }
+            }
+        };
+    };
+    server.listen(0, "127.0.0.1");
+    return server.port;
+}
+
+function keepAliveTest() {
+    var connections = { count: 0 };
+    var port = serve([
+        "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nfirst",
+        "HTTP/1.1 100 Continue\r\n\r\n" +
+            "HTTP/1.1 201 Created\r\nTransfer-Encoding: chunked\r\n\r\n" +
+            "3;ext\r\nsec\r\n4\r\nond!\r\n0\r\nX-Trailer: 1\r\n\r\n",
+        "HTTP/1.1 204 No Content\r\nConnection: close\r\n\r\n"
+    ], connections);
+    var url = "http://127.0.0.1:" + port + "/";
+    var responses = [];
+    HTTPClient.getHTTP(url, function(data, status) {
+        responses.push(status + ":" + data);
+        HTTPClient.getHTTP(url, function(data, status) {
+            responses.push(status + ":" + data);
+            HTTPClient.request("DELETE", url, null, function(data, status) {
+                responses.push(status + ":" + data);
+            }, null, { "X-Request": "last" });
+        });
+    });
+    suite.events();
+    suite.assert("200:first,201:second!,204:", responses.join(","));
+    suite.assert(1, connections.count);
+}
+
+var suite = new JSUnit("HTTP client");
+suite.add("Get a resource", getTest);
+suite.add("Post a request body", postTest);
+suite.add("Report a failed connection", errorTest);
+suite.add("Reuse the connection for chunked responses", keepAliveTest);
+suite.run();
@@ -0,0 +1,40 @@
+# Compiled scripts stored with -k cachedir
+
+. "${srcdir:-.}/common.sh"
+
+mkdir cache
+echo 'System.include("lib.js"); print(value);' > main.js
+
+# Replace the included script, keeping its modification time.
+replace() {
+    touch -r lib.js stamp
+    echo "$1" > lib.js
+    touch -r stamp lib.js
+}
+
+run() {
+    "$PRONTOSCRIPT" -k cache main.js
+}
+
+image_written() {
+    [ "$(run 2>/dev/null)" = 1 ] && [ -n "$(ls cache/*.jsc 2>/dev/null)" ]
+}
+
+other_engine() {
+    sed -i 's/JavaScript-C/JavaScript-X/' cache/*.jsc
+}
+
+echo 'var value = 1;' > lib.js
+check "Write the compiled image" image_written
+replace 'var value = 2;'
+check "Reuse the compiled image" output_is 1 run
+touch -d '+1 minute' lib.js
+check "Compile again when modified" output_is 2 run
+replace 'var value = 33;'
+check "Compile again when resized" output_is 33 run
+replace 'var value = 44;'
+other_engine
+check "Compile again for another engine" output_is 44 run
+replace 'var value = 55;'
+check "Reuse the image compiled again" output_is 44 run
+finish
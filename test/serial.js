@@ -0,0 +1,122 @@
+/*
+ * Serial ports, with a pseudo-terminal standing in for the attached device
+ */
+
+function settingsTest() {
+    var device = new Serial();
+    var port = new Serial(device.path);
+    var failed = false;
+    suite.assert(9600, port.bitrate);
+    suite.assert(8, port.databits);
+    suite.assert(0, port.parity);
+    suite.assert(1, port.stopbits);
+    port.bitrate = 115200;
+    port.databits = 7;
+    port.parity = 2;
+    port.stopbits = 2;
+    suite.assert(115200, port.bitrate);
+    suite.assert(7, port.databits);
+    suite.assert(2, port.parity);
+    suite.assert(2, port.stopbits);
+    try {
+        port.bitrate = 12345;
+    }
+    catch (e) {
+        failed = true;
+    }
+    suite.assert(true, failed);
+    suite.assert(115200, port.bitrate);
+    port.close();
+    device.close();
+}
+
+function blockingTest() {
+    var device = new Serial();
+    var port = new Serial(device.path);
+    device.send("ABCDEF\r");
+    suite.assert("ABCD", port.receive("", 4, 1000));
+    suite.assert("EF\r", port.match("", "\r", 1000));
+    suite.assert("", port.receive("", 1, 50));
+    port.send("status?");
+    suite.assert("status?", device.receive("", 7, 1000));
+    port.close();
+    device.close();
+}
+
+function matchTest() {
+    var device = new Serial();
+    var port = new Serial(device.path);
+    var responses = [];
+    device.onData = function(data) {
+        if (data == "POWER?\r") {
+            this.send("POWER=");
+            this.send("ON\rOK");
+        }
+    };
+    device.match("", "\r");
+    port.onData = function(data) {
+        responses.push(data);
+        if (responses.length == 1) {
+            this.receive("", 2, 1000);
+        }
+        else {
+            port.close();
+            device.close();
+        }
+    };
+    port.match("POWER?\r", "\r", 1000);
+    suite.events();
+    suite.assert(2, responses.length);
+    suite.assert("POWER=ON\r", responses[0]);
+    suite.assert("OK", responses[1]);
+}
+
+function timeoutTest() {
+    var device = new Serial();
+    var port = new Serial(device.path);
+    var partial = null;
+    port.onData = function(data) {
+        partial = "unexpected";
+    };
+    port.onTimeout = function(data) {
+        partial = data;
+        port.close();
+        device.close();
+    };
+    port.match("", "\r", 100);
+    device.send("no terminator");
+    suite.events();
+    suite.assert("no terminator", partial);
+}
+
+function streamTest() {
+    var device = new Serial();
+    var port = new Serial(device.path);
+    var block = "";
+    var received = 0;
+    for (var i = 0; i < 1024; ++i) {
+        block += String.fromCharCode(i % 256);
+    }
+    port.bitrate = 115200;
+    port.onData = function(data) {
+        received += data.length;
+        if (received == 256 * block.length) {
+            port.close();
+            device.close();
+        }
+    };
+    device.onData = function() {};
+    for (var i = 0; i < 256; ++i) {
+        device.send(block);
+    }
+    suite.events();
+    suite.assert(256 * block.length, received);
+}
+
+var suite = new JSUnit("Serial ports");
+suite.add("Configure the line settings", settingsTest);
+suite.add("Receive and match blocking", blockingTest);
+suite.add("Match responses asynchronously", matchTest);
+suite.add("Pass the partial data on a timeout", timeoutTest);
+suite.add("Stream data at a high rate", streamTest);
+suite.run();
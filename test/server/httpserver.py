@@ -39,6 +39,11 @@ request_map = [
           {"artist": "Led Zepelin", "title": "Communication Breakdown"}
         ]),
       "description": "Simple JSON request"
+    },
+    {
+      "path": "/large",
+      "value": json.dumps(["0123456789" * 100] * 200),
+      "description": "Large JSON response"
     }
 ]
 
@@ -58,11 +63,23 @@ class Handler(http.server.SimpleHTTPRequestHandler):
             print(f"No mapping for {self.path}")
             self.send_response(500)
 
+    def do_POST(self):
+        """
+        Echo the request body.
+        """
+        length = int(self.headers["Content-Length"])
+        body = self.rfile.read(length)
+        self.send_response(200)
+        self.send_header("Content-Type", "application/octet-stream")
+        self.end_headers()
+        self.wfile.write(body)
+
 # Start the server
 print(f"Starting HTTP server on http://localhost:{PORT}")
 print(f"Supported request queries:")
 for mapping in request_map:
     print(f"    {mapping['path']:10}  {mapping['description']:50}")
+print(f"Any POST request echoes its body")
 socketserver.TCPServer.allow_reuse_address = True
 with socketserver.TCPServer(("", PORT), Handler) as httpd:
     httpd.serve_forever()
@@ -0,0 +1,38 @@
+# Included scripts restored with -I snapshot
+
+. "${srcdir:-.}/common.sh"
+
+mkdir other
+echo 'System.include("lib.js"); print(value);' > main.js
+cp main.js other/main.js
+
+# Replace the included script, keeping its modification time.
+replace() {
+    touch -r lib.js stamp
+    echo "$1" > lib.js
+    touch -r stamp lib.js
+}
+
+run() {
+    "$PRONTOSCRIPT" -I "$WORK/snapshot" main.js
+}
+
+snapshot_written() {
+    [ "$(run 2>/dev/null)" = 1 ] && [ -s snapshot ]
+}
+
+run_elsewhere() {
+    (cd other && run)
+}
+
+echo 'var value = 1;' > lib.js
+echo 'var value = 9;' > other/lib.js
+check "Write the snapshot" snapshot_written
+replace 'var value = 2;'
+check "Restore the snapshot" output_is 1 run
+touch -d '+1 minute' lib.js
+check "Reject the snapshot when modified" output_is 2 run
+replace 'var value = 3;'
+check "Restore the snapshot written again" output_is 2 run
+check "Reject the snapshot elsewhere" output_is 9 run_elsewhere
+finish
@@ -0,0 +1,32 @@
+/*
+ * Scripts included once by System.include
+ */
+
+System.include("json2.js");
+
+function includeTest() {
+    var text = JSON.stringify({ artist: "Fleetwood Mac", tracks: [1, 2] });
+    var json = JSON;
+    JSON = undefined;
+    System.include("json2.js");
+    System.include("./json2.js");
+    suite.assert("undefined", typeof JSON);
+    JSON = json;
+    suite.assert(text, JSON.stringify(JSON.parse(text)));
+}
+
+function missingTest() {
+    var failed = false;
+    try {
+        System.include("no-such-module.js");
+    }
+    catch (e) {
+        failed = true;
+    }
+    suite.assert(true, failed);
+}
+
+var suite = new JSUnit("Script includes");
+suite.add("Include a script only once", includeTest);
+suite.add("Include a missing script", missingTest);
+suite.run();
@@ -0,0 +1,79 @@
+/*
+ * Accepting connections on a TCP server
+ */
+
+function echoTest() {
+    var server = new TCPServer();
+    var clients = 50;
+    var accepted = 0;
+    var closed = 0;
+    var echoed = 0;
+    server.onAccept = function(socket) {
+        ++accepted;
+        socket.onData = function() {
+            this.write(this.read());
+        };
+        socket.onClose = function() {
+            if (++closed == clients) {
+                server.close();
+            }
+        };
+    };
+    server.listen(0, "127.0.0.1");
+    suite.assert(true, server.listening);
+
+    for (var i = 0; i < clients; ++i) {
+        var socket = new TCPSocket(false);
+        socket.message = "client " + i;
+        socket.response = "";
+        socket.onConnect = function() {
+            this.write(this.message);
+        };
+        socket.onData = function() {
+            this.response += this.read();
+            if (this.response == this.message) {
+                ++echoed;
+                this.close();
+            }
+        };
+        socket.connect("127.0.0.1", server.port, 3000);
+    }
+    suite.events();
+    suite.assert(clients, accepted);
+    suite.assert(clients, echoed);
+    suite.assert(false, server.listening);
+}
+
+function reusePortTest() {
+    var first = new TCPServer();
+    var second = new TCPServer();
+    first.reusePort = true;
+    second.reusePort = true;
+    first.listen(0, "127.0.0.1");
+    second.listen(first.port, "127.0.0.1");
+    suite.assert(first.port, second.port);
+    first.close();
+    second.close();
+}
+
+function addressInUseTest() {
+    var first = new TCPServer();
+    var second = new TCPServer();
+    var failed = false;
+    first.listen(0, "127.0.0.1");
+    try {
+        second.listen(first.port, "127.0.0.1");
+    }
+    catch (e) {
+        failed = true;
+    }
+    first.close();
+    suite.assert(true, failed);
+    suite.assert(false, second.listening);
+}
+
+var suite = new JSUnit("TCP server");
+suite.add("Echo the data of accepted connections", echoTest);
+suite.add("Share a port between servers", reusePortTest);
+suite.add("Fail to listen on a port in use", addressInUseTest);
+suite.run();
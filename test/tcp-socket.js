@@ -0,0 +1,247 @@
+/*
+ * Receiving data on a TCP socket
+ */
+
+var request = "GET /large HTTP/1.0\r\n\r\n";
+
+function responseBody(aResponse) {
+    return aResponse.substring(aResponse.indexOf("\r\n\r\n") + 4);
+}
+
+function readAllTest() {
+    var socket = new TCPSocket(false);
+    var response = "";
+    var closed = false;
+    socket.onConnect = function() {
+        socket.write(request);
+    };
+    socket.onData = function() {
+        response += socket.read();
+    };
+    socket.onClose = function() {
+        closed = true;
+    };
+    socket.connect("localhost", 52001, 3000);
+    suite.events();
+    suite.assert(true, closed);
+    suite.assert(200, JSON.parse(responseBody(response)).length);
+}
+
+function readCountTest() {
+    var socket = new TCPSocket(false);
+    var response = "";
+    var largest = 0;
+    socket.onConnect = function() {
+        socket.write(request);
+    };
+    socket.onData = function() {
+        var data = socket.read(100);
+        largest = Math.max(largest, data.length);
+        response += data;
+    };
+    socket.connect("localhost", 52001, 3000);
+    suite.events();
+    suite.assert(100, largest);
+    suite.assert(200, JSON.parse(responseBody(response)).length);
+}
+
+function readBlockingTest() {
+    var socket = new TCPSocket(true);
+    socket.connect("localhost", 52001, 3000);
+    socket.write(request);
+    var status = socket.read(15);
+    socket.close();
+    suite.assert("HTTP/1.0 200 OK", status);
+}
+
+function writeQueueTest() {
+    var socket = new TCPSocket(false);
+    var body = "0123456789";
+    while (body.length < 8000000) {
+        body += body;
+    }
+    var response = "";
+    var queued = 0;
+    var drained = 0;
+    socket.onConnect = function() {
+        socket.write("POST /echo HTTP/1.0\r\n");
+        socket.write("Content-Length: " + body.length + "\r\n\r\n");
+        socket.write(body);
+        queued = socket.queuedBytes;
+    };
+    socket.onDrain = function() {
+        ++drained;
+    };
+    socket.onData = function() {
+        response += socket.read();
+    };
+    socket.connect("localhost", 52001, 3000);
+    suite.events();
+    suite.assert(queued > 0 ? 1 : 0, drained);
+    suite.assert(0, socket.queuedBytes);
+    suite.assert(body.length, responseBody(response).length);
+}
+
+System.include("json2.js");
+
+function serve(aWrites) {
+    var server = new TCPServer();
+    server.onAccept = function(socket) {
+        var next = function() {
+            if (aWrites.length == 0) {
+                socket.close();
+                server.close();
+                return;
+            }
+            socket.write(aWrites.shift());
+            setTimeout(next, 20);
+        };
+        next();
+    };
+    server.listen(0, "127.0.0.1");
+    return server.port;
+}
+
+function delimiterTest() {
+    var port = serve(["one\r\ntwo\r", "\nthr", "ee\r\nrest"]);
+    var socket = new TCPSocket(false);
+    var frames = [];
+    var rest = null;
+    socket.delimiter = "\r\n";
+    socket.onData = function(frame) {
+        frames.push(frame);
+    };
+    socket.onClose = function() {
+        rest = this.read();
+    };
+    socket.connect("127.0.0.1", port, 3000);
+    suite.events();
+    suite.assert("\r\n", socket.delimiter);
+    suite.assert("one,two,three", frames.join(","));
+    suite.assert("rest", rest);
+}
+
+function lengthPrefixTest() {
+    var port = serve(["\x00\x03abc\x00", "\x00\x00\x02\xff", "\xfe"]);
+    var socket = new TCPSocket(false);
+    var frames = [];
+    socket.lengthPrefix = 2;
+    socket.binary = true;
+    socket.onData = function(frame) {
+        frames.push(frame);
+    };
+    socket.connect("127.0.0.1", port, 3000);
+    suite.events();
+    suite.assert(3, frames.length);
+    suite.assert("abc", frames[0].toString());
+    suite.assert(0, frames[1].length);
+    suite.assert(0xfffe, frames[2].getUint16(0));
+}
+
+/*
+ * Send to a server that collects what it receives until the connection is
+ * closed.
+ */
+function collect(aSend, aReceived) {
+    var server = new TCPServer();
+    server.onAccept = function(socket) {
+        socket.onData = function() {
+            aReceived.data += socket.read();
+        };
+        socket.onClose = function() {
+            server.close();
+        };
+    };
+    server.listen(0, "127.0.0.1");
+    var socket = new TCPSocket(false);
+    socket.onConnect = function() {
+        aSend(socket);
+        if (socket.queuedBytes == 0) {
+            socket.close();
+        }
+    };
+    socket.onDrain = function() {
+        socket.close();
+    };
+    socket.connect("127.0.0.1", server.port, 3000);
+    suite.events();
+}
+
+function sendFileTest() {
+    var received = { data: "" };
+    collect(function(socket) {
+        socket.write("<");
+        socket.sendFile("tcp-socket.js", 3, 20);
+        socket.write(">");
+    }, received);
+    suite.assert("< * Receiving data on>", received.data);
+
+    received.data = "";
+    collect(function(socket) {
+        socket.sendFile("../js/src/prontoscript", 0, 1000000);
+        socket.sendFile("tcp-socket.js", 0, 2);
+    }, received);
+    suite.assert(1000002, received.data.length);
+    suite.assert("/*", received.data.substring(1000000));
+}
+
+function optionsTest() {
+    var server = new TCPServer();
+    var socket = new TCPSocket(false);
+    var exchanges = 0;
+    var start = 0;
+    var elapsed = -1;
+    server.onAccept = function(peer) {
+        peer.delimiter = "\n";
+        peer.onData = function(command) {
+            peer.write("OK " + command + "\n");
+        };
+    };
+    server.listen(0, "127.0.0.1");
+    suite.assert(true, socket.noDelay);
+    suite.assert(false, socket.keepAlive);
+    suite.assert(-1, socket.linger);
+    socket.keepAlive = true;
+    socket.keepAliveIdle = 30;
+    socket.keepAliveInterval = 5;
+    socket.keepAliveCount = 3;
+    socket.receiveBufferSize = 65536;
+    socket.linger = 0;
+    socket.quickAck = true;
+    socket.delimiter = "\n";
+
+    /* Each command is written in two parts, which Nagle's algorithm would
+     * hold back until the delayed acknowledgement of the first part. */
+    socket.onConnect = function() {
+        start = new Date().getTime();
+        socket.write("POW");
+        socket.write("ER?\n");
+    };
+    socket.onData = function(response) {
+        if (++exchanges < 20) {
+            socket.write("POW");
+            socket.write("ER?\n");
+            return;
+        }
+        elapsed = new Date().getTime() - start;
+        socket.close();
+        server.close();
+    };
+    socket.connect("127.0.0.1", server.port, 3000);
+    suite.events();
+    suite.assert(20, exchanges);
+    suite.assert(true, elapsed >= 0 && elapsed < 400);
+    suite.assert(30, socket.keepAliveIdle);
+    suite.assert(0, socket.linger);
+}
+
+var suite = new JSUnit("TCP socket receiving");
+suite.add("Read all the received data", readAllTest);
+suite.add("Read the received data in parts", readCountTest);
+suite.add("Read from a blocking socket", readBlockingTest);
+suite.add("Queue the data that cannot be sent right away", writeQueueTest);
+suite.add("Split the received data on a delimiter", delimiterTest);
+suite.add("Split the received data on a length header", lengthPrefixTest);
+suite.add("Send a file from the file system", sendFileTest);
+suite.add("Exchange commands without delay", optionsTest);
+suite.run();
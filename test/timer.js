@@ -0,0 +1,65 @@
+/*
+ * Timers on the asynchronous event handling
+ */
+
+function elapsedSince(start) {
+    return new Date().getTime() - start;
+}
+
+function setTimeoutTest() {
+    var start = new Date().getTime();
+    var elapsed = -1;
+    var args = "";
+    setTimeout(function(a, b) {
+        elapsed = elapsedSince(start);
+        args = a + b;
+    }, 100, "foo", "bar");
+    suite.events();
+    suite.assert(true, elapsed >= 100);
+    suite.assert("foobar", args);
+}
+
+function scheduleAfterTest() {
+    var id = "";
+    scheduleAfter(10, function(aId) {
+        id = aId;
+    }, "scheduled");
+    suite.events();
+    suite.assert("scheduled", id);
+}
+
+function orderTest() {
+    var order = "";
+    setTimeout(function() { order += "c"; }, 30);
+    setTimeout(function() { order += "a"; }, 0);
+    setTimeout(function() { order += "b"; }, 0);
+    suite.events();
+    suite.assert("abc", order);
+}
+
+function clearTimeoutTest() {
+    var called = false;
+    var timer = setTimeout(function() { called = true; }, 10);
+    setTimeout(function() { clearTimeout(timer); }, 0);
+    suite.events();
+    suite.assert(false, called);
+}
+
+function setIntervalTest() {
+    var count = 0;
+    var timer = setInterval(function() {
+        if (++count == 5) {
+            clearInterval(timer);
+        }
+    }, 5);
+    suite.events();
+    suite.assert(5, count);
+}
+
+var suite = new JSUnit("Timers");
+suite.add("Call a function after a timeout", setTimeoutTest);
+suite.add("Schedule a function after a duration", scheduleAfterTest);
+suite.add("Call functions in order of their timeout", orderTest);
+suite.add("Cancel a timer", clearTimeoutTest);
+suite.add("Call a function repeatedly", setIntervalTest);
+suite.run();
@@ -0,0 +1,125 @@
+/*
+ * Receiving and sending datagrams on a UDP socket
+ */
+
+function receiveTest() {
+    var receiver = new UDPSocket(52002);
+    var sender = new UDPSocket(52003);
+    var received = [];
+    var senders = 0;
+    receiver.onData = function(data, host, port) {
+        received.push(data);
+        if (host == "127.0.0.1" && port == 52003) {
+            ++senders;
+        }
+        if (received.length == 20) {
+            receiver.close();
+            sender.close();
+        }
+    };
+    for (var i = 0; i < 20; ++i) {
+        sender.send("datagram " + i, "127.0.0.1", 52002);
+    }
+    suite.events();
+    suite.assert(20, received.length);
+    suite.assert(20, senders);
+    suite.assert("datagram 0", received[0]);
+    suite.assert("datagram 19", received[19]);
+}
+
+function receiveLargeTest() {
+    var receiver = new UDPSocket(52002);
+    var sender = new UDPSocket();
+    var data = "";
+    var received = null;
+    for (var i = 0; i < 60000; ++i) {
+        data += String.fromCharCode(i % 256);
+    }
+    receiver.onData = function(aData) {
+        received = aData;
+        receiver.close();
+        sender.close();
+    };
+    sender.send(data, "127.0.0.1", 52002);
+    suite.events();
+    suite.assert(data.length, received.length);
+    suite.assert(true, data == received);
+}
+
+function sendBatchTest() {
+    var first = new UDPSocket(52002);
+    var second = new UDPSocket(52004);
+    var sender = new UDPSocket();
+    var datagrams = [];
+    var received = 0;
+    for (var i = 0; i < 40; ++i) {
+        datagrams.push(["datagram " + i, "127.0.0.1", i % 2 ? 52004 : 52002]);
+    }
+    first.onData = second.onData = function(data, host, port) {
+        if (++received == datagrams.length) {
+            first.close();
+            second.close();
+            sender.close();
+        }
+    };
+    suite.assert(datagrams.length, sender.sendBatch(datagrams));
+    suite.events();
+    suite.assert(datagrams.length, received);
+}
+
+function discoverTest() {
+    var device = new UDPSocket(52005);
+    var client = new UDPSocket();
+    var responses = [];
+    var ended = false;
+    device.joinGroup("239.255.0.1", "127.0.0.1");
+    device.onData = function(data, host, port) {
+        this.send("response to " + data, host, port);
+    };
+    client.multicastInterface = "127.0.0.1";
+    client.multicastTTL = 0;
+    client.onData = function(data) {
+        responses.push(data);
+    };
+    client.onDiscoverEnd = function() {
+        ended = true;
+        device.close();
+        client.close();
+    };
+    client.discover("probe", "239.255.0.1", 52005, 200);
+    suite.events();
+    suite.assert(true, ended);
+    suite.assert(1, responses.length);
+    suite.assert("response to probe", responses[0]);
+    suite.assert(0, client.multicastTTL);
+}
+
+function ipv6Test() {
+    var receiver = new UDPSocket(52006);
+    var sender = new UDPSocket(52007);
+    var received = [];
+    receiver.onData = function(data, host, port) {
+        received.push([data, host, port]);
+        if (received.length == 2) {
+            receiver.close();
+            sender.close();
+        }
+    };
+    sender.send("over IPv6", "::1", 52006);
+    sender.send("over IPv4", "127.0.0.1", 52006);
+    suite.events();
+    suite.assert(2, received.length);
+    suite.assert("over IPv6", received[0][0]);
+    suite.assert("::1", received[0][1]);
+    suite.assert(52007, received[0][2]);
+    suite.assert("over IPv4", received[1][0]);
+    suite.assert("127.0.0.1", received[1][1]);
+}
+
+var suite = new JSUnit("UDP sockets");
+suite.add("Receive each datagram separately", receiveTest);
+suite.add("Receive a large binary datagram", receiveLargeTest);
+suite.add("Send datagrams in a batch", sendBatchTest);
+suite.add("Discover devices on a multicast group", discoverTest);
+suite.add("Send and receive over IPv6 and IPv4", ipv6Test);
+suite.run();